@@ -1,9 +1,17 @@
-QT       += core gui svg xml
+QT       += core gui svg concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++11
 
+# QCborStreamReader/QCborStreamWriter need Qt 5.12
+lessThan(QT_MAJOR_VERSION, 6): lessThan(QT_MINOR_VERSION, 12): error("Qt 5.12 or later is required")
+
+# Banded PNG export streams rows through zlib: use the copy bundled with QtCore on Windows,
+# the system library elsewhere
+win32: INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+else: LIBS += -lz
+
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
 # depend on your compiler). Please consult the documentation of the
@@ -15,10 +23,31 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    chart/alignmentguides.cpp \
     chart/customtextedit.cpp \
     chart/connection.cpp \
+    chart/geometry.cpp \
+    chart/placementgrid.cpp \
+    chart/scenemodel.cpp \
+    chart/sceneio.cpp \
+    chart/geometrystore.cpp \
+    chart/objectpool.cpp \
+    chart/shapestyle.cpp \
+    chart/changeset.cpp \
+    chart/symbol.cpp \
+    chart/undostack.cpp \
+    chart/scenecommands.cpp \
+    chart/scenesnapshot.cpp \
+    chart/scenejournal.cpp \
+    chart/objectstate.cpp \
+    chart/revisionstore.cpp \
+    chart/binaryformat.cpp \
+    chart/cborformat.cpp \
+    chart/chunkeddocument.cpp \
+    chart/pngbandwriter.cpp \
     chart/shape.cpp \
     chart/shapefactory.cpp \
+    chart/spatialindex.cpp \
     drawingarea.cpp \
     main.cpp \
     mainwindow.cpp \
@@ -27,10 +56,31 @@ SOURCES += \
     util/Utils.cpp
 
 HEADERS += \
+    chart/alignmentguides.h \
     chart/customtextedit.h \
     chart/connection.h \
+    chart/geometry.h \
+    chart/placementgrid.h \
+    chart/scenemodel.h \
+    chart/sceneio.h \
+    chart/geometrystore.h \
+    chart/objectpool.h \
+    chart/shapestyle.h \
+    chart/changeset.h \
+    chart/symbol.h \
+    chart/undostack.h \
+    chart/scenecommands.h \
+    chart/scenesnapshot.h \
+    chart/scenejournal.h \
+    chart/objectstate.h \
+    chart/revisionstore.h \
+    chart/binaryformat.h \
+    chart/cborformat.h \
+    chart/chunkeddocument.h \
+    chart/pngbandwriter.h \
     chart/shape.h \
     chart/shapefactory.h \
+    chart/spatialindex.h \
     drawingarea.h \
     mainwindow.h \
     pagesettingdialog.h \
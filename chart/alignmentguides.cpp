@@ -0,0 +1,84 @@
+﻿#include "chart/alignmentguides.h"
+#include "chart/geometrystore.h"
+#include <algorithm>
+void AlignmentGuides::build(const GeometryStore& geometry, const QSet<const Shape*>& excluded)
+{
+    clear();
+    m_xs.reserve(geometry.liveCount() * 3);
+    m_ys.reserve(geometry.liveCount() * 3);
+    const QVector<QRect>& rects = geometry.rects();
+    const int count = geometry.slotCount();
+    for (int slot = 0; slot < count; ++slot) {
+        const Shape* shape = geometry.shape(slot);
+        if (!shape || excluded.contains(shape)) {
+            continue;
+        }
+        const QRect& rect = rects[slot];
+        m_xs << rect.left() << rect.center().x() << rect.right();
+        m_ys << rect.top() << rect.center().y() << rect.bottom();
+    }
+    std::sort(m_xs.begin(), m_xs.end());
+    std::sort(m_ys.begin(), m_ys.end());
+}
+void AlignmentGuides::clear()
+{
+    m_xs.clear();
+    m_ys.clear();
+}
+AlignmentGuides::SnapResult AlignmentGuides::snap(const QRect& rect, int threshold, int gridSize) const
+{
+    SnapResult result;
+    int xs[3] = { rect.left(), rect.center().x(), rect.right() };
+    int ys[3] = { rect.top(), rect.center().y(), rect.bottom() };
+    int bestDx = threshold + 1;
+    int bestDy = threshold + 1;
+    for (int i = 0; i < 3; ++i) {
+        int guide = 0;
+        if (findNearest(m_xs, xs[i], threshold, guide) && qAbs(guide - xs[i]) < qAbs(bestDx)) {
+            bestDx = guide - xs[i];
+            result.hasVerticalGuide = true;
+            result.verticalGuideX = guide;
+        }
+        if (findNearest(m_ys, ys[i], threshold, guide) && qAbs(guide - ys[i]) < qAbs(bestDy)) {
+            bestDy = guide - ys[i];
+            result.hasHorizontalGuide = true;
+            result.horizontalGuideY = guide;
+        }
+    }
+    if (result.hasVerticalGuide) {
+        result.offset.setX(bestDx);
+    } else if (gridSize > 0) {
+        result.offset.setX(snapToGrid(rect.left(), gridSize) - rect.left());
+    }
+    if (result.hasHorizontalGuide) {
+        result.offset.setY(bestDy);
+    } else if (gridSize > 0) {
+        result.offset.setY(snapToGrid(rect.top(), gridSize) - rect.top());
+    }
+    return result;
+}
+bool AlignmentGuides::findNearest(const QVector<int>& sorted, int value, int threshold, int& found)
+{
+    if (sorted.isEmpty()) {
+        return false;
+    }
+    QVector<int>::const_iterator it = std::lower_bound(sorted.constBegin(), sorted.constEnd(), value);
+    int bestDistance = threshold + 1;
+    if (it != sorted.constEnd() && *it - value < bestDistance) {
+        bestDistance = *it - value;
+        found = *it;
+    }
+    if (it != sorted.constBegin()) {
+        --it;
+        if (value - *it < bestDistance) {
+            bestDistance = value - *it;
+            found = *it;
+        }
+    }
+    return bestDistance <= threshold;
+}
+int AlignmentGuides::snapToGrid(int value, int gridSize)
+{
+    int lower = value >= 0 ? (value / gridSize) * gridSize : -(((-value + gridSize - 1) / gridSize) * gridSize);
+    return (value - lower) * 2 < gridSize ? lower : lower + gridSize;
+}
@@ -0,0 +1,42 @@
+#ifndef ALIGNMENTGUIDES_H
+#define ALIGNMENTGUIDES_H
+
+#include <QRect>
+#include <QVector>
+#include <QSet>
+
+class Shape;
+class GeometryStore;
+
+// 拖动图形时的智能对齐参考线
+// 拖动开始时把其余图形的左/中/右x坐标与上/中/下y坐标分别排序，
+// 之后每次移动只需在两个有序数组上二分查找最近的参考线
+class AlignmentGuides
+{
+public:
+    struct SnapResult {
+        QPoint offset;               // 需要叠加到移动矩形上的吸附偏移
+        bool hasVerticalGuide = false;
+        int verticalGuideX = 0;      // 命中的竖直参考线x坐标
+        bool hasHorizontalGuide = false;
+        int horizontalGuideY = 0;    // 命中的水平参考线y坐标
+    };
+
+    // 用场景中除excluded以外的图形建立参考线，直接读取几何存储的矩形数组
+    void build(const GeometryStore& geometry, const QSet<const Shape*>& excluded);
+    void clear();
+    bool isEmpty() const { return m_xs.isEmpty() && m_ys.isEmpty(); }
+
+    // 计算rect的吸附结果，未命中参考线时按gridSize吸附网格（gridSize<=0则不吸附）
+    SnapResult snap(const QRect& rect, int threshold, int gridSize) const;
+
+private:
+    // 在有序数组中查找距离value不超过threshold的最近值
+    static bool findNearest(const QVector<int>& sorted, int value, int threshold, int& found);
+    static int snapToGrid(int value, int gridSize);
+
+    QVector<int> m_xs;   // 左、中、右x坐标（有序）
+    QVector<int> m_ys;   // 上、中、下y坐标（有序）
+};
+
+#endif // ALIGNMENTGUIDES_H
@@ -0,0 +1,403 @@
+﻿#include "chart/binaryformat.h"
+#include "chart/scenemodel.h"
+#include "chart/objectstate.h"
+#include "chart/shape.h"
+#include "chart/shapestyle.h"
+#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
+#include <QFile>
+#include <QDataStream>
+#include <cstring>
+namespace {
+const char FileMagic[4] = { 'F', 'C', 'D', 'B' };
+const quint8 LittleEndianFile = 1;
+const quint8 BigEndianFile = 2;
+const quint8 HostByteOrder = Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? LittleEndianFile : BigEndianFile;
+const quint32 NoString = 0xffffffff;
+enum StyleFlag {
+    BoldFlag = 0x1,
+    ItalicFlag = 0x2,
+    UnderlineFlag = 0x4
+};
+struct Section
+{
+    quint64 offset;
+    quint32 count;
+    quint32 size;
+};
+struct FileHeader
+{
+    char magic[4];
+    quint16 version;
+    quint8 byteOrder;
+    quint8 reserved;
+    qint32 pageWidth;
+    qint32 pageHeight;
+    quint32 backgroundColor;    // QRgb
+    quint32 reserved2;
+    Section strings;            // StringEntry
+    Section stringData;         // QChar
+    Section styles;             // StyleEntry
+    Section shapes;             // ShapeEntry
+    Section connections;        // ConnectionEntry
+    Section overrides;          // OverrideEntry
+    Section symbols;            // QDataStream
+    Section revisions;          // RevisionStore::save()
+};
+struct StringEntry
+{
+    quint32 offset;             // 以QChar为单位
+    quint32 length;
+};
+struct StyleEntry
+{
+    double lineWidth;
+    quint32 fontFamily;
+    qint32 fontSize;
+    quint32 flags;
+    quint32 fontColor;
+    quint32 fillColor;
+    quint32 lineColor;
+    quint32 textAlignment;
+    qint32 transparency;
+    qint32 lineStyle;
+    quint32 reserved;
+};
+struct ShapeEntry
+{
+    qint32 x;
+    qint32 y;
+    qint32 width;
+    qint32 height;
+    quint32 text;
+    quint32 style;
+    quint16 typeId;
+    quint16 reserved;
+    qint32 symbol;              // 符号实例的母版下标，其他图形为-1
+    quint32 firstOverride;
+    quint32 overrideCount;
+};
+struct ConnectionEntry
+{
+    double startOutlineParam;
+    double endOutlineParam;
+    qint32 startShape;          // 所属图形下标，自由端点为-1
+    qint32 endShape;
+    qint32 startX;
+    qint32 startY;
+    qint32 endX;
+    qint32 endY;
+    quint8 startPosition;       // ConnectionPoint::Position
+    quint8 endPosition;
+    quint8 reserved[6];
+};
+struct OverrideEntry
+{
+    qint32 index;
+    quint32 text;
+};
+static_assert(sizeof(Section) == 16, "Section layout");
+static_assert(sizeof(FileHeader) == 152, "FileHeader layout");
+static_assert(sizeof(StyleEntry) == 48, "StyleEntry layout");
+static_assert(sizeof(ShapeEntry) == 40, "ShapeEntry layout");
+static_assert(sizeof(ConnectionEntry) == 48, "ConnectionEntry layout");
+// 写入时的字符串驻留表
+class StringTable
+{
+public:
+    quint32 intern(const QString& text)
+    {
+        QHash<QString, quint32>::const_iterator it = m_indices.constFind(text);
+        if (it != m_indices.constEnd()) {
+            return it.value();
+        }
+        StringEntry entry;
+        entry.offset = quint32(m_data.size() / sizeof(QChar));
+        entry.length = quint32(text.size());
+        m_data.append(reinterpret_cast<const char*>(text.constData()), text.size() * int(sizeof(QChar)));
+        quint32 index = quint32(m_entries.size());
+        m_entries.append(entry);
+        m_indices.insert(text, index);
+        return index;
+    }
+    const QVector<StringEntry>& entries() const { return m_entries; }
+    const QByteArray& data() const { return m_data; }
+
+private:
+    QHash<QString, quint32> m_indices;
+    QVector<StringEntry> m_entries;
+    QByteArray m_data;
+};
+template <typename T>
+QByteArray tableBytes(const QVector<T>& table)
+{
+    return QByteArray(reinterpret_cast<const char*>(table.constData()), table.size() * int(sizeof(T)));
+}
+void fillEndpoint(const ConnectionPoint& point, const QHash<const Shape*, int>& shapeIndices,
+                  qint32* shape, qint32* x, qint32* y, quint8* position, double* outlineParam)
+{
+    QPoint pos = point.isValid() ? point.getPosition() : QPoint();
+    *shape = point.getOwner() ? shapeIndices.value(point.getOwner(), -1) : -1;
+    *x = pos.x();
+    *y = pos.y();
+    *position = quint8(point.getPositionType());
+    *outlineParam = point.getOutlineParam();
+}
+ConnectionPoint readEndpoint(const QVector<Shape*>& shapes, qint32 shape, qint32 x, qint32 y,
+                             quint8 position, double outlineParam)
+{
+    EndpointState state;
+    state.position = position <= ConnectionPoint::Invalid ? static_cast<ConnectionPoint::Position>(position)
+                                                          : ConnectionPoint::Invalid;
+    state.outlineParam = outlineParam;
+    state.freePosition = QPoint(x, y);
+    return state.toPoint(shapes.value(shape, nullptr));
+}
+// 检查表是否完整落在文件内且大小与记录数一致
+template <typename T>
+const T* sectionTable(const uchar* data, qint64 fileSize, const Section& section)
+{
+    if (section.offset > quint64(fileSize) || section.size > quint64(fileSize) - section.offset
+        || quint64(section.size) != quint64(section.count) * sizeof(T) || section.offset % alignof(T) != 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<const T*>(data + section.offset);
+}
+QByteArray sectionBytes(const uchar* data, qint64 fileSize, const Section& section)
+{
+    if (section.offset > quint64(fileSize) || section.size > quint64(fileSize) - section.offset) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(data + section.offset), int(section.size));
+}
+}
+bool BinaryFormat::write(const SceneSnapshot& scene, const QString& filePath)
+{
+    StringTable strings;
+    QVector<StyleEntry> styles;
+    QHash<const ShapeStyle*, quint32> styleIndices;
+    QVector<ShapeEntry> shapes;
+    QVector<OverrideEntry> overrides;
+    shapes.reserve(scene.shapes().size());
+    for (const ShapeRecordRef& record : scene.shapes()) {
+        const Shape* shape = record->shape();
+        const ShapeStyle* style = shape->style().data();
+        QHash<const ShapeStyle*, quint32>::const_iterator styleIt = styleIndices.constFind(style);
+        quint32 styleIndex;
+        if (styleIt != styleIndices.constEnd()) {
+            styleIndex = styleIt.value();
+        } else {
+            StyleEntry entry;
+            std::memset(&entry, 0, sizeof(entry));
+            entry.lineWidth = style->lineWidth();
+            entry.fontFamily = strings.intern(style->fontFamily());
+            entry.fontSize = style->fontSize();
+            entry.flags = (style->isFontBold() ? BoldFlag : 0) | (style->isFontItalic() ? ItalicFlag : 0)
+                          | (style->isFontUnderline() ? UnderlineFlag : 0);
+            entry.fontColor = style->fontColor().rgba();
+            entry.fillColor = style->fillColor().rgba();
+            entry.lineColor = style->lineColor().rgba();
+            entry.textAlignment = quint32(style->textAlignment());
+            entry.transparency = style->transparency();
+            entry.lineStyle = style->lineStyle();
+            styleIndex = quint32(styles.size());
+            styles.append(entry);
+            styleIndices.insert(style, styleIndex);
+        }
+        ShapeEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        QRect rect = shape->getRect();
+        entry.x = rect.x();
+        entry.y = rect.y();
+        entry.width = rect.width();
+        entry.height = rect.height();
+        entry.text = shape->text().isEmpty() ? NoString : strings.intern(shape->text());
+        entry.style = styleIndex;
+        entry.typeId = quint16(shape->typeId());
+        entry.symbol = -1;
+        if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+            const SymbolInstance* instance = static_cast<const SymbolInstance*>(shape);
+            entry.symbol = scene.indexOfSymbol(instance->master().data());
+            entry.firstOverride = quint32(overrides.size());
+            for (QHash<int, QString>::const_iterator it = instance->textOverrides().constBegin();
+                 it != instance->textOverrides().constEnd(); ++it) {
+                OverrideEntry overrideEntry;
+                overrideEntry.index = it.key();
+                overrideEntry.text = strings.intern(it.value());
+                overrides.append(overrideEntry);
+            }
+            entry.overrideCount = quint32(overrides.size()) - entry.firstOverride;
+        }
+        shapes.append(entry);
+    }
+    QVector<ConnectionEntry> connections;
+    connections.reserve(scene.connections().size());
+    for (const ConnectionRecordRef& record : scene.connections()) {
+        ConnectionEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        fillEndpoint(record->startPoint(), scene.shapeIndices(), &entry.startShape, &entry.startX, &entry.startY,
+                     &entry.startPosition, &entry.startOutlineParam);
+        fillEndpoint(record->endPoint(), scene.shapeIndices(), &entry.endShape, &entry.endX, &entry.endY,
+                     &entry.endPosition, &entry.endOutlineParam);
+        connections.append(entry);
+    }
+    // 母版数量很少，沿用ShapeState/EndpointState的流式编码
+    QByteArray symbols;
+    QDataStream symbolsOut(&symbols, QIODevice::WriteOnly);
+    writeSymbols(symbolsOut, scene.symbols());
+    QByteArray revisions = scene.revisions().isEmpty() ? QByteArray() : scene.revisions().save();
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FileMagic, sizeof(header.magic));
+    header.version = Version;
+    header.byteOrder = HostByteOrder;
+    header.pageWidth = scene.pageSize().width();
+    header.pageHeight = scene.pageSize().height();
+    header.backgroundColor = scene.backgroundColor().rgba();
+    struct Part { Section* section; quint32 count; QByteArray bytes; };
+    Part parts[] = {
+        { &header.strings, quint32(strings.entries().size()), tableBytes(strings.entries()) },
+        { &header.stringData, quint32(strings.data().size() / sizeof(QChar)), strings.data() },
+        { &header.styles, quint32(styles.size()), tableBytes(styles) },
+        { &header.shapes, quint32(shapes.size()), tableBytes(shapes) },
+        { &header.connections, quint32(connections.size()), tableBytes(connections) },
+        { &header.overrides, quint32(overrides.size()), tableBytes(overrides) },
+        { &header.symbols, 1, symbols },
+        { &header.revisions, 1, revisions }
+    };
+    quint64 offset = sizeof(FileHeader);
+    for (Part& part : parts) {
+        offset = (offset + 7) & ~quint64(7);
+        part.section->offset = offset;
+        part.section->count = part.count;
+        part.section->size = quint32(part.bytes.size());
+        offset += quint64(part.bytes.size());
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[8] = { 0 };
+    for (const Part& part : parts) {
+        file.write(padding, qint64(part.section->offset) - file.pos());
+        file.write(part.bytes);
+    }
+    bool ok = file.error() == QFileDevice::NoError;
+    file.close();
+    return ok;
+}
+bool BinaryFormat::read(SceneModel& scene, const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(FileHeader))) {
+        return false;
+    }
+    const qint64 fileSize = file.size();
+    const uchar* data = file.map(0, fileSize);
+    if (!data) {
+        return false;
+    }
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+    if (std::memcmp(header->magic, FileMagic, sizeof(header->magic)) != 0 || header->version != Version
+        || header->byteOrder != HostByteOrder) {
+        file.unmap(const_cast<uchar*>(data));
+        return false;
+    }
+    const StringEntry* stringEntries = sectionTable<StringEntry>(data, fileSize, header->strings);
+    const QChar* stringData = sectionTable<QChar>(data, fileSize, header->stringData);
+    const StyleEntry* styleEntries = sectionTable<StyleEntry>(data, fileSize, header->styles);
+    const ShapeEntry* shapeEntries = sectionTable<ShapeEntry>(data, fileSize, header->shapes);
+    const ConnectionEntry* connectionEntries = sectionTable<ConnectionEntry>(data, fileSize, header->connections);
+    const OverrideEntry* overrideEntries = sectionTable<OverrideEntry>(data, fileSize, header->overrides);
+    if (!stringEntries || !stringData || !styleEntries || !shapeEntries || !connectionEntries || !overrideEntries) {
+        file.unmap(const_cast<uchar*>(data));
+        return false;
+    }
+    scene.clear();
+    QVector<QString> strings;
+    strings.reserve(int(header->strings.count));
+    for (quint32 i = 0; i < header->strings.count; ++i) {
+        const StringEntry& entry = stringEntries[i];
+        bool valid = entry.offset <= header->stringData.count && entry.length <= header->stringData.count - entry.offset;
+        strings.append(valid ? QString(stringData + entry.offset, int(entry.length)) : QString());
+    }
+    QVector<ShapeStyleRef> styles;
+    styles.reserve(int(header->styles.count));
+    for (quint32 i = 0; i < header->styles.count; ++i) {
+        const StyleEntry& entry = styleEntries[i];
+        ShapeStyle style;
+        style.setFontFamily(strings.value(int(entry.fontFamily)));
+        style.setFontSize(entry.fontSize);
+        style.setFontBold(entry.flags & BoldFlag);
+        style.setFontItalic(entry.flags & ItalicFlag);
+        style.setFontUnderline(entry.flags & UnderlineFlag);
+        style.setFontColor(QColor::fromRgba(entry.fontColor));
+        style.setFillColor(QColor::fromRgba(entry.fillColor));
+        style.setLineColor(QColor::fromRgba(entry.lineColor));
+        style.setTextAlignment(Qt::Alignment(QFlag(int(entry.textAlignment))));
+        style.setTransparency(entry.transparency);
+        style.setLineWidth(entry.lineWidth);
+        style.setLineStyle(entry.lineStyle);
+        styles.append(ShapeStyle::intern(style));
+    }
+    QDataStream symbolsIn(sectionBytes(data, fileSize, header->symbols));
+    QVector<QSharedPointer<Symbol>> symbols = readSymbols(symbolsIn);
+    for (const QSharedPointer<Symbol>& symbol : symbols) {
+        scene.addSymbol(symbol);
+    }
+    ObjectPool::Scope poolScope(scene.pool());
+    scene.beginChanges();
+    scene.setPageSize(QSize(header->pageWidth, header->pageHeight));
+    scene.setBackgroundColor(QColor::fromRgba(header->backgroundColor));
+    const ShapeFactory& factory = ShapeFactory::instance();
+    QVector<Shape*> shapes;
+    shapes.reserve(int(header->shapes.count));
+    for (quint32 i = 0; i < header->shapes.count; ++i) {
+        const ShapeEntry& entry = shapeEntries[i];
+        Shape* shape = nullptr;
+        if (entry.typeId == ShapeFactory::SymbolInstanceType) {
+            QSharedPointer<Symbol> master = symbols.value(entry.symbol);
+            if (master) {
+                SymbolInstance* instance = new SymbolInstance(master);
+                for (quint32 j = 0; j < entry.overrideCount && entry.firstOverride + j < header->overrides.count; ++j) {
+                    const OverrideEntry& overrideEntry = overrideEntries[entry.firstOverride + j];
+                    instance->setTextOverride(overrideEntry.index, strings.value(int(overrideEntry.text)));
+                }
+                shape = instance;
+            }
+        } else {
+            shape = factory.createShape(static_cast<ShapeFactory::TypeId>(entry.typeId),
+                                        qMax(qMin(entry.width, entry.height) / 2, 30));
+        }
+        shapes.append(shape);
+        if (!shape) {
+            continue;
+        }
+        shape->setRect(QRect(entry.x, entry.y, entry.width, entry.height));
+        if (entry.text != NoString) {
+            shape->setText(strings.value(int(entry.text)));
+        }
+        shape->setStyle(styles.value(int(entry.style), ShapeStyle::defaultStyle()));
+        scene.addShape(shape);
+    }
+    for (quint32 i = 0; i < header->connections.count; ++i) {
+        const ConnectionEntry& entry = connectionEntries[i];
+        ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+        connection->setStartPoint(readEndpoint(shapes, entry.startShape, entry.startX, entry.startY,
+                                               entry.startPosition, entry.startOutlineParam));
+        connection->setEndPoint(readEndpoint(shapes, entry.endShape, entry.endX, entry.endY,
+                                             entry.endPosition, entry.endOutlineParam));
+        scene.addConnection(connection);
+    }
+    if (header->revisions.size > 0) {
+        RevisionStore revisions;
+        if (revisions.load(sectionBytes(data, fileSize, header->revisions))) {
+            scene.setRevisions(revisions);
+        }
+    }
+    scene.endChanges();
+    file.unmap(const_cast<uchar*>(data));
+    return true;
+}
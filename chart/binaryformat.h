@@ -0,0 +1,23 @@
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+#include <QString>
+
+class SceneModel;
+class SceneSnapshot;
+
+// 原生二进制文档格式（.fcd）
+// 文件由固定布局的表组成：文件头、字符串表（文字与字体名去重，UTF-16存放）、样式表、
+// 图形表、连线表、文字覆盖表，以及母版和修订历史两段变长数据；各表按8字节对齐
+// 读取时用QFile::map映射整个文件，直接按偏移访问各表，不做任何文本解析
+// 表按本机字节序写入，文件头记录字节序，字节序不同的文件拒绝打开
+class BinaryFormat
+{
+public:
+    static const quint16 Version = 1;
+
+    static bool write(const SceneSnapshot& scene, const QString& filePath);
+    static bool read(SceneModel& scene, const QString& filePath);
+};
+
+#endif // BINARYFORMAT_H
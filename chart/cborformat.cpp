@@ -0,0 +1,455 @@
+﻿#include "chart/cborformat.h"
+#include "chart/scenemodel.h"
+#include "chart/objectstate.h"
+#include "chart/shape.h"
+#include "chart/shapestyle.h"
+#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
+#include <QFile>
+#include <QCborStreamWriter>
+#include <QCborStreamReader>
+namespace {
+const char FormatName[] = "flowchart";
+const char KeyFormat[] = "format";
+const char KeyVersion[] = "version";
+const char KeyPage[] = "page";
+const char KeySymbols[] = "symbols";
+const char KeyShapes[] = "shapes";
+const char KeyConnections[] = "connections";
+const char KeyRevisions[] = "revisions";
+enum StyleFlag {
+    BoldFlag = 0x1,
+    ItalicFlag = 0x2,
+    UnderlineFlag = 0x4
+};
+// 写入端：样式第一次出现时内联写出并编号，之后只写编号
+class CborWriter
+{
+public:
+    explicit CborWriter(QIODevice* device) : m_out(device) {}
+    QCborStreamWriter& out() { return m_out; }
+    void writeKey(const char* key) { m_out.append(QLatin1String(key)); }
+    void writeStyle(const ShapeStyleRef& style)
+    {
+        QHash<const ShapeStyle*, qint64>::const_iterator it = m_styleIndices.constFind(style.data());
+        if (it != m_styleIndices.constEnd()) {
+            m_out.append(it.value());
+            return;
+        }
+        m_styleIndices.insert(style.data(), qint64(m_styleIndices.size()));
+        m_out.startArray(10);
+        m_out.append(style->fontFamily());
+        m_out.append(qint64(style->fontSize()));
+        m_out.append(qint64((style->isFontBold() ? BoldFlag : 0) | (style->isFontItalic() ? ItalicFlag : 0)
+                            | (style->isFontUnderline() ? UnderlineFlag : 0)));
+        m_out.append(quint64(style->fontColor().rgba()));
+        m_out.append(qint64(style->textAlignment()));
+        m_out.append(quint64(style->fillColor().rgba()));
+        m_out.append(quint64(style->lineColor().rgba()));
+        m_out.append(qint64(style->transparency()));
+        m_out.append(double(style->lineWidth()));
+        m_out.append(qint64(style->lineStyle()));
+        m_out.endArray();
+    }
+    void writeShape(const ShapeState& state)
+    {
+        bool instance = state.typeId == ShapeFactory::SymbolInstanceType;
+        m_out.startArray(instance ? 9 : 7);
+        m_out.append(qint64(state.typeId));
+        m_out.append(qint64(state.rect.x()));
+        m_out.append(qint64(state.rect.y()));
+        m_out.append(qint64(state.rect.width()));
+        m_out.append(qint64(state.rect.height()));
+        m_out.append(state.text);
+        writeStyle(state.style);
+        if (instance) {
+            m_out.append(qint64(state.symbolIndex));
+            m_out.startMap(quint64(state.textOverrides.size()));
+            for (QHash<int, QString>::const_iterator it = state.textOverrides.constBegin();
+                 it != state.textOverrides.constEnd(); ++it) {
+                m_out.append(qint64(it.key()));
+                m_out.append(it.value());
+            }
+            m_out.endMap();
+        }
+        m_out.endArray();
+    }
+    void writeEndpoint(const ConnectionPoint& point, const QHash<const Shape*, int>& shapeIndices)
+    {
+        QPoint pos = point.isValid() ? point.getPosition() : QPoint();
+        int owner = point.getOwner() ? shapeIndices.value(point.getOwner(), -1) : -1;
+        m_out.startArray(5);
+        m_out.append(qint64(point.getPositionType()));
+        if (owner >= 0) {
+            m_out.append(qint64(owner));
+        } else {
+            m_out.appendNull();
+        }
+        m_out.append(point.getOutlineParam());
+        m_out.append(qint64(pos.x()));
+        m_out.append(qint64(pos.y()));
+        m_out.endArray();
+    }
+    void writeConnection(const ConnectionPoint& start, const ConnectionPoint& end,
+                         const QHash<const Shape*, int>& shapeIndices)
+    {
+        m_out.startArray(2);
+        writeEndpoint(start, shapeIndices);
+        writeEndpoint(end, shapeIndices);
+        m_out.endArray();
+    }
+
+private:
+    QCborStreamWriter m_out;
+    QHash<const ShapeStyle*, qint64> m_styleIndices;
+};
+// 读取端：每个读取函数消费当前元素并前进到下一个，类型不符时跳过该元素返回默认值
+class CborReader
+{
+public:
+    explicit CborReader(QIODevice* device) : m_in(device) {}
+    bool hasError() { return m_in.lastError() != QCborError::NoError; }
+    bool hasNext() { return !hasError() && m_in.hasNext(); }
+    void skip()
+    {
+        if (hasNext()) {
+            m_in.next();
+        }
+    }
+    // 当前元素是数组或映射时进入并返回true，否则跳过
+    bool enterContainer()
+    {
+        if (hasNext() && (m_in.isArray() || m_in.isMap())) {
+            return m_in.enterContainer();
+        }
+        skip();
+        return false;
+    }
+    // 跳过容器中剩余的元素并离开
+    void leaveContainer()
+    {
+        while (hasNext()) {
+            m_in.next();
+        }
+        if (!hasError()) {
+            m_in.leaveContainer();
+        }
+    }
+    bool isNull() { return hasNext() && m_in.isNull(); }
+    qint64 integer(qint64 fallback = 0)
+    {
+        if (!hasNext()) {
+            return fallback;
+        }
+        qint64 value = m_in.isInteger() ? m_in.toInteger() : fallback;
+        m_in.next();
+        return value;
+    }
+    double real()
+    {
+        if (!hasNext()) {
+            return 0.0;
+        }
+        double value = 0.0;
+        if (m_in.isDouble()) {
+            value = m_in.toDouble();
+        } else if (m_in.isFloat()) {
+            value = m_in.toFloat();
+        } else if (m_in.isInteger()) {
+            value = double(m_in.toInteger());
+        }
+        m_in.next();
+        return value;
+    }
+    QString string()
+    {
+        QString result;
+        if (!hasNext() || !m_in.isString()) {
+            skip();
+            return result;
+        }
+        QCborStreamReader::StringResult<QString> chunk = m_in.readString();
+        while (chunk.status == QCborStreamReader::Ok) {
+            result += chunk.data;
+            chunk = m_in.readString();
+        }
+        return result;
+    }
+    QByteArray bytes()
+    {
+        QByteArray result;
+        if (!hasNext() || !m_in.isByteArray()) {
+            skip();
+            return result;
+        }
+        QCborStreamReader::StringResult<QByteArray> chunk = m_in.readByteArray();
+        while (chunk.status == QCborStreamReader::Ok) {
+            result += chunk.data;
+            chunk = m_in.readByteArray();
+        }
+        return result;
+    }
+    ShapeStyleRef style()
+    {
+        if (hasNext() && m_in.isInteger()) {
+            return m_styles.value(int(integer(-1)), ShapeStyle::defaultStyle());
+        }
+        if (!enterContainer()) {
+            return ShapeStyle::defaultStyle();
+        }
+        ShapeStyle style;
+        style.setFontFamily(string());
+        style.setFontSize(int(integer(style.fontSize())));
+        qint64 flags = integer();
+        style.setFontBold(flags & BoldFlag);
+        style.setFontItalic(flags & ItalicFlag);
+        style.setFontUnderline(flags & UnderlineFlag);
+        style.setFontColor(QColor::fromRgba(QRgb(integer())));
+        style.setTextAlignment(Qt::Alignment(QFlag(int(integer()))));
+        style.setFillColor(QColor::fromRgba(QRgb(integer())));
+        style.setLineColor(QColor::fromRgba(QRgb(integer())));
+        style.setTransparency(int(integer()));
+        style.setLineWidth(real());
+        style.setLineStyle(int(integer(style.lineStyle())));
+        leaveContainer();
+        ShapeStyleRef ref = ShapeStyle::intern(style);
+        m_styles.append(ref);
+        return ref;
+    }
+    ShapeState shape()
+    {
+        ShapeState state;
+        if (!enterContainer()) {
+            return state;
+        }
+        state.typeId = static_cast<ShapeFactory::TypeId>(integer(ShapeFactory::InvalidType));
+        int x = int(integer());
+        int y = int(integer());
+        int width = int(integer());
+        int height = int(integer());
+        state.rect = QRect(x, y, width, height);
+        state.text = string();
+        state.style = style();
+        if (state.typeId == ShapeFactory::SymbolInstanceType) {
+            state.symbolIndex = int(integer(-1));
+            if (enterContainer()) {
+                while (hasNext()) {
+                    int index = int(integer(-1));
+                    state.textOverrides.insert(index, string());
+                }
+                leaveContainer();
+            }
+        }
+        leaveContainer();
+        return state;
+    }
+    ConnectionPoint endpoint(const QVector<Shape*>& shapes)
+    {
+        EndpointState state;
+        if (!enterContainer()) {
+            return ConnectionPoint();
+        }
+        qint64 position = integer(ConnectionPoint::Invalid);
+        state.position = position >= 0 && position <= ConnectionPoint::Invalid
+                             ? static_cast<ConnectionPoint::Position>(position) : ConnectionPoint::Invalid;
+        int owner = -1;
+        if (isNull()) {
+            skip();
+        } else {
+            owner = int(integer(-1));
+        }
+        state.outlineParam = real();
+        int x = int(integer());
+        int y = int(integer());
+        state.freePosition = QPoint(x, y);
+        leaveContainer();
+        return state.toPoint(shapes.value(owner, nullptr));
+    }
+    ArrowLine* connection(const QVector<Shape*>& shapes)
+    {
+        ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+        if (enterContainer()) {
+            connection->setStartPoint(endpoint(shapes));
+            connection->setEndPoint(endpoint(shapes));
+            leaveContainer();
+        }
+        return connection;
+    }
+
+private:
+    QCborStreamReader m_in;
+    QVector<ShapeStyleRef> m_styles;
+};
+}
+bool CborFormat::write(const SceneSnapshot& scene, const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    CborWriter writer(&file);
+    QCborStreamWriter& out = writer.out();
+    bool hasRevisions = !scene.revisions().isEmpty();
+    out.startMap(hasRevisions ? 7 : 6);
+    writer.writeKey(KeyFormat);
+    out.append(QLatin1String(FormatName));
+    writer.writeKey(KeyVersion);
+    out.append(qint64(Version));
+    writer.writeKey(KeyPage);
+    out.startArray(3);
+    out.append(qint64(scene.pageSize().width()));
+    out.append(qint64(scene.pageSize().height()));
+    out.append(quint64(scene.backgroundColor().rgba()));
+    out.endArray();
+    writer.writeKey(KeySymbols);
+    out.startArray(quint64(scene.symbols().size()));
+    for (const QSharedPointer<Symbol>& symbol : scene.symbols()) {
+        out.startArray(5);
+        out.append(symbol->name());
+        out.append(qint64(symbol->size().width()));
+        out.append(qint64(symbol->size().height()));
+        QHash<const Shape*, int> shapeIndices;
+        out.startArray(quint64(symbol->shapes().size()));
+        for (int i = 0; i < symbol->shapes().size(); ++i) {
+            const Shape* shape = symbol->shapes()[i];
+            int symbolIndex = shape->typeId() == ShapeFactory::SymbolInstanceType
+                                  ? scene.indexOfSymbol(static_cast<const SymbolInstance*>(shape)->master().data()) : -1;
+            ShapeState state = ShapeState::fromShape(shape, symbolIndex);
+            state.text = symbol->text(i);
+            writer.writeShape(state);
+            shapeIndices.insert(shape, i);
+        }
+        out.endArray();
+        out.startArray(quint64(symbol->connections().size()));
+        for (const Connection* connection : symbol->connections()) {
+            writer.writeConnection(connection->getStartPoint(), connection->getEndPoint(), shapeIndices);
+        }
+        out.endArray();
+        out.endArray();
+    }
+    out.endArray();
+    writer.writeKey(KeyShapes);
+    out.startArray(quint64(scene.shapes().size()));
+    for (const ShapeRecordRef& record : scene.shapes()) {
+        const Shape* shape = record->shape();
+        int symbolIndex = shape->typeId() == ShapeFactory::SymbolInstanceType
+                              ? scene.indexOfSymbol(static_cast<const SymbolInstance*>(shape)->master().data()) : -1;
+        writer.writeShape(ShapeState::fromShape(shape, symbolIndex));
+    }
+    out.endArray();
+    writer.writeKey(KeyConnections);
+    out.startArray(quint64(scene.connections().size()));
+    for (const ConnectionRecordRef& record : scene.connections()) {
+        writer.writeConnection(record->startPoint(), record->endPoint(), scene.shapeIndices());
+    }
+    out.endArray();
+    if (hasRevisions) {
+        writer.writeKey(KeyRevisions);
+        out.append(scene.revisions().save());
+    }
+    out.endMap();
+    bool ok = file.error() == QFileDevice::NoError;
+    file.close();
+    return ok;
+}
+bool CborFormat::read(SceneModel& scene, const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    CborReader reader(&file);
+    // 先核对格式名和版本，不是本格式的文件不清空场景
+    if (!reader.enterContainer() || reader.string() != QLatin1String(KeyFormat)
+        || reader.string() != QLatin1String(FormatName) || reader.string() != QLatin1String(KeyVersion)) {
+        return false;
+    }
+    qint64 version = reader.integer(-1);
+    if (version < 1 || version > Version) {
+        return false;
+    }
+    scene.clear();
+    QVector<QSharedPointer<Symbol>> symbols;
+    QVector<Shape*> shapes;
+    ObjectPool::Scope poolScope(scene.pool());
+    scene.beginChanges();
+    while (reader.hasNext()) {
+        const QString key = reader.string();
+        if (key == QLatin1String(KeyPage)) {
+            if (reader.enterContainer()) {
+                int width = int(reader.integer(scene.pageSize().width()));
+                int height = int(reader.integer(scene.pageSize().height()));
+                scene.setPageSize(QSize(width, height));
+                scene.setBackgroundColor(QColor::fromRgba(QRgb(reader.integer(scene.backgroundColor().rgba()))));
+                reader.leaveContainer();
+            }
+        } else if (key == QLatin1String(KeySymbols)) {
+            if (!reader.enterContainer()) {
+                continue;
+            }
+            // 母版对象不放进场景的对象池，见Symbol::fromShapes
+            ObjectPool::Scope heapScope(nullptr);
+            while (reader.hasNext()) {
+                if (!reader.enterContainer()) {
+                    continue;
+                }
+                QString name = reader.string();
+                int width = int(reader.integer());
+                int height = int(reader.integer());
+                QSharedPointer<Symbol> symbol(new Symbol(name, QSize(width, height)));
+                QVector<Shape*> symbolShapes;
+                if (reader.enterContainer()) {
+                    while (reader.hasNext()) {
+                        ShapeState state = reader.shape();
+                        Shape* shape = state.create(symbols);
+                        symbolShapes.append(shape);
+                        if (shape) {
+                            symbol->addShape(shape, state.text);
+                        }
+                    }
+                    reader.leaveContainer();
+                }
+                if (reader.enterContainer()) {
+                    while (reader.hasNext()) {
+                        symbol->addConnection(reader.connection(symbolShapes));
+                    }
+                    reader.leaveContainer();
+                }
+                reader.leaveContainer();
+                symbols.append(symbol);
+                scene.addSymbol(symbol);
+            }
+            reader.leaveContainer();
+        } else if (key == QLatin1String(KeyShapes)) {
+            if (!reader.enterContainer()) {
+                continue;
+            }
+            while (reader.hasNext()) {
+                Shape* shape = reader.shape().create(symbols);
+                shapes.append(shape);
+                if (shape) {
+                    scene.addShape(shape);
+                }
+            }
+            reader.leaveContainer();
+        } else if (key == QLatin1String(KeyConnections)) {
+            if (!reader.enterContainer()) {
+                continue;
+            }
+            while (reader.hasNext()) {
+                scene.addConnection(reader.connection(shapes));
+            }
+            reader.leaveContainer();
+        } else if (key == QLatin1String(KeyRevisions)) {
+            RevisionStore revisions;
+            if (revisions.load(reader.bytes())) {
+                scene.setRevisions(revisions);
+            }
+        } else {
+            reader.skip();
+        }
+    }
+    scene.endChanges();
+    return !reader.hasError();
+}
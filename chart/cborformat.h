@@ -0,0 +1,34 @@
+#ifndef CBORFORMAT_H
+#define CBORFORMAT_H
+
+#include <QString>
+
+class SceneModel;
+class SceneSnapshot;
+
+// CBOR交换格式（.cbor），供构建流水线等程序生成和读取流程图
+// 读写都用QCborStreamWriter/QCborStreamReader直接对文件流式进行，不构造中间文档树
+//
+// 顶层为映射，键依次为：
+//   "format"      "flowchart"
+//   "version"     格式版本
+//   "page"        [宽, 高, 背景色RGBA]
+//   "symbols"     [[名称, 宽, 高, [图形...], [连线...]] ...]，被嵌套引用的母版排在前面
+//   "shapes"      [图形...]，按图层顺序由下到上
+//   "connections" [连线...]
+//   "revisions"   字节串，RevisionStore::save()的内容，没有修订时省略
+// 图形：[类型, x, y, 宽, 高, 文字, 样式]，符号实例再加 [母版下标, {覆盖序号: 文字}]
+// 样式：第一次出现时内联为 [字体, 字号, 粗斜下划线标志, 文字颜色, 对齐, 填充色, 线条色, 透明度, 线宽, 线型]，
+//       同时按出现顺序编号，之后出现相同样式只写编号
+// 连线：[起点, 终点]；端点：[位置类型, 所属图形下标或null, 轮廓参数, x, y]
+// 读取时忽略不认识的键，母版与样式须先于引用它们的图形出现
+class CborFormat
+{
+public:
+    static const int Version = 1;
+
+    static bool write(const SceneSnapshot& scene, const QString& filePath);
+    static bool read(SceneModel& scene, const QString& filePath);
+};
+
+#endif // CBORFORMAT_H
@@ -0,0 +1,65 @@
+﻿#include "chart/changeset.h"
+#include <QAtomicInteger>
+quint64 Revision::next()
+{
+    static QAtomicInteger<quint64> counter(0);
+    return counter.fetchAndAddRelaxed(1) + 1;
+}
+ChangeSet::ChangeSet()
+    : orderChanged(false), pageChanged(false), revisionsChanged(false), cleared(false), revision(0)
+{
+}
+bool ChangeSet::isEmpty() const
+{
+    return addedShapes.isEmpty() && removedShapes.isEmpty() && changedShapes.isEmpty()
+        && addedConnections.isEmpty() && removedConnections.isEmpty() && changedConnections.isEmpty()
+        && !orderChanged && !pageChanged && !revisionsChanged && !cleared;
+}
+void ChangeSet::clear()
+{
+    addedShapes.clear();
+    removedShapes.clear();
+    changedShapes.clear();
+    addedConnections.clear();
+    removedConnections.clear();
+    changedConnections.clear();
+    orderChanged = false;
+    pageChanged = false;
+    revisionsChanged = false;
+    cleared = false;
+    revision = 0;
+}
+void ChangeSet::shapeAdded(quint64 id)
+{
+    addedShapes.insert(id);
+}
+void ChangeSet::shapeRemoved(quint64 id)
+{
+    changedShapes.remove(id);
+    if (!addedShapes.remove(id)) {
+        removedShapes.insert(id);
+    }
+}
+void ChangeSet::shapeChanged(quint64 id)
+{
+    if (!addedShapes.contains(id)) {
+        changedShapes.insert(id);
+    }
+}
+void ChangeSet::connectionAdded(quint64 id)
+{
+    addedConnections.insert(id);
+}
+void ChangeSet::connectionRemoved(quint64 id)
+{
+    changedConnections.remove(id);
+    if (!addedConnections.remove(id)) {
+        removedConnections.insert(id);
+    }
+}
+void ChangeSet::connectionChanged(quint64 id)
+{
+    if (!addedConnections.contains(id)) {
+        changedConnections.insert(id);
+    }
+}
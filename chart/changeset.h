@@ -0,0 +1,43 @@
+#ifndef CHANGESET_H
+#define CHANGESET_H
+
+#include <QSet>
+#include <QtGlobal>
+
+// 修订号：进程内全局单调递增，每次修改对象都取一个新值
+// 缓存只需记下生成时的修订号，之后比较是否相等即可判断是否失效
+namespace Revision {
+    quint64 next();
+}
+
+// 一批场景变化的汇总，由SceneModel::changesCommitted发出
+// 对象以SceneModel::ObjectId标识；同一批内先添加后删除的对象不会出现
+class ChangeSet
+{
+public:
+    ChangeSet();
+
+    bool isEmpty() const;
+    void clear();
+
+    void shapeAdded(quint64 id);
+    void shapeRemoved(quint64 id);
+    void shapeChanged(quint64 id);
+    void connectionAdded(quint64 id);
+    void connectionRemoved(quint64 id);
+    void connectionChanged(quint64 id);
+
+    QSet<quint64> addedShapes;
+    QSet<quint64> removedShapes;
+    QSet<quint64> changedShapes;
+    QSet<quint64> addedConnections;
+    QSet<quint64> removedConnections;
+    QSet<quint64> changedConnections;
+    bool orderChanged;      // 图层顺序变化
+    bool pageChanged;       // 页面尺寸或背景变化
+    bool revisionsChanged;  // 修订历史变化
+    bool cleared;           // 场景被清空，此前的缓存应全部丢弃
+    quint64 revision;       // 提交时的场景修订号
+};
+
+#endif // CHANGESET_H
@@ -0,0 +1,774 @@
+﻿#include "chart/chunkeddocument.h"
+#include "chart/scenemodel.h"
+#include "chart/shape.h"
+#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
+#include <QDataStream>
+#include <algorithm>
+namespace {
+const quint32 FileMagic = 0x46434d50;
+const qint64 CopyBlockSize = 64 * 1024;
+// 待编码的块内容，图形按图层顺序排列
+struct ChunkContent
+{
+    QVector<const Shape*> shapes;
+    QVector<double> ranks;
+    QVector<QPair<EndpointState, EndpointState>> connections;
+    QVector<quint64> connectionIds;
+    QRect bounds;
+};
+int floorDiv(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+QPoint cellOf(const QPoint& point, int chunkSize)
+{
+    return QPoint(floorDiv(point.x(), chunkSize), floorDiv(point.y(), chunkSize));
+}
+quint64 cellKey(const QPoint& cell)
+{
+    return (quint64(quint32(cell.x())) << 32) | quint32(cell.y());
+}
+QRect pointRect(const QPoint& point)
+{
+    return QRect(point, QSize(1, 1));
+}
+QHash<const Symbol*, int> indexSymbols(const QVector<QSharedPointer<Symbol>>& symbols)
+{
+    QHash<const Symbol*, int> indices;
+    for (int i = 0; i < symbols.size(); ++i) {
+        indices.insert(symbols[i].data(), i);
+    }
+    return indices;
+}
+QByteArray encodeChunk(const ChunkContent& content, const QHash<const Symbol*, int>& symbolIndices)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << qint32(content.shapes.size());
+    for (int i = 0; i < content.shapes.size(); ++i) {
+        const Shape* shape = content.shapes[i];
+        int symbolIndex = shape->typeId() == ShapeFactory::SymbolInstanceType
+                              ? symbolIndices.value(static_cast<const SymbolInstance*>(shape)->master().data(), -1) : -1;
+        out << content.ranks[i] << ShapeState::fromShape(shape, symbolIndex);
+    }
+    out << qint32(content.connections.size());
+    for (const QPair<EndpointState, EndpointState>& connection : content.connections) {
+        out << connection.first << connection.second;
+    }
+    return payload;
+}
+}
+ChunkedDocument::ChunkedDocument(SceneModel* scene, QObject* parent)
+    : QObject(parent)
+    , m_scene(scene)
+    , m_dataStart(0)
+    , m_chunkSize(DefaultChunkSize)
+    , m_prefetchMargin(DefaultChunkSize)
+    , m_memoryBudget(64 * 1024 * 1024)
+    , m_useCounter(0)
+    , m_applying(false)
+{
+    connect(m_scene, &SceneModel::changesCommitted, this, &ChunkedDocument::trackChanges);
+}
+ChunkedDocument::~ChunkedDocument()
+{
+}
+ChunkedDocument::EndRef ChunkedDocument::makeEnd(const ConnectionPoint& point,
+                                                 const QHash<const Shape*, QPair<int, int>>& located)
+{
+    EndRef ref;
+    ref.state = EndpointState::fromPoint(point, quint64(-1));
+    QHash<const Shape*, QPair<int, int>>::const_iterator it = located.constFind(point.getOwner());
+    if (point.getOwner() && it != located.constEnd()) {
+        ref.chunk = it.value().first;
+        ref.shape = it.value().second;
+        ref.state.ownerKey = quint64(ref.shape);
+    }
+    return ref;
+}
+bool ChunkedDocument::writeFile(const QString& filePath, int chunkSize, const QSize& pageSize, const QColor& background,
+                                const QVector<QSharedPointer<Symbol>>& symbols, QVector<ChunkOutput>& chunks,
+                                const QVector<Bridge>& bridges, QFile* source, qint64 sourceDataStart, qint64* dataStart)
+{
+    qint64 offset = 0;
+    for (ChunkOutput& chunk : chunks) {
+        if (chunk.sourceOffset < 0) {
+            chunk.size = chunk.payload.size();
+        }
+        chunk.offset = offset;
+        offset += chunk.size;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out << FileMagic << Version << qint32(chunkSize) << pageSize << background;
+    writeSymbols(out, symbols);
+    out << qint32(chunks.size());
+    for (const ChunkOutput& chunk : chunks) {
+        out << chunk.cell << chunk.bounds << chunk.offset << chunk.size;
+    }
+    out << qint32(bridges.size());
+    for (const Bridge& bridge : bridges) {
+        out << bridge.start.chunk << bridge.start.shape << bridge.start.state
+            << bridge.end.chunk << bridge.end.shape << bridge.end.state;
+    }
+    bool ok = out.status() == QDataStream::Ok;
+    *dataStart = file.pos();
+    // 块数据依次写在索引之后，未驻留的块按块大小分段从原文件复制
+    for (int i = 0; ok && i < chunks.size(); ++i) {
+        const ChunkOutput& chunk = chunks[i];
+        if (chunk.sourceOffset < 0) {
+            ok = file.write(chunk.payload) == chunk.payload.size();
+            continue;
+        }
+        ok = source && source->seek(sourceDataStart + chunk.sourceOffset);
+        for (qint64 copied = 0; ok && copied < chunk.size; ) {
+            QByteArray block = source->read(qMin(CopyBlockSize, chunk.size - copied));
+            ok = !block.isEmpty() && file.write(block) == block.size();
+            copied += block.size();
+        }
+    }
+    ok = ok && file.error() == QFileDevice::NoError;
+    file.close();
+    if (!ok) {
+        file.remove();
+    }
+    return ok;
+}
+bool ChunkedDocument::write(const SceneSnapshot& scene, const QString& filePath, int chunkSize)
+{
+    chunkSize = qMax(chunkSize, 1);
+    QVector<ChunkContent> contents;
+    QVector<QPoint> cells;
+    QHash<quint64, int> chunkAtCell;
+    auto chunkAt = [&](const QPoint& point) -> int {
+        QPoint cell = cellOf(point, chunkSize);
+        QHash<quint64, int>::const_iterator it = chunkAtCell.constFind(cellKey(cell));
+        if (it != chunkAtCell.constEnd()) {
+            return it.value();
+        }
+        chunkAtCell.insert(cellKey(cell), contents.size());
+        cells.append(cell);
+        contents.append(ChunkContent());
+        return contents.size() - 1;
+    };
+    QHash<const Shape*, QPair<int, int>> located;
+    for (int i = 0; i < scene.shapes().size(); ++i) {
+        const Shape* shape = scene.shapes()[i]->shape();
+        int chunk = chunkAt(shape->getRect().center());
+        ChunkContent& content = contents[chunk];
+        located.insert(shape, qMakePair(chunk, content.shapes.size()));
+        content.shapes.append(shape);
+        content.ranks.append(double(i));
+        content.bounds |= shape->getRect();
+    }
+    QVector<Bridge> bridges;
+    for (const ConnectionRecordRef& record : scene.connections()) {
+        EndRef start = makeEnd(record->startPoint(), located);
+        EndRef end = makeEnd(record->endPoint(), located);
+        if (start.chunk >= 0 && end.chunk >= 0 && start.chunk != end.chunk) {
+            Bridge bridge;
+            bridge.start = start;
+            bridge.end = end;
+            bridges.append(bridge);
+            continue;
+        }
+        int chunk = start.chunk >= 0 ? start.chunk : end.chunk >= 0 ? end.chunk : chunkAt(record->startPosition());
+        ChunkContent& content = contents[chunk];
+        content.connections.append(qMakePair(start.state, end.state));
+        content.bounds |= pointRect(record->startPosition()) | pointRect(record->endPosition());
+    }
+    const QHash<const Symbol*, int> symbolIndices = indexSymbols(scene.symbols());
+    QVector<ChunkOutput> chunks;
+    chunks.reserve(contents.size());
+    for (int i = 0; i < contents.size(); ++i) {
+        ChunkOutput chunk;
+        chunk.cell = cells[i];
+        chunk.bounds = contents[i].bounds;
+        chunk.payload = encodeChunk(contents[i], symbolIndices);
+        chunks.append(chunk);
+    }
+    qint64 dataStart = 0;
+    return writeFile(filePath, chunkSize, scene.pageSize(), scene.backgroundColor(), scene.symbols(),
+                     chunks, bridges, nullptr, 0, &dataStart);
+}
+bool ChunkedDocument::open(const QString& filePath)
+{
+    m_scene->flushChanges();
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_applying = true;
+    m_scene->clear();
+    bool ok = readHeader();
+    m_scene->flushChanges();
+    m_applying = false;
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+bool ChunkedDocument::readHeader()
+{
+    QDataStream in(&m_file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 chunkSize = 0;
+    QSize pageSize;
+    QColor background;
+    in >> magic >> version >> chunkSize >> pageSize >> background;
+    if (in.status() != QDataStream::Ok || magic != FileMagic || version != Version || chunkSize <= 0) {
+        return false;
+    }
+    m_chunkSize = chunkSize;
+    m_symbols = readSymbols(in);
+    qint32 chunkCount = 0;
+    in >> chunkCount;
+    for (qint32 i = 0; i < chunkCount && in.status() == QDataStream::Ok; ++i) {
+        Chunk chunk;
+        in >> chunk.cell >> chunk.bounds >> chunk.offset >> chunk.size;
+        m_chunkAtCell.insert(cellKey(chunk.cell), m_chunks.size());
+        m_chunks.append(chunk);
+    }
+    qint32 bridgeCount = 0;
+    in >> bridgeCount;
+    for (qint32 i = 0; i < bridgeCount && in.status() == QDataStream::Ok; ++i) {
+        Bridge bridge;
+        in >> bridge.start.chunk >> bridge.start.shape >> bridge.start.state
+           >> bridge.end.chunk >> bridge.end.shape >> bridge.end.state;
+        if (bridge.start.chunk >= m_chunks.size()) {
+            bridge.start.chunk = -1;
+        }
+        if (bridge.end.chunk >= m_chunks.size()) {
+            bridge.end.chunk = -1;
+        }
+        m_bridges.append(bridge);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    m_dataStart = m_file.pos();
+    rebuildBridgeIndex();
+    m_scene->setPageSize(pageSize);
+    m_scene->setBackgroundColor(background);
+    for (const QSharedPointer<Symbol>& symbol : m_symbols) {
+        m_scene->addSymbol(symbol);
+    }
+    return true;
+}
+void ChunkedDocument::rebuildBridgeIndex()
+{
+    m_chunkBridges = QVector<QVector<int>>(m_chunks.size());
+    m_bridgeConnections.clear();
+    for (int i = 0; i < m_bridges.size(); ++i) {
+        const Bridge& bridge = m_bridges[i];
+        if (bridge.start.chunk >= 0 && bridge.start.chunk < m_chunks.size()) {
+            m_chunkBridges[bridge.start.chunk].append(i);
+        }
+        if (bridge.end.chunk >= 0 && bridge.end.chunk < m_chunks.size() && bridge.end.chunk != bridge.start.chunk) {
+            m_chunkBridges[bridge.end.chunk].append(i);
+        }
+        if (bridge.connection) {
+            m_bridgeConnections.insert(bridge.connection, i);
+        }
+    }
+}
+void ChunkedDocument::close()
+{
+    m_file.close();
+    m_symbols.clear();
+    m_chunks.clear();
+    m_chunkAtCell.clear();
+    m_bridges.clear();
+    m_chunkBridges.clear();
+    m_shapeChunks.clear();
+    m_shapeRanks.clear();
+    m_connectionChunks.clear();
+    m_bridgeConnections.clear();
+}
+int ChunkedDocument::residentChunkCount() const
+{
+    int count = 0;
+    for (const Chunk& chunk : m_chunks) {
+        count += chunk.resident ? 1 : 0;
+    }
+    return count;
+}
+qint64 ChunkedDocument::residentBytes() const
+{
+    qint64 bytes = 0;
+    for (const Chunk& chunk : m_chunks) {
+        bytes += chunk.resident ? chunk.size : 0;
+    }
+    return bytes;
+}
+int ChunkedDocument::chunkAt(const QPoint& point)
+{
+    // 新对象只放进驻留的块；网格对应的块未驻留时另建一个块，文件中同一网格可以有多个块
+    QPoint cell = cellOf(point, m_chunkSize);
+    int index = m_chunkAtCell.value(cellKey(cell), -1);
+    if (index >= 0 && m_chunks[index].resident) {
+        return index;
+    }
+    Chunk chunk;
+    chunk.cell = cell;
+    chunk.resident = true;
+    chunk.lastUsed = m_useCounter;
+    index = m_chunks.size();
+    m_chunks.append(chunk);
+    m_chunkBridges.append(QVector<int>());
+    m_chunkAtCell.insert(cellKey(cell), index);
+    return index;
+}
+void ChunkedDocument::setViewport(const QRect& viewport, const QSet<const Shape*>& pinned)
+{
+    m_scene->flushChanges();
+    if (!isOpen()) {
+        return;
+    }
+    const QRect area = viewport.adjusted(-m_prefetchMargin, -m_prefetchMargin, m_prefetchMargin, m_prefetchMargin);
+    ++m_useCounter;
+    QVector<int> wanted;
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        Chunk& chunk = m_chunks[i];
+        if (chunk.bounds.intersects(area)) {
+            chunk.lastUsed = m_useCounter;
+            if (!chunk.resident) {
+                wanted.append(i);
+            }
+        }
+    }
+    qint64 used = residentBytes();
+    if (wanted.isEmpty() && used <= m_memoryBudget) {
+        return;
+    }
+    QSet<int> pinnedChunks;
+    for (const Shape* shape : pinned) {
+        pinnedChunks.insert(m_shapeChunks.value(m_scene->idOf(shape), -1));
+    }
+    m_applying = true;
+    m_scene->beginChanges();
+    for (int index : wanted) {
+        loadChunk(index);
+    }
+    used = residentBytes();
+    if (used > m_memoryBudget) {
+        QVector<int> candidates;
+        for (int i = 0; i < m_chunks.size(); ++i) {
+            const Chunk& chunk = m_chunks[i];
+            if (chunk.resident && !chunk.modified && chunk.lastUsed != m_useCounter && !pinnedChunks.contains(i)) {
+                candidates.append(i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+            return m_chunks[a].lastUsed < m_chunks[b].lastUsed;
+        });
+        for (int i = 0; i < candidates.size() && used > m_memoryBudget; ++i) {
+            used -= m_chunks[candidates[i]].size;
+            evictChunk(candidates[i]);
+        }
+    }
+    m_scene->endChanges();
+    m_applying = false;
+}
+int ChunkedDocument::insertionIndex(double rank) const
+{
+    const QVector<Shape*>& shapes = m_scene->shapes();
+    int low = 0;
+    int high = shapes.size();
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (m_shapeRanks.value(m_scene->idOf(shapes[mid])) <= rank) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+bool ChunkedDocument::loadChunk(int index)
+{
+    Chunk& chunk = m_chunks[index];
+    if (chunk.resident) {
+        return true;
+    }
+    if (chunk.offset < 0 || !m_file.seek(m_dataStart + chunk.offset)) {
+        return false;
+    }
+    const QByteArray payload = m_file.read(chunk.size);
+    if (payload.size() != chunk.size) {
+        return false;
+    }
+    QDataStream in(payload);
+    ObjectPool::Scope poolScope(m_scene->pool());
+    QVector<Shape*> shapes;
+    qint32 shapeCount = 0;
+    in >> shapeCount;
+    for (qint32 i = 0; i < shapeCount && in.status() == QDataStream::Ok; ++i) {
+        double rank = 0.0;
+        ShapeState state;
+        in >> rank >> state;
+        Shape* shape = state.create(m_symbols);
+        shapes.append(shape);
+        if (!shape) {
+            chunk.shapeIds.append(0);
+            continue;
+        }
+        // 按保存的全局图层键插入，与其他已驻留块的图形保持原来的前后顺序
+        quint64 id = m_scene->insertShape(insertionIndex(rank), shape);
+        m_shapeChunks.insert(id, index);
+        m_shapeRanks.insert(id, rank);
+        chunk.shapeIds.append(id);
+    }
+    qint32 connectionCount = 0;
+    in >> connectionCount;
+    for (qint32 i = 0; i < connectionCount && in.status() == QDataStream::Ok; ++i) {
+        EndpointState start;
+        EndpointState end;
+        in >> start >> end;
+        ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+        connection->setStartPoint(start.toPoint(shapes.value(int(start.ownerKey), nullptr)));
+        connection->setEndPoint(end.toPoint(shapes.value(int(end.ownerKey), nullptr)));
+        quint64 id = m_scene->addConnection(connection);
+        m_connectionChunks.insert(id, index);
+        chunk.connectionIds.append(id);
+    }
+    chunk.resident = true;
+    for (int bridge : m_chunkBridges[index]) {
+        attachBridge(bridge);
+    }
+    return in.status() == QDataStream::Ok;
+}
+Shape* ChunkedDocument::residentShape(const EndRef& ref) const
+{
+    if (ref.chunk < 0 || ref.chunk >= m_chunks.size() || !m_chunks[ref.chunk].resident) {
+        return nullptr;
+    }
+    return m_scene->shapeById(m_chunks[ref.chunk].shapeIds.value(ref.shape, 0));
+}
+void ChunkedDocument::attachBridge(int index)
+{
+    Bridge& bridge = m_bridges[index];
+    if (bridge.removed) {
+        return;
+    }
+    // 未驻留一端的图形取不到，toPoint退化为保存时位置上的自由端点
+    Connection* connection = bridge.connection ? m_scene->connectionById(bridge.connection) : nullptr;
+    if (connection) {
+        connection->setStartPoint(bridge.start.state.toPoint(residentShape(bridge.start)));
+        connection->setEndPoint(bridge.end.state.toPoint(residentShape(bridge.end)));
+        m_scene->notifyConnectionChanged(connection);
+        return;
+    }
+    ObjectPool::Scope poolScope(m_scene->pool());
+    ArrowLine* line = new ArrowLine(QPoint(), QPoint());
+    line->setStartPoint(bridge.start.state.toPoint(residentShape(bridge.start)));
+    line->setEndPoint(bridge.end.state.toPoint(residentShape(bridge.end)));
+    bridge.connection = m_scene->addConnection(line);
+    m_bridgeConnections.insert(bridge.connection, index);
+}
+void ChunkedDocument::evictChunk(int index)
+{
+    Chunk& chunk = m_chunks[index];
+    // 跨块连线：另一端的块仍驻留时把这一端改回自由端点，否则移出场景
+    for (int b : m_chunkBridges[index]) {
+        Bridge& bridge = m_bridges[b];
+        Connection* connection = bridge.connection ? m_scene->connectionById(bridge.connection) : nullptr;
+        if (!connection) {
+            continue;
+        }
+        const EndRef& other = bridge.start.chunk == index ? bridge.end : bridge.start;
+        if (other.chunk >= 0 && other.chunk < m_chunks.size() && other.chunk != index && m_chunks[other.chunk].resident) {
+            if (bridge.start.chunk == index) {
+                connection->setStartPoint(bridge.start.state.toPoint(nullptr));
+            }
+            if (bridge.end.chunk == index) {
+                connection->setEndPoint(bridge.end.state.toPoint(nullptr));
+            }
+            m_scene->notifyConnectionChanged(connection);
+        } else {
+            m_bridgeConnections.remove(bridge.connection);
+            bridge.connection = 0;
+            m_scene->removeConnection(connection);
+        }
+    }
+    QSet<Connection*> connections;
+    for (quint64 id : chunk.connectionIds) {
+        if (Connection* connection = m_scene->connectionById(id)) {
+            connections.insert(connection);
+        }
+        m_connectionChunks.remove(id);
+    }
+    m_scene->removeConnections(connections);
+    QSet<Shape*> shapes;
+    for (quint64 id : chunk.shapeIds) {
+        if (Shape* shape = m_scene->shapeById(id)) {
+            shapes.insert(shape);
+        }
+        m_shapeChunks.remove(id);
+        m_shapeRanks.remove(id);
+    }
+    m_scene->removeShapes(shapes);
+    chunk.shapeIds.clear();
+    chunk.connectionIds.clear();
+    chunk.resident = false;
+}
+void ChunkedDocument::markModified(int chunk)
+{
+    if (chunk >= 0 && chunk < m_chunks.size() && m_chunks[chunk].resident) {
+        m_chunks[chunk].modified = true;
+    }
+}
+void ChunkedDocument::markConnection(quint64 id)
+{
+    Connection* connection = m_scene->connectionById(id);
+    if (!connection) {
+        return;
+    }
+    QHash<quint64, int>::const_iterator bridge = m_bridgeConnections.constFind(id);
+    if (bridge != m_bridgeConnections.constEnd()) {
+        markModified(m_bridges[bridge.value()].start.chunk);
+        markModified(m_bridges[bridge.value()].end.chunk);
+    }
+    int chunk = -1;
+    const Shape* owners[] = { connection->getStartPoint().getOwner(), connection->getEndPoint().getOwner() };
+    for (const Shape* owner : owners) {
+        int ownerChunk = owner ? m_shapeChunks.value(m_scene->idOf(owner), -1) : -1;
+        markModified(ownerChunk);
+        if (chunk < 0) {
+            chunk = ownerChunk;
+        }
+    }
+    if (bridge == m_bridgeConnections.constEnd() && !m_connectionChunks.contains(id)) {
+        if (chunk < 0) {
+            chunk = chunkAt(connection->getStartPoint().getPosition());
+        }
+        markModified(chunk);
+        m_connectionChunks.insert(id, chunk);
+    }
+}
+void ChunkedDocument::updateRanks()
+{
+    // 新图形和被调整过顺序的图形取前后两个有效键的中点，其余图形的键不变
+    const QVector<Shape*>& shapes = m_scene->shapes();
+    double previous = 0.0;
+    bool first = true;
+    for (int i = 0; i < shapes.size(); ++i) {
+        quint64 id = m_scene->idOf(shapes[i]);
+        QHash<quint64, double>::const_iterator it = m_shapeRanks.constFind(id);
+        if (it != m_shapeRanks.constEnd() && (first || it.value() > previous)) {
+            previous = it.value();
+            first = false;
+            continue;
+        }
+        double next = 0.0;
+        bool hasNext = false;
+        for (int j = i + 1; j < shapes.size() && !hasNext; ++j) {
+            QHash<quint64, double>::const_iterator rank = m_shapeRanks.constFind(m_scene->idOf(shapes[j]));
+            if (rank != m_shapeRanks.constEnd() && (first || rank.value() > previous)) {
+                next = rank.value();
+                hasNext = true;
+            }
+        }
+        double rank = first ? (hasNext ? next - 1.0 : 0.0) : hasNext ? (previous + next) / 2 : previous + 1.0;
+        m_shapeRanks.insert(id, rank);
+        markModified(m_shapeChunks.value(id, -1));
+        previous = rank;
+        first = false;
+    }
+}
+void ChunkedDocument::trackChanges(const ChangeSet& changes)
+{
+    if (m_applying || !isOpen()) {
+        return;
+    }
+    if (changes.cleared) {
+        close();
+        return;
+    }
+    for (quint64 id : changes.addedShapes) {
+        if (Shape* shape = m_scene->shapeById(id)) {
+            int chunk = chunkAt(shape->getRect().center());
+            m_shapeChunks.insert(id, chunk);
+            markModified(chunk);
+        }
+    }
+    for (quint64 id : changes.removedShapes) {
+        markModified(m_shapeChunks.value(id, -1));
+        m_shapeChunks.remove(id);
+        m_shapeRanks.remove(id);
+    }
+    for (quint64 id : changes.changedShapes) {
+        markModified(m_shapeChunks.value(id, -1));
+    }
+    for (quint64 id : changes.addedConnections) {
+        markConnection(id);
+    }
+    for (quint64 id : changes.changedConnections) {
+        markConnection(id);
+    }
+    for (quint64 id : changes.removedConnections) {
+        QHash<quint64, int>::iterator bridge = m_bridgeConnections.find(id);
+        if (bridge != m_bridgeConnections.end()) {
+            Bridge& removed = m_bridges[bridge.value()];
+            markModified(removed.start.chunk);
+            markModified(removed.end.chunk);
+            removed.removed = true;
+            removed.connection = 0;
+            m_bridgeConnections.erase(bridge);
+            continue;
+        }
+        markModified(m_connectionChunks.value(id, -1));
+        m_connectionChunks.remove(id);
+    }
+    if (!changes.addedShapes.isEmpty() || changes.orderChanged) {
+        updateRanks();
+    }
+}
+bool ChunkedDocument::save(const QString& filePath)
+{
+    m_scene->flushChanges();
+    if (!isOpen()) {
+        return false;
+    }
+    // 驻留块从场景重新编码：图形按图层顺序归入各自的块
+    QVector<ChunkContent> contents(m_chunks.size());
+    QVector<QVector<quint64>> shapeIds(m_chunks.size());
+    QHash<const Shape*, QPair<int, int>> located;
+    for (Shape* shape : m_scene->shapes()) {
+        quint64 id = m_scene->idOf(shape);
+        int chunk = m_shapeChunks.value(id, -1);
+        if (chunk < 0) {
+            continue;
+        }
+        ChunkContent& content = contents[chunk];
+        located.insert(shape, qMakePair(chunk, content.shapes.size()));
+        content.shapes.append(shape);
+        content.ranks.append(m_shapeRanks.value(id));
+        content.bounds |= shape->getRect();
+        shapeIds[chunk].append(id);
+    }
+    QVector<Bridge> bridges;
+    for (Connection* connection : m_scene->connections()) {
+        quint64 id = m_scene->idOf(connection);
+        EndRef start = makeEnd(connection->getStartPoint(), located);
+        EndRef end = makeEnd(connection->getEndPoint(), located);
+        // 跨块连线另一端的块未驻留时沿用原来的引用
+        QHash<quint64, int>::const_iterator source = m_bridgeConnections.constFind(id);
+        if (source != m_bridgeConnections.constEnd()) {
+            const Bridge& original = m_bridges[source.value()];
+            if (start.chunk < 0 && original.start.chunk >= 0 && !m_chunks[original.start.chunk].resident) {
+                start = original.start;
+            }
+            if (end.chunk < 0 && original.end.chunk >= 0 && !m_chunks[original.end.chunk].resident) {
+                end = original.end;
+            }
+        }
+        int chunk = start.chunk >= 0 ? start.chunk : end.chunk >= 0 ? end.chunk : m_connectionChunks.value(id, -1);
+        bool crossing = start.chunk >= 0 && end.chunk >= 0 && start.chunk != end.chunk;
+        if (crossing || chunk < 0 || !m_chunks[chunk].resident) {
+            Bridge bridge;
+            bridge.start = start;
+            bridge.end = end;
+            bridge.connection = id;
+            bridges.append(bridge);
+            continue;
+        }
+        ChunkContent& content = contents[chunk];
+        content.connections.append(qMakePair(start.state, end.state));
+        content.connectionIds.append(id);
+        content.bounds |= pointRect(start.state.freePosition) | pointRect(end.state.freePosition);
+    }
+    // 两端的块都未驻留的跨块连线原样保留
+    for (const Bridge& bridge : m_bridges) {
+        if (!bridge.removed && !bridge.connection) {
+            bridges.append(bridge);
+        }
+    }
+    const QHash<const Symbol*, int> symbolIndices = indexSymbols(m_scene->symbols());
+    QVector<int> remap(m_chunks.size(), -1);
+    QVector<ChunkOutput> outputs;
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        const Chunk& chunk = m_chunks[i];
+        ChunkOutput output;
+        output.cell = chunk.cell;
+        if (chunk.resident) {
+            if (contents[i].shapes.isEmpty() && contents[i].connections.isEmpty()) {
+                continue;
+            }
+            output.bounds = contents[i].bounds;
+            output.payload = encodeChunk(contents[i], symbolIndices);
+        } else if (chunk.offset >= 0) {
+            output.bounds = chunk.bounds;
+            output.sourceOffset = chunk.offset;
+            output.size = chunk.size;
+        } else {
+            continue;
+        }
+        remap[i] = outputs.size();
+        outputs.append(output);
+    }
+    for (Bridge& bridge : bridges) {
+        bridge.start.chunk = bridge.start.chunk >= 0 ? remap[bridge.start.chunk] : -1;
+        bridge.end.chunk = bridge.end.chunk >= 0 ? remap[bridge.end.chunk] : -1;
+    }
+    // 先写到临时文件，写完再替换，保存到当前文件时复制数据的来源在写完之前一直有效
+    const QString partPath = filePath + ".part";
+    qint64 dataStart = 0;
+    if (!writeFile(partPath, m_chunkSize, m_scene->pageSize(), m_scene->backgroundColor(), m_scene->symbols(),
+                   outputs, bridges, &m_file, m_dataStart, &dataStart)) {
+        return false;
+    }
+    m_file.close();
+    QFile::remove(filePath);
+    if (!QFile::rename(partPath, filePath)) {
+        return false;
+    }
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // 按新文件更新块索引，驻留内容和修改标记不变
+    QVector<Chunk> chunks;
+    chunks.reserve(outputs.size());
+    m_chunkAtCell.clear();
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        if (remap[i] < 0) {
+            continue;
+        }
+        Chunk chunk = m_chunks[i];
+        const ChunkOutput& output = outputs[remap[i]];
+        chunk.bounds = output.bounds;
+        chunk.offset = output.offset;
+        chunk.size = output.size;
+        if (chunk.resident) {
+            chunk.shapeIds = shapeIds[i];
+            chunk.connectionIds = contents[i].connectionIds;
+        }
+        if (chunk.resident || !m_chunkAtCell.contains(cellKey(chunk.cell))) {
+            m_chunkAtCell.insert(cellKey(chunk.cell), chunks.size());
+        }
+        chunks.append(chunk);
+    }
+    m_chunks.swap(chunks);
+    m_shapeChunks.clear();
+    m_connectionChunks.clear();
+    for (int i = 0; i < m_chunks.size(); ++i) {
+        for (quint64 id : m_chunks[i].shapeIds) {
+            m_shapeChunks.insert(id, i);
+        }
+        for (quint64 id : m_chunks[i].connectionIds) {
+            m_connectionChunks.insert(id, i);
+        }
+    }
+    m_bridges = bridges;
+    m_dataStart = dataStart;
+    rebuildBridgeIndex();
+    return true;
+}
@@ -0,0 +1,150 @@
+#ifndef CHUNKEDDOCUMENT_H
+#define CHUNKEDDOCUMENT_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QRect>
+#include <QSet>
+#include <QVector>
+#include <QSharedPointer>
+#include <QColor>
+#include <QPair>
+#include "chart/changeset.h"
+#include "chart/objectstate.h"
+
+class SceneModel;
+class SceneSnapshot;
+class Shape;
+class Symbol;
+
+// 分块文档（.fcm）：按固定网格把图形划分到空间块中，文件头保存块索引
+// 打开时只读入页面设置、母版、块索引和跨块连线，块的内容在靠近视口时才读入场景，
+// 超出内存预算时按最近最少使用的顺序把远离视口的块移出场景
+//
+// 图形按中心所在的网格归入一个块，之后移动也不换块，只扩大块的范围；
+// 两端都在同一块内的连线随块保存，两端分属不同块的跨块连线保存在文件头中：
+// 任一端的块驻留时连线就放进场景，另一端的块未读入时该端暂作自由端点停在原位置，读入后再连回图形
+// 本次打开后修改过的块和pinned图形所在的块不会被移出；保存时驻留块从场景重新编码，其余块直接复制原文件中的数据
+// 不保存命名修订
+class ChunkedDocument : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const quint16 Version = 1;
+    static const int DefaultChunkSize = 2048;
+
+    // 把快照按chunkSize的网格分块写成新文件
+    static bool write(const SceneSnapshot& scene, const QString& filePath, int chunkSize = DefaultChunkSize);
+
+    explicit ChunkedDocument(SceneModel* scene, QObject* parent = nullptr);
+    ~ChunkedDocument();
+
+    // 清空场景并打开文件，此时还没有块驻留，需调用setViewport
+    bool open(const QString& filePath);
+    // 停止跟踪场景，已驻留的内容留在场景中；场景被清空时自动关闭
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString filePath() const { return m_file.fileName(); }
+
+    // 保存到filePath（可以就是当前文件），成功后改为跟踪新文件
+    bool save(const QString& filePath);
+
+    // 视口（场景坐标）变化后调用：读入与扩大预取边距后的视口相交的块，再淘汰超出预算的块
+    // pinned中图形所在的块不会被淘汰（选中或悬停的图形等）
+    void setViewport(const QRect& viewport, const QSet<const Shape*>& pinned = QSet<const Shape*>());
+
+    // 预取边距（场景坐标），默认为DefaultChunkSize
+    void setPrefetchMargin(int margin) { m_prefetchMargin = margin; }
+    int prefetchMargin() const { return m_prefetchMargin; }
+    // 驻留块的内存预算（字节），按块数据的大小估算，默认64MB
+    void setMemoryBudget(qint64 bytes) { m_memoryBudget = bytes; }
+    qint64 memoryBudget() const { return m_memoryBudget; }
+
+    int chunkCount() const { return m_chunks.size(); }
+    int residentChunkCount() const;
+    qint64 residentBytes() const;
+
+private slots:
+    void trackChanges(const ChangeSet& changes);
+
+private:
+    // 连线端点引用的图形：所在块与块内下标，自由端点的块为-1
+    struct EndRef
+    {
+        EndRef() : chunk(-1), shape(-1) {}
+        qint32 chunk;
+        qint32 shape;
+        EndpointState state;
+    };
+    struct Bridge
+    {
+        Bridge() : connection(0), removed(false) {}
+        EndRef start;
+        EndRef end;
+        quint64 connection;     // 放进场景后的连线ID，不在场景中时为0
+        bool removed;           // 已被用户删除
+    };
+    struct Chunk
+    {
+        Chunk() : offset(-1), size(0), resident(false), modified(false), lastUsed(0) {}
+        QPoint cell;
+        QRect bounds;
+        qint64 offset;          // 相对数据区起点，-1表示文件中还没有这个块
+        qint64 size;
+        bool resident;
+        bool modified;
+        quint64 lastUsed;
+        QVector<quint64> shapeIds;      // 驻留时按块内下标排列的图形ID
+        QVector<quint64> connectionIds; // 驻留时的块内连线ID
+    };
+
+    // 写文件时的一个块：payload为空且sourceOffset不小于0时从原文件复制
+    struct ChunkOutput
+    {
+        ChunkOutput() : sourceOffset(-1), offset(0), size(0) {}
+        QPoint cell;
+        QRect bounds;
+        QByteArray payload;
+        qint64 sourceOffset;
+        qint64 offset;
+        qint64 size;
+    };
+    static bool writeFile(const QString& filePath, int chunkSize, const QSize& pageSize, const QColor& background,
+                          const QVector<QSharedPointer<Symbol>>& symbols, QVector<ChunkOutput>& chunks,
+                          const QVector<Bridge>& bridges, QFile* source, qint64 sourceDataStart, qint64* dataStart);
+    static EndRef makeEnd(const ConnectionPoint& point, const QHash<const Shape*, QPair<int, int>>& located);
+
+    bool readHeader();
+    int chunkAt(const QPoint& point);
+    bool loadChunk(int index);
+    void evictChunk(int index);
+    void attachBridge(int index);
+    Shape* residentShape(const EndRef& ref) const;
+    int insertionIndex(double rank) const;
+    void updateRanks();
+    void markModified(int chunk);
+    void markConnection(quint64 id);
+    void rebuildBridgeIndex();
+
+    SceneModel* m_scene;
+    QFile m_file;
+    qint64 m_dataStart;
+    int m_chunkSize;
+    QVector<QSharedPointer<Symbol>> m_symbols;
+    QVector<Chunk> m_chunks;
+    QHash<quint64, int> m_chunkAtCell;
+    QVector<Bridge> m_bridges;
+    QVector<QVector<int>> m_chunkBridges;   // 每个块涉及的跨块连线
+    QHash<quint64, int> m_shapeChunks;      // 驻留图形ID -> 块
+    QHash<quint64, double> m_shapeRanks;    // 驻留图形ID -> 全局图层键
+    QHash<quint64, int> m_connectionChunks; // 驻留块内连线ID -> 块
+    QHash<quint64, int> m_bridgeConnections;// 场景中的跨块连线ID -> m_bridges下标
+    int m_prefetchMargin;
+    qint64 m_memoryBudget;
+    quint64 m_useCounter;
+    bool m_applying;                        // 正在读入或移出块，不跟踪自己引起的变化
+};
+
+#endif // CHUNKEDDOCUMENT_H
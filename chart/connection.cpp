@@ -1,38 +1,55 @@
 ﻿#include "chart/connection.h"
 #include "chart/shape.h"
 #include <cmath>
+ConnectionPoint::ConnectionPoint()
+    : m_owner(nullptr), m_position(Invalid), m_outlineParam(0.0)
+{
+}
 ConnectionPoint::ConnectionPoint(Shape* owner, Position position)
-    : m_owner(owner), m_position(position), m_freePosition(0, 0)
+    : m_owner(owner), m_position(position), m_outlineParam(0.0)
 {
 }
 ConnectionPoint::ConnectionPoint(const QPoint& freePosition)
-    : m_owner(nullptr), m_position(Free), m_freePosition(freePosition)
+    : m_owner(nullptr), m_position(Free)
+{
+    m_free.x = freePosition.x();
+    m_free.y = freePosition.y();
+}
+ConnectionPoint::ConnectionPoint(Shape* owner, qreal outlineParam)
+    : m_owner(owner), m_position(Outline), m_outlineParam(outlineParam)
 {
 }
 QPoint ConnectionPoint::getPosition() const 
 {
     if (m_position == Free) {
-        return m_freePosition;
+        return QPoint(m_free.x, m_free.y);
     }
     if (!m_owner) {
         return QPoint(0, 0);
     }
+    if (m_position == Outline) {
+        return m_owner->pointOnOutline(m_outlineParam).toPoint();
+    }
     return m_owner->getConnectionPoint(m_position);
 }
 void ConnectionPoint::setPosition(const QPoint& pos)
 {
     if (m_position == Free) {
-        m_freePosition = pos;
+        m_free.x = pos.x();
+        m_free.y = pos.y();
     }
 }
-bool ConnectionPoint::equalTo(const ConnectionPoint* other) const{
-    if (!other) {
-        return false;  
+bool ConnectionPoint::equalTo(const ConnectionPoint& other) const{
+    if (m_position != other.m_position) {
+        return false;
+    }
+    if (m_position == Free) {
+        return m_free.x == other.m_free.x && m_free.y == other.m_free.y;
     }
-    if (m_position == Free && other->m_position == Free) {
-        return m_freePosition == other->m_freePosition;
+    if (m_position == Outline) {
+        return m_owner == other.m_owner && qFuzzyCompare(1.0 + m_outlineParam, 1.0 + other.m_outlineParam);
     }
-    return (m_owner == other->m_owner) && (m_position == other->m_position);
+    return m_owner == other.m_owner;
 }
 QString ConnectionPoint::positionToString(Position pos)
 {
@@ -42,6 +59,7 @@ QString ConnectionPoint::positionToString(Position pos)
     case Bottom: return "Bottom";
     case Left: return "Left";
     case Free: return "Free";
+    case Outline: return "Outline";
     default: return "Unknown";
     }
 }
@@ -52,20 +70,19 @@ ConnectionPoint::Position ConnectionPoint::stringToPosition(const QString& str)
     if (str == "Bottom") return Bottom;
     if (str == "Left") return Left;
     if (str == "Free") return Free;
+    if (str == "Outline") return Outline;
     return Top; 
 }
-Connection::Connection(ConnectionPoint* startPoint, ConnectionPoint* endPoint)
-    : m_startPoint(startPoint), m_endPoint(endPoint), m_selected(false)
+Connection::Connection(const ConnectionPoint& startPoint, const ConnectionPoint& endPoint)
+    : m_startPoint(startPoint), m_endPoint(endPoint), m_selected(false), m_attached(true), m_revision(Revision::next())
 {
+    attachPoint(m_startPoint);
+    attachPoint(m_endPoint);
 }
 Connection::~Connection()
 {
-    if (m_startPoint && m_startPoint->getPositionType() == ConnectionPoint::Free) {
-        delete m_startPoint;
-    }
-    if (m_endPoint && m_endPoint->getPositionType() == ConnectionPoint::Free) {
-        delete m_endPoint;
-    }
+    detachPoint(m_startPoint);
+    detachPoint(m_endPoint);
 }
 void Connection::drawConnectionLine(QPainter* painter,
                                  const QPoint& startPos, 
@@ -116,66 +133,108 @@ void Connection::drawConnectionLine(QPainter* painter,
 }
 void Connection::paint(QPainter* painter)
 {
-    if (!m_startPoint) {
+    if (!m_startPoint.isValid()) {
         return;
     }
-    QPoint startPos = m_startPoint->getPosition();
+    QPoint startPos = m_startPoint.getPosition();
     QPoint endPos;
-    if (m_endPoint) {
-        endPos = m_endPoint->getPosition();
+    if (m_endPoint.isValid()) {
+        endPos = m_endPoint.getPosition();
     } else {
         endPos = m_temporaryEndPoint;
     }
     drawConnectionLine(painter, startPos, endPos, m_selected, true);
 }
-void Connection::setStartPoint(ConnectionPoint* point)
+void Connection::attachPoint(const ConnectionPoint& point)
 {
-    if (m_startPoint && m_startPoint->getPositionType() == ConnectionPoint::Free) {
-        delete m_startPoint;
+    if (m_attached && point.getOwner()) {
+        point.getOwner()->attachConnection(this);
+    }
+}
+void Connection::detachPoint(const ConnectionPoint& point)
+{
+    if (m_attached && point.getOwner()) {
+        point.getOwner()->detachConnection(this);
+    }
+}
+void Connection::setAttached(bool attached)
+{
+    if (attached == m_attached) {
+        return;
+    }
+    if (attached) {
+        m_attached = true;
+        attachPoint(m_startPoint);
+        attachPoint(m_endPoint);
+    } else {
+        detachPoint(m_startPoint);
+        detachPoint(m_endPoint);
+        m_attached = false;
+    }
+}
+void Connection::setStartPoint(const ConnectionPoint& point)
+{
+    if (point.getOwner() != m_startPoint.getOwner()) {
+        detachPoint(m_startPoint);
+        attachPoint(point);
     }
     m_startPoint = point;
+    m_revision = Revision::next();
 }
-void Connection::setEndPoint(ConnectionPoint* point)
+void Connection::setEndPoint(const ConnectionPoint& point)
 {
-    if (m_endPoint && m_endPoint->getPositionType() == ConnectionPoint::Free) {
-        delete m_endPoint;
+    if (point.getOwner() != m_endPoint.getOwner()) {
+        detachPoint(m_endPoint);
+        attachPoint(point);
     }
     m_endPoint = point;
+    m_revision = Revision::next();
+}
+void Connection::setEndpoint(bool isStart, const ConnectionPoint& point)
+{
+    if (isStart) {
+        setStartPoint(point);
+    } else {
+        setEndPoint(point);
+    }
 }
 void Connection::setTemporaryEndPoint(const QPoint& point)
 {
-    m_temporaryEndPoint = point;
+    if (point != m_temporaryEndPoint) {
+        m_temporaryEndPoint = point;
+        m_revision = Revision::next();
+    }
 }
 bool Connection::contains(const QPoint& point, int threshold) const
 {
     if (!isComplete()) {
         return false;
     }
-    QPoint startPos = m_startPoint->getPosition();
-    QPoint endPos = m_endPoint->getPosition();
+    QPoint startPos = m_startPoint.getPosition();
+    QPoint endPos = m_endPoint.getPosition();
     double distance = pointToLineDistance(point, startPos, endPos);
     return distance <= threshold;
 }
 QPoint Connection::getStartPosition() const
 {
-    return m_startPoint ? m_startPoint->getPosition() : QPoint(0, 0);
+    return m_startPoint.isValid() ? m_startPoint.getPosition() : QPoint(0, 0);
 }
 QPoint Connection::getEndPosition() const
 {
-    return m_endPoint ? m_endPoint->getPosition() : m_temporaryEndPoint;
+    return m_endPoint.isValid() ? m_endPoint.getPosition() : m_temporaryEndPoint;
 }
 bool Connection::isNearStartPoint(const QPoint& point, int threshold) const
 {
-    if (!m_startPoint) return false;
-    QPoint startPos = m_startPoint->getPosition();
+    if (!m_startPoint.isValid()) return false;
+    QPoint startPos = m_startPoint.getPosition();
     double distance = std::sqrt(std::pow(point.x() - startPos.x(), 2) + 
                               std::pow(point.y() - startPos.y(), 2));
     return distance <= threshold;
 }
 bool Connection::isNearEndPoint(const QPoint& point, int threshold) const
 {
-    if (!m_endPoint) return false;
-    QPoint endPos = m_endPoint->getPosition();
+    if (!m_endPoint.isValid()) return false;
+    QPoint endPos = m_endPoint.getPosition();
     double distance = std::sqrt(std::pow(point.x() - endPos.x(), 2) + 
                               std::pow(point.y() - endPos.y(), 2));
     return distance <= threshold;
@@ -207,7 +266,7 @@ double Connection::pointToLineDistance(const QPoint& point,
                      std::pow(point.y() - projY, 2));
 }
 ArrowLine::ArrowLine(const QPoint& startPoint, const QPoint& endPoint)
-    : Connection(new ConnectionPoint(startPoint), new ConnectionPoint(endPoint))
+    : Connection(ConnectionPoint(startPoint), ConnectionPoint(endPoint))
 {
 }
 ArrowLine::~ArrowLine()
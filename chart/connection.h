@@ -3,11 +3,14 @@
 
 #include <QPoint>
 #include <QPainter>
+#include "chart/objectpool.h"
+#include "chart/changeset.h"
 
 // 前向声明
 class Shape;
 
-// 连接点类
+// 连接点：值类型，直接内联保存在Connection中
+// 固定连接点与轮廓锚点记录所属图形，自由端点只记录坐标；默认构造的连接点无效
 class ConnectionPoint
 {
 public:
@@ -16,43 +19,61 @@ public:
         Right,
         Bottom,
         Left,
-        Free 
+        Free,
+        Outline,   // 轮廓锚点：沿图形周长的任意位置
+        Invalid
     };
 
+    ConnectionPoint();
     ConnectionPoint(Shape* owner, Position position);
-    ConnectionPoint(const QPoint& freePosition); 
+    explicit ConnectionPoint(const QPoint& freePosition); 
+    ConnectionPoint(Shape* owner, qreal outlineParam); // 轮廓锚点，outlineParam为周长参数[0,1)
     QPoint getPosition() const;
     Shape* getOwner() const { return m_owner; }
     Position getPositionType() const { return m_position; }
+    qreal getOutlineParam() const { return m_position == Outline ? m_outlineParam : 0.0; }
+    bool isValid() const { return m_position != Invalid; }
 
-    bool equalTo(const ConnectionPoint* other) const;
+    bool equalTo(const ConnectionPoint& other) const;
     void setPosition(const QPoint& pos); 
 
     static QString positionToString(Position pos);
     static Position stringToPosition(const QString& str);
 
 private:
+    struct FreeCoordinate { int x; int y; };
+
     Shape* m_owner;
     Position m_position;
-    QPoint m_freePosition; 
+    union {
+        FreeCoordinate m_free;  // 自由端点坐标
+        qreal m_outlineParam;   // 轮廓锚点的周长参数
+    };
 };
 
 class Connection
 {
 public:
-    Connection(ConnectionPoint* startPoint = nullptr, ConnectionPoint* endPoint = nullptr);
+    Connection(const ConnectionPoint& startPoint = ConnectionPoint(), const ConnectionPoint& endPoint = ConnectionPoint());
     virtual ~Connection();
+
+    static void* operator new(std::size_t size) { return ObjectPool::allocateObject(size); }
+    static void operator delete(void* object) { ObjectPool::deallocateObject(object); }
     
     virtual void paint(QPainter* painter);
     
-    void setStartPoint(ConnectionPoint* point);
-    void setEndPoint(ConnectionPoint* point);
+    void setStartPoint(const ConnectionPoint& point);
+    void setEndPoint(const ConnectionPoint& point);
     void setTemporaryEndPoint(const QPoint& point);
-    ConnectionPoint* getStartPoint() const { return m_startPoint; }
-    ConnectionPoint* getEndPoint() const { return m_endPoint; }
+    const ConnectionPoint& getStartPoint() const { return m_startPoint; }
+    const ConnectionPoint& getEndPoint() const { return m_endPoint; }
+
+    // 按端点访问，isStart为true时为起点
+    const ConnectionPoint& getEndpoint(bool isStart) const { return isStart ? m_startPoint : m_endPoint; }
+    void setEndpoint(bool isStart, const ConnectionPoint& point);
     
-    bool isComplete() const { return m_startPoint && m_endPoint; }
-    bool isTemporary() const { return m_startPoint && !m_endPoint; }
+    bool isComplete() const { return m_startPoint.isValid() && m_endPoint.isValid(); }
+    bool isTemporary() const { return m_startPoint.isValid() && !m_endPoint.isValid(); }
     
     bool contains(const QPoint& point, int threshold = 5) const;
     
@@ -64,9 +85,17 @@ public:
     bool isNearEndPoint(const QPoint& point, int threshold = 10) const;
     
     // 选中状态控制
+    // 修订号：端点或预览终点每次变化都会更新；端点所属图形的变化见Shape::revision()
+    quint64 revision() const { return m_revision; }
+
     void setSelected(bool selected) { m_selected = selected; }
     bool isSelected() const { return m_selected; }
 
+    // 是否登记在端点所属图形的incidentConnections中；新建的连线默认登记
+    // 连线移出场景时由SceneModel注销、放回时重新登记，避免场景外的连线仍挂在场景内的图形上
+    void setAttached(bool attached);
+    bool isAttached() const { return m_attached; }
+
     // 绘制连线
     static void drawConnectionLine(QPainter* painter, 
                                  const QPoint& startPos, 
@@ -75,10 +104,16 @@ public:
                                  bool drawArrow);
     
 protected:
-    ConnectionPoint* m_startPoint;
-    ConnectionPoint* m_endPoint;
+    // 在端点所属图形上登记/注销本连线
+    void attachPoint(const ConnectionPoint& point);
+    void detachPoint(const ConnectionPoint& point);
+
+    ConnectionPoint m_startPoint;
+    ConnectionPoint m_endPoint;
     QPoint m_temporaryEndPoint; // 用于绘制连线预览
     bool m_selected; // 是否被选中
+    bool m_attached; // 是否登记在端点所属图形上
+    quint64 m_revision;
     double pointToLineDistance(const QPoint& point, 
                               const QPoint& lineStart, 
                               const QPoint& lineEnd) const;
@@ -0,0 +1,133 @@
+﻿#include "chart/geometry.h"
+namespace {
+qreal cross(const QPointF& o, const QPointF& a, const QPointF& b)
+{
+    return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+bool onSegment(const QPointF& p, const QPointF& q, const QPointF& r)
+{
+    return q.x() <= qMax(p.x(), r.x()) && q.x() >= qMin(p.x(), r.x()) &&
+           q.y() <= qMax(p.y(), r.y()) && q.y() >= qMin(p.y(), r.y());
+}
+int sign(qreal value)
+{
+    if (qAbs(value) < 1e-9) {
+        return 0;
+    }
+    return value > 0 ? 1 : -1;
+}
+}
+bool Geometry::segmentsIntersect(const QPointF& p1, const QPointF& p2,
+                                 const QPointF& q1, const QPointF& q2)
+{
+    int d1 = sign(cross(q1, q2, p1));
+    int d2 = sign(cross(q1, q2, p2));
+    int d3 = sign(cross(p1, p2, q1));
+    int d4 = sign(cross(p1, p2, q2));
+    if (d1 != d2 && d3 != d4 && d1 != 0 && d2 != 0 && d3 != 0 && d4 != 0) {
+        return true;
+    }
+    if (d1 == 0 && onSegment(q1, p1, q2)) return true;
+    if (d2 == 0 && onSegment(q1, p2, q2)) return true;
+    if (d3 == 0 && onSegment(p1, q1, p2)) return true;
+    if (d4 == 0 && onSegment(p1, q2, p2)) return true;
+    return false;
+}
+bool Geometry::polygonCrossesSegment(const QPolygonF& polygon,
+                                     const QPointF& p1, const QPointF& p2)
+{
+    int count = polygon.size();
+    if (count < 2) {
+        return false;
+    }
+    QRectF segmentBounds = QRectF(p1, p2).normalized();
+    for (int i = 0; i < count; ++i) {
+        const QPointF& a = polygon[i];
+        const QPointF& b = polygon[(i + 1) % count];
+        if (qMax(a.x(), b.x()) < segmentBounds.left() || qMin(a.x(), b.x()) > segmentBounds.right() ||
+            qMax(a.y(), b.y()) < segmentBounds.top() || qMin(a.y(), b.y()) > segmentBounds.bottom()) {
+            continue;
+        }
+        if (segmentsIntersect(a, b, p1, p2)) {
+            return true;
+        }
+    }
+    return false;
+}
+bool Geometry::polygonContainsSegment(const QPolygonF& polygon,
+                                      const QPointF& p1, const QPointF& p2)
+{
+    if (!polygon.containsPoint(p1, Qt::OddEvenFill) || !polygon.containsPoint(p2, Qt::OddEvenFill)) {
+        return false;
+    }
+    return !polygonCrossesSegment(polygon, p1, p2);
+}
+bool Geometry::polygonContainsPolygon(const QPolygonF& outer, const QPolygonF& inner)
+{
+    if (outer.size() < 3 || inner.isEmpty()) {
+        return false;
+    }
+    if (!outer.boundingRect().contains(inner.boundingRect())) {
+        return false;
+    }
+    for (const QPointF& point : inner) {
+        if (!outer.containsPoint(point, Qt::OddEvenFill)) {
+            return false;
+        }
+    }
+    int count = inner.size();
+    for (int i = 0; i < count; ++i) {
+        if (polygonCrossesSegment(outer, inner[i], inner[(i + 1) % count])) {
+            return false;
+        }
+    }
+    return true;
+}
+bool Geometry::segmentIntersectsRect(const QPointF& p1, const QPointF& p2, const QRectF& rect)
+{
+    qreal dx = p2.x() - p1.x();
+    qreal dy = p2.y() - p1.y();
+    qreal p[4] = { -dx, dx, -dy, dy };
+    qreal q[4] = { p1.x() - rect.left(), rect.right() - p1.x(),
+                   p1.y() - rect.top(), rect.bottom() - p1.y() };
+    qreal t0 = 0.0;
+    qreal t1 = 1.0;
+    for (int i = 0; i < 4; ++i) {
+        if (qAbs(p[i]) < 1e-12) {
+            if (q[i] < 0) {
+                return false;
+            }
+            continue;
+        }
+        qreal t = q[i] / p[i];
+        if (p[i] < 0) {
+            if (t > t1) return false;
+            if (t > t0) t0 = t;
+        } else {
+            if (t < t0) return false;
+            if (t < t1) t1 = t;
+        }
+    }
+    return t0 <= t1;
+}
+bool Geometry::polygonIntersectsRect(const QPolygonF& polygon, const QRectF& rect)
+{
+    if (polygon.isEmpty() || !polygon.boundingRect().intersects(rect)) {
+        return false;
+    }
+    for (const QPointF& point : polygon) {
+        if (rect.contains(point)) {
+            return true;
+        }
+    }
+    if (polygon.containsPoint(rect.center(), Qt::OddEvenFill)) {
+        return true;
+    }
+    int count = polygon.size();
+    for (int i = 0; i < count; ++i) {
+        if (segmentIntersectsRect(polygon[i], polygon[(i + 1) % count], rect)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+
+// 选择与命中测试用到的几何工具函数
+namespace Geometry {
+    // 两条线段是否相交（端点接触也算相交）
+    bool segmentsIntersect(const QPointF& p1, const QPointF& p2,
+                           const QPointF& q1, const QPointF& q2);
+
+    // 多边形的任意一条边是否与线段相交
+    bool polygonCrossesSegment(const QPolygonF& polygon,
+                               const QPointF& p1, const QPointF& p2);
+
+    // 线段是否完全位于多边形内部
+    bool polygonContainsSegment(const QPolygonF& polygon,
+                                const QPointF& p1, const QPointF& p2);
+
+    // 多边形inner是否完全位于多边形outer内部
+    bool polygonContainsPolygon(const QPolygonF& outer, const QPolygonF& inner);
+
+    // 线段是否与矩形相交（Liang-Barsky裁剪）
+    bool segmentIntersectsRect(const QPointF& p1, const QPointF& p2, const QRectF& rect);
+
+    // 多边形（含内部区域）是否与矩形有重叠
+    bool polygonIntersectsRect(const QPolygonF& polygon, const QRectF& rect);
+}
+
+#endif // GEOMETRY_H
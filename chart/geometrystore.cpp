@@ -0,0 +1,66 @@
+﻿#include "chart/geometrystore.h"
+#include "chart/shape.h"
+int GeometryStore::allocate(Shape* shape)
+{
+    int slot;
+    if (!m_freeSlots.isEmpty()) {
+        slot = m_freeSlots.takeLast();
+    } else {
+        slot = m_shapes.size();
+        m_rects.append(QRect());
+        m_zKeys.append(0.0);
+        m_typeTags.append(0);
+        m_shapes.append(nullptr);
+    }
+    m_rects[slot] = shape->getRect();
+    m_zKeys[slot] = 0.0;
+    m_typeTags[slot] = static_cast<quint16>(shape->typeId());
+    m_shapes[slot] = shape;
+    return slot;
+}
+void GeometryStore::release(int slot)
+{
+    if (slot < 0 || slot >= m_shapes.size() || !m_shapes[slot]) {
+        return;
+    }
+    m_shapes[slot] = nullptr;
+    m_rects[slot] = QRect();
+    m_freeSlots.append(slot);
+}
+void GeometryStore::clear()
+{
+    m_rects.clear();
+    m_zKeys.clear();
+    m_typeTags.clear();
+    m_shapes.clear();
+    m_freeSlots.clear();
+}
+QVector<QRect> GeometryStore::liveRects() const
+{
+    QVector<QRect> result;
+    result.reserve(liveCount());
+    const int count = m_shapes.size();
+    for (int slot = 0; slot < count; ++slot) {
+        if (m_shapes[slot]) {
+            result.append(m_rects[slot]);
+        }
+    }
+    return result;
+}
+Shape* GeometryStore::topmostAt(const QPoint& point) const
+{
+    int bestSlot = InvalidSlot;
+    const int count = m_shapes.size();
+    for (int slot = 0; slot < count; ++slot) {
+        if (!m_shapes[slot] || !m_rects[slot].contains(point)) {
+            continue;
+        }
+        if (bestSlot != InvalidSlot && m_zKeys[slot] < m_zKeys[bestSlot]) {
+            continue;
+        }
+        if (m_shapes[slot]->contains(point)) {
+            bestSlot = slot;
+        }
+    }
+    return bestSlot == InvalidSlot ? nullptr : m_shapes[bestSlot];
+}
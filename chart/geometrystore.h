@@ -0,0 +1,50 @@
+#ifndef GEOMETRYSTORE_H
+#define GEOMETRYSTORE_H
+
+#include <QRect>
+#include <QVector>
+
+class Shape;
+
+// 图形几何数据的结构数组（SoA）存储
+// 外接矩形、图层键和类型标签分别放在连续数组中，按槽位下标访问；
+// 整个场景的几何遍历（命中测试、对齐参考线、空位查找）只需线性扫描这几个数组，不必逐个访问堆上的Shape
+class GeometryStore
+{
+public:
+    static const int InvalidSlot = -1;
+
+    int allocate(Shape* shape);             // 为图形分配槽位，返回槽位下标
+    void release(int slot);                 // 释放槽位，供后续分配复用
+    void clear();
+
+    void setRect(int slot, const QRect& rect) { m_rects[slot] = rect; }
+    void setZKey(int slot, qreal zKey) { m_zKeys[slot] = zKey; }
+
+    QRect rect(int slot) const { return m_rects.at(slot); }
+    qreal zKey(int slot) const { return m_zKeys.at(slot); }
+    quint16 typeTag(int slot) const { return m_typeTags.at(slot); }
+    Shape* shape(int slot) const { return m_shapes.at(slot); }
+
+    // 槽位总数（包含空闲槽位，空闲槽位的shape为nullptr）
+    int slotCount() const { return m_shapes.size(); }
+    int liveCount() const { return m_shapes.size() - m_freeSlots.size(); }
+
+    // 直接访问连续数组
+    const QVector<QRect>& rects() const { return m_rects; }
+    const QVector<qreal>& zKeys() const { return m_zKeys; }
+    const QVector<quint16>& typeTags() const { return m_typeTags; }
+
+    // 整个场景的几何遍历
+    QVector<QRect> liveRects() const;
+    Shape* topmostAt(const QPoint& point) const;    // 外接矩形预筛选后再精确命中
+
+private:
+    QVector<QRect> m_rects;
+    QVector<qreal> m_zKeys;
+    QVector<quint16> m_typeTags;
+    QVector<Shape*> m_shapes;
+    QVector<int> m_freeSlots;
+};
+
+#endif // GEOMETRYSTORE_H
@@ -0,0 +1,114 @@
+﻿#include "chart/objectpool.h"
+#include <QDebug>
+#include <new>
+#include <cstring>
+namespace {
+struct AllocationHeader
+{
+    ObjectPool* pool;
+    int sizeClass;
+};
+static_assert(sizeof(AllocationHeader) <= 16, "allocation header must fit in HeaderSize");
+thread_local ObjectPool* t_currentPool = nullptr;
+}
+ObjectPool::ObjectPool()
+    : m_liveCount(0)
+{
+    std::memset(m_freeLists, 0, sizeof(m_freeLists));
+}
+ObjectPool::~ObjectPool()
+{
+    if (m_liveCount != 0) {
+        qWarning() << "ObjectPool destroyed with" << m_liveCount << "live objects";
+    }
+    releaseBlocks();
+}
+ObjectPool::Scope::Scope(ObjectPool* pool)
+    : m_previous(t_currentPool)
+{
+    t_currentPool = pool;
+}
+ObjectPool::Scope::~Scope()
+{
+    t_currentPool = m_previous;
+}
+void* ObjectPool::allocateObject(std::size_t size)
+{
+    std::size_t total = size + HeaderSize;
+    int sizeClass = static_cast<int>((total + Granularity - 1) / Granularity) - 1;
+    ObjectPool* pool = t_currentPool;
+    char* memory;
+    if (pool && sizeClass < SizeClassCount) {
+        memory = static_cast<char*>(pool->allocate(sizeClass));
+    } else {
+        pool = nullptr;
+        memory = static_cast<char*>(::operator new(total));
+    }
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(memory);
+    header->pool = pool;
+    header->sizeClass = sizeClass;
+    return memory + HeaderSize;
+}
+void ObjectPool::deallocateObject(void* object)
+{
+    if (!object) {
+        return;
+    }
+    char* memory = static_cast<char*>(object) - HeaderSize;
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(memory);
+    if (header->pool) {
+        header->pool->deallocate(memory, header->sizeClass);
+    } else {
+        ::operator delete(memory);
+    }
+}
+ObjectPool* ObjectPool::poolOf(const void* object)
+{
+    const char* memory = static_cast<const char*>(object) - HeaderSize;
+    return reinterpret_cast<const AllocationHeader*>(memory)->pool;
+}
+void ObjectPool::refill(int sizeClass)
+{
+    std::size_t slotSize = (sizeClass + 1) * Granularity;
+    char* block = static_cast<char*>(::operator new(BlockSize));
+    m_blocks.append(block);
+    std::size_t slotCount = BlockSize / slotSize;
+    for (std::size_t i = slotCount; i > 0; --i) {
+        FreeSlot* slot = reinterpret_cast<FreeSlot*>(block + (i - 1) * slotSize);
+        slot->next = m_freeLists[sizeClass];
+        m_freeLists[sizeClass] = slot;
+    }
+}
+void* ObjectPool::allocate(int sizeClass)
+{
+    if (!m_freeLists[sizeClass]) {
+        refill(sizeClass);
+    }
+    FreeSlot* slot = m_freeLists[sizeClass];
+    m_freeLists[sizeClass] = slot->next;
+    ++m_liveCount;
+    return slot;
+}
+void ObjectPool::deallocate(void* memory, int sizeClass)
+{
+    FreeSlot* slot = static_cast<FreeSlot*>(memory);
+    slot->next = m_freeLists[sizeClass];
+    m_freeLists[sizeClass] = slot;
+    --m_liveCount;
+}
+bool ObjectPool::reset()
+{
+    if (m_liveCount != 0) {
+        return false;
+    }
+    releaseBlocks();
+    return true;
+}
+void ObjectPool::releaseBlocks()
+{
+    for (char* block : m_blocks) {
+        ::operator delete(block);
+    }
+    m_blocks.clear();
+    std::memset(m_freeLists, 0, sizeof(m_freeLists));
+}
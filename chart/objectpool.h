@@ -0,0 +1,60 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <QVector>
+#include <cstddef>
+
+// 文档级对象池：按16字节划分尺寸档位，每档从64KB的块中切分槽位，释放的槽位挂回空闲链表复用
+// Shape、Connection重载了operator new/delete，在Scope有效期间从指定的池中分配；
+// 每个分配前有一个小头部记录所属的池，因此释放时无需知道当前Scope。没有Scope时直接使用系统堆
+class ObjectPool
+{
+public:
+    ObjectPool();
+    // 析构时无论是否还有存活对象都归还全部内存块；所有者应先释放池中的对象（SceneModel在析构函数中删除全部图形与连线），
+    // 仍有存活对象时输出警告，此后再释放这些对象属于未定义行为
+    ~ObjectPool();
+
+    // 在作用域内把当前线程的对象分配指向pool
+    class Scope
+    {
+    public:
+        explicit Scope(ObjectPool* pool);
+        ~Scope();
+    private:
+        ObjectPool* m_previous;
+    };
+
+    static void* allocateObject(std::size_t size);
+    static void deallocateObject(void* object);
+    // 对象所属的池（来自系统堆时为nullptr），object必须由allocateObject分配
+    static ObjectPool* poolOf(const void* object);
+
+    // 池中所有对象都已释放时，一次性归还全部内存块；仍有对象存活时不做任何事并返回false
+    bool reset();
+
+    int liveCount() const { return m_liveCount; }
+    int blockCount() const { return m_blocks.size(); }
+
+private:
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    struct FreeSlot { FreeSlot* next; };
+
+    void* allocate(int sizeClass);
+    void deallocate(void* slot, int sizeClass);
+    void refill(int sizeClass);
+    void releaseBlocks();
+
+    static const std::size_t HeaderSize = 16;
+    static const std::size_t Granularity = 16;
+    static const int SizeClassCount = 64;       // 最大可池化的分配为 64*16 字节
+    static const std::size_t BlockSize = 64 * 1024;
+
+    QVector<char*> m_blocks;
+    FreeSlot* m_freeLists[SizeClassCount];
+    int m_liveCount;
+};
+
+#endif // OBJECTPOOL_H
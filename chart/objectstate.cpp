@@ -0,0 +1,195 @@
+﻿#include "chart/objectstate.h"
+#include "chart/shape.h"
+#include "chart/symbol.h"
+#include "chart/objectpool.h"
+ShapeState::ShapeState()
+    : typeId(ShapeFactory::InvalidType), style(ShapeStyle::defaultStyle()), symbolIndex(-1)
+{
+}
+ShapeState ShapeState::fromShape(const Shape* shape, int symbolIndex)
+{
+    ShapeState state;
+    state.typeId = shape->typeId();
+    state.rect = shape->getRect();
+    state.text = shape->text();
+    state.style = shape->style();
+    if (state.typeId == ShapeFactory::SymbolInstanceType) {
+        state.symbolIndex = symbolIndex;
+        state.textOverrides = static_cast<const SymbolInstance*>(shape)->textOverrides();
+    }
+    return state;
+}
+Shape* ShapeState::create(const QVector<QSharedPointer<Symbol>>& symbols) const
+{
+    Shape* shape = nullptr;
+    if (typeId == ShapeFactory::SymbolInstanceType) {
+        QSharedPointer<Symbol> master = symbols.value(symbolIndex);
+        shape = master ? new SymbolInstance(master) : nullptr;
+    } else {
+        shape = ShapeFactory::instance().createShape(typeId, qMax(qMin(rect.width(), rect.height()) / 2, 30));
+    }
+    if (shape) {
+        applyTo(shape);
+    }
+    return shape;
+}
+void ShapeState::applyTo(Shape* shape) const
+{
+    shape->setRect(rect);
+    shape->setText(text);
+    shape->setStyle(style);
+    if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+        static_cast<SymbolInstance*>(shape)->setTextOverrides(textOverrides);
+    }
+}
+EndpointState::EndpointState()
+    : position(ConnectionPoint::Invalid), ownerKey(0), outlineParam(0.0)
+{
+}
+EndpointState EndpointState::fromPoint(const ConnectionPoint& point, quint64 ownerKey)
+{
+    EndpointState state;
+    state.position = point.getPositionType();
+    state.ownerKey = point.getOwner() ? ownerKey : 0;
+    state.outlineParam = point.getOutlineParam();
+    state.freePosition = point.isValid() ? point.getPosition() : QPoint();
+    return state;
+}
+ConnectionPoint EndpointState::toPoint(Shape* owner) const
+{
+    if (position == ConnectionPoint::Invalid) {
+        return ConnectionPoint();
+    }
+    if (owner && position <= ConnectionPoint::Left) {
+        return owner->port(position);
+    }
+    if (owner && position == ConnectionPoint::Outline) {
+        return ConnectionPoint(owner, outlineParam);
+    }
+    return ConnectionPoint(freePosition);
+}
+QDataStream& operator<<(QDataStream& out, const ShapeState& state)
+{
+    const ShapeStyle& style = *state.style;
+    out << qint32(state.typeId) << state.rect << state.text;
+    out << style.fontFamily() << qint32(style.fontSize()) << style.isFontBold() << style.isFontItalic()
+        << style.isFontUnderline() << style.fontColor() << qint32(style.textAlignment())
+        << style.fillColor() << style.lineColor() << qint32(style.transparency())
+        << double(style.lineWidth()) << qint32(style.lineStyle());
+    if (state.typeId == ShapeFactory::SymbolInstanceType) {
+        out << qint32(state.symbolIndex) << state.textOverrides;
+    }
+    return out;
+}
+QDataStream& operator>>(QDataStream& in, ShapeState& state)
+{
+    qint32 typeId;
+    in >> typeId >> state.rect >> state.text;
+    QString fontFamily;
+    qint32 fontSize, textAlignment, transparency, lineStyle;
+    bool bold, italic, underline;
+    QColor fontColor, fillColor, lineColor;
+    double lineWidth;
+    in >> fontFamily >> fontSize >> bold >> italic >> underline >> fontColor >> textAlignment
+       >> fillColor >> lineColor >> transparency >> lineWidth >> lineStyle;
+    state.typeId = static_cast<ShapeFactory::TypeId>(typeId);
+    state.symbolIndex = -1;
+    state.textOverrides.clear();
+    if (state.typeId == ShapeFactory::SymbolInstanceType) {
+        qint32 symbolIndex;
+        in >> symbolIndex >> state.textOverrides;
+        state.symbolIndex = symbolIndex;
+    }
+    ShapeStyle style;
+    style.setFontFamily(fontFamily);
+    style.setFontSize(fontSize);
+    style.setFontBold(bold);
+    style.setFontItalic(italic);
+    style.setFontUnderline(underline);
+    style.setFontColor(fontColor);
+    style.setTextAlignment(Qt::Alignment(QFlag(textAlignment)));
+    style.setFillColor(fillColor);
+    style.setLineColor(lineColor);
+    style.setTransparency(transparency);
+    style.setLineWidth(lineWidth);
+    style.setLineStyle(lineStyle);
+    state.style = ShapeStyle::intern(style);
+    return in;
+}
+QDataStream& operator<<(QDataStream& out, const EndpointState& state)
+{
+    return out << quint8(state.position) << state.ownerKey << state.outlineParam << state.freePosition;
+}
+QDataStream& operator>>(QDataStream& in, EndpointState& state)
+{
+    quint8 position;
+    in >> position >> state.ownerKey >> state.outlineParam >> state.freePosition;
+    state.position = position <= ConnectionPoint::Invalid ? static_cast<ConnectionPoint::Position>(position)
+                                                          : ConnectionPoint::Invalid;
+    return in;
+}
+void writeSymbols(QDataStream& out, const QVector<QSharedPointer<Symbol>>& symbols)
+{
+    QHash<const Symbol*, int> symbolIndices;
+    for (int i = 0; i < symbols.size(); ++i) {
+        symbolIndices.insert(symbols[i].data(), i);
+    }
+    out << qint32(symbols.size());
+    for (const QSharedPointer<Symbol>& symbol : symbols) {
+        out << symbol->name() << symbol->size() << qint32(symbol->shapes().size());
+        QHash<const Shape*, int> shapeIndices;
+        for (int i = 0; i < symbol->shapes().size(); ++i) {
+            const Shape* shape = symbol->shapes()[i];
+            int symbolIndex = shape->typeId() == ShapeFactory::SymbolInstanceType
+                                  ? symbolIndices.value(static_cast<const SymbolInstance*>(shape)->master().data(), -1) : -1;
+            ShapeState state = ShapeState::fromShape(shape, symbolIndex);
+            state.text = symbol->text(i);
+            out << state;
+            shapeIndices.insert(shape, i);
+        }
+        out << qint32(symbol->connections().size());
+        for (const Connection* connection : symbol->connections()) {
+            const ConnectionPoint& start = connection->getStartPoint();
+            const ConnectionPoint& end = connection->getEndPoint();
+            out << EndpointState::fromPoint(start, quint64(shapeIndices.value(start.getOwner(), -1)))
+                << EndpointState::fromPoint(end, quint64(shapeIndices.value(end.getOwner(), -1)));
+        }
+    }
+}
+QVector<QSharedPointer<Symbol>> readSymbols(QDataStream& in)
+{
+    QVector<QSharedPointer<Symbol>> symbols;
+    qint32 symbolCount = 0;
+    in >> symbolCount;
+    ObjectPool::Scope heapScope(nullptr);
+    for (qint32 i = 0; i < symbolCount && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        QSize size;
+        qint32 shapeCount = 0;
+        in >> name >> size >> shapeCount;
+        QSharedPointer<Symbol> symbol(new Symbol(name, size));
+        QVector<Shape*> symbolShapes;
+        for (qint32 j = 0; j < shapeCount && in.status() == QDataStream::Ok; ++j) {
+            ShapeState state;
+            in >> state;
+            Shape* shape = state.create(symbols);
+            symbolShapes.append(shape);
+            if (shape) {
+                symbol->addShape(shape, state.text);
+            }
+        }
+        qint32 connectionCount = 0;
+        in >> connectionCount;
+        for (qint32 j = 0; j < connectionCount && in.status() == QDataStream::Ok; ++j) {
+            EndpointState start;
+            EndpointState end;
+            in >> start >> end;
+            ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+            connection->setStartPoint(start.toPoint(symbolShapes.value(int(start.ownerKey), nullptr)));
+            connection->setEndPoint(end.toPoint(symbolShapes.value(int(end.ownerKey), nullptr)));
+            symbol->addConnection(connection);
+        }
+        symbols.append(symbol);
+    }
+    return symbols;
+}
@@ -0,0 +1,65 @@
+#ifndef OBJECTSTATE_H
+#define OBJECTSTATE_H
+
+#include <QRect>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QSharedPointer>
+#include <QDataStream>
+#include "chart/shapefactory.h"
+#include "chart/shapestyle.h"
+#include "chart/connection.h"
+
+class Shape;
+class Symbol;
+
+// 图形的可序列化状态：类型、矩形、文字、样式，以及符号实例的母版下标和文字覆盖
+// 崩溃恢复日志和修订历史都用它作为二进制记录的内容
+class ShapeState
+{
+public:
+    ShapeState();
+
+    // symbolIndex为实例母版在调用方符号表中的下标，普通图形忽略
+    static ShapeState fromShape(const Shape* shape, int symbolIndex = -1);
+    // 按状态创建新图形；符号实例从symbols中取母版，取不到时返回nullptr
+    Shape* create(const QVector<QSharedPointer<Symbol>>& symbols) const;
+    // 把矩形、文字、样式和文字覆盖写回同类型的已有图形
+    void applyTo(Shape* shape) const;
+
+    ShapeFactory::TypeId typeId;
+    QRect rect;
+    QString text;
+    ShapeStyleRef style;
+    int symbolIndex;
+    QHash<int, QString> textOverrides;
+};
+
+// 连线端点的可序列化状态，所属图形用调用方决定的键表示（日志中为对象ID，修订中为图形下标）
+class EndpointState
+{
+public:
+    EndpointState();
+
+    static EndpointState fromPoint(const ConnectionPoint& point, quint64 ownerKey);
+    // owner为空时固定连接点和轮廓锚点退化为原位置的自由端点
+    ConnectionPoint toPoint(Shape* owner) const;
+
+    ConnectionPoint::Position position;
+    quint64 ownerKey;
+    double outlineParam;
+    QPoint freePosition;
+};
+
+QDataStream& operator<<(QDataStream& out, const ShapeState& state);
+QDataStream& operator>>(QDataStream& in, ShapeState& state);
+QDataStream& operator<<(QDataStream& out, const EndpointState& state);
+QDataStream& operator>>(QDataStream& in, EndpointState& state);
+
+// 符号库的流式编码：母版按顺序写出，嵌套实例引用的母版用它在symbols中的下标表示
+void writeSymbols(QDataStream& out, const QVector<QSharedPointer<Symbol>>& symbols);
+// 读出的母版对象不放进任何对象池，见Symbol::fromShapes
+QVector<QSharedPointer<Symbol>> readSymbols(QDataStream& in);
+
+#endif // OBJECTSTATE_H
@@ -0,0 +1,117 @@
+﻿#include "chart/placementgrid.h"
+#include <limits>
+PlacementGrid::PlacementGrid(int cellSize)
+    : m_cellSize(qMax(1, cellSize)), m_cols(0), m_rows(0)
+{
+}
+int PlacementGrid::cellFloor(int value) const
+{
+    return value >= 0 ? value / m_cellSize : -((-value + m_cellSize - 1) / m_cellSize);
+}
+int PlacementGrid::cellCeil(int value) const
+{
+    return -cellFloor(-value);
+}
+void PlacementGrid::build(const QRect& bounds, const QVector<QRect>& obstacles, int margin)
+{
+    m_bounds = bounds;
+    m_cols = qMax(0, cellCeil(bounds.width()));
+    m_rows = qMax(0, cellCeil(bounds.height()));
+    QVector<quint8> occupied(m_cols * m_rows, 0);
+    for (const QRect& obstacle : obstacles) {
+        QRect padded = obstacle.normalized().adjusted(-margin, -margin, margin, margin)
+                                .translated(-bounds.topLeft());
+        int left = qMax(0, cellFloor(padded.left()));
+        int top = qMax(0, cellFloor(padded.top()));
+        int right = qMin(m_cols - 1, cellFloor(padded.right()));
+        int bottom = qMin(m_rows - 1, cellFloor(padded.bottom()));
+        for (int y = top; y <= bottom; ++y) {
+            for (int x = left; x <= right; ++x) {
+                occupied[y * m_cols + x] = 1;
+            }
+        }
+    }
+    int stride = m_cols + 1;
+    m_summedArea.fill(0, stride * (m_rows + 1));
+    for (int y = 0; y < m_rows; ++y) {
+        int rowSum = 0;
+        for (int x = 0; x < m_cols; ++x) {
+            rowSum += occupied[y * m_cols + x];
+            m_summedArea[(y + 1) * stride + (x + 1)] = m_summedArea[y * stride + (x + 1)] + rowSum;
+        }
+    }
+}
+int PlacementGrid::occupiedCount(int cellX, int cellY, int cellsW, int cellsH) const
+{
+    int stride = m_cols + 1;
+    int x1 = cellX + cellsW;
+    int y1 = cellY + cellsH;
+    return m_summedArea[y1 * stride + x1] - m_summedArea[cellY * stride + x1]
+         - m_summedArea[y1 * stride + cellX] + m_summedArea[cellY * stride + cellX];
+}
+bool PlacementGrid::isFree(const QRect& rect) const
+{
+    QRect local = rect.normalized().translated(-m_bounds.topLeft());
+    int left = cellFloor(local.left());
+    int top = cellFloor(local.top());
+    int right = cellFloor(local.right());
+    int bottom = cellFloor(local.bottom());
+    if (left < 0 || top < 0 || right >= m_cols || bottom >= m_rows) {
+        return false;
+    }
+    return occupiedCount(left, top, right - left + 1, bottom - top + 1) == 0;
+}
+bool PlacementGrid::findFreeRect(const QRect& rect, QRect* result) const
+{
+    if (m_cols <= 0 || m_rows <= 0) {
+        return false;
+    }
+    if (isFree(rect)) {
+        if (result) {
+            *result = rect;
+        }
+        return true;
+    }
+    int cellsW = cellCeil(rect.width());
+    int cellsH = cellCeil(rect.height());
+    if (cellsW > m_cols || cellsH > m_rows) {
+        return false;
+    }
+    QRect local = rect.translated(-m_bounds.topLeft());
+    int startX = qBound(0, cellFloor(local.left()), m_cols - cellsW);
+    int startY = qBound(0, cellFloor(local.top()), m_rows - cellsH);
+    int maxRadius = qMax(m_cols, m_rows);
+    for (int radius = 1; radius <= maxRadius; ++radius) {
+        int bestX = -1;
+        int bestY = -1;
+        int bestDistance = std::numeric_limits<int>::max();
+        for (int dy = -radius; dy <= radius; ++dy) {
+            bool edgeRow = (dy == -radius || dy == radius);
+            int step = edgeRow ? 1 : radius * 2;
+            for (int dx = -radius; dx <= radius; dx += step) {
+                int x = startX + dx;
+                int y = startY + dy;
+                if (x < 0 || y < 0 || x + cellsW > m_cols || y + cellsH > m_rows) {
+                    continue;
+                }
+                int distance = dx * dx + dy * dy;
+                if (distance >= bestDistance) {
+                    continue;
+                }
+                if (occupiedCount(x, y, cellsW, cellsH) == 0) {
+                    bestDistance = distance;
+                    bestX = x;
+                    bestY = y;
+                }
+            }
+        }
+        if (bestX >= 0) {
+            if (result) {
+                *result = QRect(m_bounds.left() + bestX * m_cellSize, m_bounds.top() + bestY * m_cellSize,
+                                rect.width(), rect.height());
+            }
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#ifndef PLACEMENTGRID_H
+#define PLACEMENTGRID_H
+
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+// 粘贴/拖放时的空位查找
+// 把画布划分为粗粒度网格并标记被占用的格子，再建立二维前缀和（summed-area table），
+// 任意矩形区域是否空闲可O(1)判断；查找时从期望位置按环形向外搜索
+class PlacementGrid
+{
+public:
+    explicit PlacementGrid(int cellSize = 16);
+
+    // bounds为可放置区域，obstacles为已占用的矩形，margin为与已有对象保持的间距
+    void build(const QRect& bounds, const QVector<QRect>& obstacles, int margin = 10);
+
+    // 查找离rect当前位置最近、能放下rect的空闲位置；找到时通过result返回
+    bool findFreeRect(const QRect& rect, QRect* result) const;
+
+    bool isFree(const QRect& rect) const;
+
+private:
+    int occupiedCount(int cellX, int cellY, int cellsW, int cellsH) const;
+    int cellFloor(int value) const;
+    int cellCeil(int value) const;
+
+    int m_cellSize;
+    QRect m_bounds;
+    int m_cols;
+    int m_rows;
+    QVector<int> m_summedArea;   // (m_cols+1)*(m_rows+1)的前缀和
+};
+
+#endif // PLACEMENTGRID_H
@@ -0,0 +1,144 @@
+﻿#include "chart/pngbandwriter.h"
+#include <QIODevice>
+#include <QImage>
+#include <QtEndian>
+#include <cstring>
+#include <zlib.h>
+namespace {
+const int OutputBufferSize = 64 * 1024;
+const char PngSignature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+const char SubFilter = 1;
+void appendBigEndian(QByteArray& data, quint32 value)
+{
+    uchar bytes[4];
+    qToBigEndian(value, bytes);
+    data.append(reinterpret_cast<const char*>(bytes), 4);
+}
+}
+PngBandWriter::PngBandWriter(QIODevice* device)
+    : m_device(device), m_stream(nullptr), m_rowsWritten(0), m_ok(false)
+{
+}
+PngBandWriter::~PngBandWriter()
+{
+    if (m_stream) {
+        deflateEnd(m_stream);
+        delete m_stream;
+    }
+}
+bool PngBandWriter::begin(const QSize& size)
+{
+    if (m_stream || size.isEmpty()) {
+        return false;
+    }
+    m_stream = new z_stream;
+    std::memset(m_stream, 0, sizeof(z_stream));
+    if (deflateInit(m_stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        delete m_stream;
+        m_stream = nullptr;
+        return false;
+    }
+    m_size = size;
+    m_rowsWritten = 0;
+    m_row.resize(1 + size.width() * 4);
+    m_output.resize(OutputBufferSize);
+    m_stream->next_out = reinterpret_cast<Bytef*>(m_output.data());
+    m_stream->avail_out = uInt(m_output.size());
+    QByteArray header;
+    appendBigEndian(header, quint32(size.width()));
+    appendBigEndian(header, quint32(size.height()));
+    header.append(char(8));     // 位深
+    header.append(char(6));     // RGBA
+    header.append(char(0));     // deflate
+    header.append(char(0));     // 自适应滤波
+    header.append(char(0));     // 不隔行
+    m_ok = m_device->write(PngSignature, sizeof(PngSignature)) == qint64(sizeof(PngSignature))
+           && writeChunk("IHDR", header);
+    return m_ok;
+}
+bool PngBandWriter::writeRows(const QImage& band)
+{
+    if (!m_ok || band.width() != m_size.width() || m_rowsWritten + band.height() > m_size.height()) {
+        return m_ok = false;
+    }
+    const bool premultiplied = band.format() == QImage::Format_ARGB32_Premultiplied;
+    const QImage image = premultiplied || band.format() == QImage::Format_ARGB32
+                             ? band : band.convertToFormat(QImage::Format_ARGB32);
+    const int width = m_size.width();
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* pixels = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        uchar* row = reinterpret_cast<uchar*>(m_row.data());
+        row[0] = SubFilter;
+        // Sub滤波：每个字节减去左侧像素的同一通道，大面积纯色压缩后几乎不占空间
+        uchar left[4] = { 0, 0, 0, 0 };
+        for (int x = 0; x < width; ++x) {
+            const QRgb pixel = premultiplied ? qUnpremultiply(pixels[x]) : pixels[x];
+            const uchar channels[4] = { uchar(qRed(pixel)), uchar(qGreen(pixel)), uchar(qBlue(pixel)),
+                                        uchar(qAlpha(pixel)) };
+            uchar* out = row + 1 + x * 4;
+            for (int c = 0; c < 4; ++c) {
+                out[c] = uchar(channels[c] - left[c]);
+                left[c] = channels[c];
+            }
+        }
+        m_stream->next_in = reinterpret_cast<Bytef*>(m_row.data());
+        m_stream->avail_in = uInt(m_row.size());
+        if (!deflateRows(Z_NO_FLUSH)) {
+            return m_ok = false;
+        }
+    }
+    m_rowsWritten += image.height();
+    return true;
+}
+bool PngBandWriter::finish()
+{
+    if (!m_ok || m_rowsWritten != m_size.height()) {
+        return false;
+    }
+    m_stream->next_in = nullptr;
+    m_stream->avail_in = 0;
+    m_ok = deflateRows(Z_FINISH) && flushOutput() && writeChunk("IEND", QByteArray());
+    deflateEnd(m_stream);
+    delete m_stream;
+    m_stream = nullptr;
+    return m_ok;
+}
+bool PngBandWriter::deflateRows(int flush)
+{
+    for (;;) {
+        int result = deflate(m_stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            return false;
+        }
+        if (m_stream->avail_out == 0) {
+            if (!flushOutput()) {
+                return false;
+            }
+            continue;
+        }
+        if (flush == Z_FINISH ? result == Z_STREAM_END : m_stream->avail_in == 0) {
+            return true;
+        }
+    }
+}
+bool PngBandWriter::flushOutput()
+{
+    int used = m_output.size() - int(m_stream->avail_out);
+    bool ok = used == 0 || writeChunk("IDAT", QByteArray::fromRawData(m_output.constData(), used));
+    m_stream->next_out = reinterpret_cast<Bytef*>(m_output.data());
+    m_stream->avail_out = uInt(m_output.size());
+    return ok;
+}
+bool PngBandWriter::writeChunk(const char* type, const QByteArray& data)
+{
+    QByteArray chunk;
+    chunk.reserve(data.size() + 12);
+    appendBigEndian(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    // CRC覆盖块类型和数据，不含长度
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData()) + 4, uInt(chunk.size() - 4));
+    appendBigEndian(chunk, quint32(crc));
+    return m_device->write(chunk) == chunk.size();
+}
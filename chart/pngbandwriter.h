@@ -0,0 +1,40 @@
+#ifndef PNGBANDWRITER_H
+#define PNGBANDWRITER_H
+
+#include <QByteArray>
+#include <QSize>
+
+class QIODevice;
+class QImage;
+struct z_stream_s;
+
+// 分段写出PNG：每次追加一条带的像素行，压缩后立即写入设备，内存占用只与带的大小有关
+// 输出8位RGBA，行滤波固定用Sub，压缩数据积满64KB就作为一个IDAT块写出
+class PngBandWriter
+{
+public:
+    explicit PngBandWriter(QIODevice* device);
+    ~PngBandWriter();
+
+    // 写出文件签名和IHDR
+    bool begin(const QSize& size);
+    // band宽度须与图像相同，累计行数不能超过图像高度
+    bool writeRows(const QImage& band);
+    // 全部行写完后调用，写出剩余的压缩数据和IEND
+    bool finish();
+
+private:
+    bool deflateRows(int flush);
+    bool flushOutput();
+    bool writeChunk(const char* type, const QByteArray& data);
+
+    QIODevice* m_device;
+    z_stream_s* m_stream;
+    QSize m_size;
+    int m_rowsWritten;
+    QByteArray m_row;       // 加上滤波类型字节后的一行
+    QByteArray m_output;    // 压缩输出缓冲
+    bool m_ok;
+};
+
+#endif // PNGBANDWRITER_H
@@ -0,0 +1,194 @@
+﻿#include "chart/revisionstore.h"
+#include "chart/scenemodel.h"
+#include "chart/objectstate.h"
+#include "chart/shape.h"
+#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+namespace {
+const quint32 RevisionMagic = 0x46435256;
+const quint16 RevisionVersion = 1;
+QByteArray encodeShape(const Shape* shape, const QString& text, const SceneSnapshot& scene)
+{
+    int symbolIndex = -1;
+    if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+        symbolIndex = scene.indexOfSymbol(static_cast<const SymbolInstance*>(shape)->master().data());
+    }
+    ShapeState state = ShapeState::fromShape(shape, symbolIndex);
+    state.text = text;
+    QByteArray content;
+    QDataStream out(&content, QIODevice::WriteOnly);
+    out << state;
+    return content;
+}
+QByteArray encodeConnection(const ConnectionPoint& start, const ConnectionPoint& end,
+                            const QHash<const Shape*, int>& shapeIndices)
+{
+    QByteArray content;
+    QDataStream out(&content, QIODevice::WriteOnly);
+    out << EndpointState::fromPoint(start, quint64(shapeIndices.value(start.getOwner(), -1)))
+        << EndpointState::fromPoint(end, quint64(shapeIndices.value(end.getOwner(), -1)));
+    return content;
+}
+Connection* decodeConnection(const QByteArray& content, const QVector<Shape*>& shapes)
+{
+    QDataStream in(content);
+    EndpointState start;
+    EndpointState end;
+    in >> start >> end;
+    ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+    connection->setStartPoint(start.toPoint(shapes.value(int(start.ownerKey), nullptr)));
+    connection->setEndPoint(end.toPoint(shapes.value(int(end.ownerKey), nullptr)));
+    return connection;
+}
+}
+QByteArray RevisionStore::store(const QByteArray& content)
+{
+    QByteArray key = QCryptographicHash::hash(content, QCryptographicHash::Sha1);
+    if (!m_blobs.contains(key)) {
+        m_blobs.insert(key, content);
+    }
+    return key;
+}
+int RevisionStore::commit(const SceneSnapshot& scene, const QString& name)
+{
+    Manifest manifest;
+    manifest.name = name;
+    manifest.created = QDateTime::currentDateTime();
+    manifest.pageSize = scene.pageSize();
+    manifest.backgroundColor = scene.backgroundColor();
+    // 母版：名称、尺寸以及其中图形和连线的键
+    for (const QSharedPointer<Symbol>& symbol : scene.symbols()) {
+        QByteArray content;
+        QDataStream out(&content, QIODevice::WriteOnly);
+        out << symbol->name() << symbol->size();
+        QHash<const Shape*, int> shapeIndices;
+        QVector<QByteArray> shapeKeys;
+        for (int i = 0; i < symbol->shapes().size(); ++i) {
+            shapeIndices.insert(symbol->shapes()[i], i);
+            shapeKeys.append(store(encodeShape(symbol->shapes()[i], symbol->text(i), scene)));
+        }
+        QVector<QByteArray> connectionKeys;
+        for (const Connection* connection : symbol->connections()) {
+            connectionKeys.append(store(encodeConnection(connection->getStartPoint(), connection->getEndPoint(), shapeIndices)));
+        }
+        out << shapeKeys << connectionKeys;
+        manifest.symbols.append(store(content));
+    }
+    manifest.shapes.reserve(scene.shapes().size());
+    for (const ShapeRecordRef& record : scene.shapes()) {
+        manifest.shapes.append(store(encodeShape(record->shape(), record->shape()->text(), scene)));
+    }
+    manifest.connections.reserve(scene.connections().size());
+    for (const ConnectionRecordRef& record : scene.connections()) {
+        manifest.connections.append(store(encodeConnection(record->startPoint(), record->endPoint(), scene.shapeIndices())));
+    }
+    m_revisions.append(manifest);
+    return m_revisions.size() - 1;
+}
+bool RevisionStore::checkout(int index, SceneModel& scene) const
+{
+    if (index < 0 || index >= m_revisions.size()) {
+        return false;
+    }
+    const Manifest& manifest = m_revisions[index];
+    QVector<QSharedPointer<Symbol>> symbols;
+    for (const QByteArray& key : manifest.symbols) {
+        QDataStream in(m_blobs.value(key));
+        QString name;
+        QSize size;
+        QVector<QByteArray> shapeKeys;
+        QVector<QByteArray> connectionKeys;
+        in >> name >> size >> shapeKeys >> connectionKeys;
+        // 母版对象不放进场景的对象池，见Symbol::fromShapes
+        ObjectPool::Scope heapScope(nullptr);
+        QSharedPointer<Symbol> symbol(new Symbol(name, size));
+        QVector<Shape*> shapes;
+        for (const QByteArray& shapeKey : shapeKeys) {
+            QDataStream shapeIn(m_blobs.value(shapeKey));
+            ShapeState state;
+            shapeIn >> state;
+            Shape* shape = state.create(symbols);
+            shapes.append(shape);
+            if (shape) {
+                symbol->addShape(shape, state.text);
+            }
+        }
+        for (const QByteArray& connectionKey : connectionKeys) {
+            symbol->addConnection(decodeConnection(m_blobs.value(connectionKey), shapes));
+        }
+        symbols.append(symbol);
+        scene.addSymbol(symbol);
+    }
+    ObjectPool::Scope poolScope(scene.pool());
+    scene.beginChanges();
+    scene.setPageSize(manifest.pageSize);
+    scene.setBackgroundColor(manifest.backgroundColor);
+    QVector<Shape*> shapes;
+    shapes.reserve(manifest.shapes.size());
+    for (const QByteArray& key : manifest.shapes) {
+        QDataStream in(m_blobs.value(key));
+        ShapeState state;
+        in >> state;
+        Shape* shape = state.create(symbols);
+        shapes.append(shape);
+        if (shape) {
+            scene.addShape(shape);
+        }
+    }
+    for (const QByteArray& key : manifest.connections) {
+        scene.addConnection(decodeConnection(m_blobs.value(key), shapes));
+    }
+    scene.endChanges();
+    return true;
+}
+qint64 RevisionStore::blobBytes() const
+{
+    qint64 bytes = 0;
+    for (QHash<QByteArray, QByteArray>::const_iterator it = m_blobs.constBegin(); it != m_blobs.constEnd(); ++it) {
+        bytes += it.key().size() + it.value().size();
+    }
+    return bytes;
+}
+void RevisionStore::clear()
+{
+    m_blobs.clear();
+    m_revisions.clear();
+}
+QByteArray RevisionStore::save() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << RevisionMagic << RevisionVersion << m_blobs << qint32(m_revisions.size());
+    for (const Manifest& manifest : m_revisions) {
+        out << manifest.name << manifest.created << manifest.pageSize << manifest.backgroundColor
+            << manifest.symbols << manifest.shapes << manifest.connections;
+    }
+    return data;
+}
+bool RevisionStore::load(const QByteArray& data)
+{
+    clear();
+    QDataStream in(data);
+    quint32 magic;
+    quint16 version;
+    qint32 count;
+    in >> magic >> version;
+    if (magic != RevisionMagic || version != RevisionVersion) {
+        return false;
+    }
+    in >> m_blobs >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Manifest manifest;
+        in >> manifest.name >> manifest.created >> manifest.pageSize >> manifest.backgroundColor
+           >> manifest.symbols >> manifest.shapes >> manifest.connections;
+        m_revisions.append(manifest);
+    }
+    if (in.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef REVISIONSTORE_H
+#define REVISIONSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QDateTime>
+#include <QSize>
+#include <QColor>
+
+class SceneModel;
+class SceneSnapshot;
+
+// 文档内的命名修订历史（如“v1 已审批”“v2 草稿”），按内容寻址去重存储
+// 每个图形、连线和符号母版序列化后以内容的SHA-1为键存入blob库，修订本身只是引用这些键的清单，
+// 未变化的对象在各修订之间共享同一个blob；签出修订时只解码其清单引用到的blob
+// 内部容器都是隐式共享的，复制整个修订库（如放进快照）是O(1)的
+class RevisionStore
+{
+public:
+    RevisionStore() {}
+
+    int revisionCount() const { return m_revisions.size(); }
+    QString revisionName(int index) const { return m_revisions.value(index).name; }
+    QDateTime revisionTime(int index) const { return m_revisions.value(index).created; }
+
+    // 把快照的内容保存为一个命名修订，返回修订下标
+    int commit(const SceneSnapshot& scene, const QString& name);
+    // 把修订中的符号、图形和连线加入场景并恢复页面设置；调用方负责先移走现有的图形与连线
+    bool checkout(int index, SceneModel& scene) const;
+
+    int blobCount() const { return m_blobs.size(); }
+    qint64 blobBytes() const;
+    bool isEmpty() const { return m_revisions.isEmpty(); }
+    void clear();
+
+    // 整个修订库的二进制形式，嵌入在文档的元数据中
+    QByteArray save() const;
+    bool load(const QByteArray& data);
+
+private:
+    // 修订清单：页面设置以及按顺序排列的符号、图形、连线blob键
+    // 图形引用的母版和连线端点所属的图形都用在本清单（或母版）中的下标表示
+    struct Manifest
+    {
+        QString name;
+        QDateTime created;
+        QSize pageSize;
+        QColor backgroundColor;
+        QVector<QByteArray> symbols;
+        QVector<QByteArray> shapes;
+        QVector<QByteArray> connections;
+    };
+
+    QByteArray store(const QByteArray& content);    // 返回内容的键，相同内容只保存一份
+
+    QHash<QByteArray, QByteArray> m_blobs;
+    QVector<Manifest> m_revisions;
+};
+
+#endif // REVISIONSTORE_H
@@ -0,0 +1,296 @@
+﻿#include "chart/scenecommands.h"
+#include "chart/scenemodel.h"
+#include "chart/shape.h"
+#include "chart/symbol.h"
+#include <QSet>
+#include <QHash>
+#include <QPair>
+#include <algorithm>
+ObjectSetCommand::ObjectSetCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                                   const QVector<Connection*>& connections, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_shapes(shapes),
+      m_connections(connections),
+      m_owned(false)
+{
+}
+ObjectSetCommand::~ObjectSetCommand()
+{
+    if (m_owned) {
+        qDeleteAll(m_connections);
+        qDeleteAll(m_shapes);
+    }
+}
+qint64 ObjectSetCommand::byteCost() const
+{
+    qint64 cost = UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand)
+                  + m_shapes.capacity() * sizeof(Shape*) + m_shapeIndices.capacity() * sizeof(int)
+                  + m_shapeIds.capacity() * sizeof(quint64)
+                  + m_connections.capacity() * sizeof(Connection*) + m_connectionIndices.capacity() * sizeof(int)
+                  + m_connectionIds.capacity() * sizeof(quint64);
+    if (m_owned) {
+        for (const Shape* shape : m_shapes) {
+            cost += sizeof(Shape) + shape->text().capacity() * sizeof(QChar)
+                    + shape->incidentConnections().capacity() * sizeof(Connection*);
+        }
+        cost += m_connections.size() * sizeof(ArrowLine);
+    }
+    return cost;
+}
+void ObjectSetCommand::take()
+{
+    if (m_owned) {
+        return;
+    }
+    // 先记录ID，再各遍历一次列表批量移出；已不在场景中的对象不归本命令所有，批量移出时自然被忽略
+    QSet<Shape*> shapeSet;
+    QHash<const Shape*, quint64> shapeIds;
+    for (Shape* shape : m_shapes) {
+        shapeSet.insert(shape);
+        shapeIds.insert(shape, m_scene->idOf(shape));
+    }
+    QSet<Connection*> connectionSet;
+    QHash<const Connection*, quint64> connectionIds;
+    for (Connection* connection : m_connections) {
+        connectionSet.insert(connection);
+        connectionIds.insert(connection, m_scene->idOf(connection));
+    }
+    m_shapes.clear();
+    m_shapeIndices.clear();
+    m_shapeIds.clear();
+    m_connections.clear();
+    m_connectionIndices.clear();
+    m_connectionIds.clear();
+    m_scene->beginChanges();
+    for (const QPair<int, Connection*>& taken : m_scene->takeConnections(connectionSet)) {
+        m_connections.append(taken.second);
+        m_connectionIndices.append(taken.first);
+        m_connectionIds.append(connectionIds.value(taken.second));
+    }
+    for (const QPair<int, Shape*>& taken : m_scene->takeShapes(shapeSet)) {
+        m_shapes.append(taken.second);
+        m_shapeIndices.append(taken.first);
+        m_shapeIds.append(shapeIds.value(taken.second));
+    }
+    m_scene->endChanges();
+    m_owned = true;
+}
+void ObjectSetCommand::restore()
+{
+    if (!m_owned) {
+        return;
+    }
+    m_scene->beginChanges();
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        m_scene->insertShape(m_shapeIndices[i], m_shapes[i], m_shapeIds[i]);
+    }
+    for (int i = 0; i < m_connections.size(); ++i) {
+        m_scene->insertConnection(m_connectionIndices[i], m_connections[i], m_connectionIds[i]);
+    }
+    m_scene->endChanges();
+    m_owned = false;
+}
+AddObjectsCommand::AddObjectsCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                                     const QVector<Connection*>& connections, const QString& text)
+    : ObjectSetCommand(scene, shapes, connections, text)
+{
+}
+RemoveObjectsCommand::RemoveObjectsCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                                           const QVector<Connection*>& connections, const QString& text)
+    : ObjectSetCommand(scene, shapes, connections, text)
+{
+    QSet<Connection*> listed;
+    for (Connection* connection : m_connections) {
+        listed.insert(connection);
+    }
+    for (Shape* shape : m_shapes) {
+        for (Connection* connection : shape->incidentConnections()) {
+            if (!listed.contains(connection) && m_scene->idOf(connection) != SceneModel::InvalidId) {
+                listed.insert(connection);
+                m_connections.append(connection);
+            }
+        }
+    }
+}
+DocumentCommand::State DocumentCommand::capture(const SceneModel* scene)
+{
+    State state;
+    state.symbols = scene->symbols();
+    state.revisions = scene->revisions();
+    state.pageSize = scene->pageSize();
+    state.backgroundColor = scene->backgroundColor();
+    return state;
+}
+DocumentCommand::DocumentCommand(SceneModel* scene, const State& before, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_before(before),
+      m_after(capture(scene))
+{
+}
+qint64 DocumentCommand::byteCost() const
+{
+    return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand)
+           + (m_before.symbols.capacity() + m_after.symbols.capacity()) * sizeof(QSharedPointer<Symbol>);
+}
+void DocumentCommand::apply(const State& state)
+{
+    m_scene->setSymbols(state.symbols);
+    m_scene->setRevisions(state.revisions);
+    m_scene->setPageSize(state.pageSize);
+    m_scene->setBackgroundColor(state.backgroundColor);
+}
+GeometryCommand::GeometryCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                                 const QVector<QRect>& before, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_shapes(shapes),
+      m_before(before)
+{
+    for (Shape* shape : m_shapes) {
+        m_after.append(shape->getRect());
+    }
+}
+bool GeometryCommand::mergeWith(const UndoCommand* other)
+{
+    const GeometryCommand* next = static_cast<const GeometryCommand*>(other);
+    if (next->m_shapes != m_shapes) {
+        return false;
+    }
+    m_after = next->m_after;
+    return true;
+}
+qint64 GeometryCommand::byteCost() const
+{
+    return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand) + m_shapes.capacity() * sizeof(Shape*)
+           + (m_before.capacity() + m_after.capacity()) * sizeof(QRect);
+}
+void GeometryCommand::apply(const QVector<QRect>& rects)
+{
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        if (m_shapes[i]->getRect() != rects[i]) {
+            m_shapes[i]->setRect(rects[i]);
+            m_scene->notifyShapeChanged(m_shapes[i]);
+        }
+    }
+}
+EndpointCommand::EndpointCommand(SceneModel* scene, Connection* connection,
+                                 const ConnectionPoint& startBefore, const ConnectionPoint& endBefore, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_connection(connection),
+      m_startBefore(startBefore),
+      m_endBefore(endBefore),
+      m_startAfter(connection->getStartPoint()),
+      m_endAfter(connection->getEndPoint())
+{
+}
+bool EndpointCommand::mergeWith(const UndoCommand* other)
+{
+    const EndpointCommand* next = static_cast<const EndpointCommand*>(other);
+    if (next->m_connection != m_connection) {
+        return false;
+    }
+    m_startAfter = next->m_startAfter;
+    m_endAfter = next->m_endAfter;
+    return true;
+}
+void EndpointCommand::apply(const ConnectionPoint& start, const ConnectionPoint& end)
+{
+    bool changed = false;
+    if (!m_connection->getStartPoint().equalTo(start)) {
+        m_connection->setStartPoint(start);
+        changed = true;
+    }
+    if (!m_connection->getEndPoint().equalTo(end)) {
+        m_connection->setEndPoint(end);
+        changed = true;
+    }
+    if (changed) {
+        m_scene->notifyConnectionChanged(m_connection);
+    }
+}
+StyleCommand::StyleCommand(SceneModel* scene, Shape* shape, const ShapeStyleRef& before, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_shape(shape),
+      m_before(before),
+      m_after(shape->style())
+{
+}
+bool StyleCommand::mergeWith(const UndoCommand* other)
+{
+    const StyleCommand* next = static_cast<const StyleCommand*>(other);
+    if (next->m_shape != m_shape || next->text() != text()) {
+        return false;
+    }
+    m_after = next->m_after;
+    return true;
+}
+void StyleCommand::apply(const ShapeStyleRef& style)
+{
+    if (m_shape->style() != style) {
+        m_shape->setStyle(style);
+        m_scene->notifyShapeChanged(m_shape);
+    }
+}
+TextCommand::TextCommand(SceneModel* scene, Shape* shape, const QString& before, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_shape(shape),
+      m_before(before),
+      m_after(shape->text())
+{
+}
+qint64 TextCommand::byteCost() const
+{
+    return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand)
+           + (m_before.capacity() + m_after.capacity()) * sizeof(QChar);
+}
+void TextCommand::apply(const QString& text)
+{
+    if (m_shape->text() != text) {
+        m_shape->setText(text);
+        m_scene->notifyShapeChanged(m_shape);
+    }
+}
+LayerCommand::LayerCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                           const QVector<int>& before, const QString& text)
+    : UndoCommand(text),
+      m_scene(scene),
+      m_shapes(shapes),
+      m_before(before)
+{
+    for (Shape* shape : m_shapes) {
+        m_after.append(m_scene->indexOf(shape));
+    }
+}
+qint64 LayerCommand::byteCost() const
+{
+    return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand) + m_shapes.capacity() * sizeof(Shape*)
+           + (m_before.capacity() + m_after.capacity()) * sizeof(int);
+}
+void LayerCommand::apply(const QVector<int>& indices)
+{
+    bool inPlace = true;
+    QSet<Shape*> moved;
+    QVector<QPair<int, Shape*>> targets;
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        moved.insert(m_shapes[i]);
+        targets.append(qMakePair(indices[i], m_shapes[i]));
+        inPlace = inPlace && m_scene->indexOf(m_shapes[i]) == indices[i];
+    }
+    if (inPlace) {
+        return;
+    }
+    // 先把被移动的图形按原相对顺序放到最上层，其余图形就处在正确的相对位置；
+    // 再按目标下标从小到大逐个插回，每一步之前的前缀都已经正确
+    std::sort(targets.begin(), targets.end());
+    m_scene->beginChanges();
+    m_scene->bringShapesToFront(moved);
+    for (const QPair<int, Shape*>& target : targets) {
+        m_scene->moveShape(m_scene->indexOf(target.second), target.first);
+    }
+    m_scene->endChanges();
+}
@@ -0,0 +1,197 @@
+#ifndef SCENECOMMANDS_H
+#define SCENECOMMANDS_H
+
+#include <QVector>
+#include <QRect>
+#include <QSize>
+#include <QColor>
+#include <QSharedPointer>
+#include "chart/undostack.h"
+#include "chart/connection.h"
+#include "chart/shapestyle.h"
+#include "chart/revisionstore.h"
+
+class SceneModel;
+class Shape;
+class Symbol;
+
+// 场景编辑命令：都按对象指针记录差量，被删除的对象由命令持有而不是销毁，
+// 因此撤销后指针保持不变，栈中更早的命令仍然有效
+enum SceneCommandId {
+    GeometryCommandId = 1,
+    EndpointCommandId,
+    StyleCommandId
+};
+
+// 一组图形与连线在场景中的进出；对象不在场景中时由命令持有并在析构时释放
+// 移出时记录对象ID，放回时沿用原ID，按ID记录的修订与日志在撤销前后保持一致
+class ObjectSetCommand : public UndoCommand
+{
+public:
+    ObjectSetCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                     const QVector<Connection*>& connections, const QString& text);
+    ~ObjectSetCommand();
+    qint64 byteCost() const override;
+
+protected:
+    void take();      // 记录图层位置后移出场景
+    void restore();   // 按记录的位置放回场景
+
+    SceneModel* m_scene;
+    QVector<Shape*> m_shapes;
+    QVector<int> m_shapeIndices;
+    QVector<quint64> m_shapeIds;
+    QVector<Connection*> m_connections;
+    QVector<int> m_connectionIndices;
+    QVector<quint64> m_connectionIds;
+    bool m_owned;
+};
+
+// 新建对象（拖放、连线、粘贴、导入）：入栈前对象已加入场景
+class AddObjectsCommand : public ObjectSetCommand
+{
+public:
+    AddObjectsCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                      const QVector<Connection*>& connections, const QString& text);
+    void undo() override { take(); }
+    void redo() override { restore(); }
+};
+
+// 删除对象：图形上的连线会一并删除
+class RemoveObjectsCommand : public ObjectSetCommand
+{
+public:
+    RemoveObjectsCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                         const QVector<Connection*>& connections, const QString& text);
+    void undo() override { restore(); }
+    void redo() override { take(); }
+};
+
+// 文档级状态：符号库、命名修订与页面设置
+// 导入和恢复修订会替换这些状态，与对象进出命令放进同一个宏，撤销时一并恢复；各容器都是隐式共享的，保存一份是O(1)的
+class DocumentCommand : public UndoCommand
+{
+public:
+    struct State {
+        QVector<QSharedPointer<Symbol>> symbols;
+        RevisionStore revisions;
+        QSize pageSize;
+        QColor backgroundColor;
+    };
+    static State capture(const SceneModel* scene);
+
+    // before为修改前用capture保存的状态，修改后的状态在构造时读取
+    DocumentCommand(SceneModel* scene, const State& before, const QString& text);
+    void undo() override { apply(m_before); }
+    void redo() override { apply(m_after); }
+    qint64 byteCost() const override;
+
+private:
+    void apply(const State& state);
+
+    SceneModel* m_scene;
+    State m_before;
+    State m_after;
+};
+
+// 移动或缩放：只保存前后矩形，同一组图形的连续更新合并为一条
+class GeometryCommand : public UndoCommand
+{
+public:
+    GeometryCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                    const QVector<QRect>& before, const QString& text);
+    void undo() override { apply(m_before); }
+    void redo() override { apply(m_after); }
+    int id() const override { return GeometryCommandId; }
+    bool mergeWith(const UndoCommand* other) override;
+    qint64 byteCost() const override;
+
+private:
+    void apply(const QVector<QRect>& rects);
+
+    SceneModel* m_scene;
+    QVector<Shape*> m_shapes;
+    QVector<QRect> m_before;
+    QVector<QRect> m_after;
+};
+
+// 连线端点变化（拖动端点、重新连接、平移自由连线）
+class EndpointCommand : public UndoCommand
+{
+public:
+    EndpointCommand(SceneModel* scene, Connection* connection,
+                    const ConnectionPoint& startBefore, const ConnectionPoint& endBefore, const QString& text);
+    void undo() override { apply(m_startBefore, m_endBefore); }
+    void redo() override { apply(m_startAfter, m_endAfter); }
+    int id() const override { return EndpointCommandId; }
+    bool mergeWith(const UndoCommand* other) override;
+    qint64 byteCost() const override { return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand); }
+
+private:
+    void apply(const ConnectionPoint& start, const ConnectionPoint& end);
+
+    SceneModel* m_scene;
+    Connection* m_connection;
+    ConnectionPoint m_startBefore;
+    ConnectionPoint m_endBefore;
+    ConnectionPoint m_startAfter;
+    ConnectionPoint m_endAfter;
+};
+
+// 样式变化：样式是共享的驻留对象，前后各只保存一个引用；同一图形同一属性的连续修改合并
+class StyleCommand : public UndoCommand
+{
+public:
+    StyleCommand(SceneModel* scene, Shape* shape, const ShapeStyleRef& before, const QString& text);
+    void undo() override { apply(m_before); }
+    void redo() override { apply(m_after); }
+    int id() const override { return StyleCommandId; }
+    bool mergeWith(const UndoCommand* other) override;
+    qint64 byteCost() const override { return UndoCommand::byteCost() + sizeof(*this) - sizeof(UndoCommand); }
+
+private:
+    void apply(const ShapeStyleRef& style);
+
+    SceneModel* m_scene;
+    Shape* m_shape;
+    ShapeStyleRef m_before;
+    ShapeStyleRef m_after;
+};
+
+class TextCommand : public UndoCommand
+{
+public:
+    TextCommand(SceneModel* scene, Shape* shape, const QString& before, const QString& text);
+    void undo() override { apply(m_before); }
+    void redo() override { apply(m_after); }
+    qint64 byteCost() const override;
+
+private:
+    void apply(const QString& text);
+
+    SceneModel* m_scene;
+    Shape* m_shape;
+    QString m_before;
+    QString m_after;
+};
+
+// 图层顺序变化：只记录被移动图形的前后下标，其余图形的相对顺序不变
+class LayerCommand : public UndoCommand
+{
+public:
+    LayerCommand(SceneModel* scene, const QVector<Shape*>& shapes,
+                 const QVector<int>& before, const QString& text);
+    void undo() override { apply(m_before); }
+    void redo() override { apply(m_after); }
+    qint64 byteCost() const override;
+
+private:
+    void apply(const QVector<int>& indices);
+
+    SceneModel* m_scene;
+    QVector<Shape*> m_shapes;
+    QVector<int> m_before;
+    QVector<int> m_after;
+};
+
+#endif // SCENECOMMANDS_H
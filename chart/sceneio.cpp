@@ -0,0 +1,612 @@
+﻿#include "chart/sceneio.h"
+#include "chart/scenemodel.h"
+#include "chart/shape.h"
+#include "chart/connection.h"
+#include "chart/shapefactory.h"
+#include "chart/symbol.h"
+#include "chart/binaryformat.h"
+#include "chart/cborformat.h"
+#include "chart/pngbandwriter.h"
+#include <QCoreApplication>
+#include <QPainter>
+#include <QImage>
+#include <QSvgGenerator>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QBuffer>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QtMath>
+#include <functional>
+namespace {
+const char* const FlowchartNamespace = "http://flowchart.zeqi.com/ns";
+int connectionPointIndex(const ConnectionPoint& point, qreal* outlineParam)
+{
+    switch (point.getPositionType()) {
+    case ConnectionPoint::Top: return 0;
+    case ConnectionPoint::Right: return 1;
+    case ConnectionPoint::Bottom: return 2;
+    case ConnectionPoint::Left: return 3;
+    case ConnectionPoint::Outline:
+        *outlineParam = point.getOutlineParam();
+        return -1;
+    default: return -1;
+    }
+}
+QString boolAttribute(bool value)
+{
+    return value ? QStringLiteral("true") : QStringLiteral("false");
+}
+void writeShape(QXmlStreamWriter& writer, const Shape* shape, int id, const QString& text, const SceneSnapshot& scene)
+{
+    QRect rect = shape->getRect();
+    writer.writeStartElement("flowchart:shape");
+    writer.writeAttribute("id", QString::number(id));
+    writer.writeAttribute("type", shape->type());
+    writer.writeAttribute("x", QString::number(rect.x()));
+    writer.writeAttribute("y", QString::number(rect.y()));
+    writer.writeAttribute("width", QString::number(rect.width()));
+    writer.writeAttribute("height", QString::number(rect.height()));
+    writer.writeAttribute("text", text);
+    writer.writeAttribute("fontFamily", shape->fontFamily());
+    writer.writeAttribute("fontSize", QString::number(shape->fontSize()));
+    writer.writeAttribute("fontBold", boolAttribute(shape->isFontBold()));
+    writer.writeAttribute("fontItalic", boolAttribute(shape->isFontItalic()));
+    writer.writeAttribute("fontColor", shape->fontColor().name());
+    writer.writeAttribute("fontUnderline", boolAttribute(shape->isFontUnderline()));
+    if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+        const SymbolInstance* instance = static_cast<const SymbolInstance*>(shape);
+        writer.writeAttribute("symbol", QString::number(scene.indexOfSymbol(instance->master().data())));
+        for (QHash<int, QString>::const_iterator it = instance->textOverrides().constBegin();
+             it != instance->textOverrides().constEnd(); ++it) {
+            writer.writeEmptyElement("flowchart:override");
+            writer.writeAttribute("index", QString::number(it.key()));
+            writer.writeAttribute("text", it.value());
+        }
+    }
+    writer.writeEndElement();
+}
+void writeConnection(QXmlStreamWriter& writer, const ConnectionPoint& startCP, const ConnectionPoint& endCP, bool isArrow,
+                     int id, const QHash<const Shape*, int>& shapeIndices)
+{
+    QPoint startPos = startCP.isValid() ? startCP.getPosition() : QPoint(0, 0);
+    QPoint endPos = endCP.getPosition();
+    int startShapeIndex = -1;
+    int startConnectionPointIndex = -1;
+    int endShapeIndex = -1;
+    int endConnectionPointIndex = -1;
+    qreal startOutlineParam = -1.0;
+    qreal endOutlineParam = -1.0;
+    if (startCP.getOwner()) {
+        startShapeIndex = shapeIndices.value(startCP.getOwner(), -1);
+        startConnectionPointIndex = connectionPointIndex(startCP, &startOutlineParam);
+    }
+    if (endCP.getOwner()) {
+        endShapeIndex = shapeIndices.value(endCP.getOwner(), -1);
+        endConnectionPointIndex = connectionPointIndex(endCP, &endOutlineParam);
+    }
+    writer.writeEmptyElement("flowchart:connection");
+    writer.writeAttribute("id", QString::number(id));
+    writer.writeAttribute("startX", QString::number(startPos.x()));
+    writer.writeAttribute("startY", QString::number(startPos.y()));
+    writer.writeAttribute("endX", QString::number(endPos.x()));
+    writer.writeAttribute("endY", QString::number(endPos.y()));
+    writer.writeAttribute("isArrow", boolAttribute(isArrow));
+    writer.writeAttribute("startShapeIndex", QString::number(startShapeIndex));
+    writer.writeAttribute("startConnectionPointIndex", QString::number(startConnectionPointIndex));
+    writer.writeAttribute("endShapeIndex", QString::number(endShapeIndex));
+    writer.writeAttribute("endConnectionPointIndex", QString::number(endConnectionPointIndex));
+    if (startOutlineParam >= 0.0 || endOutlineParam >= 0.0) {
+        writer.writeAttribute("startOutlineParam", QString::number(startOutlineParam, 'g', 10));
+        writer.writeAttribute("endOutlineParam", QString::number(endOutlineParam, 'g', 10));
+    }
+}
+void writeSymbol(QXmlStreamWriter& writer, const Symbol& symbol, int id, const SceneSnapshot& scene)
+{
+    writer.writeStartElement("flowchart:symbol");
+    writer.writeAttribute("id", QString::number(id));
+    writer.writeAttribute("name", symbol.name());
+    writer.writeAttribute("width", QString::number(symbol.size().width()));
+    writer.writeAttribute("height", QString::number(symbol.size().height()));
+    QHash<const Shape*, int> shapeIndices;
+    for (int i = 0; i < symbol.shapes().size(); ++i) {
+        shapeIndices.insert(symbol.shapes()[i], i);
+        writeShape(writer, symbol.shapes()[i], i, symbol.text(i), scene);
+    }
+    writer.writeStartElement("flowchart:connections");
+    for (int i = 0; i < symbol.connections().size(); ++i) {
+        const Connection* conn = symbol.connections()[i];
+        writeConnection(writer, conn->getStartPoint(), conn->getEndPoint(),
+                        dynamic_cast<const ArrowLine*>(conn) != nullptr, i, shapeIndices);
+    }
+    writer.writeEndElement();
+    writer.writeEndElement();
+}
+// 每一段都单独声明flowchart命名空间，与旧版本写出的文件保持一致
+void writeFlowchartSection(QXmlStreamWriter& writer, const QString& name)
+{
+    writer.writeStartElement(name);
+    writer.writeAttribute("xmlns:flowchart", FlowchartNamespace);
+}
+void writeMetadata(QXmlStreamWriter& writer, const SceneSnapshot& scene)
+{
+    writer.writeStartElement("metadata");
+    writeFlowchartSection(writer, "flowchart:settings");
+    writer.writeTextElement("flowchart:drawingAreaWidth", QString::number(scene.pageSize().width()));
+    writer.writeTextElement("flowchart:drawingAreaHeight", QString::number(scene.pageSize().height()));
+    writer.writeTextElement("flowchart:backgroundColor", scene.backgroundColor().name());
+    writer.writeEndElement();
+    if (!scene.symbols().isEmpty()) {
+        writeFlowchartSection(writer, "flowchart:symbols");
+        for (int i = 0; i < scene.symbols().size(); ++i) {
+            writeSymbol(writer, *scene.symbols().at(i), i, scene);
+        }
+        writer.writeEndElement();
+    }
+    writeFlowchartSection(writer, "flowchart:shapes");
+    for (int i = 0; i < scene.shapes().size(); ++i) {
+        const Shape* shape = scene.shapes()[i]->shape();
+        writeShape(writer, shape, i, shape->text(), scene);
+    }
+    writer.writeStartElement("flowchart:connections");
+    for (int i = 0; i < scene.connections().size(); ++i) {
+        const ConnectionRecord& record = *scene.connections()[i];
+        writeConnection(writer, record.startPoint(), record.endPoint(), record.isArrow(), i, scene.shapeIndices());
+    }
+    writer.writeEndElement();
+    writer.writeEndElement();
+    if (!scene.revisions().isEmpty()) {
+        writeFlowchartSection(writer, "flowchart:revisions");
+        writer.writeCharacters(QString::fromLatin1(scene.revisions().save().toBase64()));
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+}
+Shape* readShape(QXmlStreamReader& reader, const QVector<SymbolRef>& symbols)
+{
+    const QXmlStreamAttributes attributes = reader.attributes();
+    QString type = attributes.value("type").toString();
+    int x = attributes.value("x").toInt();
+    int y = attributes.value("y").toInt();
+    int width = attributes.value("width").toInt();
+    int height = attributes.value("height").toInt();
+    Shape* newShape = nullptr;
+    if (ShapeFactory::typeId(type) == ShapeFactory::SymbolInstanceType) {
+        SymbolRef master = attributes.hasAttribute("symbol") ? symbols.value(attributes.value("symbol").toInt()) : SymbolRef();
+        if (master) {
+            newShape = new SymbolInstance(master);
+        }
+    } else {
+        int basis = qMin(width, height) / 2;
+        basis = qMax(basis, 30); 
+        newShape = ShapeFactory::instance().createShape(type, basis);
+    }
+    // 子元素只有实例的文字覆盖，读完后读取位置停在</flowchart:shape>
+    while (reader.readNextStartElement()) {
+        if (newShape && reader.qualifiedName() == QLatin1String("flowchart:override")) {
+            static_cast<SymbolInstance*>(newShape)->setTextOverride(reader.attributes().value("index").toInt(),
+                                                                    reader.attributes().value("text").toString());
+        }
+        reader.skipCurrentElement();
+    }
+    if (!newShape) {
+        return nullptr;
+    }
+    QRect rect(x, y, width, height);
+    newShape->setRect(rect);
+    newShape->setText(attributes.value("text").toString());
+    ShapeStyle style(*newShape->style());
+    QStringRef fontFamily = attributes.value("fontFamily");
+    if (!fontFamily.isEmpty()) {
+        style.setFontFamily(fontFamily.toString());
+    }
+    int fontSize = attributes.value("fontSize").toInt();
+    if (fontSize > 0) {
+        style.setFontSize(fontSize);
+    }
+    style.setFontBold(attributes.value("fontBold") == QLatin1String("true"));
+    style.setFontItalic(attributes.value("fontItalic") == QLatin1String("true"));
+    style.setFontUnderline(attributes.value("fontUnderline") == QLatin1String("true"));
+    QStringRef fontColor = attributes.value("fontColor");
+    if (!fontColor.isEmpty()) {
+        style.setFontColor(QColor(fontColor.toString()));
+    }
+    newShape->setStyle(ShapeStyle::intern(style));
+    return newShape;
+}
+Connection* readConnection(const QXmlStreamAttributes& attributes, const QVector<Shape*>& shapes)
+{
+    int startX = attributes.value("startX").toInt();
+    int startY = attributes.value("startY").toInt();
+    int endX = attributes.value("endX").toInt();
+    int endY = attributes.value("endY").toInt();
+    int startShapeIndex = attributes.value("startShapeIndex").toInt();
+    int startConnectionPointIndex = attributes.value("startConnectionPointIndex").toInt();
+    int endShapeIndex = attributes.value("endShapeIndex").toInt();
+    int endConnectionPointIndex = attributes.value("endConnectionPointIndex").toInt();
+    qreal startOutlineParam = attributes.hasAttribute("startOutlineParam") ? attributes.value("startOutlineParam").toDouble() : -1.0;
+    qreal endOutlineParam = attributes.hasAttribute("endOutlineParam") ? attributes.value("endOutlineParam").toDouble() : -1.0;
+    ArrowLine* arrowLine = new ArrowLine(QPoint(startX, startY), QPoint(endX, endY));
+    Shape* startShape = shapes.value(startShapeIndex, nullptr);
+    if (startShape && startConnectionPointIndex >= 0 && startConnectionPointIndex <= 3) {
+        arrowLine->setStartPoint(startShape->port(static_cast<ConnectionPoint::Position>(startConnectionPointIndex)));
+    } else if (startShape && startOutlineParam >= 0.0) {
+        arrowLine->setStartPoint(ConnectionPoint(startShape, startOutlineParam));
+    }
+    Shape* endShape = shapes.value(endShapeIndex, nullptr);
+    if (endShape && endConnectionPointIndex >= 0 && endConnectionPointIndex <= 3) {
+        arrowLine->setEndPoint(endShape->port(static_cast<ConnectionPoint::Position>(endConnectionPointIndex)));
+    } else if (endShape && endOutlineParam >= 0.0) {
+        arrowLine->setEndPoint(ConnectionPoint(endShape, endOutlineParam));
+    }
+    return arrowLine;
+}
+// 读取<flowchart:shape>和<flowchart:connections>交替出现的列表，shapeRead在每读入一个图形后调用
+// 读取位置停在列表父元素的结束标签
+void readShapeList(QXmlStreamReader& reader, const QVector<SymbolRef>& symbols, QVector<Shape*>* shapes,
+                   QVector<Connection*>* connections, const std::function<void(Shape*)>& shapeRead)
+{
+    while (reader.readNextStartElement()) {
+        if (reader.qualifiedName() == QLatin1String("flowchart:shape")) {
+            Shape* shape = readShape(reader, symbols);
+            shapes->append(shape);
+            shapeRead(shape);
+        } else if (reader.qualifiedName() == QLatin1String("flowchart:connections")) {
+            while (reader.readNextStartElement()) {
+                if (reader.qualifiedName() == QLatin1String("flowchart:connection")) {
+                    connections->append(readConnection(reader.attributes(), *shapes));
+                }
+                reader.skipCurrentElement();
+            }
+        } else {
+            reader.skipCurrentElement();
+        }
+    }
+}
+
+// 用QSvgGenerator把一段内容渲染到内存，返回</defs>之后、</svg>之前的部分；header返回文档开头到</defs>为止的部分
+QByteArray renderSvgBody(const QSize& size, const std::function<void(QPainter*)>& paint, QByteArray* header = nullptr)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QSvgGenerator generator;
+    generator.setOutputDevice(&buffer);
+    generator.setSize(size);
+    generator.setViewBox(QRect(0, 0, size.width(), size.height()));
+    if (header) {
+        generator.setTitle(QCoreApplication::translate("DrawingArea", "flow chart"));
+        generator.setDescription(QCoreApplication::translate("DrawingArea", "SVG file generated by flowchart designer"));
+    }
+    generator.setResolution(96);
+    QPainter painter;
+    painter.begin(&generator);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::TextAntialiasing, true);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    paint(&painter);
+    painter.end();
+    const QByteArray& svgData = buffer.data();
+    int bodyStart = svgData.indexOf("</defs>");
+    bodyStart = bodyStart == -1 ? 0 : bodyStart + 7;
+    int bodyEnd = svgData.lastIndexOf("</svg>");
+    if (bodyEnd < bodyStart) {
+        bodyEnd = svgData.size();
+    }
+    if (header) {
+        *header = svgData.left(bodyStart);
+    }
+    return svgData.mid(bodyStart, bodyEnd - bodyStart);
+}
+QByteArray transformAttribute(const QTransform& transform)
+{
+    return QString("matrix(%1 %2 %3 %4 %5 %6)")
+        .arg(transform.m11(), 0, 'g', 10)
+        .arg(transform.m12(), 0, 'g', 10)
+        .arg(transform.m21(), 0, 'g', 10)
+        .arg(transform.m22(), 0, 'g', 10)
+        .arg(transform.dx(), 0, 'g', 10)
+        .arg(transform.dy(), 0, 'g', 10)
+        .toLatin1();
+}
+// 含符号实例时的SVG内容：每个母版在<defs>中只输出一次，实例输出为<use>加上自身的文字
+// 普通图形按图层顺序分段渲染，与<use>交错排列以保持遮挡关系；header返回到</defs>为止的部分
+QByteArray renderSvgWithSymbols(const SceneSnapshot& scene, QByteArray* header)
+{
+    QSize pageSize = scene.pageSize();
+    QByteArray body = renderSvgBody(pageSize, [&scene, pageSize](QPainter* painter) {
+        painter->fillRect(QRect(QPoint(0, 0), pageSize), scene.backgroundColor());
+    }, header);
+    QVector<ShapeRecordRef> run;
+    QSet<int> usedSymbols;
+    const QVector<ShapeRecordRef>& shapes = scene.shapes();
+    for (int i = 0; i <= shapes.size(); ++i) {
+        const Shape* shape = i < shapes.size() ? shapes[i]->shape() : nullptr;
+        bool isInstance = shape && shape->typeId() == ShapeFactory::SymbolInstanceType;
+        if ((isInstance || !shape) && !run.isEmpty()) {
+            body += renderSvgBody(pageSize, [&run](QPainter* painter) {
+                for (const ShapeRecordRef& item : run) {
+                    item->paint(painter);
+                }
+            });
+            run.clear();
+        }
+        if (!shape) {
+            break;
+        }
+        if (!isInstance) {
+            run.append(shapes[i]);
+            continue;
+        }
+        const SymbolInstance* instance = static_cast<const SymbolInstance*>(shape);
+        int symbolIndex = scene.indexOfSymbol(instance->master().data());
+        if (symbolIndex >= 0) {
+            usedSymbols.insert(symbolIndex);
+            body += "<use xlink:href=\"#symbol-" + QByteArray::number(symbolIndex)
+                    + "\" transform=\"" + transformAttribute(instance->transform()) + "\"/>\n";
+        }
+        body += renderSvgBody(pageSize, [instance](QPainter* painter) {
+            instance->paintTexts(painter);
+        });
+    }
+    body += renderSvgBody(pageSize, [&scene](QPainter* painter) {
+        for (const ConnectionRecordRef& connection : scene.connections()) {
+            connection->paint(painter);
+        }
+    });
+    QByteArray defs;
+    for (int symbolIndex : usedSymbols) {
+        const SymbolRef& symbol = scene.symbols().at(symbolIndex);
+        defs += "<g id=\"symbol-" + QByteArray::number(symbolIndex) + "\">";
+        defs += renderSvgBody(symbol->size(), [&symbol](QPainter* painter) {
+            painter->drawPicture(0, 0, symbol->picture());
+        });
+        defs += "</g>\n";
+    }
+    if (!header->contains("xmlns:xlink")) {
+        header->replace("<svg ", "<svg xmlns:xlink=\"http://www.w3.org/1999/xlink\" ");
+    }
+    if (header->endsWith("</defs>")) {
+        header->insert(header->size() - 7, defs);
+    } else {
+        *header += "<defs>" + defs + "</defs>";
+    }
+    return body;
+}
+bool SceneIO::exportToPng(const SceneModel& scene, const QString& filePath)
+{
+    return exportToPng(*scene.snapshot(), filePath);
+}
+bool SceneIO::exportToPng(const SceneSnapshot& scene, const QString& filePath)
+{
+    if (qint64(scene.pageSize().width()) * scene.pageSize().height() > LargeImagePixels) {
+        return exportToPngBanded(scene, filePath);
+    }
+    QImage image(scene.pageSize(), QImage::Format_ARGB32);
+    image.fill(scene.backgroundColor());
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::TextAntialiasing, true);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    scene.paint(&painter);
+    painter.end();
+    return image.save(filePath, "PNG");
+}
+bool SceneIO::exportToPngBanded(const SceneSnapshot& scene, const QString& filePath, qreal scale, int bandHeight)
+{
+    const QSize size(qCeil(scene.pageSize().width() * scale), qCeil(scene.pageSize().height() * scale));
+    if (size.isEmpty() || scale <= 0 || bandHeight <= 0) {
+        return false;
+    }
+    // 对象的绘制范围只算一次：图形留出线宽，连线留出箭头
+    QVector<QRectF> shapeBounds;
+    shapeBounds.reserve(scene.shapes().size());
+    for (const ShapeRecordRef& record : scene.shapes()) {
+        qreal margin = record->shape()->style()->lineWidth() + 2;
+        shapeBounds.append(QRectF(record->shape()->getRect()).adjusted(-margin, -margin, margin, margin));
+    }
+    QVector<QRectF> connectionBounds;
+    connectionBounds.reserve(scene.connections().size());
+    for (const ConnectionRecordRef& record : scene.connections()) {
+        connectionBounds.append(QRectF(record->startPosition(), record->endPosition()).normalized()
+                                    .adjusted(-12, -12, 12, 12));
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    PngBandWriter writer(&file);
+    if (!writer.begin(size)) {
+        return false;
+    }
+    QImage band(size.width(), qMin(bandHeight, size.height()), QImage::Format_ARGB32_Premultiplied);
+    for (int top = 0; top < size.height(); top += band.height()) {
+        const int rows = qMin(band.height(), size.height() - top);
+        if (rows != band.height()) {
+            band = QImage(size.width(), rows, QImage::Format_ARGB32_Premultiplied);
+        }
+        band.fill(scene.backgroundColor());
+        const QRectF area(0, top / scale, scene.pageSize().width(), rows / scale);
+        QPainter painter(&band);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.setRenderHint(QPainter::TextAntialiasing, true);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        painter.translate(0, -top);
+        painter.scale(scale, scale);
+        for (int i = 0; i < shapeBounds.size(); ++i) {
+            if (shapeBounds[i].intersects(area)) {
+                scene.shapes()[i]->paint(&painter);
+            }
+        }
+        for (int i = 0; i < connectionBounds.size(); ++i) {
+            if (connectionBounds[i].intersects(area)) {
+                scene.connections()[i]->paint(&painter);
+            }
+        }
+        painter.end();
+        if (!writer.writeRows(band)) {
+            return false;
+        }
+    }
+    bool ok = writer.finish() && file.error() == QFileDevice::NoError;
+    file.close();
+    return ok;
+}
+bool SceneIO::exportToSvg(const SceneModel& scene, const QString& filePath)
+{
+    return exportToSvg(*scene.snapshot(), filePath);
+}
+bool SceneIO::exportToSvg(const SceneSnapshot& scene, const QString& filePath)
+{
+    bool hasInstances = false;
+    for (const ShapeRecordRef& shape : scene.shapes()) {
+        if (shape->shape()->typeId() == ShapeFactory::SymbolInstanceType) {
+            hasInstances = true;
+            break;
+        }
+    }
+    // 渲染结果先留在内存里，文件只顺序写一遍：</defs>之前的部分、元数据、图形内容
+    QByteArray header;
+    QByteArray body;
+    if (hasInstances) {
+        body = renderSvgWithSymbols(scene, &header);
+    } else {
+        body = renderSvgBody(scene.pageSize(), [&scene](QPainter* painter) {
+            scene.paint(painter);
+        }, &header);
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(header);
+    QXmlStreamWriter writer(&file);
+    writeMetadata(writer, scene);
+    file.write(body);
+    file.write("</svg>\n");
+    bool ok = !writer.hasError() && file.error() == QFileDevice::NoError;
+    file.close();
+    return ok;
+}
+bool SceneIO::importFromSvg(SceneModel& scene, const QString& filePath, const ProgressCallback& progress)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    scene.clear();
+    ObjectPool::Scope poolScope(scene.pool());
+    const qint64 fileSize = qMax<qint64>(file.size(), 1);
+    int lastPercent = -1;
+    auto reportProgress = [&file, fileSize, &lastPercent, &progress]() {
+        int percent = int(file.pos() * 100 / fileSize);
+        if (progress && percent != lastPercent) {
+            lastPercent = percent;
+            progress(percent);
+        }
+    };
+    QXmlStreamReader reader(&file);
+    if (!reader.readNextStartElement())
+        return false;
+    // 流式读取：QSvgGenerator渲染出的几何元素整段跳过，只解析<metadata>；元数据之后只剩渲染结果，不再读取
+    while (reader.readNextStartElement()) {
+        if (reader.qualifiedName() != QLatin1String("metadata")) {
+            reader.skipCurrentElement();
+            reportProgress();
+            continue;
+        }
+        QVector<SymbolRef> symbols;
+        while (reader.readNextStartElement()) {
+            const QStringRef name = reader.qualifiedName();
+            if (name == QLatin1String("flowchart:settings")) {
+                int width = -1;
+                int height = -1;
+                while (reader.readNextStartElement()) {
+                    const QString settingName = reader.qualifiedName().toString();
+                    const QString value = reader.readElementText();
+                    if (settingName == "flowchart:drawingAreaWidth") {
+                        width = value.toInt();
+                    } else if (settingName == "flowchart:drawingAreaHeight") {
+                        height = value.toInt();
+                    } else if (settingName == "flowchart:backgroundColor") {
+                        scene.setBackgroundColor(QColor(value));
+                    }
+                }
+                if (width >= 0 && height >= 0) {
+                    scene.setPageSize(QSize(width, height));
+                }
+            } else if (name == QLatin1String("flowchart:symbols")) {
+                while (reader.readNextStartElement()) {
+                    if (reader.qualifiedName() != QLatin1String("flowchart:symbol")) {
+                        reader.skipCurrentElement();
+                        continue;
+                    }
+                    // 母版对象不放进场景的对象池，见Symbol::fromShapes
+                    ObjectPool::Scope heapScope(nullptr);
+                    const QXmlStreamAttributes attributes = reader.attributes();
+                    SymbolRef symbol(new Symbol(attributes.value("name").toString(),
+                                                QSize(attributes.value("width").toInt(), attributes.value("height").toInt())));
+                    QVector<Shape*> symbolShapes;
+                    QVector<Connection*> symbolConnections;
+                    readShapeList(reader, symbols, &symbolShapes, &symbolConnections, [&symbol](Shape* shape) {
+                        if (shape) {
+                            symbol->addShape(shape, shape->text());
+                        }
+                    });
+                    for (Connection* connection : symbolConnections) {
+                        symbol->addConnection(connection);
+                    }
+                    symbols.append(symbol);
+                    scene.addSymbol(symbol);
+                }
+            } else if (name == QLatin1String("flowchart:shapes")) {
+                QVector<Shape*> loadedShapes;
+                QVector<Connection*> loadedConnections;
+                readShapeList(reader, symbols, &loadedShapes, &loadedConnections, [&scene, &reportProgress](Shape* shape) {
+                    if (shape) {
+                        scene.addShape(shape);
+                    }
+                    reportProgress();
+                });
+                for (Connection* connection : loadedConnections) {
+                    scene.addConnection(connection);
+                }
+            } else if (name == QLatin1String("flowchart:revisions")) {
+                RevisionStore revisions;
+                if (revisions.load(QByteArray::fromBase64(reader.readElementText().toLatin1()))) {
+                    scene.setRevisions(revisions);
+                }
+            } else {
+                reader.skipCurrentElement();
+            }
+        }
+        break;
+    }
+    if (progress) {
+        progress(100);
+    }
+    return !reader.hasError();
+}
+bool SceneIO::exportToBinary(const SceneModel& scene, const QString& filePath)
+{
+    return exportToBinary(*scene.snapshot(), filePath);
+}
+bool SceneIO::exportToBinary(const SceneSnapshot& scene, const QString& filePath)
+{
+    return BinaryFormat::write(scene, filePath);
+}
+bool SceneIO::importFromBinary(SceneModel& scene, const QString& filePath)
+{
+    return BinaryFormat::read(scene, filePath);
+}
+bool SceneIO::exportToCbor(const SceneModel& scene, const QString& filePath)
+{
+    return exportToCbor(*scene.snapshot(), filePath);
+}
+bool SceneIO::exportToCbor(const SceneSnapshot& scene, const QString& filePath)
+{
+    return CborFormat::write(scene, filePath);
+}
+bool SceneIO::importFromCbor(SceneModel& scene, const QString& filePath)
+{
+    return CborFormat::read(scene, filePath);
+}
@@ -0,0 +1,41 @@
+#ifndef SCENEIO_H
+#define SCENEIO_H
+
+#include <QString>
+#include <functional>
+
+class SceneModel;
+class SceneSnapshot;
+
+// 文档的导入导出，只依赖SceneModel，可在没有界面的情况下使用
+// 导出只读取快照，接受SceneSnapshot的重载可以在工作线程中调用
+class SceneIO
+{
+public:
+    // 导入进度回调，参数为0-100的百分比
+    typedef std::function<void(int)> ProgressCallback;
+
+    static bool exportToPng(const SceneModel& scene, const QString& filePath);
+    static bool exportToPng(const SceneSnapshot& scene, const QString& filePath);
+    // 分带导出PNG：按scale缩放后逐条渲染高bandHeight像素的水平带，每条带只绘制与它相交的对象，
+    // 编码写出后再渲染下一条，峰值内存与带的大小成正比；页面超过LargeImagePixels时exportToPng自动改用此方式
+    static const qint64 LargeImagePixels = 16 * 1024 * 1024;
+    static bool exportToPngBanded(const SceneSnapshot& scene, const QString& filePath,
+                                  qreal scale = 1.0, int bandHeight = 256);
+    // SVG中除了图形本身，还在<metadata>里保存了可重新导入的流程图数据
+    static bool exportToSvg(const SceneModel& scene, const QString& filePath);
+    static bool exportToSvg(const SceneSnapshot& scene, const QString& filePath);
+    // 用QXmlStreamReader流式读取，跳过渲染出的几何元素，边解析边创建对象
+    static bool importFromSvg(SceneModel& scene, const QString& filePath,
+                              const ProgressCallback& progress = ProgressCallback());
+    // 原生二进制格式（.fcd），见BinaryFormat
+    static bool exportToBinary(const SceneModel& scene, const QString& filePath);
+    static bool exportToBinary(const SceneSnapshot& scene, const QString& filePath);
+    static bool importFromBinary(SceneModel& scene, const QString& filePath);
+    // CBOR交换格式（.cbor），见CborFormat
+    static bool exportToCbor(const SceneModel& scene, const QString& filePath);
+    static bool exportToCbor(const SceneSnapshot& scene, const QString& filePath);
+    static bool importFromCbor(SceneModel& scene, const QString& filePath);
+};
+
+#endif // SCENEIO_H
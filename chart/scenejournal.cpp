@@ -0,0 +1,466 @@
+﻿#include "chart/scenejournal.h"
+#include "chart/scenemodel.h"
+#include "chart/sceneio.h"
+#include "chart/shape.h"
+#include "chart/objectstate.h"
+#include "chart/shapefactory.h"
+#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
+#include <QDataStream>
+#include <QDir>
+#include <QtConcurrent>
+#include <algorithm>
+namespace {
+const quint32 JournalMagic = 0x464a4e4c;
+const quint16 JournalVersion = 1;
+enum RecordKind {
+    UpsertShapeRecord = 1,
+    RemoveShapeRecord,
+    UpsertConnectionRecord,
+    RemoveConnectionRecord,
+    ShapeOrderRecord,
+    PageRecord
+};
+QString basePath(const QString& directory, int generation)
+{
+    return QDir(directory).filePath(QString("recovery-%1.svg").arg(generation));
+}
+QString journalPath(const QString& directory, int generation)
+{
+    return QDir(directory).filePath(QString("recovery-%1.journal").arg(generation));
+}
+int generationOf(const QString& fileName)
+{
+    int start = fileName.indexOf('-') + 1;
+    return fileName.mid(start, fileName.indexOf('.') - start).toInt();
+}
+QStringList recoveryFiles(const QDir& dir, const QString& suffix)
+{
+    return dir.entryList(QStringList() << QString("recovery-*") + suffix, QDir::Files);
+}
+// 每条记录前有长度和CRC，写到一半时崩溃留下的残缺记录在回放时会被发现并丢弃
+void appendBlock(QDataStream& out, const QByteArray& payload)
+{
+    out << quint32(payload.size()) << qChecksum(payload.constData(), payload.size());
+    out.writeRawData(payload.constData(), payload.size());
+}
+QByteArray shapeRecord(const SceneModel* scene, const Shape* shape, int symbolIndex)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(UpsertShapeRecord) << quint64(scene->idOf(shape)) << qint32(scene->indexOf(shape))
+        << ShapeState::fromShape(shape, symbolIndex);
+    return payload;
+}
+quint64 ownerId(const SceneModel* scene, const ConnectionPoint& point)
+{
+    return point.getOwner() ? scene->idOf(point.getOwner()) : 0;
+}
+QByteArray connectionRecord(const SceneModel* scene, const Connection* connection)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(UpsertConnectionRecord) << quint64(scene->idOf(connection))
+        << EndpointState::fromPoint(connection->getStartPoint(), ownerId(scene, connection->getStartPoint()))
+        << EndpointState::fromPoint(connection->getEndPoint(), ownerId(scene, connection->getEndPoint()));
+    return payload;
+}
+QByteArray removalRecord(RecordKind kind, quint64 id)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(kind) << id;
+    return payload;
+}
+// 回放状态：日志中的对象ID到恢复出的对象
+struct Replay
+{
+    explicit Replay(SceneModel& target) : scene(target) {}
+    SceneModel& scene;
+    QHash<quint64, Shape*> shapes;
+    QHash<quint64, Connection*> connections;
+};
+void replayShape(QDataStream& in, Replay& replay)
+{
+    quint64 id;
+    qint32 index;
+    ShapeState state;
+    in >> id >> index >> state;
+    if (in.status() != QDataStream::Ok) {
+        return;
+    }
+    SceneModel& scene = replay.scene;
+    Shape* shape = replay.shapes.value(id, nullptr);
+    if (!shape) {
+        shape = state.create(scene.symbols());
+        if (!shape) {
+            return;
+        }
+        scene.insertShape(qBound(0, int(index), scene.shapes().size()), shape);
+        replay.shapes.insert(id, shape);
+        return;
+    }
+    state.applyTo(shape);
+    int from = scene.indexOf(shape);
+    int to = qBound(0, int(index), scene.shapes().size() - 1);
+    if (from != to) {
+        scene.moveShape(from, to);
+    }
+    scene.notifyShapeChanged(shape);
+}
+void replayConnection(QDataStream& in, Replay& replay)
+{
+    quint64 id;
+    EndpointState start;
+    EndpointState end;
+    in >> id >> start >> end;
+    if (in.status() != QDataStream::Ok) {
+        return;
+    }
+    ConnectionPoint startPoint = start.toPoint(replay.shapes.value(start.ownerKey, nullptr));
+    ConnectionPoint endPoint = end.toPoint(replay.shapes.value(end.ownerKey, nullptr));
+    Connection* connection = replay.connections.value(id, nullptr);
+    if (!connection) {
+        connection = new ArrowLine(QPoint(), QPoint());
+        replay.scene.addConnection(connection);
+        replay.connections.insert(id, connection);
+    }
+    if (!connection->getStartPoint().equalTo(startPoint)) {
+        connection->setStartPoint(startPoint);
+    }
+    if (!connection->getEndPoint().equalTo(endPoint)) {
+        connection->setEndPoint(endPoint);
+    }
+    replay.scene.notifyConnectionChanged(connection);
+}
+void replayRemoval(RecordKind kind, quint64 id, Replay& replay)
+{
+    if (kind == RemoveConnectionRecord) {
+        Connection* connection = replay.connections.take(id);
+        if (connection) {
+            replay.scene.removeConnection(connection);
+        }
+        return;
+    }
+    Shape* shape = replay.shapes.take(id);
+    if (!shape) {
+        return;
+    }
+    // 正常情况下连线的删除记录在前，这里只是防止残留的连线指向已删除的图形
+    QVector<Connection*> incident = shape->incidentConnections();
+    for (Connection* connection : incident) {
+        replay.connections.remove(replay.connections.key(connection));
+        replay.scene.removeConnection(connection);
+    }
+    replay.scene.removeShape(shape);
+}
+void replayOrder(const QVector<quint64>& order, Replay& replay)
+{
+    int position = 0;
+    for (quint64 id : order) {
+        Shape* shape = replay.shapes.value(id, nullptr);
+        if (!shape) {
+            continue;
+        }
+        int from = replay.scene.indexOf(shape);
+        if (from != position) {
+            replay.scene.moveShape(from, position);
+        }
+        ++position;
+    }
+}
+void replayRecord(const QByteArray& payload, Replay& replay)
+{
+    QDataStream in(payload);
+    quint8 kind;
+    in >> kind;
+    switch (kind) {
+    case UpsertShapeRecord:
+        replayShape(in, replay);
+        break;
+    case UpsertConnectionRecord:
+        replayConnection(in, replay);
+        break;
+    case RemoveShapeRecord:
+    case RemoveConnectionRecord: {
+        quint64 id;
+        in >> id;
+        replayRemoval(static_cast<RecordKind>(kind), id, replay);
+        break;
+    }
+    case ShapeOrderRecord: {
+        QVector<quint64> order;
+        in >> order;
+        replayOrder(order, replay);
+        break;
+    }
+    case PageRecord: {
+        QSize pageSize;
+        QColor backgroundColor;
+        in >> pageSize >> backgroundColor;
+        replay.scene.setPageSize(pageSize);
+        replay.scene.setBackgroundColor(backgroundColor);
+        break;
+    }
+    default:
+        break;
+    }
+}
+// 回放一份日志；isBase为true时用文件头中的ID表把基准中的对象按顺序登记到回放状态中
+void replayJournal(const QString& filePath, bool isBase, Replay& replay)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QByteArray data = file.readAll();
+    QDataStream in(data);
+    bool headerRead = false;
+    while (!in.atEnd()) {
+        quint32 size;
+        quint16 checksum;
+        in >> size >> checksum;
+        if (in.status() != QDataStream::Ok || size > quint32(data.size() - in.device()->pos())) {
+            break;
+        }
+        QByteArray payload(int(size), Qt::Uninitialized);
+        in.readRawData(payload.data(), int(size));
+        if (qChecksum(payload.constData(), size) != checksum) {
+            break;
+        }
+        if (headerRead) {
+            replayRecord(payload, replay);
+            continue;
+        }
+        QDataStream header(payload);
+        quint32 magic;
+        quint16 version;
+        qint32 generation;
+        QVector<quint64> shapeIds;
+        QVector<quint64> connectionIds;
+        header >> magic >> version >> generation >> shapeIds >> connectionIds;
+        if (magic != JournalMagic || version != JournalVersion) {
+            return;
+        }
+        if (isBase) {
+            const QVector<Shape*>& shapes = replay.scene.shapes();
+            const QVector<Connection*>& connections = replay.scene.connections();
+            for (int i = 0; i < shapeIds.size() && i < shapes.size(); ++i) {
+                replay.shapes.insert(shapeIds[i], shapes[i]);
+            }
+            for (int i = 0; i < connectionIds.size() && i < connections.size(); ++i) {
+                replay.connections.insert(connectionIds[i], connections[i]);
+            }
+        }
+        headerRead = true;
+    }
+}
+}
+SceneJournal::SceneJournal(SceneModel* scene, const QString& directory, QObject* parent)
+    : QObject(parent), m_scene(scene), m_directory(directory), m_generation(0), m_baseSymbolCount(0),
+      m_compactionThreshold(1024 * 1024), m_compactPending(false)
+{
+    connect(&m_compaction, &QFutureWatcher<bool>::finished, this, &SceneJournal::compactionFinished);
+}
+SceneJournal::~SceneJournal()
+{
+    m_compaction.waitForFinished();
+    m_file.close();
+}
+bool SceneJournal::start()
+{
+    QDir dir(m_directory);
+    if (!dir.mkpath(".")) {
+        return false;
+    }
+    // 新的代号接在目录中已有文件之后，旧数据在新基准写好之前一直可用于恢复
+    m_generation = 0;
+    QStringList existing = recoveryFiles(dir, ".svg") + recoveryFiles(dir, ".journal");
+    for (const QString& name : existing) {
+        m_generation = qMax(m_generation, generationOf(name));
+    }
+    m_scene->flushChanges();
+    connect(m_scene, &SceneModel::changesCommitted, this, &SceneJournal::appendChanges, Qt::UniqueConnection);
+    compact();
+    return m_file.isOpen();
+}
+void SceneJournal::discard()
+{
+    disconnect(m_scene, &SceneModel::changesCommitted, this, &SceneJournal::appendChanges);
+    m_compactPending = false;
+    m_compaction.waitForFinished();
+    m_file.close();
+    QDir dir(m_directory);
+    QStringList files = recoveryFiles(dir, ".svg") + recoveryFiles(dir, ".svg.part") + recoveryFiles(dir, ".journal");
+    for (const QString& name : files) {
+        dir.remove(name);
+    }
+}
+void SceneJournal::compact()
+{
+    if (m_compaction.isRunning()) {
+        m_compactPending = true;
+        return;
+    }
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    int generation = m_generation + 1;
+    m_file.close();
+    m_file.setFileName(journalPath(m_directory, generation));
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    // 文件头记录基准中图形和连线的ID，回放时按导入后的顺序对应回去
+    QVector<quint64> shapeIds;
+    shapeIds.reserve(snapshot->shapes().size());
+    for (const ShapeRecordRef& record : snapshot->shapes()) {
+        shapeIds.append(record->id());
+    }
+    QVector<quint64> connectionIds;
+    connectionIds.reserve(snapshot->connections().size());
+    for (const ConnectionRecordRef& record : snapshot->connections()) {
+        connectionIds.append(record->id());
+    }
+    QByteArray header;
+    QDataStream headerOut(&header, QIODevice::WriteOnly);
+    headerOut << JournalMagic << JournalVersion << qint32(generation) << shapeIds << connectionIds;
+    QByteArray block;
+    QDataStream out(&block, QIODevice::WriteOnly);
+    appendBlock(out, header);
+    m_file.write(block);
+    m_file.flush();
+    m_generation = generation;
+    m_baseSymbolCount = snapshot->symbols().size();
+    QString path = basePath(m_directory, generation);
+    m_compaction.setFuture(QtConcurrent::run([snapshot, path]() -> bool {
+        // 先写到临时文件再改名，带.svg后缀的基准总是完整的
+        QString partPath = path + ".part";
+        QFile::remove(partPath);
+        if (!SceneIO::exportToSvg(*snapshot, partPath)) {
+            QFile::remove(partPath);
+            return false;
+        }
+        return QFile::rename(partPath, path);
+    }));
+}
+void SceneJournal::compactionFinished()
+{
+    if (m_compaction.result()) {
+        removeGenerationsBefore(m_generation);
+    }
+    if (m_compactPending) {
+        m_compactPending = false;
+        compact();
+    }
+}
+void SceneJournal::removeGenerationsBefore(int generation)
+{
+    QDir dir(m_directory);
+    QStringList files = recoveryFiles(dir, ".svg") + recoveryFiles(dir, ".svg.part") + recoveryFiles(dir, ".journal");
+    for (const QString& name : files) {
+        if (generationOf(name) < generation) {
+            dir.remove(name);
+        }
+    }
+}
+void SceneJournal::appendChanges(const ChangeSet& changes)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    // 清空（导入等）之后几乎所有对象都变了，直接写新的基准；修订历史只保存在基准中
+    if (changes.cleared || changes.revisionsChanged) {
+        compact();
+        return;
+    }
+    QByteArray batch;
+    QDataStream out(&batch, QIODevice::WriteOnly);
+    for (quint64 id : changes.removedConnections) {
+        appendBlock(out, removalRecord(RemoveConnectionRecord, id));
+    }
+    for (quint64 id : changes.removedShapes) {
+        appendBlock(out, removalRecord(RemoveShapeRecord, id));
+    }
+    // 按图层顺序由下到上写入，回放时依次插入即可还原各自的位置
+    QVector<Shape*> shapes;
+    for (quint64 id : changes.addedShapes + changes.changedShapes) {
+        Shape* shape = m_scene->shapeById(id);
+        if (shape) {
+            shapes.append(shape);
+        }
+    }
+    std::sort(shapes.begin(), shapes.end(), [this](Shape* a, Shape* b) {
+        return m_scene->indexOf(a) < m_scene->indexOf(b);
+    });
+    bool needsBase = false;
+    for (Shape* shape : shapes) {
+        int symbolIndex = -1;
+        if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+            symbolIndex = m_scene->indexOfSymbol(static_cast<SymbolInstance*>(shape)->master().data());
+            // 日志中不保存母版，引用新符号的实例要等下一个基准才能恢复
+            if (symbolIndex < 0 || symbolIndex >= m_baseSymbolCount) {
+                needsBase = true;
+                continue;
+            }
+        }
+        appendBlock(out, shapeRecord(m_scene, shape, symbolIndex));
+    }
+    for (quint64 id : changes.addedConnections + changes.changedConnections) {
+        Connection* connection = m_scene->connectionById(id);
+        if (connection) {
+            appendBlock(out, connectionRecord(m_scene, connection));
+        }
+    }
+    if (changes.orderChanged) {
+        QByteArray payload;
+        QDataStream record(&payload, QIODevice::WriteOnly);
+        QVector<quint64> order;
+        order.reserve(m_scene->shapes().size());
+        for (Shape* shape : m_scene->shapes()) {
+            order.append(m_scene->idOf(shape));
+        }
+        record << quint8(ShapeOrderRecord) << order;
+        appendBlock(out, payload);
+    }
+    if (changes.pageChanged) {
+        QByteArray payload;
+        QDataStream record(&payload, QIODevice::WriteOnly);
+        record << quint8(PageRecord) << m_scene->pageSize() << m_scene->backgroundColor();
+        appendBlock(out, payload);
+    }
+    m_file.write(batch);
+    m_file.flush();
+    if (needsBase || m_file.size() > m_compactionThreshold) {
+        compact();
+    }
+}
+bool SceneJournal::hasRecoveryData(const QString& directory)
+{
+    return !recoveryFiles(QDir(directory), ".svg").isEmpty();
+}
+bool SceneJournal::recover(SceneModel& scene, const QString& directory)
+{
+    QDir dir(directory);
+    int base = -1;
+    for (const QString& name : recoveryFiles(dir, ".svg")) {
+        base = qMax(base, generationOf(name));
+    }
+    if (base < 0 || !SceneIO::importFromSvg(scene, basePath(directory, base))) {
+        return false;
+    }
+    // 压缩未完成时新修改已经写进了后面几代日志，按代号顺序全部回放
+    QList<int> generations;
+    for (const QString& name : recoveryFiles(dir, ".journal")) {
+        int generation = generationOf(name);
+        if (generation >= base) {
+            generations.append(generation);
+        }
+    }
+    std::sort(generations.begin(), generations.end());
+    ObjectPool::Scope poolScope(scene.pool());
+    Replay replay(scene);
+    for (int generation : generations) {
+        replayJournal(journalPath(directory, generation), generation == base, replay);
+    }
+    return true;
+}
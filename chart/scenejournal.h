@@ -0,0 +1,60 @@
+#ifndef SCENEJOURNAL_H
+#define SCENEJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <QFutureWatcher>
+#include "chart/changeset.h"
+
+class SceneModel;
+
+// 崩溃恢复日志：基准快照（SVG）加上只追加的二进制日志
+// 每批场景变化只把涉及的对象写成几条小记录，自动保存的开销与修改量成正比，与文档大小无关；
+// 日志超过阈值后在工作线程中把当前快照写成新的基准，完成后再删除旧的基准和日志
+//
+// 目录中的文件按代编号：recovery-<代>.svg为基准，recovery-<代>.journal为其后的修改
+// 压缩进行中新修改写入下一代日志，因此崩溃时最多需要回放两份日志
+class SceneJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    SceneJournal(SceneModel* scene, const QString& directory, QObject* parent = nullptr);
+    ~SceneJournal();
+
+    // 以当前场景为基准开始记录；目录中已有的恢复数据在新基准写好后删除
+    bool start();
+    // 停止记录并删除目录中全部恢复数据（正常退出时调用）
+    void discard();
+
+    // 日志超过该字节数时自动压缩，默认1MB
+    void setCompactionThreshold(qint64 bytes) { m_compactionThreshold = bytes; }
+    qint64 compactionThreshold() const { return m_compactionThreshold; }
+    // 在工作线程中把当前快照写成新的基准；已有压缩在进行时，完成后再压缩一次
+    void compact();
+
+    // 目录中是否有可恢复的数据
+    static bool hasRecoveryData(const QString& directory);
+    // 导入最新的完整基准并依次回放其后的日志；日志末尾不完整的记录被忽略
+    static bool recover(SceneModel& scene, const QString& directory);
+
+private slots:
+    void appendChanges(const ChangeSet& changes);
+    void compactionFinished();
+
+private:
+    bool openJournal(int generation);
+    void removeGenerationsBefore(int generation);
+
+    SceneModel* m_scene;
+    QString m_directory;
+    QFile m_file;
+    int m_generation;           // 当前写入的日志代号
+    int m_baseSymbolCount;      // 基准中的符号数，引用之后新增符号的实例需要重新压缩才能恢复
+    qint64 m_compactionThreshold;
+    bool m_compactPending;
+    QFutureWatcher<bool> m_compaction;
+};
+
+#endif // SCENEJOURNAL_H
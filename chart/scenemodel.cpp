@@ -0,0 +1,550 @@
+﻿#include "chart/scenemodel.h"
+#include "chart/shape.h"
+#include "chart/connection.h"
+#include "chart/symbol.h"
+#include "util/Utils.h"
+#include <QPainter>
+#include <QTimer>
+#include <algorithm>
+const SceneModel::ObjectId SceneModel::InvalidId;
+SceneModel::SceneModel(QObject* parent)
+    : QObject(parent),
+      m_nextId(1),
+      m_revision(Revision::next()),
+      m_batchDepth(0),
+      m_flushScheduled(false),
+      m_pageSize(Utils::Default_WIDTH, Utils::Default_HEIGHT),
+      m_backgroundColor(Qt::white)
+{
+    connect(this, &SceneModel::shapeAdded, this, [this](ObjectId id) {
+        m_pendingChanges.shapeAdded(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::shapeRemoved, this, [this](ObjectId id) {
+        m_pendingChanges.shapeRemoved(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::shapeChanged, this, [this](ObjectId id) {
+        m_pendingChanges.shapeChanged(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::shapeOrderChanged, this, [this]() {
+        m_pendingChanges.orderChanged = true;
+        recordChange();
+    });
+    connect(this, &SceneModel::connectionAdded, this, [this](ObjectId id) {
+        m_pendingChanges.connectionAdded(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::connectionRemoved, this, [this](ObjectId id) {
+        m_pendingChanges.connectionRemoved(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::connectionChanged, this, [this](ObjectId id) {
+        m_pendingChanges.connectionChanged(id);
+        recordChange();
+    });
+    connect(this, &SceneModel::sceneCleared, this, [this]() {
+        m_pendingChanges.clear();
+        m_pendingChanges.cleared = true;
+        recordChange();
+    });
+    connect(this, &SceneModel::pageChanged, this, [this]() {
+        m_pendingChanges.pageChanged = true;
+        recordChange();
+    });
+    connect(this, &SceneModel::revisionsChanged, this, [this]() {
+        m_pendingChanges.revisionsChanged = true;
+        recordChange();
+    });
+}
+SceneModel::~SceneModel()
+{
+    qDeleteAll(m_connections);
+    qDeleteAll(m_shapes);
+}
+SceneModel::ObjectId SceneModel::registerShape(Shape* shape, ObjectId id)
+{
+    if (id == InvalidId || id >= m_nextId || m_shapesById.contains(id) || m_connectionsById.contains(id)) {
+        id = m_nextId++;
+    }
+    m_shapesById.insert(id, shape);
+    m_shapeIds.insert(shape, id);
+    return id;
+}
+SceneModel::ObjectId SceneModel::registerConnection(Connection* connection, ObjectId id)
+{
+    if (id == InvalidId || id >= m_nextId || m_shapesById.contains(id) || m_connectionsById.contains(id)) {
+        id = m_nextId++;
+    }
+    m_connectionsById.insert(id, connection);
+    m_connectionIds.insert(connection, id);
+    return id;
+}
+void SceneModel::bindGeometry(Shape* shape)
+{
+    shape->bindGeometryStore(&m_geometry, m_geometry.allocate(shape));
+}
+void SceneModel::unbindGeometry(Shape* shape)
+{
+    m_geometry.release(shape->geometrySlot());
+    shape->bindGeometryStore(nullptr, GeometryStore::InvalidSlot);
+}
+qreal SceneModel::zKeyAt(int index) const
+{
+    return m_geometry.zKey(m_shapes[index]->geometrySlot());
+}
+void SceneModel::assignZKey(int index)
+{
+    const int count = m_shapes.size();
+    qreal key = 0.0;
+    if (count > 1) {
+        if (index == 0) {
+            key = zKeyAt(1) - 1.0;
+        } else if (index == count - 1) {
+            key = zKeyAt(index - 1) + 1.0;
+        } else {
+            qreal lower = zKeyAt(index - 1);
+            qreal upper = zKeyAt(index + 1);
+            key = lower + (upper - lower) / 2;
+            if (key <= lower || key >= upper) {
+                renumberZKeys();
+                return;
+            }
+        }
+    }
+    m_geometry.setZKey(m_shapes[index]->geometrySlot(), key);
+}
+void SceneModel::renumberZKeys()
+{
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        m_geometry.setZKey(m_shapes[i]->geometrySlot(), i);
+    }
+}
+void SceneModel::swapShapes(int a, int b)
+{
+    int slotA = m_shapes[a]->geometrySlot();
+    int slotB = m_shapes[b]->geometrySlot();
+    qreal keyA = m_geometry.zKey(slotA);
+    m_geometry.setZKey(slotA, m_geometry.zKey(slotB));
+    m_geometry.setZKey(slotB, keyA);
+    std::swap(m_shapes[a], m_shapes[b]);
+}
+int SceneModel::indexOf(const Shape* shape) const
+{
+    if (!shape || !m_shapeIds.contains(shape)) {
+        return -1;
+    }
+    qreal key = m_geometry.zKey(shape->geometrySlot());
+    QVector<Shape*>::const_iterator it = std::lower_bound(m_shapes.constBegin(), m_shapes.constEnd(), key,
+        [this](const Shape* item, qreal value) {
+            return m_geometry.zKey(item->geometrySlot()) < value;
+        });
+    if (it != m_shapes.constEnd() && *it == shape) {
+        return int(it - m_shapes.constBegin());
+    }
+    return m_shapes.indexOf(const_cast<Shape*>(shape));
+}
+SceneModel::ObjectId SceneModel::addShape(Shape* shape)
+{
+    return insertShape(m_shapes.size(), shape);
+}
+SceneModel::ObjectId SceneModel::insertShape(int index, Shape* shape, ObjectId id)
+{
+    if (!shape) {
+        return InvalidId;
+    }
+    if (m_shapeIds.contains(shape)) {
+        return m_shapeIds.value(shape);
+    }
+    if (shape->typeId() == ShapeFactory::SymbolInstanceType) {
+        addSymbol(static_cast<SymbolInstance*>(shape)->master());
+    }
+    index = qBound(0, index, m_shapes.size());
+    m_shapes.insert(index, shape);
+    bindGeometry(shape);
+    assignZKey(index);
+    id = registerShape(shape, id);
+    emit shapeAdded(id);
+    return id;
+}
+Shape* SceneModel::takeShape(Shape* shape)
+{
+    // 下标要在移除ID之前查找，indexOf只认已登记的图形
+    int index = indexOf(shape);
+    if (index < 0) {
+        return nullptr;
+    }
+    ObjectId id = m_shapeIds.take(shape);
+    m_shapesById.remove(id);
+    m_shapes.remove(index);
+    unbindGeometry(shape);
+    emit shapeRemoved(id);
+    return shape;
+}
+void SceneModel::removeShape(Shape* shape)
+{
+    delete takeShape(shape);
+}
+void SceneModel::removeShapes(const QSet<Shape*>& shapes)
+{
+    for (const QPair<int, Shape*>& taken : takeShapes(shapes)) {
+        delete taken.second;
+    }
+}
+QVector<QPair<int, Shape*>> SceneModel::takeShapes(const QSet<Shape*>& shapes)
+{
+    QVector<QPair<int, Shape*>> taken;
+    if (shapes.isEmpty()) {
+        return taken;
+    }
+    QVector<Shape*> remaining;
+    remaining.reserve(m_shapes.size());
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        if (shapes.contains(m_shapes[i])) {
+            taken.append(qMakePair(i, m_shapes[i]));
+        } else {
+            remaining.append(m_shapes[i]);
+        }
+    }
+    m_shapes.swap(remaining);
+    for (const QPair<int, Shape*>& item : taken) {
+        unbindGeometry(item.second);
+        ObjectId id = m_shapeIds.take(item.second);
+        m_shapesById.remove(id);
+        emit shapeRemoved(id);
+    }
+    return taken;
+}
+void SceneModel::moveShape(int from, int to)
+{
+    if (from < 0 || from >= m_shapes.size() || to < 0 || to >= m_shapes.size() || from == to) {
+        return;
+    }
+    m_shapes.move(from, to);
+    assignZKey(to);
+    emit shapeOrderChanged();
+}
+QVector<int> SceneModel::sortedIndices(const QSet<Shape*>& shapes) const
+{
+    QVector<int> indices;
+    indices.reserve(shapes.size());
+    for (Shape* shape : shapes) {
+        int index = indexOf(shape);
+        if (index >= 0) {
+            indices.append(index);
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+void SceneModel::raiseShapes(const QSet<Shape*>& shapes)
+{
+    // 只访问被移动的图形：从上往下依次与上方相邻的未选中图形交换
+    const QVector<int> indices = sortedIndices(shapes);
+    bool changed = false;
+    for (int k = indices.size() - 1; k >= 0; --k) {
+        int i = indices[k];
+        if (i + 1 < m_shapes.size() && !shapes.contains(m_shapes[i + 1])) {
+            swapShapes(i, i + 1);
+            changed = true;
+        }
+    }
+    if (changed) {
+        emit shapeOrderChanged();
+    }
+}
+void SceneModel::lowerShapes(const QSet<Shape*>& shapes)
+{
+    const QVector<int> indices = sortedIndices(shapes);
+    bool changed = false;
+    for (int i : indices) {
+        if (i > 0 && !shapes.contains(m_shapes[i - 1])) {
+            swapShapes(i, i - 1);
+            changed = true;
+        }
+    }
+    if (changed) {
+        emit shapeOrderChanged();
+    }
+}
+void SceneModel::bringShapesToFront(const QSet<Shape*>& shapes)
+{
+    QVector<Shape*> remaining;
+    QVector<Shape*> moved;
+    for (Shape* shape : m_shapes) {
+        if (shapes.contains(shape)) {
+            moved.append(shape);
+        } else {
+            remaining.append(shape);
+        }
+    }
+    if (moved.isEmpty() || remaining.isEmpty()) {
+        return;
+    }
+    qreal top = zKeyAt(m_shapes.size() - 1);
+    for (int i = 0; i < moved.size(); ++i) {
+        m_geometry.setZKey(moved[i]->geometrySlot(), top + 1 + i);
+    }
+    remaining += moved;
+    m_shapes.swap(remaining);
+    emit shapeOrderChanged();
+}
+void SceneModel::sendShapesToBack(const QSet<Shape*>& shapes)
+{
+    QVector<Shape*> remaining;
+    QVector<Shape*> moved;
+    for (Shape* shape : m_shapes) {
+        if (shapes.contains(shape)) {
+            moved.append(shape);
+        } else {
+            remaining.append(shape);
+        }
+    }
+    if (moved.isEmpty() || remaining.isEmpty()) {
+        return;
+    }
+    qreal bottom = zKeyAt(0);
+    for (int i = 0; i < moved.size(); ++i) {
+        m_geometry.setZKey(moved[i]->geometrySlot(), bottom - moved.size() + i);
+    }
+    moved += remaining;
+    m_shapes.swap(moved);
+    emit shapeOrderChanged();
+}
+SceneModel::ObjectId SceneModel::addConnection(Connection* connection)
+{
+    return insertConnection(m_connections.size(), connection);
+}
+SceneModel::ObjectId SceneModel::insertConnection(int index, Connection* connection, ObjectId id)
+{
+    if (!connection) {
+        return InvalidId;
+    }
+    if (m_connectionIds.contains(connection)) {
+        return m_connectionIds.value(connection);
+    }
+    m_connections.insert(qBound(0, index, m_connections.size()), connection);
+    connection->setAttached(true);
+    id = registerConnection(connection, id);
+    emit connectionAdded(id);
+    return id;
+}
+Connection* SceneModel::takeConnection(Connection* connection)
+{
+    ObjectId id = m_connectionIds.take(connection);
+    if (id == InvalidId) {
+        return nullptr;
+    }
+    m_connectionsById.remove(id);
+    m_connections.removeOne(connection);
+    connection->setAttached(false);
+    emit connectionRemoved(id);
+    return connection;
+}
+void SceneModel::removeConnection(Connection* connection)
+{
+    delete takeConnection(connection);
+}
+void SceneModel::removeConnections(const QSet<Connection*>& connections)
+{
+    for (const QPair<int, Connection*>& taken : takeConnections(connections)) {
+        delete taken.second;
+    }
+}
+QVector<QPair<int, Connection*>> SceneModel::takeConnections(const QSet<Connection*>& connections)
+{
+    QVector<QPair<int, Connection*>> taken;
+    if (connections.isEmpty()) {
+        return taken;
+    }
+    QVector<Connection*> remaining;
+    remaining.reserve(m_connections.size());
+    for (int i = 0; i < m_connections.size(); ++i) {
+        if (connections.contains(m_connections[i])) {
+            taken.append(qMakePair(i, m_connections[i]));
+        } else {
+            remaining.append(m_connections[i]);
+        }
+    }
+    m_connections.swap(remaining);
+    for (const QPair<int, Connection*>& item : taken) {
+        ObjectId id = m_connectionIds.take(item.second);
+        m_connectionsById.remove(id);
+        item.second->setAttached(false);
+        emit connectionRemoved(id);
+    }
+    return taken;
+}
+void SceneModel::notifyShapeChanged(const Shape* shape)
+{
+    ObjectId id = idOf(shape);
+    if (id != InvalidId) {
+        emit shapeChanged(id);
+    }
+}
+void SceneModel::notifyConnectionChanged(const Connection* connection)
+{
+    ObjectId id = idOf(connection);
+    if (id != InvalidId) {
+        emit connectionChanged(id);
+    }
+}
+void SceneModel::recordChange()
+{
+    m_revision = Revision::next();
+    if (m_batchDepth == 0 && !m_flushScheduled) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, &SceneModel::flushChanges);
+    }
+}
+void SceneModel::beginChanges()
+{
+    ++m_batchDepth;
+}
+void SceneModel::endChanges()
+{
+    if (m_batchDepth > 0 && --m_batchDepth == 0) {
+        flushChanges();
+    }
+}
+void SceneModel::flushChanges()
+{
+    m_flushScheduled = false;
+    if (m_batchDepth > 0 || m_pendingChanges.isEmpty()) {
+        return;
+    }
+    ChangeSet changes = m_pendingChanges;
+    changes.revision = m_revision;
+    m_pendingChanges.clear();
+    emit changesCommitted(changes);
+}
+void SceneModel::addSymbol(const SymbolRef& symbol)
+{
+    if (symbol && !m_symbols.contains(symbol)) {
+        m_symbols.append(symbol);
+    }
+}
+void SceneModel::setSymbols(const QVector<SymbolRef>& symbols)
+{
+    if (symbols != m_symbols) {
+        m_symbols = symbols;
+        recordChange();
+    }
+}
+int SceneModel::indexOfSymbol(const Symbol* symbol) const
+{
+    for (int i = 0; i < m_symbols.size(); ++i) {
+        if (m_symbols[i].data() == symbol) {
+            return i;
+        }
+    }
+    return -1;
+}
+void SceneModel::setRevisions(const RevisionStore& revisions)
+{
+    m_revisions = revisions;
+    emit revisionsChanged();
+}
+int SceneModel::commitRevision(const QString& name)
+{
+    int index = m_revisions.commit(*snapshot(), name);
+    emit revisionsChanged();
+    return index;
+}
+void SceneModel::clear()
+{
+    qDeleteAll(m_connections);
+    m_connections.clear();
+    m_connectionsById.clear();
+    m_connectionIds.clear();
+    qDeleteAll(m_shapes);
+    m_shapes.clear();
+    m_geometry.clear();
+    m_shapesById.clear();
+    m_shapeIds.clear();
+    m_symbols.clear();
+    m_revisions.clear();
+    m_pool.reset();
+    emit sceneCleared();
+}
+void SceneModel::setPageSize(const QSize& size)
+{
+    if (size == m_pageSize) {
+        return;
+    }
+    m_pageSize = size;
+    emit pageChanged();
+}
+void SceneModel::setBackgroundColor(const QColor& color)
+{
+    if (color == m_backgroundColor) {
+        return;
+    }
+    m_backgroundColor = color;
+    emit pageChanged();
+}
+SceneSnapshotRef SceneModel::snapshot() const
+{
+    QHash<const Shape*, ShapeRecordRef> previousShapes;
+    QHash<quint64, ConnectionRecordRef> previousConnections;
+    if (m_snapshot) {
+        for (const ShapeRecordRef& record : m_snapshot->shapes()) {
+            previousShapes.insert(shapeById(record->id()), record);
+        }
+        for (const ConnectionRecordRef& record : m_snapshot->connections()) {
+            previousConnections.insert(record->id(), record);
+        }
+    }
+    QSharedPointer<SceneSnapshot> next(new SceneSnapshot());
+    next->m_revision = m_revision;
+    next->m_pageSize = m_pageSize;
+    next->m_backgroundColor = m_backgroundColor;
+    next->m_symbols = m_symbols;
+    next->m_revisions = m_revisions;
+    next->m_shapes.reserve(m_shapes.size());
+    next->m_connections.reserve(m_connections.size());
+    bool unchanged = m_snapshot && m_snapshot->pageSize() == m_pageSize && m_snapshot->backgroundColor() == m_backgroundColor
+                     && m_snapshot->symbols() == m_symbols
+                     && m_snapshot->revisions().revisionCount() == m_revisions.revisionCount()
+                     && m_snapshot->shapes().size() == m_shapes.size()
+                     && m_snapshot->connections().size() == m_connections.size();
+    QHash<const Shape*, ShapeRecordRef> records;
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        const Shape* shape = m_shapes[i];
+        ShapeRecordRef record = previousShapes.value(shape);
+        if (!record || record->revision() != shape->revision()) {
+            record = ShapeRecordRef(new ShapeRecord(idOf(shape), shape));
+        }
+        unchanged = unchanged && m_snapshot->shapes().at(i) == record;
+        records.insert(shape, record);
+        next->m_shapeIndices.insert(record->shape(), i);
+        next->m_shapes.append(record);
+    }
+    for (int i = 0; i < m_connections.size(); ++i) {
+        const Connection* connection = m_connections[i];
+        ShapeRecordRef startOwner = records.value(connection->getStartPoint().getOwner());
+        ShapeRecordRef endOwner = records.value(connection->getEndPoint().getOwner());
+        ConnectionRecordRef record = previousConnections.value(idOf(connection));
+        if (!record || record->revision() != connection->revision()
+            || record->startOwner() != startOwner || record->endOwner() != endOwner) {
+            record = ConnectionRecordRef(new ConnectionRecord(idOf(connection), connection, startOwner, endOwner));
+        }
+        unchanged = unchanged && m_snapshot->connections().at(i) == record;
+        next->m_connections.append(record);
+    }
+    if (!unchanged) {
+        m_snapshot = next;
+    }
+    return m_snapshot;
+}
+void SceneModel::paint(QPainter* painter) const
+{
+    painter->fillRect(QRect(QPoint(0, 0), m_pageSize), m_backgroundColor);
+    for (Shape* shape : m_shapes) {
+        shape->paint(painter);
+    }
+    for (Connection* connection : m_connections) {
+        connection->paint(painter);
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef SCENEMODEL_H
+#define SCENEMODEL_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QColor>
+#include <QSize>
+#include <QSharedPointer>
+#include "chart/geometrystore.h"
+#include "chart/objectpool.h"
+#include "chart/changeset.h"
+#include "chart/scenesnapshot.h"
+#include "chart/revisionstore.h"
+
+class Shape;
+class Connection;
+class Symbol;
+class QPainter;
+
+// 文档模型：持有全部图形与连线以及页面设置，不依赖任何控件
+// 每个对象分配一个稳定的64位ID，可O(1)查找；所有结构变化都通过信号通知
+class SceneModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef quint64 ObjectId;
+    static const ObjectId InvalidId = 0;
+
+    explicit SceneModel(QObject* parent = nullptr);
+    ~SceneModel();
+
+    // 按图层顺序（由下到上）排列
+    const QVector<Shape*>& shapes() const { return m_shapes; }
+    const QVector<Connection*>& connections() const { return m_connections; }
+    int objectCount() const { return m_shapes.size() + m_connections.size(); }
+
+    // 图形：模型接管所有权；插入符号实例时其母版自动加入符号库
+    // insert时可传入对象移出前的ID（撤销删除时放回），使ID在撤销前后保持不变；该ID已被占用时重新分配
+    ObjectId addShape(Shape* shape);
+    ObjectId insertShape(int index, Shape* shape, ObjectId id = InvalidId);
+    Shape* takeShape(Shape* shape);         // 移出模型但不删除
+    void removeShape(Shape* shape);         // 移出并删除
+    void removeShapes(const QSet<Shape*>& shapes);  // 批量移出并删除，只遍历一次列表
+    // 批量移出但不删除，只遍历一次列表；返回移出的图形及其原下标（按下标升序），不在模型中的图形被忽略
+    QVector<QPair<int, Shape*>> takeShapes(const QSet<Shape*>& shapes);
+    void moveShape(int from, int to);       // 调整图层顺序
+    int indexOf(const Shape* shape) const;  // 按zKey二分查找，O(log n)
+
+    // 批量图层操作：被移动的图形之间保持原有相对顺序，只改写被移动图形的zKey
+    void raiseShapes(const QSet<Shape*>& shapes);          // 上移一层
+    void lowerShapes(const QSet<Shape*>& shapes);          // 下移一层
+    void bringShapesToFront(const QSet<Shape*>& shapes);   // 置于顶层
+    void sendShapesToBack(const QSet<Shape*>& shapes);     // 置于底层
+
+    // 连线：模型接管所有权
+    ObjectId addConnection(Connection* connection);
+    ObjectId insertConnection(int index, Connection* connection, ObjectId id = InvalidId);
+    Connection* takeConnection(Connection* connection);     // 线性查找，移出多条连线时用takeConnections
+    QVector<QPair<int, Connection*>> takeConnections(const QSet<Connection*>& connections);
+    void removeConnection(Connection* connection);
+    void removeConnections(const QSet<Connection*>& connections);
+    int indexOf(const Connection* connection) const { return m_connections.indexOf(const_cast<Connection*>(connection)); }
+
+    // 图形几何数据的连续存储，槽位与Shape::geometrySlot()对应
+    // zKey为严格递增的小数键，插入或移动图形时取相邻两键的中点，不必重排其余图形
+    const GeometryStore& geometry() const { return m_geometry; }
+
+    // 符号库：场景中SymbolInstance引用的母版，按加入顺序保存（被嵌套引用的母版排在前面）
+    void addSymbol(const QSharedPointer<Symbol>& symbol);
+    void setSymbols(const QVector<QSharedPointer<Symbol>>& symbols);   // 整体替换，用于撤销导入
+    const QVector<QSharedPointer<Symbol>>& symbols() const { return m_symbols; }
+    int indexOfSymbol(const Symbol* symbol) const;
+
+    // 文档中保存的命名修订，clear()时一并清空
+    const RevisionStore& revisions() const { return m_revisions; }
+    void setRevisions(const RevisionStore& revisions);
+    int commitRevision(const QString& name);   // 把当前内容保存为命名修订，返回修订下标
+
+    // 文档对象池，在ObjectPool::Scope中创建的图形与连线从这里分配
+    ObjectPool* pool() { return &m_pool; }
+
+    // ID查找
+    ObjectId idOf(const Shape* shape) const { return m_shapeIds.value(shape, InvalidId); }
+    ObjectId idOf(const Connection* connection) const { return m_connectionIds.value(connection, InvalidId); }
+    Shape* shapeById(ObjectId id) const { return m_shapesById.value(id, nullptr); }
+    Connection* connectionById(ObjectId id) const { return m_connectionsById.value(id, nullptr); }
+
+    // 对象属性被外部修改后调用，用于发出变化信号
+    void notifyShapeChanged(const Shape* shape);
+    void notifyConnectionChanged(const Connection* connection);
+
+    // 场景修订号：任何结构变化或notify*调用后都会更新，可用于O(1)判断缓存是否失效
+    quint64 revision() const { return m_revision; }
+
+    // 批量变化通知：begin/end之间的变化合并为一次changesCommitted；
+    // 不在批量修改中时，变化在下一次事件循环时合并提交，也可调用flushChanges立即提交
+    void beginChanges();
+    void endChanges();
+    void flushChanges();
+
+    // 当前内容的不可变快照，可交给其他线程读取；只能在场景所在线程调用
+    // 未变化的对象沿用上一次快照中的记录，内容完全没有变化时直接返回上一次的快照
+    SceneSnapshotRef snapshot() const;
+
+    // 删除全部对象
+    void clear();
+
+    // 页面设置
+    QSize pageSize() const { return m_pageSize; }
+    void setPageSize(const QSize& size);
+    QColor backgroundColor() const { return m_backgroundColor; }
+    void setBackgroundColor(const QColor& color);
+
+    // 按图层顺序绘制背景、图形和连线（用于导出）
+    void paint(QPainter* painter) const;
+
+signals:
+    void shapeAdded(SceneModel::ObjectId id);
+    void shapeRemoved(SceneModel::ObjectId id);
+    void shapeChanged(SceneModel::ObjectId id);
+    void shapeOrderChanged();
+    void connectionAdded(SceneModel::ObjectId id);
+    void connectionRemoved(SceneModel::ObjectId id);
+    void connectionChanged(SceneModel::ObjectId id);
+    void sceneCleared();
+    void pageChanged();
+    void revisionsChanged();
+    void changesCommitted(const ChangeSet& changes);
+
+private:
+    ObjectId registerShape(Shape* shape, ObjectId id);
+    ObjectId registerConnection(Connection* connection, ObjectId id);
+    void bindGeometry(Shape* shape);
+    void unbindGeometry(Shape* shape);
+    qreal zKeyAt(int index) const;
+    void assignZKey(int index);
+    void renumberZKeys();
+    void swapShapes(int a, int b);
+    QVector<int> sortedIndices(const QSet<Shape*>& shapes) const;   // 图形的图层下标（升序），O(k log n)
+    void recordChange();
+
+    QVector<Shape*> m_shapes;
+    QVector<Connection*> m_connections;
+    QHash<ObjectId, Shape*> m_shapesById;
+    QHash<const Shape*, ObjectId> m_shapeIds;
+    QHash<ObjectId, Connection*> m_connectionsById;
+    QHash<const Connection*, ObjectId> m_connectionIds;
+    ObjectId m_nextId;
+    ObjectPool m_pool;
+    GeometryStore m_geometry;
+    QVector<QSharedPointer<Symbol>> m_symbols;
+    RevisionStore m_revisions;
+    mutable SceneSnapshotRef m_snapshot;
+
+    quint64 m_revision;
+    ChangeSet m_pendingChanges;
+    int m_batchDepth;
+    bool m_flushScheduled;
+
+    QSize m_pageSize;
+    QColor m_backgroundColor;
+};
+
+#endif // SCENEMODEL_H
@@ -0,0 +1,81 @@
+﻿#include "chart/scenesnapshot.h"
+#include "chart/shape.h"
+#include "chart/shapefactory.h"
+#include "chart/symbol.h"
+#include "chart/objectpool.h"
+#include <QPainter>
+ShapeRecord::ShapeRecord(quint64 id, const Shape* source)
+    : m_id(id), m_revision(source->revision()), m_shape(nullptr)
+{
+    // 记录可能在其他线程释放，不能从场景的对象池分配
+    ObjectPool::Scope heapScope(nullptr);
+    m_shape = ShapeFactory::instance().createCopy(source);
+    if (!m_shape) {
+        return;
+    }
+    // 预先生成各种延迟计算的缓存，之后的读取都不再写入对象
+    m_shape->outlinePolyline();
+    if (m_shape->typeId() == ShapeFactory::SymbolInstanceType) {
+        static_cast<SymbolInstance*>(m_shape)->master()->picture();
+    }
+}
+ShapeRecord::~ShapeRecord()
+{
+    delete m_shape;
+}
+void ShapeRecord::paint(QPainter* painter) const
+{
+    if (m_shape) {
+        m_shape->paint(painter);
+    }
+}
+namespace {
+ConnectionPoint rebindPoint(const ConnectionPoint& point, Shape* owner)
+{
+    if (!owner || !point.getOwner()) {
+        return point.isValid() ? ConnectionPoint(point.getPosition()) : ConnectionPoint();
+    }
+    if (point.getPositionType() == ConnectionPoint::Outline) {
+        return ConnectionPoint(owner, point.getOutlineParam());
+    }
+    return ConnectionPoint(owner, point.getPositionType());
+}
+}
+ConnectionRecord::ConnectionRecord(quint64 id, const Connection* source,
+                                   const ShapeRecordRef& startOwner, const ShapeRecordRef& endOwner)
+    : m_id(id),
+      m_revision(source->revision()),
+      m_startOwner(startOwner),
+      m_endOwner(endOwner),
+      m_startPoint(rebindPoint(source->getStartPoint(), startOwner ? startOwner->m_shape : nullptr)),
+      m_endPoint(rebindPoint(source->getEndPoint(), endOwner ? endOwner->m_shape : nullptr)),
+      m_startPosition(source->getStartPosition()),
+      m_endPosition(source->getEndPosition()),
+      m_isArrow(dynamic_cast<const ArrowLine*>(source) != nullptr)
+{
+}
+void ConnectionRecord::paint(QPainter* painter) const
+{
+    if (m_startPoint.isValid()) {
+        Connection::drawConnectionLine(painter, m_startPosition, m_endPosition, false, true);
+    }
+}
+int SceneSnapshot::indexOfSymbol(const Symbol* symbol) const
+{
+    for (int i = 0; i < m_symbols.size(); ++i) {
+        if (m_symbols[i].data() == symbol) {
+            return i;
+        }
+    }
+    return -1;
+}
+void SceneSnapshot::paint(QPainter* painter) const
+{
+    painter->fillRect(QRect(QPoint(0, 0), m_pageSize), m_backgroundColor);
+    for (const ShapeRecordRef& record : m_shapes) {
+        record->paint(painter);
+    }
+    for (const ConnectionRecordRef& record : m_connections) {
+        record->paint(painter);
+    }
+}
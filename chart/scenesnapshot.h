@@ -0,0 +1,109 @@
+#ifndef SCENESNAPSHOT_H
+#define SCENESNAPSHOT_H
+
+#include <QVector>
+#include <QHash>
+#include <QSize>
+#include <QColor>
+#include <QSharedPointer>
+#include "chart/connection.h"
+#include "chart/revisionstore.h"
+
+class Shape;
+class Symbol;
+class QPainter;
+
+// 图形的只读记录：保存创建时拷贝出的一份独立图形，此后不再修改
+// 记录可在多个快照之间共享，也可在任意线程读取和释放
+class ShapeRecord
+{
+public:
+    ShapeRecord(quint64 id, const Shape* source);
+    ~ShapeRecord();
+
+    quint64 id() const { return m_id; }
+    quint64 revision() const { return m_revision; }   // 对应源图形的Shape::revision()
+    const Shape* shape() const { return m_shape; }
+    void paint(QPainter* painter) const;
+
+private:
+    friend class ConnectionRecord;
+    ShapeRecord(const ShapeRecord&);
+    ShapeRecord& operator=(const ShapeRecord&);
+
+    quint64 m_id;
+    quint64 m_revision;
+    Shape* m_shape;
+};
+typedef QSharedPointer<const ShapeRecord> ShapeRecordRef;
+
+// 连线的只读记录：端点指向所属图形记录中冻结的图形（并持有这些记录），位置在创建时已经算好
+class ConnectionRecord
+{
+public:
+    ConnectionRecord(quint64 id, const Connection* source,
+                     const ShapeRecordRef& startOwner, const ShapeRecordRef& endOwner);
+
+    quint64 id() const { return m_id; }
+    quint64 revision() const { return m_revision; }
+    const ShapeRecordRef& startOwner() const { return m_startOwner; }
+    const ShapeRecordRef& endOwner() const { return m_endOwner; }
+    const ConnectionPoint& startPoint() const { return m_startPoint; }
+    const ConnectionPoint& endPoint() const { return m_endPoint; }
+    QPoint startPosition() const { return m_startPosition; }
+    QPoint endPosition() const { return m_endPosition; }
+    bool isArrow() const { return m_isArrow; }
+    void paint(QPainter* painter) const;
+
+private:
+    quint64 m_id;
+    quint64 m_revision;
+    ShapeRecordRef m_startOwner;
+    ShapeRecordRef m_endOwner;
+    ConnectionPoint m_startPoint;
+    ConnectionPoint m_endPoint;
+    QPoint m_startPosition;
+    QPoint m_endPosition;
+    bool m_isArrow;
+};
+typedef QSharedPointer<const ConnectionRecord> ConnectionRecordRef;
+
+// 场景的不可变快照，由SceneModel::snapshot()生成
+// 未变化的对象在相邻快照间共享同一条记录，生成快照只需复制指针并为变化的对象重建记录；
+// 编辑路径上不加任何锁，工作线程（导出、自动保存、缩略图等）可在用户继续编辑时读取快照
+class SceneSnapshot
+{
+public:
+    quint64 revision() const { return m_revision; }
+    QSize pageSize() const { return m_pageSize; }
+    QColor backgroundColor() const { return m_backgroundColor; }
+
+    // 按图层顺序（由下到上）排列
+    const QVector<ShapeRecordRef>& shapes() const { return m_shapes; }
+    const QVector<ConnectionRecordRef>& connections() const { return m_connections; }
+    const QVector<QSharedPointer<Symbol>>& symbols() const { return m_symbols; }
+    int indexOfSymbol(const Symbol* symbol) const;
+    // 冻结图形到图层下标的映射，用于把连线端点换算成图形下标
+    const QHash<const Shape*, int>& shapeIndices() const { return m_shapeIndices; }
+    // 文档中保存的修订历史
+    const RevisionStore& revisions() const { return m_revisions; }
+
+    // 与SceneModel::paint相同：背景、图形、连线，不含任何选中状态
+    void paint(QPainter* painter) const;
+
+private:
+    friend class SceneModel;
+    SceneSnapshot() : m_revision(0) {}
+
+    quint64 m_revision;
+    QSize m_pageSize;
+    QColor m_backgroundColor;
+    QVector<ShapeRecordRef> m_shapes;
+    QVector<ConnectionRecordRef> m_connections;
+    QVector<QSharedPointer<Symbol>> m_symbols;
+    QHash<const Shape*, int> m_shapeIndices;
+    RevisionStore m_revisions;
+};
+typedef QSharedPointer<const SceneSnapshot> SceneSnapshotRef;
+
+#endif // SCENESNAPSHOT_H
@@ -1,31 +1,114 @@
 ﻿#include "chart/shape.h"
-#include "chart/shapefactory.h"
 #include "chart/connection.h"
-Shape::Shape(const QString& type, const int& basis)
-    : m_type(type), m_editing(false)
-{
-    m_font = QFont("寰蒋闆呴粦", 12);
-    m_fontColor = Qt::black;
-    m_fillColor = Qt::white;  
-    m_lineColor = Qt::black;  
-    m_textAlignment = Qt::AlignCenter;
-    m_transparency = 100;     
-    m_lineWidth = 1.5;        
-    m_lineStyle = 0;          
+#include "chart/geometrystore.h"
+#include <algorithm>
+#include <limits>
+Shape::Shape(ShapeFactory::TypeId typeId, const int& basis)
+    : m_typeId(typeId), m_editing(false), m_revision(Revision::next()), m_style(ShapeStyle::defaultStyle()),
+      m_geometryStore(nullptr), m_geometrySlot(-1)
+{
 }
 Shape::~Shape()
 {
-    qDeleteAll(m_connectionPoints);
-    m_connectionPoints.clear();
 }
 void Shape::setRect(const QRect& rect)
 {
+    if (rect != m_rect) {
+        m_revision = Revision::next();
+    }
     m_rect = rect;
+    if (m_geometryStore) {
+        m_geometryStore->setRect(m_geometrySlot, m_rect);
+    }
+}
+void Shape::bindGeometryStore(GeometryStore* store, int slot)
+{
+    m_geometryStore = store;
+    m_geometrySlot = store ? slot : -1;
+    if (m_geometryStore) {
+        m_geometryStore->setRect(m_geometrySlot, m_rect);
+    }
 }
 bool Shape::contains(const QPoint& point) const
 {
     return m_rect.contains(point);
 }
+QPolygonF Shape::outlinePolygon() const
+{
+    return QPolygonF(QRectF(m_rect));
+}
+void Shape::ensureOutlineCache() const
+{
+    if (!m_outlineCache.isEmpty() && m_outlineCacheRect == m_rect) {
+        return;
+    }
+    m_outlineCacheRect = m_rect;
+    m_outlineCache = outlinePolygon();
+    m_outlineLengths.clear();
+    if (m_outlineCache.isEmpty()) {
+        return;
+    }
+    if (m_outlineCache.first() != m_outlineCache.last()) {
+        m_outlineCache.append(m_outlineCache.first());
+    }
+    m_outlineLengths.reserve(m_outlineCache.size());
+    qreal total = 0.0;
+    m_outlineLengths.append(total);
+    for (int i = 1; i < m_outlineCache.size(); ++i) {
+        total += QLineF(m_outlineCache[i - 1], m_outlineCache[i]).length();
+        m_outlineLengths.append(total);
+    }
+}
+const QPolygonF& Shape::outlinePolyline() const
+{
+    ensureOutlineCache();
+    return m_outlineCache;
+}
+QPointF Shape::pointOnOutline(qreal t) const
+{
+    ensureOutlineCache();
+    if (m_outlineCache.size() < 2 || m_outlineLengths.last() <= 0.0) {
+        return QPointF(m_rect.center());
+    }
+    t -= std::floor(t);
+    qreal target = t * m_outlineLengths.last();
+    int index = int(std::upper_bound(m_outlineLengths.constBegin(), m_outlineLengths.constEnd(), target)
+                    - m_outlineLengths.constBegin());
+    index = qBound(1, index, m_outlineCache.size() - 1);
+    qreal segmentStart = m_outlineLengths[index - 1];
+    qreal segmentLength = m_outlineLengths[index] - segmentStart;
+    qreal fraction = segmentLength > 0.0 ? (target - segmentStart) / segmentLength : 0.0;
+    return m_outlineCache[index - 1] + (m_outlineCache[index] - m_outlineCache[index - 1]) * fraction;
+}
+qreal Shape::nearestOutlineParam(const QPointF& point, qreal* distance) const
+{
+    ensureOutlineCache();
+    if (m_outlineCache.size() < 2 || m_outlineLengths.last() <= 0.0) {
+        if (distance) {
+            *distance = std::numeric_limits<qreal>::max();
+        }
+        return 0.0;
+    }
+    qreal bestDistanceSquared = std::numeric_limits<qreal>::max();
+    qreal bestLength = 0.0;
+    for (int i = 1; i < m_outlineCache.size(); ++i) {
+        QPointF a = m_outlineCache[i - 1];
+        QPointF ab = m_outlineCache[i] - a;
+        qreal lengthSquared = QPointF::dotProduct(ab, ab);
+        qreal fraction = lengthSquared > 0.0 ? QPointF::dotProduct(point - a, ab) / lengthSquared : 0.0;
+        fraction = qBound(0.0, fraction, 1.0);
+        QPointF diff = point - (a + ab * fraction);
+        qreal distanceSquared = QPointF::dotProduct(diff, diff);
+        if (distanceSquared < bestDistanceSquared) {
+            bestDistanceSquared = distanceSquared;
+            bestLength = m_outlineLengths[i - 1] + (m_outlineLengths[i] - m_outlineLengths[i - 1]) * fraction;
+        }
+    }
+    if (distance) {
+        *distance = std::sqrt(bestDistanceSquared);
+    }
+    return bestLength / m_outlineLengths.last();
+}
 void Shape::drawResizeHandles(QPainter* painter) const
 {
     painter->save();
@@ -128,12 +211,16 @@ void Shape::resize(HandlePosition handle, const QPoint& offset)
             newRect.setBottom(newRect.top() + MIN_SIZE);
         }
     }
-    m_rect = newRect;
+    setRect(newRect);
 }
 void Shape::setText(const QString& text)
 {
-    m_text = text;
-    m_text.remove(QRegularExpression("^\\n+")); 
+    QString stripped = text;
+    stripped.remove(QRegularExpression("^\\n+"));
+    if (stripped != m_text) {
+        m_text = stripped;
+        m_revision = Revision::next();
+    }
 }
 QString Shape::text() const
 {
@@ -149,16 +236,19 @@ void Shape::setEditing(bool editing)
 }
 void Shape::drawText(QPainter* painter) const
 {
-    if (m_editing || m_text.isEmpty())
+    if (m_editing)
+        return;
+    drawText(painter, m_text);
+}
+void Shape::drawText(QPainter* painter, const QString& text) const
+{
+    if (text.isEmpty())
         return;
     QRect rect = textRect();
     painter->save();
-    int alpha = qRound(m_transparency * 2.55); 
-    QColor fontColorWithAlpha = m_fontColor;
-    fontColorWithAlpha.setAlpha(alpha);
-    painter->setPen(fontColorWithAlpha);
-    painter->setFont(m_font);  
-    painter->drawText(rect, m_textAlignment | Qt::TextWordWrap, m_text);
+    painter->setPen(m_style->textColor());
+    painter->setFont(m_style->font());
+    painter->drawText(rect, m_style->textAlignment() | Qt::TextWordWrap, text);
     painter->restore();
 }
 QRect Shape::textRect() const
@@ -167,14 +257,11 @@ QRect Shape::textRect() const
 }
 void Shape::drawConnectionPoints(QPainter* painter) const
 {
-    if (m_connectionPoints.isEmpty()) {
-        createConnectionPoints();
-    }
     painter->save();
     painter->setPen(Qt::blue);
     painter->setBrush(Qt::white);
-    for (const ConnectionPoint* point : m_connectionPoints) {
-        QPoint pos = point->getPosition();
+    for (int position = ConnectionPoint::Top; position <= ConnectionPoint::Left; ++position) {
+        QPoint pos = getConnectionPoint(static_cast<ConnectionPoint::Position>(position));
         int halfSize = CONNECTION_POINT_SIZE / 2;
         QRect pointRect(pos.x() - halfSize, pos.y() - halfSize, 
                        CONNECTION_POINT_SIZE, CONNECTION_POINT_SIZE);
@@ -197,58 +284,39 @@ QPoint Shape::getConnectionPoint(ConnectionPoint::Position position) const{
         return rect.center();
     }
 }
-void Shape::createConnectionPoints() const
+void Shape::attachConnection(Connection* connection)
 {
-    qDeleteAll(m_connectionPoints);
-    m_connectionPoints.clear();
-    m_connectionPoints.append(new ConnectionPoint(const_cast<Shape*>(this), ConnectionPoint::Top));
-    m_connectionPoints.append(new ConnectionPoint(const_cast<Shape*>(this), ConnectionPoint::Right));
-    m_connectionPoints.append(new ConnectionPoint(const_cast<Shape*>(this), ConnectionPoint::Bottom));
-    m_connectionPoints.append(new ConnectionPoint(const_cast<Shape*>(this), ConnectionPoint::Left));
+    m_incidentConnections.append(connection);
 }
-QVector<ConnectionPoint*> Shape::getConnectionPoints()
+void Shape::detachConnection(Connection* connection)
 {
-    if (m_connectionPoints.isEmpty()) {
-        createConnectionPoints();
-    }
-    return m_connectionPoints;
+    m_incidentConnections.removeOne(connection);
 }
-ConnectionPoint* Shape::hitConnectionPoint(const QPoint& point,bool isStart) const
+ConnectionPoint Shape::port(ConnectionPoint::Position position) const
 {
-    if (m_connectionPoints.isEmpty()) {
-        createConnectionPoints();
-    }
-    if(isStart){
-        for (ConnectionPoint* cp : m_connectionPoints) {
-            QPoint pos = cp->getPosition();
-            int halfSize = CONNECTION_POINT_SIZE*3/4;
-            QRect pointRect(pos.x() - halfSize, pos.y() - halfSize, 
-                            CONNECTION_POINT_SIZE*3/2, CONNECTION_POINT_SIZE*3/2);
-            if (pointRect.contains(point)) {
-                return cp;
-            }
-        }
-    }else{
-        for (ConnectionPoint* cp : m_connectionPoints) {
-            QPoint pos = cp->getPosition();
-            int halfSize = CONNECTION_POINT_SIZE;
-            QRect pointRect(pos.x() - halfSize, pos.y() - halfSize, 
-                            CONNECTION_POINT_SIZE*2, CONNECTION_POINT_SIZE*2);
-            if (pointRect.contains(point)) {
-                return cp;
-            }
+    return ConnectionPoint(const_cast<Shape*>(this), position);
+}
+ConnectionPoint Shape::hitConnectionPoint(const QPoint& point,bool isStart) const
+{
+    int halfSize = isStart ? CONNECTION_POINT_SIZE*3/4 : CONNECTION_POINT_SIZE;
+    for (int position = ConnectionPoint::Top; position <= ConnectionPoint::Left; ++position) {
+        ConnectionPoint::Position type = static_cast<ConnectionPoint::Position>(position);
+        QPoint pos = getConnectionPoint(type);
+        QRect pointRect(pos.x() - halfSize, pos.y() - halfSize, halfSize * 2, halfSize * 2);
+        if (pointRect.contains(point)) {
+            return port(type);
         }
     }
-    return nullptr;
+    return ConnectionPoint();
 }
 RectangleShape::RectangleShape(const int& basis)
-    : Shape(ShapeTypes::Rectangle, basis)
+    : Shape(ShapeFactory::RectangleType, basis)
 {
     int width = basis * 98 / 55;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
 }
-void RectangleShape::paint(QPainter* painter)
+void RectangleShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -256,20 +324,13 @@ void RectangleShape::paint(QPainter* painter)
     painter->restore();
     drawText(painter);
 }
-void RectangleShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Rectangle,
-        [](const int& basis) -> Shape* { return new RectangleShape(basis); }
-    );
-}
 CircleShape::CircleShape(const int& basis)
-    : Shape(ShapeTypes::Circle, basis)
+    : Shape(ShapeFactory::CircleType, basis)
 {
     int size = 1.5 * basis;
     m_rect = QRect(0, 0, size, size);
 }
-void CircleShape::paint(QPainter* painter)
+void CircleShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -286,15 +347,14 @@ bool CircleShape::contains(const QPoint& point) const
     double normY = (point.y() - center.y()) / b;
     return (normX * normX + normY * normY) <= 1.0;
 }
-void CircleShape::registerShape()
+QPolygonF CircleShape::outlinePolygon() const
 {
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Circle,
-        [](const int& basis) -> Shape* { return new CircleShape(basis); }
-    );
+    QPainterPath path;
+    path.addEllipse(QRectF(m_rect));
+    return path.toFillPolygon();
 }
 PentagonShape::PentagonShape(const int& basis)
-    : Shape(ShapeTypes::Pentagon, basis)
+    : Shape(ShapeFactory::PentagonType, basis)
 {
     double cos18 = cos(M_PI / 10); 
     double cos36 = cos(M_PI / 5);  
@@ -302,7 +362,7 @@ PentagonShape::PentagonShape(const int& basis)
     int height = (basis*0.8) * (1 + cos36);
     m_rect = QRect(0, 0, width, height);
 }
-void PentagonShape::paint(QPainter* painter)
+void PentagonShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -329,6 +389,10 @@ bool PentagonShape::contains(const QPoint& point) const
 {
     return createPentagonPolygon().containsPoint(point, Qt::OddEvenFill);
 }
+QPolygonF PentagonShape::outlinePolygon() const
+{
+    return QPolygonF(createPentagonPolygon());
+}
 QPoint PentagonShape::getConnectionPoint(ConnectionPoint::Position position) const{
     QRect rect = this->getRect();
     int w = rect.width();
@@ -349,21 +413,14 @@ QPoint PentagonShape::getConnectionPoint(ConnectionPoint::Position position) con
         return rect.center();
     }
 }
-void PentagonShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Pentagon,
-        [](const int& basis) -> Shape* { return new PentagonShape(basis); }
-    );
-}
 EllipseShape::EllipseShape(const int& basis)
-    : Shape(ShapeTypes::Ellipse, basis)
+    : Shape(ShapeFactory::EllipseType, basis)
 {
     int width = basis * 98 / 55;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
 }
-void EllipseShape::paint(QPainter* painter)
+void EllipseShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -380,22 +437,21 @@ bool EllipseShape::contains(const QPoint& point) const
     double normY = (point.y() - center.y()) / b;
     return (normX * normX + normY * normY) <= 1.0;
 }
-void EllipseShape::registerShape()
+QPolygonF EllipseShape::outlinePolygon() const
 {
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Ellipse,
-        [](const int& basis) -> Shape* { return new EllipseShape(basis); }
-    );
+    QPainterPath path;
+    path.addEllipse(QRectF(m_rect));
+    return path.toFillPolygon();
 }
 RoundedRectangleShape::RoundedRectangleShape(const int& basis)
-    : Shape(ShapeTypes::RoundedRectangle, basis)
+    : Shape(ShapeFactory::RoundedRectangleType, basis)
 {
     int width = basis * 98 / 55;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
     m_radius = height / 6;
 }
-void RoundedRectangleShape::paint(QPainter* painter)
+void RoundedRectangleShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -403,21 +459,20 @@ void RoundedRectangleShape::paint(QPainter* painter)
     painter->restore();
     drawText(painter);
 }
-void RoundedRectangleShape::registerShape()
+QPolygonF RoundedRectangleShape::outlinePolygon() const
 {
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::RoundedRectangle,
-        [](const int& basis) -> Shape* { return new RoundedRectangleShape(basis); }
-    );
+    QPainterPath path;
+    path.addRoundedRect(QRectF(m_rect), m_radius, m_radius);
+    return path.toFillPolygon();
 }
 DiamondShape::DiamondShape(const int& basis)
-    : Shape(ShapeTypes::Diamond, basis)
+    : Shape(ShapeFactory::DiamondType, basis)
 {
     int width = basis * 98 / 55;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
 }
-void DiamondShape::paint(QPainter* painter)
+void DiamondShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -440,6 +495,10 @@ bool DiamondShape::contains(const QPoint& point) const
 {
     return createDiamondPolygon().containsPoint(point, Qt::OddEvenFill);
 }
+QPolygonF DiamondShape::outlinePolygon() const
+{
+    return QPolygonF(createDiamondPolygon());
+}
 QPoint DiamondShape::getConnectionPoint(ConnectionPoint::Position position) const
 {
     QRect rect = this->getRect(); 
@@ -456,21 +515,14 @@ QPoint DiamondShape::getConnectionPoint(ConnectionPoint::Position position) cons
         return rect.center();
     }
 }
-void DiamondShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Diamond,
-        [](const int& basis) -> Shape* { return new DiamondShape(basis); }
-    );
-}
 HexagonShape::HexagonShape(const int& basis)
-    : Shape(ShapeTypes::Hexagon, basis)
+    : Shape(ShapeFactory::HexagonType, basis)
 {
     int width = basis * 98 / 55;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
 }
-void HexagonShape::paint(QPainter* painter)
+void HexagonShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -495,6 +547,10 @@ bool HexagonShape::contains(const QPoint& point) const
 {
     return createHexagonPolygon().containsPoint(point, Qt::OddEvenFill);
 }
+QPolygonF HexagonShape::outlinePolygon() const
+{
+    return QPolygonF(createHexagonPolygon());
+}
 QPoint HexagonShape::getConnectionPoint(ConnectionPoint::Position position) const
 {
     QRect rect = this->getRect();
@@ -513,20 +569,13 @@ QPoint HexagonShape::getConnectionPoint(ConnectionPoint::Position position) cons
         return rect.center();
     }
 }
-void HexagonShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Hexagon,
-        [](const int& basis) -> Shape* { return new HexagonShape(basis); }
-    );
-}
 OctagonShape::OctagonShape(const int& basis)
-    : Shape(ShapeTypes::Octagon, basis)
+    : Shape(ShapeFactory::OctagonType, basis)
 {
     int size = basis * 1.2;
     m_rect = QRect(0, 0, size, size);
 }
-void OctagonShape::paint(QPainter* painter)
+void OctagonShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
@@ -555,6 +604,10 @@ bool OctagonShape::contains(const QPoint& point) const
 {
     return createOctagonPolygon().containsPoint(point, Qt::OddEvenFill);
 }
+QPolygonF OctagonShape::outlinePolygon() const
+{
+    return QPolygonF(createOctagonPolygon());
+}
 QPoint OctagonShape::getConnectionPoint(ConnectionPoint::Position position) const
 {
     QRect rect = this->getRect();
@@ -574,40 +627,45 @@ QPoint OctagonShape::getConnectionPoint(ConnectionPoint::Position position) cons
         return rect.center();
     }
 }
-void OctagonShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Octagon,
-        [](const int& basis) -> Shape* { return new OctagonShape(basis); }
-    );
-}
 CloudShape::CloudShape(const int& basis)
-    : Shape(ShapeTypes::Cloud, basis)
+    : Shape(ShapeFactory::CloudType, basis)
 {
     int width = basis * 1.5;
     int height = basis;
     m_rect = QRect(0, 0, width, height);
-    m_cloudPath= createCloudPath();
 }
-void CloudShape::paint(QPainter* painter)
+void CloudShape::paint(QPainter* painter) const
 {
     painter->save();
     setupPainter(painter);
-    m_cloudPath= createCloudPath();
-    painter->drawPath(m_cloudPath);
+    painter->drawPath(createCloudPath());
     painter->restore();
     drawText(painter);
 }
 bool CloudShape::contains(const QPoint& point) const
 {
-    return m_cloudPath.contains(QPointF(point));
+    return createCloudPath().contains(QPointF(point));
+}
+QPolygonF CloudShape::outlinePolygon() const
+{
+    return createCloudPath().toFillPolygon();
 }
 QPoint CloudShape::getConnectionPoint(ConnectionPoint::Position position) const
 {
-    QPointF topmost, bottommost, leftmost, rightmost;
-    findExtremePointsOnPath(m_cloudPath, topmost, bottommost, 
-                                      leftmost, rightmost, 
-                                      60);
+    const QPolygonF& outline = outlinePolyline();
+    if (outline.isEmpty()) {
+        return m_rect.center();
+    }
+    QPointF topmost = outline.first();
+    QPointF bottommost = outline.first();
+    QPointF leftmost = outline.first();
+    QPointF rightmost = outline.first();
+    for (const QPointF& point : outline) {
+        if (point.y() < topmost.y()) topmost = point;
+        if (point.y() > bottommost.y()) bottommost = point;
+        if (point.x() < leftmost.x()) leftmost = point;
+        if (point.x() > rightmost.x()) rightmost = point;
+    }
     switch (position) {
     case ConnectionPoint::Top:
         return topmost.toPoint();
@@ -621,51 +679,7 @@ QPoint CloudShape::getConnectionPoint(ConnectionPoint::Position position) const
         return m_rect.center();
     }
 }
-void CloudShape::findExtremePointsOnPath(
-    const QPainterPath& path, 
-    QPointF& outTopmost, 
-    QPointF& outBottommost, 
-    QPointF& outLeftmost, 
-    QPointF& outRightmost,
-    int numberOfSamples ) const
-{
-    if (path.isEmpty()) {
-        qWarning() << "Path is empty, cannot find extreme points.";
-        outTopmost = outBottommost = outLeftmost = outRightmost = QPointF(); 
-        return;
-    }
-    outTopmost    = path.pointAtPercent(0.0);
-    outBottommost = path.pointAtPercent(0.0);
-    outLeftmost   = path.pointAtPercent(0.0);
-    outRightmost  = path.pointAtPercent(0.0);
-    if (numberOfSamples < 2) {
-        numberOfSamples = 2; 
-    }
-    for (int i = 0; i <= numberOfSamples; ++i) { 
-        qreal percent = static_cast<qreal>(i) / static_cast<qreal>(numberOfSamples);
-        QPointF currentPoint = path.pointAtPercent(percent);
-        if (currentPoint.y() < outTopmost.y()) {
-            outTopmost = currentPoint;
-        }
-        if (currentPoint.y() > outBottommost.y()) {
-            outBottommost = currentPoint;
-        }
-        if (currentPoint.x() < outLeftmost.x()) {
-            outLeftmost = currentPoint;
-        }
-        if (currentPoint.x() > outRightmost.x()) {
-            outRightmost = currentPoint;
-        }
-    }
-}
-void CloudShape::registerShape()
-{
-    ShapeFactory::instance().registerShape(
-        ShapeTypes::Cloud,
-        [](const int& basis) -> Shape* { return new CloudShape(basis); }
-    );
-}
-QPainterPath CloudShape::createCloudPath() {
+QPainterPath CloudShape::createCloudPath() const {
     QRectF targetRect(m_rect);
     QPointF pointA(30, 110);
     QPainterPath prototypeCloudPath;
@@ -700,141 +714,139 @@ QPainterPath CloudShape::createCloudPath() {
                          );
     return transform.map(prototypeCloudPath);
 }
+void Shape::setStyle(const ShapeStyleRef& style)
+{
+    if (style && style != m_style) {
+        m_style = style;
+        m_revision = Revision::next();
+    }
+}
 void Shape::setFontFamily(const QString& family)
 {
-    m_font.setFamily(family);
+    ShapeStyle modified(*m_style);
+    modified.setFontFamily(family);
+    setStyle(ShapeStyle::intern(modified));
 }
 QString Shape::fontFamily() const
 {
-    return m_font.family();
+    return m_style->fontFamily();
 }
 void Shape::setFontSize(int size)
 {
-    m_font.setPointSize(size);
+    ShapeStyle modified(*m_style);
+    modified.setFontSize(size);
+    setStyle(ShapeStyle::intern(modified));
 }
 int Shape::fontSize() const
 {
-    return m_font.pointSize();
+    return m_style->fontSize();
 }
 void Shape::setFontBold(bool bold)
 {
-    m_font.setWeight(bold ? QFont::Bold : QFont::Normal);
+    ShapeStyle modified(*m_style);
+    modified.setFontBold(bold);
+    setStyle(ShapeStyle::intern(modified));
 }
 bool Shape::isFontBold() const
 {
-    return m_font.weight() >= QFont::Bold;
+    return m_style->isFontBold();
 }
 void Shape::setFontItalic(bool italic)
 {
-    m_font.setItalic(italic);
+    ShapeStyle modified(*m_style);
+    modified.setFontItalic(italic);
+    setStyle(ShapeStyle::intern(modified));
 }
 bool Shape::isFontItalic() const
 {
-    return m_font.italic();
+    return m_style->isFontItalic();
 }
 void Shape::setFontUnderline(bool underline)
 {
-    m_font.setUnderline(underline);
+    ShapeStyle modified(*m_style);
+    modified.setFontUnderline(underline);
+    setStyle(ShapeStyle::intern(modified));
 }
 bool Shape::isFontUnderline() const
 {
-    return m_font.underline();
+    return m_style->isFontUnderline();
 }
 void Shape::setFontColor(const QColor& color)
 {
-    m_fontColor = color;
+    ShapeStyle modified(*m_style);
+    modified.setFontColor(color);
+    setStyle(ShapeStyle::intern(modified));
 }
 QColor Shape::fontColor() const
 {
-    return m_fontColor;
+    return m_style->fontColor();
 }
 void Shape::setTextAlignment(Qt::Alignment alignment)
 {
-    m_textAlignment = alignment;
+    ShapeStyle modified(*m_style);
+    modified.setTextAlignment(alignment);
+    setStyle(ShapeStyle::intern(modified));
 }
 Qt::Alignment Shape::textAlignment() const
 {
-    return m_textAlignment;
+    return m_style->textAlignment();
 }
 QFont Shape::getFont() const
 {
-    return m_font;
+    return m_style->font();
 }
 void Shape::setFillColor(const QColor& color)
 {
-    m_fillColor = color;
+    ShapeStyle modified(*m_style);
+    modified.setFillColor(color);
+    setStyle(ShapeStyle::intern(modified));
 }
 QColor Shape::fillColor() const
 {
-    return m_fillColor;
+    return m_style->fillColor();
 }
 void Shape::setLineColor(const QColor& color)
 {
-    m_lineColor = color;
+    ShapeStyle modified(*m_style);
+    modified.setLineColor(color);
+    setStyle(ShapeStyle::intern(modified));
 }
 QColor Shape::lineColor() const
 {
-    return m_lineColor;
+    return m_style->lineColor();
 }
 void Shape::setTransparency(int transparency)
 {
-    m_transparency = qBound(0, transparency, 100);
+    ShapeStyle modified(*m_style);
+    modified.setTransparency(transparency);
+    setStyle(ShapeStyle::intern(modified));
 }
 int Shape::transparency() const
 {
-    return m_transparency;
+    return m_style->transparency();
 }
 void Shape::setLineWidth(qreal width)
 {
-    m_lineWidth = qMax(0.0, width);
+    ShapeStyle modified(*m_style);
+    modified.setLineWidth(width);
+    setStyle(ShapeStyle::intern(modified));
 }
 qreal Shape::lineWidth() const
 {
-    return m_lineWidth;
+    return m_style->lineWidth();
 }
 void Shape::setLineStyle(int style)
 {
-    m_lineStyle = qBound(0, style, 3);
+    ShapeStyle modified(*m_style);
+    modified.setLineStyle(style);
+    setStyle(ShapeStyle::intern(modified));
 }
 int Shape::lineStyle() const
 {
-    return m_lineStyle;
+    return m_style->lineStyle();
 }
 void Shape::setupPainter(QPainter* painter) const
 {
-    int alpha = qRound(m_transparency * 2.55); 
-    QColor fillColorWithAlpha = m_fillColor;
-    fillColorWithAlpha.setAlpha(alpha);
-    painter->setBrush(QBrush(fillColorWithAlpha));
-    QColor lineColorWithAlpha = m_lineColor;
-    lineColorWithAlpha.setAlpha(alpha);
-    QPen pen(lineColorWithAlpha);
-    pen.setWidthF(m_lineWidth);
-    switch(m_lineStyle) {
-    case 0: 
-        pen.setStyle(Qt::SolidLine);
-        break;
-    case 1: 
-        {
-            QVector<qreal> pattern;
-            pattern << 3.0 << 3.0;
-            pen.setDashPattern(pattern);
-        }
-        break;
-    case 2: 
-        {
-            QVector<qreal> pattern;
-            pattern << 8.0 << 3.0;
-            pen.setDashPattern(pattern);
-        }
-        break;
-    case 3: 
-        {
-            QVector<qreal> pattern;
-            pattern << 7.0 << 3.0 << 2.0 << 3.0;
-            pen.setDashPattern(pattern);
-        }
-        break;
-    }
-    painter->setPen(pen);
+    painter->setBrush(m_style->brush());
+    painter->setPen(m_style->pen());
 }
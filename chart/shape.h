@@ -17,11 +17,15 @@
 #endif
 
 #include "chart/connection.h" //因为要用到ConnectionPoint里的枚举
+#include "chart/shapestyle.h"
+#include "chart/changeset.h"
+#include "chart/shapefactory.h"
 
 // 前向声明
 class ConnectionPoint;
+class GeometryStore;
 
-// 常量定义形状类型
+// 常量定义形状类型（文件格式与拖放数据中使用的类型名，与ShapeFactory::TypeId对应）
 namespace ShapeTypes {
     const QString Rectangle = "Rectangle";
     const QString Circle = "Circle";
@@ -41,21 +45,37 @@ class Shape
 public:
     static const int CONNECTION_POINT_SIZE = 8;
 
-    Shape(const QString& type, const int& basis);
+    Shape(ShapeFactory::TypeId typeId, const int& basis);
     virtual ~Shape();
+
+    // 图形从文档对象池中分配，见ObjectPool
+    static void* operator new(std::size_t size) { return ObjectPool::allocateObject(size); }
+    static void operator delete(void* object) { ObjectPool::deallocateObject(object); }
     
-    virtual void paint(QPainter* painter) = 0;
+    virtual void paint(QPainter* painter) const = 0;
     void setupPainter(QPainter* painter) const;
     
     virtual QRect getRect() const { return m_rect; }
     virtual void setRect(const QRect& rect);
-    QString type() const { return m_type; }
+    QString type() const { return ShapeFactory::typeName(m_typeId); }
+    ShapeFactory::TypeId typeId() const { return m_typeId; }
+
+    // 修订号：几何、文本或样式每次变化都会更新为新的全局修订号
+    quint64 revision() const { return m_revision; }
     
     // 显示名称，可以与类型不同
-    virtual QString displayName() const { return QObject::tr(m_type.toUtf8().constData()); }
+    virtual QString displayName() const { return QObject::tr(ShapeFactory::typeName(m_typeId).toUtf8().constData()); }
     
     virtual bool contains(const QPoint& point) const;
 
+    // 图形轮廓多边形，用于套索选择等精确命中测试
+    virtual QPolygonF outlinePolygon() const;
+
+    // 轮廓锚点相关方法：基于缓存的展平轮廓折线，参数t为沿周长的比例[0,1)
+    const QPolygonF& outlinePolyline() const;
+    QPointF pointOnOutline(qreal t) const;
+    qreal nearestOutlineParam(const QPointF& point, qreal* distance = nullptr) const;
+
     // 调整大小用
     enum HandlePosition {
         None = -1,
@@ -86,6 +106,7 @@ public:
     bool isEditing() const;
     void setEditing(bool editing);
     void drawText(QPainter* painter) const;
+    void drawText(QPainter* painter, const QString& text) const;   // 用本图形的样式与文本区域绘制指定文字
     virtual QRect textRect() const;
 
     // 连接点相关方法
@@ -93,8 +114,24 @@ public:
 
     virtual QPoint getConnectionPoint(ConnectionPoint::Position position) const;
 
-    virtual QVector<ConnectionPoint*> getConnectionPoints();
-    ConnectionPoint* hitConnectionPoint(const QPoint& point, bool isStart) const;
+    // 固定连接点（Top/Right/Bottom/Left），位置由几何实时计算，不单独分配
+    ConnectionPoint port(ConnectionPoint::Position position) const;
+    ConnectionPoint hitConnectionPoint(const QPoint& point, bool isStart) const;  // 未命中时返回无效连接点
+
+    // 与该图形相连的连线，由Connection在设置端点和析构时维护
+    // 两端都连在本图形上的连线会出现两次
+    const QVector<Connection*>& incidentConnections() const { return m_incidentConnections; }
+    void attachConnection(Connection* connection);
+    void detachConnection(Connection* connection);
+
+    // 绑定到场景的几何存储后，setRect会同步写入存储中的槽位
+    void bindGeometryStore(GeometryStore* store, int slot);
+    int geometrySlot() const { return m_geometrySlot; }
+
+    // 样式为驻留的共享对象，内容相同的图形指向同一个ShapeStyle，可直接比较指针
+    // 下面的setter会复制当前样式、修改后重新驻留，不影响共享该样式的其他图形
+    const ShapeStyleRef& style() const { return m_style; }
+    void setStyle(const ShapeStyleRef& style);
 
     // 字体相关方法
     void setFontFamily(const QString& family);
@@ -133,25 +170,27 @@ public:
     int lineStyle() const;
 
 protected:
-    QString m_type;
+    ShapeFactory::TypeId m_typeId;
     QRect m_rect;
     QString m_text;  // 存储形状中的文本
     bool m_editing;  // 标记是否处于编辑状态
-    QFont m_font;    // 存储字体
-    QColor m_fontColor;       // 存储字体颜色
-    QColor m_fillColor;       // 存储填充颜色
-    QColor m_lineColor;       // 存储线条颜色
-    Qt::Alignment m_textAlignment; // 存储文本对齐方式
-    int m_transparency;      // 存储透明度值（0-100）
-    qreal m_lineWidth;       // 存储线条粗细
-    int m_lineStyle;         // 存储线条样式
+    quint64 m_revision;
+    ShapeStyleRef m_style;   // 共享的字体、颜色、透明度、线条样式
     
     // 手柄大小常量
     static const int HANDLE_SIZE = 8;
     // 连接点大小常量
 
-    mutable QVector<ConnectionPoint*> m_connectionPoints;
-    virtual void createConnectionPoints() const;
+    QVector<Connection*> m_incidentConnections;
+
+    GeometryStore* m_geometryStore;
+    int m_geometrySlot;
+
+    // 展平轮廓缓存，m_rect变化后自动重建
+    mutable QPolygonF m_outlineCache;
+    mutable QVector<qreal> m_outlineLengths;   // 各顶点处的累计周长
+    mutable QRect m_outlineCacheRect;
+    void ensureOutlineCache() const;
 };
 
 // 矩形形状
@@ -159,10 +198,9 @@ class RectangleShape : public Shape
 {
 public:
     RectangleShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     QString displayName() const override { return QObject::tr("Rectangle"); }
     
-    static void registerShape();
 };
 
 // 圆形形状
@@ -170,11 +208,11 @@ class CircleShape : public Shape
 {
 public:
     CircleShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     
     QString displayName() const override { return QObject::tr("Circle"); }
-    static void registerShape();
 };
 
 // 五边形形状
@@ -182,13 +220,13 @@ class PentagonShape : public Shape
 {
 public:
     PentagonShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Pentagon"); }
 
     virtual QPoint getConnectionPoint(ConnectionPoint::Position position) const;
-    static void registerShape();
     
 private:
     QPolygon createPentagonPolygon() const;
@@ -199,11 +237,11 @@ class EllipseShape : public Shape
 {
 public:
     EllipseShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Ellipse"); }
-    static void registerShape();
 };
 
 // 圆角矩形形状
@@ -211,10 +249,10 @@ class RoundedRectangleShape : public Shape
 {
 public:
     RoundedRectangleShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
+    QPolygonF outlinePolygon() const override;
     
     QString displayName() const override { return QObject::tr("Rounded Rectangle"); }
-    static void registerShape();
     
 private:
     int m_radius; // 圆角半径
@@ -225,12 +263,12 @@ class DiamondShape : public Shape
 {
 public:
     DiamondShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Diamond"); }
     QPoint getConnectionPoint(ConnectionPoint::Position position) const;
-    static void registerShape();
     
 private:
     QPolygon createDiamondPolygon() const;
@@ -241,12 +279,12 @@ class HexagonShape : public Shape
 {
 public:
     HexagonShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Hexagon"); }
     QPoint getConnectionPoint(ConnectionPoint::Position position) const override;
-    static void registerShape();
     
 private:
     QPolygon createHexagonPolygon() const;
@@ -257,12 +295,12 @@ class OctagonShape : public Shape
 {
 public:
     OctagonShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Octagon"); }
     QPoint getConnectionPoint(ConnectionPoint::Position position) const override;
-    static void registerShape();
     
 private:
     QPolygon createOctagonPolygon() const;
@@ -273,22 +311,15 @@ class CloudShape : public Shape
 {
 public:
     CloudShape(const int& basis);
-    void paint(QPainter* painter) override;
+    void paint(QPainter* painter) const override;
     
     bool contains(const QPoint& point) const override;
+    QPolygonF outlinePolygon() const override;
     QString displayName() const override { return QObject::tr("Cloud"); }
     QPoint getConnectionPoint(ConnectionPoint::Position position) const override;
-    void findExtremePointsOnPath(
-        const QPainterPath& path, 
-        QPointF& outTopmost, 
-        QPointF& outBottommost, 
-        QPointF& outLeftmost, 
-        QPointF& outRightmost,
-        int numberOfSamples ) const;
-    static void registerShape();
 private:
-    QPainterPath createCloudPath();
-    QPainterPath m_cloudPath;
+    // 路径由当前矩形实时生成，不缓存在对象中：快照中的图形会在多个线程上同时绘制
+    QPainterPath createCloudPath() const;
 };
 
 #endif // SHAPE_H
@@ -1,19 +1,113 @@
 ﻿#include "chart/shapefactory.h"
 #include "chart/shape.h"
+#include "chart/symbol.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QVector>
+namespace {
+template <typename T>
+Shape* createShapeOf(const int& basis)
+{
+    return new T(basis);
+}
+struct TypeInfo
+{
+    const char* name;
+    const char* displayName;
+    Shape* (*create)(const int& basis);
+};
+const TypeInfo typeTable[ShapeFactory::TypeCount] = {
+    { "Rectangle", QT_TRANSLATE_NOOP("ShapeItem", "Rectangle"), &createShapeOf<RectangleShape> },
+    { "Circle", QT_TRANSLATE_NOOP("ShapeItem", "Circle"), &createShapeOf<CircleShape> },
+    { "Pentagon", QT_TRANSLATE_NOOP("ShapeItem", "Pentagon"), &createShapeOf<PentagonShape> },
+    { "Ellipse", QT_TRANSLATE_NOOP("ShapeItem", "Ellipse"), &createShapeOf<EllipseShape> },
+    { "RoundedRectangle", QT_TRANSLATE_NOOP("ShapeItem", "RoundedRectangle"), &createShapeOf<RoundedRectangleShape> },
+    { "Diamond", QT_TRANSLATE_NOOP("ShapeItem", "Diamond"), &createShapeOf<DiamondShape> },
+    { "Hexagon", QT_TRANSLATE_NOOP("ShapeItem", "Hexagon"), &createShapeOf<HexagonShape> },
+    { "Octagon", QT_TRANSLATE_NOOP("ShapeItem", "Octagon"), &createShapeOf<OctagonShape> },
+    { "Cloud", QT_TRANSLATE_NOOP("ShapeItem", "Cloud"), &createShapeOf<CloudShape> },
+    { "SymbolInstance", QT_TRANSLATE_NOOP("ShapeItem", "Symbol"), nullptr },
+    { "ArrowLine", QT_TRANSLATE_NOOP("ShapeItem", "ArrowLine"), nullptr }
+};
+const QVector<QString>& typeNames()
+{
+    static QVector<QString> names;
+    if (names.isEmpty()) {
+        for (int i = 0; i < ShapeFactory::TypeCount; ++i) {
+            names.append(QString::fromLatin1(typeTable[i].name));
+        }
+    }
+    return names;
+}
+}
 ShapeFactory& ShapeFactory::instance() {
     static ShapeFactory instance;
     return instance;
 }
-void ShapeFactory::registerShape(const QString& shapeType, 
-                               std::function<Shape*(const int&)> creator) {
-    m_creators[shapeType] = creator;
+Shape* ShapeFactory::createShape(TypeId typeId, const int& basis) const {
+    if (typeId < 0 || typeId >= TypeCount || !typeTable[typeId].create) {
+        return nullptr;
+    }
+    return typeTable[typeId].create(basis);
+}
+Shape* ShapeFactory::createShape(const QString& shapeType, const int& basis) const {
+    return createShape(typeId(shapeType), basis);
+}
+Shape* ShapeFactory::createCopy(const Shape* source) const {
+    if (!source) {
+        return nullptr;
+    }
+    Shape* copy;
+    if (source->typeId() == SymbolInstanceType) {
+        const SymbolInstance* instance = static_cast<const SymbolInstance*>(source);
+        SymbolInstance* instanceCopy = new SymbolInstance(instance->master());
+        instanceCopy->setTextOverrides(instance->textOverrides());
+        copy = instanceCopy;
+    } else {
+        copy = createShape(source->typeId(), source->getRect().width() / 2);
+    }
+    if (copy) {
+        copy->setRect(source->getRect());
+        copy->setText(source->text());
+        copy->setStyle(source->style());
+    }
+    return copy;
+}
+ShapeFactory::TypeId ShapeFactory::typeId(const QString& shapeType) {
+    static QHash<QString, TypeId> ids;
+    if (ids.isEmpty()) {
+        for (int i = 0; i < TypeCount; ++i) {
+            ids.insert(typeNames().at(i), static_cast<TypeId>(i));
+        }
+    }
+    return ids.value(shapeType, InvalidType);
+}
+const QString& ShapeFactory::typeName(TypeId typeId) {
+    static const QString empty;
+    if (typeId < 0 || typeId >= TypeCount) {
+        return empty;
+    }
+    return typeNames().at(typeId);
 }
-Shape* ShapeFactory::createShape(const QString& shapeType, const int& basis) {
-    if (m_creators.contains(shapeType)) {
-        return m_creators[shapeType](basis);
+const QString& ShapeFactory::displayName(TypeId typeId) {
+    static QVector<QString> names;
+    static const QString empty;
+    if (typeId < 0 || typeId >= TypeCount) {
+        return empty;
     }
-    return nullptr;
+    if (names.isEmpty()) {
+        for (int i = 0; i < TypeCount; ++i) {
+            names.append(QCoreApplication::translate("ShapeItem", typeTable[i].displayName));
+        }
+    }
+    return names.at(typeId);
 }
 QStringList ShapeFactory::availableShapes() const {
-    return m_creators.keys(); 
+    QStringList shapes;
+    for (int i = 0; i < TypeCount; ++i) {
+        if (typeTable[i].create) {
+            shapes.append(typeNames().at(i));
+        }
+    }
+    return shapes;
 }
@@ -2,24 +2,48 @@
 #define SHAPEFACTORY_H
 
 #include <QString>
-#include <QMap>
-#include <functional>
+#include <QStringList>
 
 class Shape; 
 
+// 形状类型注册表：编译期确定的静态表，按稠密整数ID直接索引
+// 字符串类型名只用于文件格式和拖放数据，与ID一一对应
 class ShapeFactory {
 public:
+    enum TypeId {
+        InvalidType = -1,
+        RectangleType = 0,
+        CircleType,
+        PentagonType,
+        EllipseType,
+        RoundedRectangleType,
+        DiamondType,
+        HexagonType,
+        OctagonType,
+        CloudType,
+        SymbolInstanceType, // 符号实例，需要母版，由SymbolInstance直接构造
+        ArrowLineType,      // 工具栏中的箭头连线，不是Shape，不能通过工厂创建
+        TypeCount
+    };
+
     static ShapeFactory& instance();
-    void registerShape(const QString& shapeType, 
-                      std::function<Shape*(const int&)> creator);
-    Shape* createShape(const QString& shapeType, const int& basis);
+
+    Shape* createShape(TypeId typeId, const int& basis) const;
+    Shape* createShape(const QString& shapeType, const int& basis) const;
+    // 复制图形的类型、位置、文字与样式（符号实例复制为引用同一母版的新实例），不复制连线
+    Shape* createCopy(const Shape* source) const;
+
+    // 类型名与ID互相转换，typeName返回驻留的字符串
+    static TypeId typeId(const QString& shapeType);
+    static const QString& typeName(TypeId typeId);
+    // 工具栏中显示的名称（已翻译，首次调用后缓存）
+    static const QString& displayName(TypeId typeId);
     
-    // 获取所有已注册的形状类型
+    // 获取所有可创建的形状类型
     QStringList availableShapes() const;
 
 private:
     ShapeFactory() {}
-    QMap<QString, std::function<Shape*(const int&)>> m_creators;
 };
 
-#endif // SHAPEFACTORY_H
\ No newline at end of file
+#endif // SHAPEFACTORY_H
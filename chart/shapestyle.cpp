@@ -0,0 +1,181 @@
+﻿#include "chart/shapestyle.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+namespace {
+struct FontKey
+{
+    QString family;
+    int pointSize;
+    bool bold;
+    bool italic;
+    bool underline;
+    bool operator==(const FontKey& other) const
+    {
+        return pointSize == other.pointSize && bold == other.bold && italic == other.italic
+            && underline == other.underline && family == other.family;
+    }
+};
+uint qHash(const FontKey& key, uint seed = 0)
+{
+    return ::qHash(key.family, seed) ^ ::qHash(key.pointSize * 8 + key.bold * 4 + key.italic * 2 + key.underline, seed);
+}
+// 线宽按0.01量化后参与比较和哈希，保证相等的样式哈希值一定相同
+int lineWidthKey(qreal width)
+{
+    return qRound(width * 100);
+}
+QMutex& styleMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+QHash<ShapeStyle, QWeakPointer<const ShapeStyle>>& styleTable()
+{
+    static QHash<ShapeStyle, QWeakPointer<const ShapeStyle>> table;
+    return table;
+}
+int& styleTablePruneSize()
+{
+    static int size = 64;
+    return size;
+}
+}
+QFont FontCache::font(const QString& family, int pointSize, bool bold, bool italic, bool underline)
+{
+    static QMutex mutex;
+    static QHash<FontKey, QFont> cache;
+    FontKey key = { family, pointSize, bold, italic, underline };
+    QMutexLocker locker(&mutex);
+    QHash<FontKey, QFont>::const_iterator it = cache.constFind(key);
+    if (it != cache.constEnd()) {
+        return it.value();
+    }
+    QFont font(family, pointSize);
+    font.setWeight(bold ? QFont::Bold : QFont::Normal);
+    font.setItalic(italic);
+    font.setUnderline(underline);
+    cache.insert(key, font);
+    return font;
+}
+ShapeStyle::ShapeStyle()
+    : m_fontFamily("寰蒋闆呴粦"),
+      m_fontSize(12),
+      m_fontBold(false),
+      m_fontItalic(false),
+      m_fontUnderline(false),
+      m_fontColor(Qt::black),
+      m_fillColor(Qt::white),
+      m_lineColor(Qt::black),
+      m_textAlignment(Qt::AlignCenter),
+      m_transparency(100),
+      m_lineWidth(1.5),
+      m_lineStyle(0)
+{
+}
+bool ShapeStyle::operator==(const ShapeStyle& other) const
+{
+    return m_fontSize == other.m_fontSize
+        && m_fontBold == other.m_fontBold
+        && m_fontItalic == other.m_fontItalic
+        && m_fontUnderline == other.m_fontUnderline
+        && m_fontColor == other.m_fontColor
+        && m_fillColor == other.m_fillColor
+        && m_lineColor == other.m_lineColor
+        && m_textAlignment == other.m_textAlignment
+        && m_transparency == other.m_transparency
+        && lineWidthKey(m_lineWidth) == lineWidthKey(other.m_lineWidth)
+        && m_lineStyle == other.m_lineStyle
+        && m_fontFamily == other.m_fontFamily;
+}
+uint qHash(const ShapeStyle& style, uint seed)
+{
+    uint h = qHash(style.fontFamily(), seed);
+    h = h * 31 + uint(style.fontSize());
+    h = h * 31 + uint(style.isFontBold()) * 4 + uint(style.isFontItalic()) * 2 + uint(style.isFontUnderline());
+    h = h * 31 + style.fontColor().rgba();
+    h = h * 31 + style.fillColor().rgba();
+    h = h * 31 + style.lineColor().rgba();
+    h = h * 31 + uint(style.textAlignment());
+    h = h * 31 + uint(style.transparency());
+    h = h * 31 + uint(lineWidthKey(style.lineWidth()));
+    h = h * 31 + uint(style.lineStyle());
+    return h;
+}
+void ShapeStyle::resolve()
+{
+    m_font = FontCache::font(m_fontFamily, m_fontSize, m_fontBold, m_fontItalic, m_fontUnderline);
+    int alpha = qRound(m_transparency * 2.55);
+    QColor fillColorWithAlpha = m_fillColor;
+    fillColorWithAlpha.setAlpha(alpha);
+    m_brush = QBrush(fillColorWithAlpha);
+    QColor lineColorWithAlpha = m_lineColor;
+    lineColorWithAlpha.setAlpha(alpha);
+    m_pen = QPen(lineColorWithAlpha);
+    m_pen.setWidthF(m_lineWidth);
+    QVector<qreal> pattern;
+    switch (m_lineStyle) {
+    case 1:
+        pattern << 3.0 << 3.0;
+        break;
+    case 2:
+        pattern << 8.0 << 3.0;
+        break;
+    case 3:
+        pattern << 7.0 << 3.0 << 2.0 << 3.0;
+        break;
+    default:
+        break;
+    }
+    if (pattern.isEmpty()) {
+        m_pen.setStyle(Qt::SolidLine);
+    } else {
+        m_pen.setDashPattern(pattern);
+    }
+    m_textColor = m_fontColor;
+    m_textColor.setAlpha(alpha);
+}
+ShapeStyleRef ShapeStyle::intern(const ShapeStyle& style)
+{
+    QMutexLocker locker(&styleMutex());
+    QHash<ShapeStyle, QWeakPointer<const ShapeStyle>>& table = styleTable();
+    QHash<ShapeStyle, QWeakPointer<const ShapeStyle>>::iterator it = table.find(style);
+    if (it != table.end()) {
+        ShapeStyleRef existing = it.value().toStrongRef();
+        if (existing) {
+            return existing;
+        }
+    }
+    if (table.size() >= styleTablePruneSize()) {
+        for (it = table.begin(); it != table.end();) {
+            if (it.value().isNull()) {
+                it = table.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        styleTablePruneSize() = qMax(64, table.size() * 2);
+    }
+    ShapeStyle* resolved = new ShapeStyle(style);
+    resolved->resolve();
+    ShapeStyleRef ref(resolved);
+    table.insert(style, ref.toWeakRef());
+    return ref;
+}
+ShapeStyleRef ShapeStyle::defaultStyle()
+{
+    static ShapeStyleRef style = intern(ShapeStyle());
+    return style;
+}
+int ShapeStyle::internedCount()
+{
+    QMutexLocker locker(&styleMutex());
+    int count = 0;
+    for (const QWeakPointer<const ShapeStyle>& ref : styleTable()) {
+        if (!ref.isNull()) {
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,91 @@
+#ifndef SHAPESTYLE_H
+#define SHAPESTYLE_H
+
+#include <QString>
+#include <QColor>
+#include <QFont>
+#include <QPen>
+#include <QBrush>
+#include <QSharedPointer>
+
+class ShapeStyle;
+typedef QSharedPointer<const ShapeStyle> ShapeStyleRef;
+
+// 进程级字体缓存：按字体描述返回解析好的QFont，避免每个图形各自查询字体数据库
+class FontCache
+{
+public:
+    static QFont font(const QString& family, int pointSize, bool bold, bool italic, bool underline);
+};
+
+// 图形样式（享元）：内容相同的样式通过intern()共享同一个不可变对象，
+// 比较两个样式只需比较指针；修改图形样式时先复制一份、修改后再重新驻留（写时复制）
+class ShapeStyle
+{
+public:
+    ShapeStyle();
+
+    static ShapeStyleRef defaultStyle();
+    static ShapeStyleRef intern(const ShapeStyle& style);
+    static int internedCount();         // 当前仍在使用的样式数量
+
+    QString fontFamily() const { return m_fontFamily; }
+    int fontSize() const { return m_fontSize; }
+    bool isFontBold() const { return m_fontBold; }
+    bool isFontItalic() const { return m_fontItalic; }
+    bool isFontUnderline() const { return m_fontUnderline; }
+    QColor fontColor() const { return m_fontColor; }
+    QColor fillColor() const { return m_fillColor; }
+    QColor lineColor() const { return m_lineColor; }
+    Qt::Alignment textAlignment() const { return m_textAlignment; }
+    int transparency() const { return m_transparency; }
+    qreal lineWidth() const { return m_lineWidth; }
+    int lineStyle() const { return m_lineStyle; }
+
+    void setFontFamily(const QString& family) { m_fontFamily = family; }
+    void setFontSize(int size) { m_fontSize = size; }
+    void setFontBold(bool bold) { m_fontBold = bold; }
+    void setFontItalic(bool italic) { m_fontItalic = italic; }
+    void setFontUnderline(bool underline) { m_fontUnderline = underline; }
+    void setFontColor(const QColor& color) { m_fontColor = color; }
+    void setFillColor(const QColor& color) { m_fillColor = color; }
+    void setLineColor(const QColor& color) { m_lineColor = color; }
+    void setTextAlignment(Qt::Alignment alignment) { m_textAlignment = alignment; }
+    void setTransparency(int transparency) { m_transparency = qBound(0, transparency, 100); }
+    void setLineWidth(qreal width) { m_lineWidth = qMax(0.0, width); }
+    void setLineStyle(int style) { m_lineStyle = qBound(0, style, 3); }
+
+    // 以下为驻留时预先计算好的绘制对象（已应用透明度）
+    const QFont& font() const { return m_font; }
+    const QPen& pen() const { return m_pen; }
+    const QBrush& brush() const { return m_brush; }
+    const QColor& textColor() const { return m_textColor; }
+
+    bool operator==(const ShapeStyle& other) const;
+    bool operator!=(const ShapeStyle& other) const { return !(*this == other); }
+
+private:
+    void resolve();
+
+    QString m_fontFamily;
+    int m_fontSize;
+    bool m_fontBold;
+    bool m_fontItalic;
+    bool m_fontUnderline;
+    QColor m_fontColor;
+    QColor m_fillColor;
+    QColor m_lineColor;
+    Qt::Alignment m_textAlignment;
+    int m_transparency;      // 透明度（0-100）
+    qreal m_lineWidth;
+    int m_lineStyle;
+
+    QFont m_font;
+    QPen m_pen;
+    QBrush m_brush;
+    QColor m_textColor;
+};
+
+uint qHash(const ShapeStyle& style, uint seed = 0);
+
+#endif // SHAPESTYLE_H
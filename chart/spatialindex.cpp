@@ -0,0 +1,48 @@
+﻿#include "chart/spatialindex.h"
+#include "chart/shape.h"
+#include "chart/connection.h"
+SpatialIndex::SpatialIndex(int cellSize)
+    : m_shapeGrid(cellSize), m_connectionGrid(cellSize)
+{
+}
+void SpatialIndex::clear()
+{
+    m_shapeGrid.clear();
+    m_connectionGrid.clear();
+}
+void SpatialIndex::insertShape(ObjectId id, const Shape* shape)
+{
+    m_shapeGrid.insert(id, shape->getRect());
+}
+void SpatialIndex::removeShape(ObjectId id)
+{
+    m_shapeGrid.remove(id);
+}
+void SpatialIndex::updateShape(ObjectId id, const Shape* shape)
+{
+    m_shapeGrid.update(id, shape->getRect());
+}
+void SpatialIndex::insertConnection(ObjectId id, const Connection* connection)
+{
+    m_connectionGrid.insert(id, connectionBounds(connection));
+}
+void SpatialIndex::removeConnection(ObjectId id)
+{
+    m_connectionGrid.remove(id);
+}
+void SpatialIndex::updateConnection(ObjectId id, const Connection* connection)
+{
+    m_connectionGrid.update(id, connectionBounds(connection));
+}
+QVector<SpatialIndex::ObjectId> SpatialIndex::queryShapes(const QRect& rect) const
+{
+    return m_shapeGrid.query(rect);
+}
+QVector<SpatialIndex::ObjectId> SpatialIndex::queryConnections(const QRect& rect) const
+{
+    return m_connectionGrid.query(rect);
+}
+QRect SpatialIndex::connectionBounds(const Connection* connection)
+{
+    return QRect(connection->getStartPosition(), connection->getEndPosition()).normalized();
+}
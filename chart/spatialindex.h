@@ -0,0 +1,186 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QRect>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <algorithm>
+
+class Shape;
+class Connection;
+
+// 均匀网格空间索引：按外接矩形把对象分桶，查询时只检查与查询矩形重叠的网格
+template <typename T>
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(int cellSize = 128) : m_cellSize(qMax(1, cellSize)), m_nextOrder(0) {}
+
+    void clear()
+    {
+        m_cells.clear();
+        m_entries.clear();
+        m_nextOrder = 0;
+    }
+
+    void insert(T item, const QRect& bounds)
+    {
+        if (m_entries.contains(item)) {
+            update(item, bounds);
+            return;
+        }
+        Entry entry;
+        entry.bounds = bounds.normalized();
+        entry.order = m_nextOrder++;
+        m_entries.insert(item, entry);
+        addToCells(item, entry.bounds);
+    }
+
+    void remove(T item)
+    {
+        if (!m_entries.contains(item)) {
+            return;
+        }
+        removeFromCells(item, m_entries.value(item).bounds);
+        m_entries.remove(item);
+    }
+
+    // 更新外接矩形，保留原插入顺序
+    void update(T item, const QRect& bounds)
+    {
+        if (!m_entries.contains(item)) {
+            insert(item, bounds);
+            return;
+        }
+        Entry& entry = m_entries[item];
+        QRect normalized = bounds.normalized();
+        if (entry.bounds == normalized) {
+            return;
+        }
+        removeFromCells(item, entry.bounds);
+        entry.bounds = normalized;
+        addToCells(item, normalized);
+    }
+
+    // 返回外接矩形与rect相交的对象，按插入顺序排列
+    QVector<T> query(const QRect& rect) const
+    {
+        QVector<QPair<int, T>> hits;
+        QSet<T> seen;
+        QRect area = rect.normalized();
+        int left = cellCoord(area.left());
+        int right = cellCoord(area.right());
+        int top = cellCoord(area.top());
+        int bottom = cellCoord(area.bottom());
+        for (int cy = top; cy <= bottom; ++cy) {
+            for (int cx = left; cx <= right; ++cx) {
+                typename QHash<quint64, QVector<T>>::const_iterator it = m_cells.constFind(cellKey(cx, cy));
+                if (it == m_cells.constEnd()) {
+                    continue;
+                }
+                for (T item : it.value()) {
+                    if (seen.contains(item)) {
+                        continue;
+                    }
+                    seen.insert(item);
+                    const Entry& entry = m_entries.find(item).value();
+                    if (entry.bounds.intersects(area)) {
+                        hits.append(qMakePair(entry.order, item));
+                    }
+                }
+            }
+        }
+        std::sort(hits.begin(), hits.end(), [](const QPair<int, T>& a, const QPair<int, T>& b) {
+            return a.first < b.first;
+        });
+        QVector<T> result;
+        result.reserve(hits.size());
+        for (const QPair<int, T>& hit : hits) {
+            result.append(hit.second);
+        }
+        return result;
+    }
+
+    int size() const { return m_entries.size(); }
+
+private:
+    struct Entry {
+        QRect bounds;
+        int order;
+    };
+
+    int cellCoord(int value) const
+    {
+        return value >= 0 ? value / m_cellSize : -((-value - 1) / m_cellSize) - 1;
+    }
+
+    static quint64 cellKey(int cx, int cy)
+    {
+        return (quint64(quint32(cx)) << 32) | quint64(quint32(cy));
+    }
+
+    void addToCells(T item, const QRect& bounds)
+    {
+        for (int cy = cellCoord(bounds.top()); cy <= cellCoord(bounds.bottom()); ++cy) {
+            for (int cx = cellCoord(bounds.left()); cx <= cellCoord(bounds.right()); ++cx) {
+                m_cells[cellKey(cx, cy)].append(item);
+            }
+        }
+    }
+
+    void removeFromCells(T item, const QRect& bounds)
+    {
+        for (int cy = cellCoord(bounds.top()); cy <= cellCoord(bounds.bottom()); ++cy) {
+            for (int cx = cellCoord(bounds.left()); cx <= cellCoord(bounds.right()); ++cx) {
+                quint64 key = cellKey(cx, cy);
+                typename QHash<quint64, QVector<T>>::iterator it = m_cells.find(key);
+                if (it == m_cells.end()) {
+                    continue;
+                }
+                it.value().removeOne(item);
+                if (it.value().isEmpty()) {
+                    m_cells.erase(it);
+                }
+            }
+        }
+    }
+
+    int m_cellSize;                            // 网格边长
+    int m_nextOrder;                           // 下一个插入序号
+    QHash<quint64, QVector<T>> m_cells;        // 网格 -> 对象列表
+    QHash<T, Entry> m_entries;                 // 对象 -> 外接矩形与插入序号
+};
+
+// 画布上图形与连线的空间索引，按场景对象ID登记
+// 由场景的增删改信号增量维护，查询前不需要重建
+class SpatialIndex
+{
+public:
+    typedef quint64 ObjectId;
+
+    explicit SpatialIndex(int cellSize = 128);
+
+    void clear();
+
+    // 已登记的对象按当前外接矩形更新，保留原登记顺序
+    void insertShape(ObjectId id, const Shape* shape);
+    void removeShape(ObjectId id);
+    void updateShape(ObjectId id, const Shape* shape);
+
+    void insertConnection(ObjectId id, const Connection* connection);
+    void removeConnection(ObjectId id);
+    void updateConnection(ObjectId id, const Connection* connection);
+
+    // 外接矩形与rect相交的候选对象ID，按登记顺序排列
+    QVector<ObjectId> queryShapes(const QRect& rect) const;
+    QVector<ObjectId> queryConnections(const QRect& rect) const;
+
+    static QRect connectionBounds(const Connection* connection);
+
+private:
+    SpatialGrid<ObjectId> m_shapeGrid;
+    SpatialGrid<ObjectId> m_connectionGrid;
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,172 @@
+﻿#include "chart/symbol.h"
+#include "chart/connection.h"
+#include "chart/shapefactory.h"
+#include "chart/objectpool.h"
+#include <QPainter>
+#include <QSet>
+namespace {
+ConnectionPoint mapEndpoint(const ConnectionPoint& point, const QHash<const Shape*, Shape*>& copies, const QPoint& origin)
+{
+    Shape* owner = copies.value(point.getOwner(), nullptr);
+    if (!owner) {
+        return ConnectionPoint(point.getPosition() - origin);
+    }
+    if (point.getPositionType() == ConnectionPoint::Outline) {
+        return ConnectionPoint(owner, point.getOutlineParam());
+    }
+    return ConnectionPoint(owner, point.getPositionType());
+}
+}
+Symbol::Symbol(const QString& name, const QSize& size)
+    : m_name(name), m_size(size), m_pictureValid(false)
+{
+}
+Symbol::~Symbol()
+{
+    qDeleteAll(m_connections);
+    qDeleteAll(m_shapes);
+}
+SymbolRef Symbol::fromShapes(const QString& name, const QVector<Shape*>& shapes,
+                             const QVector<Connection*>& connections, QPoint* origin)
+{
+    QSet<const Shape*> members;
+    QRect bounds;
+    for (Shape* shape : shapes) {
+        members.insert(shape);
+        bounds = bounds.united(shape->getRect());
+    }
+    QVector<Connection*> inner;
+    for (Connection* connection : connections) {
+        const ConnectionPoint& start = connection->getStartPoint();
+        const ConnectionPoint& end = connection->getEndPoint();
+        if (!start.isValid() || !end.isValid()) {
+            continue;
+        }
+        if ((start.getOwner() && !members.contains(start.getOwner())) ||
+            (end.getOwner() && !members.contains(end.getOwner()))) {
+            continue;
+        }
+        inner.append(connection);
+        bounds = bounds.united(QRect(connection->getStartPosition(), connection->getEndPosition()).normalized());
+    }
+    if (origin) {
+        *origin = bounds.topLeft();
+    }
+    // 母版可能比所在的场景存活更久，不从场景的对象池分配
+    ObjectPool::Scope heapScope(nullptr);
+    SymbolRef symbol(new Symbol(name, bounds.size()));
+    QHash<const Shape*, Shape*> copies;
+    for (Shape* shape : shapes) {
+        Shape* copy = ShapeFactory::instance().createCopy(shape);
+        if (!copy) {
+            continue;
+        }
+        copy->setRect(shape->getRect().translated(-bounds.topLeft()));
+        symbol->addShape(copy, shape->text());
+        copies.insert(shape, copy);
+    }
+    for (Connection* connection : inner) {
+        Connection* copy;
+        if (dynamic_cast<ArrowLine*>(connection)) {
+            copy = new ArrowLine(QPoint(), QPoint());
+        } else {
+            copy = new Connection();
+        }
+        copy->setStartPoint(mapEndpoint(connection->getStartPoint(), copies, bounds.topLeft()));
+        copy->setEndPoint(mapEndpoint(connection->getEndPoint(), copies, bounds.topLeft()));
+        symbol->addConnection(copy);
+    }
+    return symbol;
+}
+void Symbol::addShape(Shape* shape, const QString& text)
+{
+    shape->setText(QString());
+    m_shapes.append(shape);
+    m_texts.append(text);
+    m_pictureValid = false;
+}
+void Symbol::addConnection(Connection* connection)
+{
+    m_connections.append(connection);
+    m_pictureValid = false;
+}
+const QPicture& Symbol::picture() const
+{
+    if (!m_pictureValid) {
+        QPicture picture;
+        QPainter painter(&picture);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        for (Shape* shape : m_shapes) {
+            shape->paint(&painter);
+        }
+        for (Connection* connection : m_connections) {
+            connection->paint(&painter);
+        }
+        painter.end();
+        m_picture = picture;
+        m_pictureValid = true;
+    }
+    return m_picture;
+}
+void Symbol::paintTexts(QPainter* painter, const QHash<int, QString>& overrides) const
+{
+    for (int i = 0; i < m_shapes.size(); ++i) {
+        QHash<int, QString>::const_iterator it = overrides.constFind(i);
+        m_shapes[i]->drawText(painter, it != overrides.constEnd() ? it.value() : m_texts[i]);
+    }
+}
+SymbolInstance::SymbolInstance(const SymbolRef& master)
+    : Shape(ShapeFactory::SymbolInstanceType, 0), m_master(master)
+{
+    m_rect = QRect(QPoint(0, 0), master ? master->size() : QSize(100, 100));
+}
+QString SymbolInstance::displayName() const
+{
+    return m_master ? m_master->name() : ShapeFactory::displayName(ShapeFactory::SymbolInstanceType);
+}
+QTransform SymbolInstance::transform() const
+{
+    QTransform transform;
+    transform.translate(m_rect.x(), m_rect.y());
+    if (m_master && !m_master->size().isEmpty()) {
+        transform.scale(qreal(m_rect.width()) / m_master->size().width(),
+                        qreal(m_rect.height()) / m_master->size().height());
+    }
+    return transform;
+}
+void SymbolInstance::paint(QPainter* painter) const
+{
+    if (m_master) {
+        painter->save();
+        painter->setTransform(transform(), true);
+        painter->drawPicture(0, 0, m_master->picture());
+        painter->restore();
+    }
+    paintTexts(painter);
+}
+void SymbolInstance::paintTexts(QPainter* painter) const
+{
+    if (m_master) {
+        painter->save();
+        painter->setTransform(transform(), true);
+        m_master->paintTexts(painter, m_textOverrides);
+        painter->restore();
+    }
+    drawText(painter);
+}
+void SymbolInstance::setTextOverride(int index, const QString& text)
+{
+    m_textOverrides.insert(index, text);
+    m_revision = Revision::next();
+}
+void SymbolInstance::clearTextOverride(int index)
+{
+    if (m_textOverrides.remove(index) > 0) {
+        m_revision = Revision::next();
+    }
+}
+void SymbolInstance::setTextOverrides(const QHash<int, QString>& overrides)
+{
+    m_textOverrides = overrides;
+    m_revision = Revision::next();
+}
@@ -0,0 +1,78 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <QPicture>
+#include <QSharedPointer>
+#include <QHash>
+#include <QTransform>
+#include "chart/shape.h"
+
+class Symbol;
+typedef QSharedPointer<Symbol> SymbolRef;
+
+// 符号母版：一组可复用的图形与连线，坐标以母版左上角为原点
+// 所有实例共享同一个母版；母版的绘制结果（不含文字）缓存为QPicture，实例绘制时直接回放
+class Symbol
+{
+public:
+    Symbol(const QString& name, const QSize& size);
+    ~Symbol();
+
+    // 由场景中的图形生成母版：深拷贝这些图形，以及端点都落在这些图形上（或为自由端点）的连线
+    // origin返回母版原点在场景中的位置
+    static SymbolRef fromShapes(const QString& name, const QVector<Shape*>& shapes,
+                                const QVector<Connection*>& connections, QPoint* origin = nullptr);
+
+    QString name() const { return m_name; }
+    QSize size() const { return m_size; }
+
+    // 母版接管所有权；文字单独保存，实例可以按图形下标覆盖
+    void addShape(Shape* shape, const QString& text);
+    void addConnection(Connection* connection);
+    const QVector<Shape*>& shapes() const { return m_shapes; }
+    const QVector<Connection*>& connections() const { return m_connections; }
+    QString text(int index) const { return m_texts.value(index); }
+
+    // 缓存的绘制记录，不含文字
+    const QPicture& picture() const;
+    // 绘制母版中的文字，overrides中有的下标使用覆盖文字
+    void paintTexts(QPainter* painter, const QHash<int, QString>& overrides) const;
+
+private:
+    Symbol(const Symbol&);
+    Symbol& operator=(const Symbol&);
+
+    QString m_name;
+    QSize m_size;
+    QVector<Shape*> m_shapes;
+    QVector<QString> m_texts;
+    QVector<Connection*> m_connections;
+    mutable QPicture m_picture;
+    mutable bool m_pictureValid;
+};
+
+// 符号实例：只保存母版引用、实例矩形和文字覆盖，绘制时把母版缩放到实例矩形中
+class SymbolInstance : public Shape
+{
+public:
+    explicit SymbolInstance(const SymbolRef& master);
+    void paint(QPainter* painter) const override;
+    QString displayName() const override;
+
+    const SymbolRef& master() const { return m_master; }
+    QTransform transform() const;   // 母版坐标到场景坐标的变换
+
+    void setTextOverride(int index, const QString& text);
+    void clearTextOverride(int index);
+    void setTextOverrides(const QHash<int, QString>& overrides);
+    const QHash<int, QString>& textOverrides() const { return m_textOverrides; }
+
+    // 只绘制文字（母版文字或覆盖文字，以及实例自身的文字），导出SVG时与<use>配合
+    void paintTexts(QPainter* painter) const;
+
+private:
+    SymbolRef m_master;
+    QHash<int, QString> m_textOverrides;
+};
+
+#endif // SYMBOL_H
@@ -0,0 +1,180 @@
+﻿#include "chart/undostack.h"
+UndoMacro::~UndoMacro()
+{
+    qDeleteAll(m_children);
+}
+void UndoMacro::undo()
+{
+    for (int i = m_children.size() - 1; i >= 0; --i) {
+        m_children[i]->undo();
+    }
+}
+void UndoMacro::redo()
+{
+    for (UndoCommand* child : m_children) {
+        child->redo();
+    }
+}
+qint64 UndoMacro::byteCost() const
+{
+    qint64 cost = UndoCommand::byteCost() + m_children.capacity() * sizeof(UndoCommand*);
+    for (const UndoCommand* child : m_children) {
+        cost += child->byteCost();
+    }
+    return cost;
+}
+UndoStack::UndoStack(QObject* parent)
+    : QObject(parent),
+      m_index(0),
+      m_mergeOpen(false),
+      m_memoryLimit(16 * 1024 * 1024),
+      m_memoryUsage(0)
+{
+}
+UndoStack::~UndoStack()
+{
+    qDeleteAll(m_macros);
+    qDeleteAll(m_commands);
+}
+void UndoStack::push(UndoCommand* command)
+{
+    if (!command) {
+        return;
+    }
+    command->redo();
+    if (!m_macros.isEmpty()) {
+        m_macros.last()->append(command);
+        return;
+    }
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    discardRedo();
+    if (m_mergeOpen && m_index > 0 && command->id() != -1) {
+        UndoCommand* top = m_commands[m_index - 1];
+        if (top->id() == command->id() && top->mergeWith(command)) {
+            delete command;
+            qint64 cost = top->byteCost();
+            m_memoryUsage += cost - m_costs[m_index - 1];
+            m_costs[m_index - 1] = cost;
+            return;
+        }
+    }
+    m_commands.append(command);
+    m_costs.append(command->byteCost());
+    m_memoryUsage += m_costs.last();
+    m_index = m_commands.size();
+    m_mergeOpen = true;
+    enforceLimit();
+    emitState(couldUndo, couldRedo);
+}
+void UndoStack::beginMacro(const QString& text)
+{
+    m_macros.append(new UndoMacro(text));
+}
+void UndoStack::endMacro()
+{
+    if (m_macros.isEmpty()) {
+        return;
+    }
+    UndoMacro* macro = m_macros.takeLast();
+    if (macro->isEmpty()) {
+        delete macro;
+        return;
+    }
+    if (!m_macros.isEmpty()) {
+        m_macros.last()->append(macro);
+        return;
+    }
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    discardRedo();
+    m_commands.append(macro);
+    m_costs.append(macro->byteCost());
+    m_memoryUsage += m_costs.last();
+    m_index = m_commands.size();
+    m_mergeOpen = false;
+    enforceLimit();
+    emitState(couldUndo, couldRedo);
+}
+void UndoStack::cancelMacro()
+{
+    if (m_macros.isEmpty()) {
+        return;
+    }
+    UndoMacro* macro = m_macros.takeLast();
+    macro->undo();
+    delete macro;
+}
+void UndoStack::undo()
+{
+    if (!canUndo()) {
+        return;
+    }
+    bool couldRedo = canRedo();
+    --m_index;
+    m_commands[m_index]->undo();
+    qint64 cost = m_commands[m_index]->byteCost();
+    m_memoryUsage += cost - m_costs[m_index];
+    m_costs[m_index] = cost;
+    m_mergeOpen = false;
+    emitState(true, couldRedo);
+}
+void UndoStack::redo()
+{
+    if (!canRedo()) {
+        return;
+    }
+    bool couldUndo = canUndo();
+    m_commands[m_index]->redo();
+    qint64 cost = m_commands[m_index]->byteCost();
+    m_memoryUsage += cost - m_costs[m_index];
+    m_costs[m_index] = cost;
+    ++m_index;
+    m_mergeOpen = false;
+    emitState(couldUndo, true);
+}
+void UndoStack::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimit = qMax<qint64>(0, bytes);
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    enforceLimit();
+    emitState(couldUndo, couldRedo);
+}
+void UndoStack::clear()
+{
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    qDeleteAll(m_commands);
+    m_commands.clear();
+    m_costs.clear();
+    m_index = 0;
+    m_memoryUsage = 0;
+    m_mergeOpen = false;
+    emitState(couldUndo, couldRedo);
+}
+void UndoStack::discardRedo()
+{
+    while (m_commands.size() > m_index) {
+        m_memoryUsage -= m_costs.takeLast();
+        delete m_commands.takeLast();
+    }
+}
+void UndoStack::enforceLimit()
+{
+    while (m_memoryUsage > m_memoryLimit && m_index > 1) {
+        m_memoryUsage -= m_costs.takeFirst();
+        delete m_commands.takeFirst();
+        --m_index;
+    }
+}
+void UndoStack::emitState(bool couldUndo, bool couldRedo)
+{
+    emit indexChanged(m_index);
+    if (couldUndo != canUndo()) {
+        emit canUndoChanged(canUndo());
+    }
+    if (couldRedo != canRedo()) {
+        emit canRedoChanged(canRedo());
+    }
+}
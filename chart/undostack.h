@@ -0,0 +1,106 @@
+#ifndef UNDOSTACK_H
+#define UNDOSTACK_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// 可撤销命令：只保存状态差量（移动前后的矩形、新旧样式引用等），不保存场景快照
+// redo()必须是幂等的：命令入栈时会执行一次redo()，而很多命令是在修改已经发生后才记录的
+class UndoCommand
+{
+public:
+    explicit UndoCommand(const QString& text = QString()) : m_text(text) {}
+    virtual ~UndoCommand() {}
+
+    virtual void undo() = 0;
+    virtual void redo() = 0;
+
+    // id相同且mergeWith返回true时，新命令合并进栈顶命令，用于把连续的拖动更新合成一条
+    virtual int id() const { return -1; }
+    virtual bool mergeWith(const UndoCommand* other) { Q_UNUSED(other); return false; }
+
+    // 命令当前占用的字节数（含其持有的对象），随undo/redo状态变化
+    virtual qint64 byteCost() const { return sizeof(*this) + m_text.capacity() * sizeof(QChar); }
+
+    QString text() const { return m_text; }
+
+private:
+    QString m_text;
+};
+
+// 复合命令：按顺序redo、逆序undo其中的子命令
+class UndoMacro : public UndoCommand
+{
+public:
+    explicit UndoMacro(const QString& text) : UndoCommand(text) {}
+    ~UndoMacro();
+
+    void undo() override;
+    void redo() override;
+    qint64 byteCost() const override;
+
+    void append(UndoCommand* command) { m_children.append(command); }
+    bool isEmpty() const { return m_children.isEmpty(); }
+
+private:
+    QVector<UndoCommand*> m_children;
+};
+
+// 撤销栈：按字节数限制内存，超出上限时从最旧的命令开始丢弃
+class UndoStack : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UndoStack(QObject* parent = nullptr);
+    ~UndoStack();
+
+    // 执行command->redo()后入栈，栈接管所有权；当前位置之上的可重做命令被丢弃
+    void push(UndoCommand* command);
+    // 结束当前的合并窗口，之后入栈的命令不再与栈顶合并（例如一次拖动结束时）
+    void closeMerge() { m_mergeOpen = false; }
+
+    // begin/end之间入栈的命令组成一条复合命令；cancelMacro撤销已执行的子命令并丢弃
+    void beginMacro(const QString& text);
+    void endMacro();
+    void cancelMacro();
+
+    bool canUndo() const { return m_macros.isEmpty() && m_index > 0; }
+    bool canRedo() const { return m_macros.isEmpty() && m_index < m_commands.size(); }
+    QString undoText() const { return canUndo() ? m_commands[m_index - 1]->text() : QString(); }
+    QString redoText() const { return canRedo() ? m_commands[m_index]->text() : QString(); }
+    int count() const { return m_commands.size(); }
+    int index() const { return m_index; }
+
+    // 内存上限（字节），默认16MB；至少保留最新的一条命令
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const { return m_memoryLimit; }
+    qint64 memoryUsage() const { return m_memoryUsage; }
+
+    void clear();
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    void indexChanged(int index);
+    void canUndoChanged(bool canUndo);
+    void canRedoChanged(bool canRedo);
+
+private:
+    void discardRedo();
+    void enforceLimit();
+    void emitState(bool couldUndo, bool couldRedo);
+
+    QVector<UndoCommand*> m_commands;
+    QVector<UndoMacro*> m_macros;
+    QVector<qint64> m_costs;        // 与m_commands对应，入栈和undo/redo时刷新
+    int m_index;
+    bool m_mergeOpen;
+    qint64 m_memoryLimit;
+    qint64 m_memoryUsage;
+};
+
+#endif // UNDOSTACK_H
@@ -8,16 +8,22 @@
 #include <algorithm>  
 #include <QFontMetrics>
 #include <QTextCharFormat>
+#include <QtConcurrent>
+#include <QFutureInterface>
 #include <QTimer>
-#include <QSvgGenerator>
-#include <QDomDocument>
-#include <QFile>
-#include <QSvgRenderer>
+#include <QInputDialog>
 #include <QDebug> 
 #include "chart/shapefactory.h"
+#include "chart/symbol.h"
 #include "chart/customtextedit.h"
 #include "chart/shape.h"
 #include "chart/connection.h"
+#include "chart/geometry.h"
+#include "chart/placementgrid.h"
+#include "chart/sceneio.h"
+#include "chart/scenejournal.h"
+#include "chart/chunkeddocument.h"
+#include "chart/scenecommands.h"
 
 
 
@@ -40,9 +46,9 @@ DrawingArea::DrawingArea(QWidget *parent)
       m_copiedShapes(),
       m_copiedShapesPositions(),
       m_movingConnectionPoint(false),
-      m_activeConnectionPoint(nullptr),
-      m_backgroundColor(Qt::white),
-      m_drawingAreaSize(Default_WIDTH, Default_HEIGHT),
+      m_activeEndpointIsStart(false),
+      m_scene(new SceneModel(this)),
+      m_undoStack(new UndoStack(this)),
       m_showGrid(true),
       m_gridColor(QColor(220, 220, 220)),
       m_gridSize(15),
@@ -52,12 +58,16 @@ DrawingArea::DrawingArea(QWidget *parent)
       m_multyShapesStartPos(),
       m_isMultiRectSelecting(false),
       m_multiSelectionStart(),
-      m_multiSelectionRect()
+      m_multiSelectionRect(),
+      m_isCrossingSelection(false),
+      m_isLassoSelecting(false),
+      m_lassoPolygon(),
+      m_alignmentGuidesReady(false),
+      m_autoPlacement(true),
+      m_chunkedDocument(nullptr)
 {
     setAcceptDrops(true);
     setMouseTracking(true);
-    m_backgroundColor = Qt::white;
-    m_drawingAreaSize = QSize(Default_WIDTH, Default_HEIGHT); 
     m_showGrid = true;
     m_gridColor = QColor(220, 220, 220);
     m_gridSize = 15;
@@ -66,7 +76,47 @@ DrawingArea::DrawingArea(QWidget *parent)
     setFocusPolicy(Qt::StrongFocus);
     createTextEditor();
     createContextMenus();
-    setMinimumSize(m_drawingAreaSize.width() * 3, m_drawingAreaSize.height() * 3);
+    connect(m_scene, &SceneModel::sceneCleared, this, [this]() {
+        m_selectedShape = nullptr;
+        m_hoveredShape = nullptr;
+        m_selectedConnection = nullptr;
+        m_multiSelectedShapes.clear();
+        m_multySelectedConnections.clear();
+        m_spatialIndex.clear();
+    });
+    // 空间索引随场景变化增量维护；图形移动后其上的连线端点也随之移动
+    connect(m_scene, &SceneModel::shapeAdded, this, [this](SceneModel::ObjectId id) {
+        m_spatialIndex.insertShape(id, m_scene->shapeById(id));
+    });
+    connect(m_scene, &SceneModel::shapeRemoved, this, [this](SceneModel::ObjectId id) {
+        m_spatialIndex.removeShape(id);
+    });
+    connect(m_scene, &SceneModel::shapeChanged, this, [this](SceneModel::ObjectId id) {
+        Shape* shape = m_scene->shapeById(id);
+        if (!shape) {
+            return;
+        }
+        m_spatialIndex.updateShape(id, shape);
+        for (Connection* connection : shape->incidentConnections()) {
+            SceneModel::ObjectId connectionId = m_scene->idOf(connection);
+            if (connectionId != SceneModel::InvalidId) {
+                m_spatialIndex.updateConnection(connectionId, connection);
+            }
+        }
+    });
+    connect(m_scene, &SceneModel::connectionAdded, this, [this](SceneModel::ObjectId id) {
+        m_spatialIndex.insertConnection(id, m_scene->connectionById(id));
+    });
+    connect(m_scene, &SceneModel::connectionRemoved, this, [this](SceneModel::ObjectId id) {
+        m_spatialIndex.removeConnection(id);
+    });
+    connect(m_scene, &SceneModel::connectionChanged, this, [this](SceneModel::ObjectId id) {
+        m_spatialIndex.updateConnection(id, m_scene->connectionById(id));
+    });
+    connect(m_scene, &SceneModel::pageChanged, this, [this]() {
+        update();
+    });
+    setMinimumSize(m_scene->pageSize().width() * 3, m_scene->pageSize().height() * 3);
     QTimer::singleShot(0, this, [this]() {
         setScale(m_scale);
     });
@@ -76,12 +126,7 @@ DrawingArea::DrawingArea(QWidget *parent)
 }
 DrawingArea::~DrawingArea()
 {
-    for (Shape* shape : m_shapes) {
-        delete shape;
-    }
-    for (Connection* connection : m_connections) {
-        delete connection;
-    }
+    delete m_undoStack;
     if (m_currentConnection) {
         delete m_currentConnection;
     }
@@ -113,22 +158,22 @@ void DrawingArea::paintEvent(QPaintEvent *event)
     painter.fillRect(rect(), QColor(230, 230, 230));
     painter.save();
     QRectF drawingRect(
-        (width() - m_drawingAreaSize.width() * m_scale) / 2,
-        (height() - m_drawingAreaSize.height() * m_scale) / 2,
-        m_drawingAreaSize.width() * m_scale,
-        m_drawingAreaSize.height() * m_scale
+        (width() - m_scene->pageSize().width() * m_scale) / 2,
+        (height() - m_scene->pageSize().height() * m_scale) / 2,
+        m_scene->pageSize().width() * m_scale,
+        m_scene->pageSize().height() * m_scale
     );
     painter.translate(drawingRect.topLeft());
     painter.scale(m_scale, m_scale);
     painter.translate(-m_viewOffset);
-    QRectF bgRect(0, 0, m_drawingAreaSize.width(), m_drawingAreaSize.height());
-    painter.fillRect(bgRect, m_backgroundColor);
+    QRectF bgRect(0, 0, m_scene->pageSize().width(), m_scene->pageSize().height());
+    painter.fillRect(bgRect, m_scene->backgroundColor());
     if (m_showGrid) {
         painter.setClipRect(bgRect);
         drawGrid(&painter);
         painter.setClipping(false);
     }
-    for (Shape *shape : m_shapes) {
+    for (Shape *shape : m_scene->shapes()) {
         shape->paint(&painter);
         if(m_hoveredShape==shape){
             shape->drawConnectionPoints(&painter);
@@ -159,7 +204,7 @@ void DrawingArea::paintEvent(QPaintEvent *event)
             painter.setRenderHint(QPainter::Antialiasing, true);
         }
     }
-    for (Connection *connection : m_connections) {
+    for (Connection *connection : m_scene->connections()) {
         if (m_movingConnectionPoint && connection == m_selectedConnection) {
             drawConnectionPreview(&painter, connection);
         } else {
@@ -169,10 +214,25 @@ void DrawingArea::paintEvent(QPaintEvent *event)
     if (m_currentConnection) {
         m_currentConnection->paint(&painter);
     }
+    if (m_dragging) {
+        drawAlignmentGuides(&painter);
+    }
     painter.restore();
     if (m_isMultiRectSelecting) {
         drawMultiSelectionRect(&painter);
     }
+    if (m_isLassoSelecting) {
+        drawLassoPolygon(&painter);
+    }
+    // 可见范围变化后在下一次事件循环中调整驻留块，不在绘制过程中修改场景
+    if (m_chunkedDocument && m_chunkedDocument->isOpen()) {
+        QRect visible = visibleRegion().boundingRect();
+        QRect sceneRect = QRect(mapToScene(visible.topLeft()), mapToScene(visible.bottomRight())).normalized();
+        if (sceneRect != m_chunkViewport) {
+            m_chunkViewport = sceneRect;
+            QMetaObject::invokeMethod(this, "updateResidentChunks", Qt::QueuedConnection);
+        }
+    }
 }
 void DrawingArea::dragEnterEvent(QDragEnterEvent *event)
 {
@@ -188,10 +248,11 @@ void DrawingArea::dragMoveEvent(QDragMoveEvent *event)
 }
 void DrawingArea::dropEvent(QDropEvent *event)
 {
+    ObjectPool::Scope poolScope(m_scene->pool());
     if (event->mimeData()->hasText()) {
-        QString type = event->mimeData()->text();
+        ShapeFactory::TypeId type = ShapeFactory::typeId(event->mimeData()->text());
         QPoint scenePos = mapToScene(event->pos());
-        if (type == ShapeTypes::ArrowLine) {
+        if (type == ShapeFactory::ArrowLineType) {
             QPoint center = scenePos;
             QPoint startPoint = center - QPoint(40, 0);
             QPoint endPoint = center + QPoint(40, 0);
@@ -205,9 +266,11 @@ void DrawingArea::dropEvent(QDropEvent *event)
         if (newShape) {
             QRect shapeRect = newShape->getRect();
             shapeRect.moveCenter(scenePos);
+            shapeRect.translate(findPlacementOffset(shapeRect));
             newShape->setRect(shapeRect);
             m_selectedShape = newShape; 
-            m_shapes.append(newShape);
+            m_scene->addShape(newShape);
+            m_undoStack->push(new AddObjectsCommand(m_scene, QVector<Shape*>() << newShape, QVector<Connection*>(), tr("Add Shape")));
             emit shapesCountChanged(getShapesCount());        
             emit shapeSelectionChanged(true);
             update();
@@ -225,14 +288,18 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
         updateRectMultiSelection(event->pos());
         return;
     }
+    if (m_isLassoSelecting) {
+        updateLassoSelection(event->pos());
+        return;
+    }
     if (m_currentConnection) {
         m_temporaryEndPoint = scenePos;
         m_currentConnection->setTemporaryEndPoint(scenePos);
         bool isOverShape = false;
-        for (int i = m_shapes.size() - 1; i >= 0; --i) {
-            ConnectionPoint* cp = m_shapes[i]->hitConnectionPoint(scenePos, false);
-            if(cp || m_shapes[i]->contains(scenePos)) {
-                m_hoveredShape = m_shapes[i];
+        for (int i = m_scene->shapes().size() - 1; i >= 0; --i) {
+            ConnectionPoint cp = m_scene->shapes()[i]->hitConnectionPoint(scenePos, false);
+            if(cp.isValid() || m_scene->shapes()[i]->contains(scenePos) || isNearShapeOutline(m_scene->shapes()[i], scenePos)) {
+                m_hoveredShape = m_scene->shapes()[i];
                 setCursor(Qt::ArrowCursor); 
                 isOverShape = true;
                 break;
@@ -244,26 +311,29 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
         update();
         return;
     }
-    if (m_movingConnectionPoint && m_activeConnectionPoint) {
+    if (m_movingConnectionPoint && m_selectedConnection) {
         m_connectionDragPoint = scenePos;
         bool isOverShape = false;
-        for (int i = m_shapes.size() - 1; i >= 0; --i) {
-            ConnectionPoint* cp = m_shapes[i]->hitConnectionPoint(scenePos, false);
-            if (cp) {
-                m_hoveredShape = m_shapes[i];
+        for (int i = m_scene->shapes().size() - 1; i >= 0; --i) {
+            ConnectionPoint cp = m_scene->shapes()[i]->hitConnectionPoint(scenePos, false);
+            if (cp.isValid()) {
+                m_hoveredShape = m_scene->shapes()[i];
                 setCursor(Qt::CrossCursor);
                 isOverShape = true;
                 break;
-            } else if (m_shapes[i]->contains(scenePos)) {
-                m_hoveredShape = m_shapes[i];
+            } else if (m_scene->shapes()[i]->contains(scenePos) || isNearShapeOutline(m_scene->shapes()[i], scenePos)) {
+                m_hoveredShape = m_scene->shapes()[i];
                 setCursor(Qt::ArrowCursor);
                 isOverShape = true;
                 break;
             }
         }
         if (!isOverShape) {
-            if (m_activeConnectionPoint->getOwner() == nullptr) {
-                m_activeConnectionPoint->setPosition(scenePos);
+            if (m_selectedConnection->getEndpoint(m_activeEndpointIsStart).getOwner() == nullptr) {
+                ConnectionPoint startBefore = m_selectedConnection->getStartPoint();
+                ConnectionPoint endBefore = m_selectedConnection->getEndPoint();
+                m_selectedConnection->setEndpoint(m_activeEndpointIsStart, ConnectionPoint(scenePos));
+                m_undoStack->push(new EndpointCommand(m_scene, m_selectedConnection, startBefore, endBefore, tr("Move Endpoint")));
             }
             m_hoveredShape = nullptr;
         }
@@ -273,7 +343,9 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
     if (m_resizing && m_selectedShape) {
         QPoint delta = event->pos() - m_dragStart;
         QPoint sceneDelta = mapToScene(delta) - mapToScene(QPoint(0, 0));
+        QRect before = m_selectedShape->getRect();
         m_selectedShape->resize(m_activeHandle, sceneDelta);
+        recordGeometry(m_selectedShape, before, tr("Resize"));
         m_dragStart = event->pos();
         emit shapeSizeChanged(m_selectedShape->getRect().size());
         update();
@@ -285,48 +357,63 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
         if (m_selectedShape) {
             QRect newRect = m_selectedShape->getRect();
             newRect.moveTo(m_shapeStart + sceneDelta);
+            newRect.translate(snapMovingRect(newRect, event->modifiers()));
+            QRect before = m_selectedShape->getRect();
             m_selectedShape->setRect(newRect);
+            recordGeometry(m_selectedShape, before, tr("Move"));
             emit shapePositionChanged(newRect.topLeft());
         } else if (!m_multiSelectedShapes.isEmpty()) {
+            QRect groupRect;
+            for (int i = 0; i < m_multiSelectedShapes.size(); ++i) {
+                QRect movedRect(m_multyShapesStartPos[i] + sceneDelta, m_multiSelectedShapes[i]->getRect().size());
+                groupRect = groupRect.isNull() ? movedRect : groupRect.united(movedRect);
+            }
+            QPoint snapOffset = snapMovingRect(groupRect, event->modifiers());
+            QVector<QRect> before;
             for (int i = 0; i < m_multiSelectedShapes.size(); ++i) {
                 QRect newRect = m_multiSelectedShapes[i]->getRect();
-                newRect.moveTo(m_multyShapesStartPos[i] + sceneDelta);
+                before.append(newRect);
+                newRect.moveTo(m_multyShapesStartPos[i] + sceneDelta + snapOffset);
                 m_multiSelectedShapes[i]->setRect(newRect);
             }
+            m_undoStack->push(new GeometryCommand(m_scene, m_multiSelectedShapes, before, tr("Move")));
         } else if (m_selectedConnection) {
             Connection* conn = m_selectedConnection;
-            if (conn->getStartPoint() && conn->getEndPoint() && 
-                conn->getStartPoint()->getOwner() == nullptr && 
-                conn->getEndPoint()->getOwner() == nullptr) {
+            if (conn->isComplete() && 
+                conn->getStartPoint().getOwner() == nullptr && 
+                conn->getEndPoint().getOwner() == nullptr) {
                 QPoint startPos = conn->getStartPosition();
                 QPoint endPos = conn->getEndPosition();
                 QPoint newStartPos = startPos + sceneDelta;
                 QPoint newEndPos = endPos + sceneDelta;
-                conn->getStartPoint()->setPosition(newStartPos);
-                conn->getEndPoint()->setPosition(newEndPos);
+                ConnectionPoint startBefore = conn->getStartPoint();
+                ConnectionPoint endBefore = conn->getEndPoint();
+                conn->setStartPoint(ConnectionPoint(newStartPos));
+                conn->setEndPoint(ConnectionPoint(newEndPos));
+                m_undoStack->push(new EndpointCommand(m_scene, conn, startBefore, endBefore, tr("Move Connection")));
                 m_dragStart = event->pos();
             }
         }
         update();
         return;
     }
-    for (int i = m_connections.size() - 1; i >= 0; --i) {
-        Connection* conn = m_connections[i];
+    for (int i = m_scene->connections().size() - 1; i >= 0; --i) {
+        Connection* conn = m_scene->connections()[i];
         if (conn->isNearStartPoint(scenePos, 20)) {
-            if (conn->getStartPoint()->getOwner() == nullptr || 
-                !conn->getStartPoint()->getOwner()->hitConnectionPoint(scenePos, true)) {
+            if (conn->getStartPoint().getOwner() == nullptr || 
+                !conn->getStartPoint().getOwner()->hitConnectionPoint(scenePos, true).isValid()) {
                 setCursor(Qt::SizeAllCursor); 
                 return;
             }
         } else if (conn->isNearEndPoint(scenePos, 20)) {
-            if (conn->getEndPoint()->getOwner() == nullptr || 
-                !conn->getEndPoint()->getOwner()->hitConnectionPoint(scenePos, true)) {
+            if (conn->getEndPoint().getOwner() == nullptr || 
+                !conn->getEndPoint().getOwner()->hitConnectionPoint(scenePos, true).isValid()) {
                 setCursor(Qt::SizeAllCursor); 
                 return;
             }
         } else if (conn->contains(scenePos)) {
-            if (conn->getStartPoint()->getOwner() == nullptr && 
-                conn->getEndPoint()->getOwner() == nullptr) {
+            if (conn->getStartPoint().getOwner() == nullptr && 
+                conn->getEndPoint().getOwner() == nullptr) {
                 setCursor(Qt::SizeAllCursor);
             } else {
                 setCursor(Qt::PointingHandCursor);
@@ -357,18 +444,18 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
             }
         }   
     }
-    for (int i = m_shapes.size() - 1; i >= 0; --i) {
-        ConnectionPoint* cp = m_shapes[i]->hitConnectionPoint(scenePos, true);
-        if (cp && m_selectedShape != m_shapes[i]) {
+    for (int i = m_scene->shapes().size() - 1; i >= 0; --i) {
+        ConnectionPoint cp = m_scene->shapes()[i]->hitConnectionPoint(scenePos, true);
+        if (cp.isValid() && m_selectedShape != m_scene->shapes()[i]) {
             setCursor(Utils::getCrossCursor()); 
-            if (m_hoveredShape != m_shapes[i]) {
-                m_hoveredShape = m_shapes[i];
+            if (m_hoveredShape != m_scene->shapes()[i]) {
+                m_hoveredShape = m_scene->shapes()[i];
                 update(); 
             }
             return;
-        } else if (m_shapes[i]->contains(scenePos)) {
-            if (m_hoveredShape != m_shapes[i]) {
-                m_hoveredShape = m_shapes[i];
+        } else if (m_scene->shapes()[i]->contains(scenePos)) {
+            if (m_hoveredShape != m_scene->shapes()[i]) {
+                m_hoveredShape = m_scene->shapes()[i];
                 update(); 
             }
             setCursor(Qt::SizeAllCursor); 
@@ -384,6 +471,7 @@ void DrawingArea::mouseMoveEvent(QMouseEvent *event)
 void DrawingArea::mousePressEvent(QMouseEvent *event)
 {
     setFocus();
+    m_undoStack->closeMerge();
     if (m_textEditor && m_textEditor->isVisible()) {
         QRect editorRect = m_textEditor->geometry();
         if (!editorRect.contains(event->pos())) {
@@ -394,31 +482,31 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton) {
         QPoint scenePos = mapToScene(event->pos());
         if (m_hoveredShape && m_hoveredShape!=m_selectedShape){
-            ConnectionPoint* cp = m_hoveredShape->hitConnectionPoint(scenePos, true);
-            if (cp) {
+            ConnectionPoint cp = m_hoveredShape->hitConnectionPoint(scenePos, true);
+            if (cp.isValid()) {
                 startConnection(cp);
                 return;
             }
         }
-        for (int i = m_connections.size() - 1; i >= 0; --i) {
-            Connection* conn = m_connections[i];
+        for (int i = m_scene->connections().size() - 1; i >= 0; --i) {
+            Connection* conn = m_scene->connections()[i];
             if (conn->isNearStartPoint(scenePos, 20)) {
-                if (conn->getStartPoint()->getOwner() == nullptr || 
-                    !conn->getStartPoint()->getOwner()->hitConnectionPoint(scenePos, true)) {
+                if (conn->getStartPoint().getOwner() == nullptr || 
+                    !conn->getStartPoint().getOwner()->hitConnectionPoint(scenePos, true).isValid()) {
                     selectConnection(conn);
                     m_movingConnectionPoint = true;
-                    m_activeConnectionPoint = conn->getStartPoint();
+                    m_activeEndpointIsStart = true;
                     m_dragStart = event->pos();
                     m_connectionDragPoint = scenePos;
                     setCursor(Qt::SizeAllCursor); 
                     return;
                 }
             } else if (conn->isNearEndPoint(scenePos, 20)) {
-                if (conn->getEndPoint()->getOwner() == nullptr || 
-                    !conn->getEndPoint()->getOwner()->hitConnectionPoint(scenePos, true)) {
+                if (conn->getEndPoint().getOwner() == nullptr || 
+                    !conn->getEndPoint().getOwner()->hitConnectionPoint(scenePos, true).isValid()) {
                     selectConnection(conn);
                     m_movingConnectionPoint = true;
-                    m_activeConnectionPoint = conn->getEndPoint();
+                    m_activeEndpointIsStart = false;
                     m_dragStart = event->pos();
                     m_connectionDragPoint = scenePos;
                     setCursor(Qt::SizeAllCursor); 
@@ -426,8 +514,8 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                 }
             } else if (conn->contains(scenePos)) {
                 bool isIndependentLine = 
-                    (conn->getStartPoint()->getOwner() == nullptr && 
-                     conn->getEndPoint()->getOwner() == nullptr);
+                    (conn->getStartPoint().getOwner() == nullptr && 
+                     conn->getEndPoint().getOwner() == nullptr);
                 selectConnection(conn);
                 if (isIndependentLine) {
                     m_dragging = true;
@@ -464,14 +552,14 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
             }
         }
         Shape* oldSelectedShape = m_selectedShape;  
-        for (int i = m_shapes.size() - 1; i >= 0; --i) {
-            if (m_shapes[i]->contains(scenePos)) {
+        for (int i = m_scene->shapes().size() - 1; i >= 0; --i) {
+            if (m_scene->shapes()[i]->contains(scenePos)) {
                 if (event->modifiers() & Qt::ControlModifier) {
-                    if (m_shapes[i] == m_selectedShape) {
+                    if (m_scene->shapes()[i] == m_selectedShape) {
                         m_selectedShape = nullptr;
                         emit shapeSelectionChanged(false);
-                    } else if (m_multiSelectedShapes.contains(m_shapes[i])) {
-                        m_multiSelectedShapes.removeOne(m_shapes[i]);
+                    } else if (m_multiSelectedShapes.contains(m_scene->shapes()[i])) {
+                        m_multiSelectedShapes.removeOne(m_scene->shapes()[i]);
                         if (m_multiSelectedShapes.isEmpty()) {
                             emit multiSelectionChanged(false);
                         }
@@ -480,7 +568,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                             m_multiSelectedShapes.append(m_selectedShape);
                             m_selectedShape = nullptr;
                         }
-                        m_multiSelectedShapes.append(m_shapes[i]);
+                        m_multiSelectedShapes.append(m_scene->shapes()[i]);
                         emit multiSelectionChanged(true);
                     }
                 } else {
@@ -492,7 +580,7 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                         m_multiSelectedShapes.clear();
                         emit multiSelectionChanged(false);
                     }
-                    m_selectedShape = m_shapes[i];
+                    m_selectedShape = m_scene->shapes()[i];
                     m_dragging = true;
                     m_dragStart = event->pos();
                     m_shapeStart = m_selectedShape->getRect().topLeft();
@@ -520,7 +608,11 @@ void DrawingArea::mousePressEvent(QMouseEvent *event)
                 m_selectedConnection = nullptr;
                 update();
             }
-            startRectMultiSelection(event->pos());
+            if (event->modifiers() & Qt::AltModifier) {
+                startLassoSelection(event->pos());
+            } else {
+                startRectMultiSelection(event->pos());
+            }
         }
     }
 }
@@ -532,59 +624,56 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
 		update();
         return;
     }
+    if (m_isLassoSelecting && event->button() == Qt::LeftButton) {
+        finishLassoSelection();
+        update();
+        return;
+    }
     if (m_currentConnection && event->button() == Qt::LeftButton) {
         if (m_hoveredShape) {
-            ConnectionPoint* nearestPoint = findNearestConnectionPoint(m_hoveredShape, scenePos);
-            if (nearestPoint && (!m_currentConnection->getStartPoint()->equalTo(nearestPoint))) {
+            ConnectionPoint nearestPoint = resolveAnchorPoint(m_hoveredShape, scenePos);
+            if (nearestPoint.isValid() && (!m_currentConnection->getStartPoint().equalTo(nearestPoint))) {
                 completeConnection(nearestPoint);
             } else {
-                completeConnection(nullptr);
+                completeConnection();
             }
         } else {
-            completeConnection(nullptr);
+            completeConnection();
         }
         update();
         emit shapeSelectionChanged(m_selectedShape != nullptr);
         return;
     }
     if (m_movingConnectionPoint && event->button() == Qt::LeftButton) {
+        ConnectionPoint startBefore = m_selectedConnection->getStartPoint();
+        ConnectionPoint endBefore = m_selectedConnection->getEndPoint();
         if (m_hoveredShape) {
-            ConnectionPoint* nearestPoint = findNearestConnectionPoint(m_hoveredShape, scenePos);
-            if (nearestPoint) {
+            ConnectionPoint nearestPoint = resolveAnchorPoint(m_hoveredShape, scenePos);
+            if (nearestPoint.isValid()) {
                 Connection* conn = m_selectedConnection;
-                bool isStartPoint = (m_activeConnectionPoint == conn->getStartPoint());
-                if (isStartPoint) {
-                    if (conn->getEndPoint() && !nearestPoint->equalTo(conn->getEndPoint())) {
-                        conn->setStartPoint(nearestPoint);
-                    }
-                } else {
-                    if (conn->getStartPoint() && !nearestPoint->equalTo(conn->getStartPoint())) {
-                        conn->setEndPoint(nearestPoint);
-                    }
+                const ConnectionPoint& otherPoint = conn->getEndpoint(!m_activeEndpointIsStart);
+                if (otherPoint.isValid() && !nearestPoint.equalTo(otherPoint)) {
+                    conn->setEndpoint(m_activeEndpointIsStart, nearestPoint);
                 }
-            } else {
             }
         } else {
-            ConnectionPoint* freePoint = new ConnectionPoint(scenePos);
-            Connection* conn = m_selectedConnection;
-            bool isStartPoint = (m_activeConnectionPoint == conn->getStartPoint());
-            if (isStartPoint) {
-                conn->setStartPoint(freePoint);
-            } else {
-                conn->setEndPoint(freePoint);
-            }
+            m_selectedConnection->setEndpoint(m_activeEndpointIsStart, ConnectionPoint(scenePos));
         }
+        m_scene->notifyConnectionChanged(m_selectedConnection);
+        m_undoStack->push(new EndpointCommand(m_scene, m_selectedConnection, startBefore, endBefore, tr("Move Endpoint")));
+        m_undoStack->closeMerge();
         m_movingConnectionPoint = false;
-        m_activeConnectionPoint = nullptr;
         setCursor(Qt::ArrowCursor);
         update();
         return;
     }
     if (m_resizing && event->button() == Qt::LeftButton) {
         m_resizing = false;
+        m_undoStack->closeMerge();
         m_activeHandle = Shape::None;
         setCursor(Qt::ArrowCursor);
         if (m_selectedShape) {
+            m_scene->notifyShapeChanged(m_selectedShape);
             emit shapeSizeChanged(m_selectedShape->getRect().size());
         }
         update();
@@ -592,9 +681,15 @@ void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
     }
     if (m_dragging && event->button() == Qt::LeftButton) {
         m_dragging = false;
+        m_undoStack->closeMerge();
         m_multyShapesStartPos.clear(); 
+        resetAlignmentGuides();
         setCursor(Qt::ArrowCursor);
+        for (Shape* shape : m_multiSelectedShapes) {
+            m_scene->notifyShapeChanged(shape);
+        }
         if (m_selectedShape) {
+            m_scene->notifyShapeChanged(m_selectedShape);
             emit shapePositionChanged(m_selectedShape->getRect().topLeft());
         }
         update();
@@ -607,13 +702,7 @@ void DrawingArea::mouseDoubleClickEvent(QMouseEvent *event)
         return;  
     }
     QPoint scenePos = mapToScene(event->pos());
-    Shape* clickedShape = nullptr;
-    for (int i = m_shapes.size() - 1; i >= 0; i--) {
-        if (m_shapes.at(i)->contains(scenePos)) {
-            clickedShape = m_shapes.at(i);
-            break;
-        }
-    }
+    Shape* clickedShape = m_scene->geometry().topmostAt(scenePos);
     if (clickedShape) {
         m_selectedShape = clickedShape;
         startTextEditing();
@@ -657,7 +746,12 @@ if (!m_selectedShape) return;
 void DrawingArea::finishTextEditing()
 {
     if (!m_textEditor || !m_selectedShape) return;
+    QString before = m_selectedShape->text();
     m_selectedShape->setText(m_textEditor->toPlainText());
+    if (m_selectedShape->text() != before) {
+        m_undoStack->push(new TextCommand(m_scene, m_selectedShape, before, tr("Edit Text")));
+    }
+    m_scene->notifyShapeChanged(m_selectedShape);
     m_selectedShape->setEditing(false);
     m_textEditor->hide();
     update();
@@ -689,35 +783,37 @@ bool DrawingArea::eventFilter(QObject *watched, QEvent *event)
     }
     return QWidget::eventFilter(watched, event);
 }
-void DrawingArea::startConnection(ConnectionPoint* startPoint)
+void DrawingArea::startConnection(const ConnectionPoint& startPoint)
 {
+    ObjectPool::Scope poolScope(m_scene->pool());
     m_currentConnection = new Connection(startPoint);
     QPoint cursorPos = mapToScene(mapFromGlobal(QCursor::pos()));
     m_temporaryEndPoint = cursorPos;
     m_currentConnection->setTemporaryEndPoint(cursorPos);
     update();
 }
-void DrawingArea::completeConnection(ConnectionPoint* endPoint)
+void DrawingArea::completeConnection(const ConnectionPoint& endPoint)
 {
     if (!m_currentConnection) {
         return;
     }
-    if (endPoint) {
+    if (endPoint.isValid()) {
         m_currentConnection->setEndPoint(endPoint);
     } else {
         QPoint tempPos = m_currentConnection->getEndPosition(); 
         double distance = std::sqrt(std::pow(tempPos.x() - m_currentConnection->getStartPosition().x(), 2) + 
                                   std::pow(tempPos.y() - m_currentConnection->getStartPosition().y(), 2));
         if (distance < 20.0) {
+            delete m_currentConnection;
             m_currentConnection = nullptr;
             m_selectedShape = nullptr;
             return;
         }
-        ConnectionPoint* freeEndPoint = new ConnectionPoint(tempPos);
-        m_currentConnection->setEndPoint(freeEndPoint);
+        m_currentConnection->setEndPoint(ConnectionPoint(tempPos));
     }
     if (m_currentConnection->isComplete()) {
-        m_connections.append(m_currentConnection);
+        m_scene->addConnection(m_currentConnection);
+        m_undoStack->push(new AddObjectsCommand(m_scene, QVector<Shape*>(), QVector<Connection*>() << m_currentConnection, tr("Add Connection")));
         selectConnection(m_currentConnection); 
         emit shapesCountChanged(getShapesCount());
     } else {
@@ -740,19 +836,16 @@ void DrawingArea::cancelConnection()
         m_hoveredShape = nullptr;
     }
 }
-ConnectionPoint* DrawingArea::findNearestConnectionPoint(Shape* shape, const QPoint& pos)
+ConnectionPoint DrawingArea::findNearestConnectionPoint(Shape* shape, const QPoint& pos)
 {
     if (!shape) {
-        return nullptr;
+        return ConnectionPoint();
     }
-    QVector<ConnectionPoint*> points = shape->getConnectionPoints();
-    if (points.isEmpty()) {
-        return nullptr;
-    }
-    ConnectionPoint* nearest = nullptr;
+    ConnectionPoint nearest;
     double minDistance = std::numeric_limits<double>::max();
-    for (ConnectionPoint* point : points) {
-        QPoint pointPos = point->getPosition();
+    for (int position = ConnectionPoint::Top; position <= ConnectionPoint::Left; ++position) {
+        ConnectionPoint point = shape->port(static_cast<ConnectionPoint::Position>(position));
+        QPoint pointPos = point.getPosition();
         double distance = std::sqrt(std::pow(pointPos.x() - pos.x(), 2) + 
                                   std::pow(pointPos.y() - pos.y(), 2));
         if (distance < minDistance) {
@@ -762,6 +855,31 @@ ConnectionPoint* DrawingArea::findNearestConnectionPoint(Shape* shape, const QPo
     }
     return nearest;
 }
+ConnectionPoint DrawingArea::resolveAnchorPoint(Shape* shape, const QPoint& pos)
+{
+    if (!shape) {
+        return ConnectionPoint();
+    }
+    if (!shape->hitConnectionPoint(pos, false).isValid()) {
+        qreal distance = 0.0;
+        qreal param = shape->nearestOutlineParam(QPointF(pos), &distance);
+        if (distance <= Shape::CONNECTION_POINT_SIZE) {
+            return ConnectionPoint(shape, param);
+        }
+    }
+    return findNearestConnectionPoint(shape, pos);
+}
+bool DrawingArea::isNearShapeOutline(Shape* shape, const QPoint& pos) const
+{
+    QRect bounds = shape->getRect().adjusted(-Shape::CONNECTION_POINT_SIZE, -Shape::CONNECTION_POINT_SIZE,
+                                             Shape::CONNECTION_POINT_SIZE, Shape::CONNECTION_POINT_SIZE);
+    if (!bounds.contains(pos)) {
+        return false;
+    }
+    qreal distance = 0.0;
+    shape->nearestOutlineParam(QPointF(pos), &distance);
+    return distance <= Shape::CONNECTION_POINT_SIZE;
+}
 void DrawingArea::contextMenuEvent(QContextMenuEvent *event)
 {
     QPoint pos = event->pos();
@@ -786,7 +904,7 @@ void DrawingArea::contextMenuEvent(QContextMenuEvent *event)
         return;
     }
     else if (m_selectedConnection) {
-        for (Connection* connection : m_connections) {
+        for (Connection* connection : m_scene->connections()) {
             if (connection == m_selectedConnection && connection->contains(scenePos)) {
                 showShapeContextMenu(pos);
                 event->accept();
@@ -822,6 +940,9 @@ void DrawingArea::createContextMenus()
     connect(bringForwardAction, &QAction::triggered, this, &DrawingArea::moveShapeUp);
     QAction *sendBackwardAction = layerMenu->addAction(tr("Move Shape Down"));
     connect(sendBackwardAction, &QAction::triggered, this, &DrawingArea::moveShapeDown);
+    m_shapeContextMenu->addSeparator();
+    QAction *createSymbolAction = m_shapeContextMenu->addAction(tr("Create Symbol"));
+    connect(createSymbolAction, &QAction::triggered, this, &DrawingArea::createSymbolFromSelection);
     m_canvasContextMenu = new QMenu(this);
     QAction *pasteAction = m_canvasContextMenu->addAction(tr("Paste"));
     pasteAction->setShortcut(QKeySequence::Paste);  
@@ -830,6 +951,24 @@ void DrawingArea::createContextMenus()
     selectAllAction->setShortcut(QKeySequence::SelectAll);  
     selectAllAction->setShortcutVisibleInContextMenu(true);  
     connect(selectAllAction, &QAction::triggered, this, &DrawingArea::selectAllShapes);
+    m_canvasContextMenu->addSeparator();
+    QAction *autoPlacementAction = m_canvasContextMenu->addAction(tr("Auto Placement"));
+    autoPlacementAction->setCheckable(true);
+    autoPlacementAction->setChecked(m_autoPlacement);
+    connect(autoPlacementAction, &QAction::toggled, this, &DrawingArea::setAutoPlacement);
+    m_canvasContextMenu->addSeparator();
+    QAction *undoAction = m_canvasContextMenu->addAction(tr("Undo"));
+    undoAction->setShortcut(QKeySequence::Undo);
+    undoAction->setShortcutVisibleInContextMenu(true);
+    connect(undoAction, &QAction::triggered, this, &DrawingArea::undo);
+    QAction *redoAction = m_canvasContextMenu->addAction(tr("Redo"));
+    redoAction->setShortcut(QKeySequence::Redo);
+    redoAction->setShortcutVisibleInContextMenu(true);
+    connect(redoAction, &QAction::triggered, this, &DrawingArea::redo);
+    m_canvasContextMenu->addSeparator();
+    QAction *saveRevisionAction = m_canvasContextMenu->addAction(tr("Save Revision..."));
+    connect(saveRevisionAction, &QAction::triggered, this, &DrawingArea::saveRevision);
+    m_canvasContextMenu->addMenu(tr("Restore Revision"));
 }
 void DrawingArea::showShapeContextMenu(const QPoint &pos)
 {
@@ -839,22 +978,20 @@ void DrawingArea::showShapeContextMenu(const QPoint &pos)
     QAction *copyAction = m_shapeContextMenu->actions().at(0);
     QAction *cutAction = m_shapeContextMenu->actions().at(1);
     QAction *deleteAction = m_shapeContextMenu->actions().at(2);
-    QMenu *layerMenu = m_shapeContextMenu->actions().at(4)->menu();
     disconnect(copyAction, nullptr, this, nullptr);
     disconnect(cutAction, nullptr, this, nullptr);
     disconnect(deleteAction, nullptr, this, nullptr);
+    m_shapeContextMenu->actions().at(6)->setEnabled(m_multiSelectedShapes.size() > 1);
     if (!m_multiSelectedShapes.isEmpty()) {
         connect(copyAction, &QAction::triggered, this, &DrawingArea::copyMultiSelectedShapes);
         connect(cutAction, &QAction::triggered, this, &DrawingArea::cutMultiSelectedShapes);
         connect(deleteAction, &QAction::triggered, this, [this]() {
             cutMultiSelectedShapes(); 
         });
-        layerMenu->setEnabled(false);
     } else {
         connect(copyAction, &QAction::triggered, this, &DrawingArea::copySelectedShape);
         connect(cutAction, &QAction::triggered, this, &DrawingArea::cutSelectedShape);
         connect(deleteAction, &QAction::triggered, this, &DrawingArea::deleteSelectedShape);
-        layerMenu->setEnabled(true);
     }
     m_shapeContextMenu->exec(mapToGlobal(pos));
 }
@@ -866,75 +1003,195 @@ void DrawingArea::showCanvasContextMenu(const QPoint &pos)
     QPoint canvasPos = pos;
     QAction *pasteAction = m_canvasContextMenu->actions().at(0);
     pasteAction->setEnabled(m_copiedShape != nullptr || !m_copiedShapes.isEmpty());
+    m_canvasContextMenu->actions().at(5)->setEnabled(m_undoStack->canUndo());
+    m_canvasContextMenu->actions().at(6)->setEnabled(m_undoStack->canRedo());
+    QMenu *revisionMenu = m_canvasContextMenu->actions().at(9)->menu();
+    revisionMenu->clear();
+    const RevisionStore& revisions = m_scene->revisions();
+    for (int i = revisions.revisionCount() - 1; i >= 0; --i) {
+        QAction *revisionAction = revisionMenu->addAction(QString("%1  (%2)")
+            .arg(revisions.revisionName(i))
+            .arg(revisions.revisionTime(i).toString("yyyy-MM-dd HH:mm")));
+        connect(revisionAction, &QAction::triggered, this, [this, i]() {
+            restoreRevision(i);
+        });
+    }
+    revisionMenu->menuAction()->setEnabled(!revisions.isEmpty());
     disconnect(pasteAction, nullptr, this, nullptr);
     connect(pasteAction, &QAction::triggered, this, [this, canvasPos]() {
         this->pasteShape(canvasPos);
     });
     m_canvasContextMenu->exec(mapToGlobal(pos));
 }
+void DrawingArea::recordGeometry(Shape* shape, const QRect& before, const QString& text)
+{
+    m_undoStack->push(new GeometryCommand(m_scene, QVector<Shape*>() << shape, QVector<QRect>() << before, text));
+}
+void DrawingArea::undo()
+{
+    if (m_textEditor && m_textEditor->isVisible()) {
+        cancelTextEditing();
+    }
+    clearMultySelection();
+    m_hoveredShape = nullptr;
+    m_undoStack->undo();
+    emit shapesCountChanged(getShapesCount());
+    update();
+}
+void DrawingArea::redo()
+{
+    if (m_textEditor && m_textEditor->isVisible()) {
+        cancelTextEditing();
+    }
+    clearMultySelection();
+    m_hoveredShape = nullptr;
+    m_undoStack->redo();
+    emit shapesCountChanged(getShapesCount());
+    update();
+}
+QSet<Shape*> DrawingArea::layerTargets() const
+{
+    QSet<Shape*> targets;
+    for (Shape* shape : m_multiSelectedShapes) {
+        targets.insert(shape);
+    }
+    if (m_selectedShape) {
+        targets.insert(m_selectedShape);
+    }
+    return targets;
+}
+void DrawingArea::createSymbolFromSelection()
+{
+    if (m_multiSelectedShapes.size() < 2) {
+        return;
+    }
+    QSet<Shape*> members;
+    QVector<Shape*> ordered;
+    for (Shape* shape : m_scene->shapes()) {
+        if (m_multiSelectedShapes.contains(shape)) {
+            members.insert(shape);
+            ordered.append(shape);
+        }
+    }
+    int topIndex = m_scene->indexOf(ordered.last());
+    QSet<Connection*> innerSet;
+    QVector<Connection*> inner;
+    QVector<Connection*> boundary;
+    for (Shape* shape : ordered) {
+        for (Connection* connection : shape->incidentConnections()) {
+            if (innerSet.contains(connection) || boundary.contains(connection)) {
+                continue;
+            }
+            Shape* startOwner = connection->getStartPoint().getOwner();
+            Shape* endOwner = connection->getEndPoint().getOwner();
+            if ((!startOwner || members.contains(startOwner)) && (!endOwner || members.contains(endOwner))) {
+                innerSet.insert(connection);
+                inner.append(connection);
+            } else {
+                boundary.append(connection);
+            }
+        }
+    }
+    QPoint origin;
+    SymbolRef symbol = Symbol::fromShapes(tr("Symbol %1").arg(m_scene->symbols().size() + 1), ordered, inner, &origin);
+    m_scene->addSymbol(symbol);
+    m_scene->beginChanges();
+    m_undoStack->beginMacro(tr("Create Symbol"));
+    ObjectPool::Scope poolScope(m_scene->pool());
+    SymbolInstance* instance = new SymbolInstance(symbol);
+    instance->setRect(QRect(origin, symbol->size()));
+    m_scene->insertShape(topIndex - ordered.size() + 1, instance);
+    m_undoStack->push(new AddObjectsCommand(m_scene, QVector<Shape*>() << instance, QVector<Connection*>(), tr("Create Symbol")));
+    for (Connection* connection : boundary) {
+        ConnectionPoint startBefore = connection->getStartPoint();
+        ConnectionPoint endBefore = connection->getEndPoint();
+        for (int i = 0; i < 2; ++i) {
+            bool isStart = (i == 0);
+            const ConnectionPoint& point = connection->getEndpoint(isStart);
+            if (point.getOwner() && members.contains(point.getOwner())) {
+                qreal param = instance->nearestOutlineParam(QPointF(point.getPosition()));
+                connection->setEndpoint(isStart, ConnectionPoint(instance, param));
+            }
+        }
+        m_undoStack->push(new EndpointCommand(m_scene, connection, startBefore, endBefore, tr("Create Symbol")));
+        m_scene->notifyConnectionChanged(connection);
+    }
+    m_undoStack->push(new RemoveObjectsCommand(m_scene, ordered, inner, tr("Create Symbol")));
+    m_undoStack->endMacro();
+    m_scene->endChanges();
+    clearMultySelection();
+    m_selectedShape = instance;
+    emit shapeSelectionChanged(true);
+    emit shapesCountChanged(getShapesCount());
+    update();
+}
 void DrawingArea::moveShapeUp()
 {
-    if (!m_selectedShape) {
-        qDebug() << "moveShapeUp: No selected graphics";
+    QSet<Shape*> targets = layerTargets();
+    if (targets.isEmpty()) {
         return;
     }
-    int index = m_shapes.indexOf(m_selectedShape);
-    qDebug() << "Moveshapeup: current drawing index= " << index << ", Total number of drawings= " << m_shapes.size();
-    if (index < m_shapes.size() - 1) {
-        std::swap(m_shapes[index], m_shapes[index + 1]);
-        qDebug() << "Moveshapeup: swapped location, new index=" << (index + 1);
-        update(); 
-        emit shapeSelectionChanged(true);
-    } else {
-        qDebug() << "Moveshapeup: the shape is already on the top layer";
+    QVector<Shape*> shapes;
+    QVector<int> before;
+    for (Shape* shape : targets) {
+        shapes.append(shape);
+        before.append(m_scene->indexOf(shape));
     }
+    m_scene->raiseShapes(targets);
+    m_undoStack->push(new LayerCommand(m_scene, shapes, before, tr("Move Shape Up")));
+    update();
+    emit shapeSelectionChanged(m_selectedShape != nullptr);
 }
 void DrawingArea::moveShapeDown()
 {
-    if (!m_selectedShape) {
-        qDebug() << "Moveshapedown: no selected shapes";
+    QSet<Shape*> targets = layerTargets();
+    if (targets.isEmpty()) {
         return;
     }
-    int index = m_shapes.indexOf(m_selectedShape);
-    qDebug() << "Moveshapedown: current drawing index=" << index << ", total number of drawings=" << m_shapes.size();
-    if (index > 0) {
-        std::swap(m_shapes[index], m_shapes[index - 1]);
-        qDebug() << "Moveshapedown: swapped location, new index=" << (index - 1);
-        update(); 
-        emit shapeSelectionChanged(true);
-    } else {
-        qDebug() << "Moveshapedown: the graph is already at the lowest level";
+    QVector<Shape*> shapes;
+    QVector<int> before;
+    for (Shape* shape : targets) {
+        shapes.append(shape);
+        before.append(m_scene->indexOf(shape));
     }
+    m_scene->lowerShapes(targets);
+    m_undoStack->push(new LayerCommand(m_scene, shapes, before, tr("Move Shape Down")));
+    update();
+    emit shapeSelectionChanged(m_selectedShape != nullptr);
 }
 void DrawingArea::moveShapeToTop()
 {
-    if (!m_selectedShape) {
+    QSet<Shape*> targets = layerTargets();
+    if (targets.isEmpty()) {
         return;
     }
-    int index = m_shapes.indexOf(m_selectedShape);
-    if (index >= 0 && index < m_shapes.size() - 1) {
-        Shape* shapeToMove = m_selectedShape;
-        m_shapes.removeAt(index);
-        m_shapes.append(shapeToMove);
-        update(); 
-        emit shapeSelectionChanged(true);
-    } else if (index < 0) {
-    } else {
+    QVector<Shape*> shapes;
+    QVector<int> before;
+    for (Shape* shape : targets) {
+        shapes.append(shape);
+        before.append(m_scene->indexOf(shape));
     }
+    m_scene->bringShapesToFront(targets);
+    m_undoStack->push(new LayerCommand(m_scene, shapes, before, tr("Move Shape To Top")));
+    update();
+    emit shapeSelectionChanged(m_selectedShape != nullptr);
 }
 void DrawingArea::moveShapeToBottom()
 {
-    if (!m_selectedShape) {
+    QSet<Shape*> targets = layerTargets();
+    if (targets.isEmpty()) {
         return;
     }
-    int index = m_shapes.indexOf(m_selectedShape);
-    if (index > 0) {
-        m_shapes.removeAt(index);
-        m_shapes.prepend(m_selectedShape);
-        update(); 
-        emit shapeSelectionChanged(true);
-    } else {
+    QVector<Shape*> shapes;
+    QVector<int> before;
+    for (Shape* shape : targets) {
+        shapes.append(shape);
+        before.append(m_scene->indexOf(shape));
     }
+    m_scene->sendShapesToBack(targets);
+    m_undoStack->push(new LayerCommand(m_scene, shapes, before, tr("Move Shape To Bottom")));
+    update();
+    emit shapeSelectionChanged(m_selectedShape != nullptr);
 }
 void DrawingArea::copySelectedShape()
 {
@@ -952,18 +1209,7 @@ void DrawingArea::copySelectedShape()
     }
     m_copiedShapes.clear();
     m_copiedShapesPositions.clear();
-    QString type = m_selectedShape->type();
-    int basis = m_selectedShape->getRect().width() / 2;
-    m_copiedShape = ShapeFactory::instance().createShape(type, basis);
-    if (m_copiedShape) {
-        m_copiedShape->setRect(m_selectedShape->getRect());
-        m_copiedShape->setText(m_selectedShape->text());
-        m_copiedShape->setFillColor(m_selectedShape->fillColor());
-        m_copiedShape->setLineColor(m_selectedShape->lineColor());
-        m_copiedShape->setLineWidth(m_selectedShape->lineWidth());
-        m_copiedShape->setLineStyle(m_selectedShape->lineStyle());
-        m_copiedShape->setTransparency(m_selectedShape->transparency());
-    }
+    m_copiedShape = ShapeFactory::instance().createCopy(m_selectedShape);
 }
 void DrawingArea::cutSelectedShape()
 {
@@ -975,6 +1221,7 @@ void DrawingArea::cutSelectedShape()
 }
 void DrawingArea::pasteShape(const QPoint &pos)
 {
+    ObjectPool::Scope poolScope(m_scene->pool());
     if (!m_copiedShapes.isEmpty() || !m_copiedConnections.isEmpty()) {
         m_selectedShape = nullptr;
         m_multiSelectedShapes.clear();
@@ -982,23 +1229,29 @@ void DrawingArea::pasteShape(const QPoint &pos)
         m_multySelectedConnections.clear();
         QPoint pastePos = pos.isNull() ? mapFromGlobal(QCursor::pos()) : pos;
         QPoint scenePos = mapToScene(pastePos);
+        QRect pasteBounds;
+        for (int i = 0; i < m_copiedShapes.size(); ++i) {
+            QRect rect = m_copiedShapes[i]->getRect();
+            rect.moveCenter(scenePos + m_copiedShapesPositions[i]);
+            pasteBounds = pasteBounds.united(rect);
+        }
+        for (int i = 0; i < m_copiedConnections.size(); ++i) {
+            QPoint startPos = m_copiedConnections[i]->getStartPosition();
+            QPoint endPos = m_copiedConnections[i]->getEndPosition();
+            QPoint center = scenePos + m_copiedConnectionsPositions[i];
+            QPoint halfSpan = (endPos - startPos) / 2;
+            pasteBounds = pasteBounds.united(QRect(center - halfSpan, center + halfSpan).normalized());
+        }
+        scenePos += findPlacementOffset(pasteBounds);
         for (int i = 0; i < m_copiedShapes.size(); ++i) {
             Shape* sourceShape = m_copiedShapes[i];
             QPoint relativePos = m_copiedShapesPositions[i];
-            QString type = sourceShape->type();
-            int basis = sourceShape->getRect().width() / 2;
-            Shape* newShape = ShapeFactory::instance().createShape(type, basis);
+            Shape* newShape = ShapeFactory::instance().createCopy(sourceShape);
             if (newShape) {
                 QRect rect = sourceShape->getRect();
                 rect.moveCenter(scenePos + relativePos);
                 newShape->setRect(rect);
-                newShape->setText(sourceShape->text());
-                newShape->setFillColor(sourceShape->fillColor());
-                newShape->setLineColor(sourceShape->lineColor());
-                newShape->setLineWidth(sourceShape->lineWidth());
-                newShape->setLineStyle(sourceShape->lineStyle());
-                newShape->setTransparency(sourceShape->transparency());
-                m_shapes.append(newShape);
+                m_scene->addShape(newShape);
                 m_multiSelectedShapes.append(newShape);
             }
         }
@@ -1017,11 +1270,14 @@ void DrawingArea::pasteShape(const QPoint &pos)
             int endShapeIndex = -1;
             ConnectionPoint::Position startPosition = ConnectionPoint::Free;
             ConnectionPoint::Position endPosition = ConnectionPoint::Free;
+            qreal startParam = 0.0;
+            qreal endParam = 0.0;
             for (int j = 0; j < m_copiedConnectionStartShapes.size(); ++j) {
                 if (m_copiedConnectionStartShapes[j].first == i) {
                     startShapeIndex = m_copiedConnectionStartShapes[j].second;
                     if (j >= 0 && j < m_copiedConnectionStartPoints.size()) {
                         startPosition = m_copiedConnectionStartPoints[j];
+                        startParam = m_copiedConnectionStartParams.value(j, 0.0);
                     }
                     break;
                 }
@@ -1031,48 +1287,38 @@ void DrawingArea::pasteShape(const QPoint &pos)
                     endShapeIndex = m_copiedConnectionEndShapes[j].second;
                     if (j >= 0 && j < m_copiedConnectionEndPoints.size()) {
                         endPosition = m_copiedConnectionEndPoints[j];
+                        endParam = m_copiedConnectionEndParams.value(j, 0.0);
                     }
                     break;
                 }
             }
-            ConnectionPoint* startPoint = nullptr;
-            ConnectionPoint* endPoint = nullptr;
+            ConnectionPoint startPoint(newStartPos);
+            ConnectionPoint endPoint(newEndPos);
             if (startShapeIndex >= 0 && startShapeIndex < m_multiSelectedShapes.size()) {
                 Shape* startShape = m_multiSelectedShapes[startShapeIndex];
-                QVector<ConnectionPoint*> points = startShape->getConnectionPoints();
-                for (ConnectionPoint* point : points) {
-                    if (point->getPositionType() == startPosition) {
-                        startPoint = point;
-                        break;
-                    }
+                if (startPosition == ConnectionPoint::Outline) {
+                    startPoint = ConnectionPoint(startShape, startParam);
+                } else if (startPosition != ConnectionPoint::Free) {
+                    startPoint = startShape->port(startPosition);
                 }
-            } else {
-                startPoint = new ConnectionPoint(newStartPos);
             }
             if (endShapeIndex >= 0 && endShapeIndex < m_multiSelectedShapes.size()) {
                 Shape* endShape = m_multiSelectedShapes[endShapeIndex];
-                QVector<ConnectionPoint*> points = endShape->getConnectionPoints();
-                for (ConnectionPoint* point : points) {
-                    if (point->getPositionType() == endPosition) {
-                        endPoint = point;
-                        break;
-                    }
+                if (endPosition == ConnectionPoint::Outline) {
+                    endPoint = ConnectionPoint(endShape, endParam);
+                } else if (endPosition != ConnectionPoint::Free) {
+                    endPoint = endShape->port(endPosition);
                 }
-            } else {
-                endPoint = new ConnectionPoint(newEndPos);
             }
             ArrowLine* newConnection = new ArrowLine(newStartPos, newEndPos);
-            if (startPoint) {
-                newConnection->setStartPoint(startPoint);
-            }
-            if (endPoint) {
-                newConnection->setEndPoint(endPoint);
-            }
-            m_connections.append(newConnection);
+            newConnection->setStartPoint(startPoint);
+            newConnection->setEndPoint(endPoint);
+            m_scene->addConnection(newConnection);
             m_multySelectedConnections.append(newConnection);
             newConnection->setSelected(true);
         }
         if (!m_multiSelectedShapes.isEmpty() || !m_multySelectedConnections.isEmpty()) {
+            m_undoStack->push(new AddObjectsCommand(m_scene, m_multiSelectedShapes, m_multySelectedConnections, tr("Paste")));
             emit multiSelectionChanged(true);
             emit shapesCountChanged(getShapesCount());
             update();
@@ -1080,9 +1326,7 @@ void DrawingArea::pasteShape(const QPoint &pos)
         return;
     }
     if (!m_copiedShape) return;
-    QString type = m_copiedShape->type();
-    int basis = m_copiedShape->getRect().width() / 2;
-    Shape *newShape = ShapeFactory::instance().createShape(type, basis);
+    Shape *newShape = ShapeFactory::instance().createCopy(m_copiedShape);
     if (newShape) {
         QRect rect = m_copiedShape->getRect();
         if (!pos.isNull()) {
@@ -1091,14 +1335,10 @@ void DrawingArea::pasteShape(const QPoint &pos)
         } else {
             rect.translate(20, 20);
         }
+        rect.translate(findPlacementOffset(rect));
         newShape->setRect(rect);
-        newShape->setText(m_copiedShape->text());
-        newShape->setFillColor(m_copiedShape->fillColor());
-        newShape->setLineColor(m_copiedShape->lineColor());
-        newShape->setLineWidth(m_copiedShape->lineWidth());
-        newShape->setLineStyle(m_copiedShape->lineStyle());
-        newShape->setTransparency(m_copiedShape->transparency());
-        m_shapes.append(newShape);
+        m_scene->addShape(newShape);
+        m_undoStack->push(new AddObjectsCommand(m_scene, QVector<Shape*>() << newShape, QVector<Connection*>(), tr("Paste")));
         m_multiSelectedShapes.clear();
         m_multySelectedConnections.clear();
         m_selectedConnection = nullptr;
@@ -1112,29 +1352,13 @@ void DrawingArea::pasteShape(const QPoint &pos)
 void DrawingArea::deleteSelectedShape()
 {
     if (m_selectedShape) {
-        int index = m_shapes.indexOf(m_selectedShape);
-        if (index >= 0) {
-            m_shapes.removeAt(index);
-        }
-        QVector<Connection*> connectionsToRemove;
-        for (Connection* connection : m_connections) {
-            if ((connection->getStartPoint() && connection->getStartPoint()->getOwner() == m_selectedShape) || 
-                (connection->getEndPoint() && connection->getEndPoint()->getOwner() == m_selectedShape)) {
-                connectionsToRemove.append(connection);
-            }
-        }
-        for (Connection* connection : connectionsToRemove) {
-            m_connections.removeOne(connection);
-            delete connection;
-        }
-        delete m_selectedShape;
+        m_undoStack->push(new RemoveObjectsCommand(m_scene, QVector<Shape*>() << m_selectedShape, QVector<Connection*>(), tr("Delete")));
         m_selectedShape = nullptr;
         emit shapeSelectionChanged(false);
         emit shapesCountChanged(getShapesCount());
         update();
     } else if (m_selectedConnection) {
-        m_connections.removeOne(m_selectedConnection);
-        delete m_selectedConnection;
+        m_undoStack->push(new RemoveObjectsCommand(m_scene, QVector<Shape*>(), QVector<Connection*>() << m_selectedConnection, tr("Delete")));
         m_selectedConnection = nullptr;
         emit shapesCountChanged(getShapesCount());
         update();
@@ -1143,12 +1367,12 @@ void DrawingArea::deleteSelectedShape()
 void DrawingArea::selectAllShapes()
 {
     clearMultySelection();
-    for (int i = 0; i < m_shapes.size(); ++i) {
-        m_multiSelectedShapes.append(m_shapes[i]);
+    for (int i = 0; i < m_scene->shapes().size(); ++i) {
+        m_multiSelectedShapes.append(m_scene->shapes()[i]);
     }
-    for (int i = 0; i < m_connections.size(); ++i) {
-        m_multySelectedConnections.append(m_connections[i]);
-        m_connections[i]->setSelected(true);
+    for (int i = 0; i < m_scene->connections().size(); ++i) {
+        m_multySelectedConnections.append(m_scene->connections()[i]);
+        m_scene->connections()[i]->setSelected(true);
     }
     if (!m_multiSelectedShapes.isEmpty() || !m_multySelectedConnections.isEmpty()) {
         emit multiSelectionChanged(true);
@@ -1177,6 +1401,10 @@ void DrawingArea::keyPressEvent(QKeyEvent *event)
         }
     } else if (event->matches(QKeySequence::Paste)) {
         pasteShape(mapFromGlobal(QCursor::pos()));
+    } else if (event->matches(QKeySequence::Undo)) {
+        undo();
+    } else if (event->matches(QKeySequence::Redo)) {
+        redo();
     } else if (event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace) {
         if (!m_multiSelectedShapes.isEmpty()) {
             cutMultiSelectedShapes(); 
@@ -1189,8 +1417,10 @@ void DrawingArea::keyPressEvent(QKeyEvent *event)
 }
 void DrawingArea::createArrowLine(const QPoint& startPoint, const QPoint& endPoint)
 {
+    ObjectPool::Scope poolScope(m_scene->pool());
     ArrowLine* arrowLine = new ArrowLine(startPoint, endPoint);
-    m_connections.append(arrowLine);
+    m_scene->addConnection(arrowLine);
+    m_undoStack->push(new AddObjectsCommand(m_scene, QVector<Shape*>(), QVector<Connection*>() << arrowLine, tr("Add Connection")));
     selectConnection(arrowLine);
     update();
 }
@@ -1211,7 +1441,7 @@ Shape* DrawingArea::cloneShape(const Shape* sourceShape)
     if (!sourceShape) {
         return nullptr;
     }
-    Shape* clonedShape = ShapeFactory::instance().createShape(sourceShape->type(), 55);
+    Shape* clonedShape = ShapeFactory::instance().createShape(sourceShape->typeId(), 55);
     if (!clonedShape) {
         return nullptr;
     }
@@ -1221,10 +1451,10 @@ Shape* DrawingArea::cloneShape(const Shape* sourceShape)
 }
 void DrawingArea::drawConnectionPreview(QPainter* painter, Connection* connection)
 {
-    if (!connection || !m_movingConnectionPoint || !m_activeConnectionPoint) 
+    if (!connection || !m_movingConnectionPoint) 
         return;
     QPoint startPos, endPos;
-    if (m_activeConnectionPoint == connection->getStartPoint()) {
+    if (m_activeEndpointIsStart) {
         startPos = m_connectionDragPoint;
         endPos = connection->getEndPosition();
     } else {
@@ -1236,7 +1466,7 @@ void DrawingArea::drawConnectionPreview(QPainter* painter, Connection* connectio
     if (arrowLine) {
         drawArrow = true;
     } 
-    else if (m_activeConnectionPoint == connection->getEndPoint()) {
+    else if (!m_activeEndpointIsStart) {
         drawArrow = true;
     }
     Connection::drawConnectionLine(painter, startPos, endPos, true, drawArrow);
@@ -1245,7 +1475,7 @@ void DrawingArea::drawGrid(QPainter *painter)
 {
     if (!m_showGrid) return;
     painter->save();
-    QRectF gridRect(0, 0, m_drawingAreaSize.width(), m_drawingAreaSize.height());
+    QRectF gridRect(0, 0, m_scene->pageSize().width(), m_scene->pageSize().height());
     QColor lightColor(245, 245, 245);  
     QColor darkColor(241, 241, 241);   
     for (int y = 0; y <= gridRect.height(); y += m_gridSize) {
@@ -1272,12 +1502,12 @@ void DrawingArea::drawGrid(QPainter *painter)
 }
 void DrawingArea::setBackgroundColor(const QColor &color)
 {
-    m_backgroundColor = color;
+    m_scene->setBackgroundColor(color);
     update();
 }
 void DrawingArea::setPageSize(const QSize &size)
 {
-    QSize oldSize = m_drawingAreaSize;
+    QSize oldSize = m_scene->pageSize();
     setDrawingAreaSize(size);
     update();
 }
@@ -1303,7 +1533,7 @@ void DrawingArea::setGridThickness(int thickness)
 }
 QColor DrawingArea::getBackgroundColor() const
 {
-    return m_backgroundColor;
+    return m_scene->backgroundColor();
 }
 bool DrawingArea::getShowGrid() const
 {
@@ -1351,8 +1581,8 @@ void DrawingArea::setScale(qreal scale)
         relativePos = QPointF(hRatio, vRatio);
     }
     m_scale = newScale;
-    QSize newSize(m_drawingAreaSize.width() * 3 * m_scale, 
-                 m_drawingAreaSize.height() * 3 * m_scale);
+    QSize newSize(m_scene->pageSize().width() * 3 * m_scale, 
+                 m_scene->pageSize().height() * 3 * m_scale);
     setFixedSize(newSize);  
     emit scaleChanged(m_scale);
     update();
@@ -1422,8 +1652,8 @@ QScrollBar* DrawingArea::findParentScrollBar(Qt::Orientation orientation) const
 QPoint DrawingArea::mapToScene(const QPoint& viewPoint) const
 {
     QPoint drawingAreaTopLeft(
-        (width() - m_drawingAreaSize.width() * m_scale) / 2,
-        (height() - m_drawingAreaSize.height() * m_scale) / 2
+        (width() - m_scene->pageSize().width() * m_scale) / 2,
+        (height() - m_scene->pageSize().height() * m_scale) / 2
     );
     QPoint relativePos = viewPoint - drawingAreaTopLeft;
     QPoint scaledPos(
@@ -1441,8 +1671,8 @@ QPoint DrawingArea::mapFromScene(const QPoint& scenePoint) const
         pointWithoutOffset.y() * m_scale
     );
     QPoint drawingAreaTopLeft(
-        (width() - m_drawingAreaSize.width() * m_scale) / 2,
-        (height() - m_drawingAreaSize.height() * m_scale) / 2
+        (width() - m_scene->pageSize().width() * m_scale) / 2,
+        (height() - m_scene->pageSize().height() * m_scale) / 2
     );
     QPoint viewPoint = scaledPoint + drawingAreaTopLeft;
     return viewPoint;
@@ -1450,7 +1680,9 @@ QPoint DrawingArea::mapFromScene(const QPoint& scenePoint) const
 void DrawingArea::setSelectedShapeFontFamily(const QString& family)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontFamily(family);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font")));
         QFont font = m_selectedShape->getFont();
         m_textEditor->setFont(font);
         QTextDocument *doc = m_textEditor->document();
@@ -1467,13 +1699,16 @@ void DrawingArea::setSelectedShapeFontFamily(const QString& family)
                                 .arg(transparentFillColor.alphaF())
                                 .arg(family);
         m_textEditor->setStyleSheet(styleSheet);
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeFontSize(int size)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontSize(size);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font Size")));
         QFont font = m_selectedShape->getFont();
         m_textEditor->setFont(font);
         QTextDocument *doc = m_textEditor->document();
@@ -1490,60 +1725,76 @@ void DrawingArea::setSelectedShapeFontSize(int size)
                                 .arg(transparentFillColor.alphaF())
                                 .arg(size);
         m_textEditor->setStyleSheet(styleSheet);
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeFontBold(bool bold)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontBold(bold);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font")));
         QFont font = m_selectedShape->getFont();
         m_textEditor->setFont(font);  
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeFontItalic(bool italic)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontItalic(italic);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font")));
         QFont font = m_selectedShape->getFont();
         m_textEditor->setFont(font);  
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeFontUnderline(bool underline)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontUnderline(underline);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font")));
         QFont font = m_selectedShape->getFont();
         m_textEditor->setFont(font);  
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeFontColor(const QColor& color)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFontColor(color);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Font Color")));
         m_textEditor->setTextColor(color);  
         emit fontColorChanged(color);       
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 void DrawingArea::setSelectedShapeTextAlignment(Qt::Alignment alignment)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setTextAlignment(alignment);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Alignment")));
         m_textEditor->setAlignment(alignment);  
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
     }
 }
 int DrawingArea::getShapesCount() const
 {
-    return m_shapes.size() + m_connections.size();
+    return m_scene->shapes().size() + m_scene->connections().size();
 }
 void DrawingArea::setDrawingAreaSize(const QSize &size)
 {
-    if (size == m_drawingAreaSize)
+    if (size == m_scene->pageSize())
         return;
     QScrollArea* scrollArea = nullptr;
     QWidget* parent = parentWidget();
@@ -1563,9 +1814,9 @@ void DrawingArea::setDrawingAreaSize(const QSize &size)
                        (double)vBar->value() / vBar->maximum() : 0.5;
         relativePos = QPointF(hRatio, vRatio);
     }
-    m_drawingAreaSize = size;
-    QSize newWidgetSize(m_drawingAreaSize.width() * 3 * m_scale, 
-                       m_drawingAreaSize.height() * 3 * m_scale);
+    m_scene->setPageSize(size);
+    QSize newWidgetSize(m_scene->pageSize().width() * 3 * m_scale, 
+                       m_scene->pageSize().height() * 3 * m_scale);
     setFixedSize(newWidgetSize);
     if (scrollArea) {
         scrollArea->updateGeometry();
@@ -1604,271 +1855,173 @@ void DrawingArea::centerDrawingArea()
     }
     update();
 }
-bool DrawingArea::exportToPng(const QString &filePath)
+QFuture<bool> DrawingArea::exportToPng(const QString &filePath)
 {
-    QImage image(m_drawingAreaSize, QImage::Format_ARGB32);
-    image.fill(m_backgroundColor); 
-    QPainter painter(&image);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.setRenderHint(QPainter::TextAntialiasing, true);
-    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-    Shape* tempSelectedShape = m_selectedShape;
-    Connection* tempSelectedConnection = m_selectedConnection;
-    m_selectedShape = nullptr;
-    m_selectedConnection = nullptr;
-    /*
-    if (m_showGrid) {
-        drawGrid(&painter);
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    return QtConcurrent::run([snapshot, filePath]() {
+        return SceneIO::exportToPng(*snapshot, filePath);
+    });
+}
+QFuture<bool> DrawingArea::exportToSvg(const QString &filePath)
+{
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    return QtConcurrent::run([snapshot, filePath]() {
+        return SceneIO::exportToSvg(*snapshot, filePath);
+    });
+}
+QFuture<bool> DrawingArea::exportToBinary(const QString &filePath)
+{
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    return QtConcurrent::run([snapshot, filePath]() {
+        return SceneIO::exportToBinary(*snapshot, filePath);
+    });
+}
+QFuture<bool> DrawingArea::exportToCbor(const QString &filePath)
+{
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    return QtConcurrent::run([snapshot, filePath]() {
+        return SceneIO::exportToCbor(*snapshot, filePath);
+    });
+}
+bool DrawingArea::importFromSvg(const QString &filePath, const SceneIO::ProgressCallback &progress)
+{
+    return importWith([this, filePath, progress]() {
+        return SceneIO::importFromSvg(*m_scene, filePath, progress);
+    });
+}
+bool DrawingArea::importFromBinary(const QString &filePath)
+{
+    return importWith([this, filePath]() {
+        return SceneIO::importFromBinary(*m_scene, filePath);
+    });
+}
+bool DrawingArea::importFromCbor(const QString &filePath)
+{
+    return importWith([this, filePath]() {
+        return SceneIO::importFromCbor(*m_scene, filePath);
+    });
+}
+bool DrawingArea::importWith(const std::function<bool()>& import)
+{
+    // 导入前先把现有内容移入撤销命令，SceneModel::clear()不会再销毁它们；
+    // clear()同时清空的符号库、命名修订和页面设置由DocumentCommand保存
+    DocumentCommand::State before = DocumentCommand::capture(m_scene);
+    m_undoStack->beginMacro(tr("Import"));
+    m_undoStack->push(new RemoveObjectsCommand(m_scene, m_scene->shapes(), m_scene->connections(), tr("Import")));
+    bool imported = import();
+    m_undoStack->push(new DocumentCommand(m_scene, before, tr("Import")));
+    if (!imported) {
+        m_undoStack->cancelMacro();
+        return false;
     }
-    */
-    for (Shape* shape : m_shapes) {
-        shape->paint(&painter);
+    m_undoStack->push(new AddObjectsCommand(m_scene, m_scene->shapes(), m_scene->connections(), tr("Import")));
+    m_undoStack->endMacro();
+    setScale(1.0);
+    update();
+    emit shapesCountChanged(getShapesCount());
+    emit selectionChanged();
+    return true;
+}
+void DrawingArea::saveRevision()
+{
+    bool ok = false;
+    QString name = QInputDialog::getText(this, tr("Save Revision"), tr("Revision name:"), QLineEdit::Normal,
+                                         tr("Revision %1").arg(m_scene->revisions().revisionCount() + 1), &ok);
+    if (ok && !name.trimmed().isEmpty()) {
+        m_scene->commitRevision(name.trimmed());
     }
-    for (Connection* connection : m_connections) {
-        connection->paint(&painter);
+}
+bool DrawingArea::restoreRevision(int index)
+{
+    if (m_textEditor && m_textEditor->isVisible()) {
+        cancelTextEditing();
     }
-    m_selectedShape = tempSelectedShape;
-    m_selectedConnection = tempSelectedConnection;
-    bool success = image.save(filePath, "PNG");
+    clearMultySelection();
+    m_hoveredShape = nullptr;
+    DocumentCommand::State before = DocumentCommand::capture(m_scene);
+    m_undoStack->beginMacro(tr("Restore Revision"));
+    m_undoStack->push(new RemoveObjectsCommand(m_scene, m_scene->shapes(), m_scene->connections(), tr("Restore Revision")));
+    bool restored = m_scene->revisions().checkout(index, *m_scene);
+    m_undoStack->push(new DocumentCommand(m_scene, before, tr("Restore Revision")));
+    if (!restored) {
+        m_undoStack->cancelMacro();
+        return false;
+    }
+    m_undoStack->push(new AddObjectsCommand(m_scene, m_scene->shapes(), m_scene->connections(), tr("Restore Revision")));
+    m_undoStack->endMacro();
     update();
-    return success;
-}
-bool DrawingArea::exportToSvg(const QString &filePath)
-{
-    QSvgGenerator generator;
-    generator.setFileName(filePath);
-    generator.setSize(m_drawingAreaSize);
-    generator.setViewBox(QRect(0, 0, m_drawingAreaSize.width(), m_drawingAreaSize.height()));
-    generator.setTitle(tr("flow chart"));
-    generator.setDescription(tr("SVG file generated by flowchart designer"));
-    generator.setResolution(96); 
-    QString shapesMetadata = "<flowchart:shapes xmlns:flowchart=\"http://flowchart.zeqi.com/ns\">";
-    for (int i = 0; i < m_shapes.size(); ++i) {
-        Shape* shape = m_shapes[i];
-        QRect rect = shape->getRect();
-        shapesMetadata += QString("<flowchart:shape id=\"%1\" type=\"%2\" x=\"%3\" y=\"%4\" width=\"%5\" height=\"%6\"")
-                               .arg(i)
-                               .arg(shape->type())
-                               .arg(rect.x())
-                               .arg(rect.y())
-                               .arg(rect.width())
-                               .arg(rect.height());
-        shapesMetadata += QString(" text=\"%1\"").arg(shape->text().toHtmlEscaped());
-        shapesMetadata += QString(" fontFamily=\"%1\" fontSize=\"%2\" fontBold=\"%3\" fontItalic=\"%4\" fontColor=\"%5\" fontUnderline=\"%6\"")
-                               .arg(shape->fontFamily())
-                               .arg(shape->fontSize())
-                               .arg(shape->isFontBold() ? "true" : "false")
-                               .arg(shape->isFontItalic() ? "true" : "false")
-                               .arg(shape->fontColor().name())
-                               .arg(shape->isFontUnderline() ? "true" : "false");
-        shapesMetadata += " />";
-    }
-    shapesMetadata += "<flowchart:connections>";
-    for (int i = 0; i < m_connections.size(); ++i) {
-        Connection* conn = m_connections[i];
-        QPoint startPos = conn->getStartPosition();
-        QPoint endPos = conn->getEndPosition();
-        bool isArrow = (dynamic_cast<ArrowLine*>(conn) != nullptr);
-        int startShapeIndex = -1;
-        int startConnectionPointIndex = -1;
-        int endShapeIndex = -1;
-        int endConnectionPointIndex = -1;
-        if (conn->getStartPoint() && conn->getStartPoint()->getOwner()) {
-            Shape* startShape = conn->getStartPoint()->getOwner();
-            startShapeIndex = m_shapes.indexOf(startShape);
-            ConnectionPoint* startCP = conn->getStartPoint();
-            ConnectionPoint::Position startPosition = startCP->getPositionType();
-            if (startPosition == ConnectionPoint::Top) startConnectionPointIndex = 0;
-            else if (startPosition == ConnectionPoint::Right) startConnectionPointIndex = 1;
-            else if (startPosition == ConnectionPoint::Bottom) startConnectionPointIndex = 2;
-            else if (startPosition == ConnectionPoint::Left) startConnectionPointIndex = 3;
-        }
-        if (conn->getEndPoint() && conn->getEndPoint()->getOwner()) {
-            Shape* endShape = conn->getEndPoint()->getOwner();
-            endShapeIndex = m_shapes.indexOf(endShape);
-            ConnectionPoint* endCP = conn->getEndPoint();
-            ConnectionPoint::Position endPosition = endCP->getPositionType();
-            if (endPosition == ConnectionPoint::Top) endConnectionPointIndex = 0;
-            else if (endPosition == ConnectionPoint::Right) endConnectionPointIndex = 1;
-            else if (endPosition == ConnectionPoint::Bottom) endConnectionPointIndex = 2;
-            else if (endPosition == ConnectionPoint::Left) endConnectionPointIndex = 3;
-        }
-        shapesMetadata += QString("<flowchart:connection id=\"%1\" startX=\"%2\" startY=\"%3\" endX=\"%4\" endY=\"%5\" isArrow=\"%6\" "
-                               "startShapeIndex=\"%7\" startConnectionPointIndex=\"%8\" "
-                               "endShapeIndex=\"%9\" endConnectionPointIndex=\"%10\" />")
-                               .arg(i)
-                               .arg(startPos.x())
-                               .arg(startPos.y())
-                               .arg(endPos.x())
-                               .arg(endPos.y())
-                               .arg(isArrow ? "true" : "false")
-                               .arg(startShapeIndex)
-                               .arg(startConnectionPointIndex)
-                               .arg(endShapeIndex)
-                               .arg(endConnectionPointIndex);
-    }
-    shapesMetadata += "</flowchart:connections>";
-    shapesMetadata += "</flowchart:shapes>";
-    QString metadata = QString(
-        "<metadata>"
-        "<flowchart:settings xmlns:flowchart=\"http://flowchart.zeqi.com/ns\">"
-        "<flowchart:drawingAreaWidth>%1</flowchart:drawingAreaWidth>"
-        "<flowchart:drawingAreaHeight>%2</flowchart:drawingAreaHeight>"
-        "<flowchart:backgroundColor>%3</flowchart:backgroundColor>"
-        "</flowchart:settings>"
-        "%4"
-        "</metadata>"
-    ).arg(m_drawingAreaSize.width())
-     .arg(m_drawingAreaSize.height())
-     .arg(m_backgroundColor.name())
-     .arg(shapesMetadata);
-    QPainter painter;
-    painter.begin(&generator);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.setRenderHint(QPainter::TextAntialiasing, true);
-    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-    Shape* tempSelectedShape = m_selectedShape;
-    Connection* tempSelectedConnection = m_selectedConnection;
-    m_selectedShape = nullptr;
-    m_selectedConnection = nullptr;
-    painter.fillRect(QRect(0, 0, m_drawingAreaSize.width(), m_drawingAreaSize.height()), m_backgroundColor);
-    for (Shape* shape : m_shapes) {
-        shape->paint(&painter);
+    emit shapesCountChanged(getShapesCount());
+    emit selectionChanged();
+    return true;
+}
+bool DrawingArea::openChunkedDocument(const QString &filePath)
+{
+    clearMultySelection();
+    m_hoveredShape = nullptr;
+    m_undoStack->clear();
+    if (!m_chunkedDocument) {
+        m_chunkedDocument = new ChunkedDocument(m_scene, this);
     }
-    for (Connection* connection : m_connections) {
-        connection->paint(&painter);
+    if (!m_chunkedDocument->open(filePath)) {
+        return false;
     }
-    m_selectedShape = tempSelectedShape;
-    m_selectedConnection = tempSelectedConnection;
-    painter.end();
+    m_chunkViewport = QRect();
+    setScale(1.0);
     update();
-    QFile file(filePath);
-    if (file.open(QIODevice::ReadWrite)) {
-        QByteArray svgData = file.readAll();
-        QString svgText = QString::fromUtf8(svgData);
-        int defsEndPos = svgText.indexOf("</defs>");
-        if (defsEndPos != -1) {
-            svgText.insert(defsEndPos + 7, metadata);
-            file.seek(0);
-            file.write(svgText.toUtf8());
-            file.resize(file.pos());
-        }
-        file.close();
-    }
+    emit shapesCountChanged(getShapesCount());
+    emit selectionChanged();
     return true;
 }
-bool DrawingArea::importFromSvg(const QString &filePath)
+QFuture<bool> DrawingArea::exportToChunked(const QString &filePath)
 {
-    qDeleteAll(m_shapes);
-    m_shapes.clear();
-    qDeleteAll(m_connections);
-    m_connections.clear();
-    m_selectedShape = nullptr;
-    m_selectedConnection = nullptr;
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly))
-        return false;
-    QByteArray svgData = file.readAll();
-    file.close();
-    QDomDocument domDocument;
-    if (!domDocument.setContent(svgData))
-        return false;
-    QDomElement metadataElement = domDocument.elementsByTagName("metadata").item(0).toElement();
-    if (!metadataElement.isNull()) {
-        QDomElement settingsElement = metadataElement.firstChildElement("flowchart:settings");
-        if (!settingsElement.isNull()) {
-            QDomElement widthElement = settingsElement.firstChildElement("flowchart:drawingAreaWidth");
-            QDomElement heightElement = settingsElement.firstChildElement("flowchart:drawingAreaHeight");
-            QDomElement bgColorElement = settingsElement.firstChildElement("flowchart:backgroundColor");
-            if (!widthElement.isNull() && !heightElement.isNull()) {
-                int width = widthElement.text().toInt();
-                int height = heightElement.text().toInt();
-                m_drawingAreaSize = QSize(width, height);
-            }
-            if (!bgColorElement.isNull()) {
-                m_backgroundColor = QColor(bgColorElement.text());
-            }
-        }
-        QDomElement shapesElement = metadataElement.firstChildElement("flowchart:shapes");
-        if (!shapesElement.isNull()) {
-            QDomNodeList shapeNodes = shapesElement.elementsByTagName("flowchart:shape");
-            QMap<int, Shape*> shapeIdMap;
-            for (int i = 0; i < shapeNodes.count(); ++i) {
-                QDomElement shapeElement = shapeNodes.at(i).toElement();
-                int id = shapeElement.attribute("id").toInt();
-                QString type = shapeElement.attribute("type");
-                int x = shapeElement.attribute("x").toInt();
-                int y = shapeElement.attribute("y").toInt();
-                int width = shapeElement.attribute("width").toInt();
-                int height = shapeElement.attribute("height").toInt();
-                QString text = shapeElement.attribute("text");
-                int basis = qMin(width, height) / 2;
-                basis = qMax(basis, 30); 
-                Shape* newShape = ShapeFactory::instance().createShape(type, basis);
-                if (newShape) {
-                    QRect rect(x, y, width, height);
-                    newShape->setRect(rect);
-                    newShape->setText(text);
-                    QString fontFamily = shapeElement.attribute("fontFamily");
-                    if (!fontFamily.isEmpty()) {
-                        newShape->setFontFamily(fontFamily);
-                    }
-                    int fontSize = shapeElement.attribute("fontSize").toInt();
-                    if (fontSize > 0) {
-                        newShape->setFontSize(fontSize);
-                    }
-                    bool isBold = (shapeElement.attribute("fontBold") == "true");
-                    newShape->setFontBold(isBold);
-                    bool isItalic = (shapeElement.attribute("fontItalic") == "true");
-                    newShape->setFontItalic(isItalic);
-                    bool isUnderline = (shapeElement.attribute("fontUnderline") == "true");
-                    newShape->setFontUnderline(isUnderline);
-                    QString fontColor = shapeElement.attribute("fontColor");
-                    if (!fontColor.isEmpty()) {
-                        newShape->setFontColor(QColor(fontColor));
-                    }
-                    m_shapes.append(newShape);
-                    shapeIdMap[id] = newShape;
-                }
-            }
-            QDomNodeList connectionNodes = shapesElement.elementsByTagName("flowchart:connection");
-            for (int i = 0; i < connectionNodes.count(); ++i) {
-                QDomElement connectionElement = connectionNodes.at(i).toElement();
-                int startX = connectionElement.attribute("startX").toInt();
-                int startY = connectionElement.attribute("startY").toInt();
-                int endX = connectionElement.attribute("endX").toInt();
-                int endY = connectionElement.attribute("endY").toInt();
-                bool isArrow = (connectionElement.attribute("isArrow") == "true");
-                int startShapeIndex = connectionElement.attribute("startShapeIndex").toInt();
-                int startConnectionPointIndex = connectionElement.attribute("startConnectionPointIndex").toInt();
-                int endShapeIndex = connectionElement.attribute("endShapeIndex").toInt();
-                int endConnectionPointIndex = connectionElement.attribute("endConnectionPointIndex").toInt();
-                
-                ArrowLine* arrowLine = new ArrowLine(QPoint(startX, startY), QPoint(endX, endY));
-                bool startConnected = false;
-                bool endConnected = false;
-                if (startShapeIndex >= 0 && startShapeIndex < m_shapes.size() && 
-                    startConnectionPointIndex >= 0 && startConnectionPointIndex <= 3) {
-                    Shape* startShape = m_shapes[startShapeIndex];
-                    QVector<ConnectionPoint*> startPoints = startShape->getConnectionPoints();
-                    if (startConnectionPointIndex < startPoints.size()) {
-                        arrowLine->setStartPoint(startPoints[startConnectionPointIndex]);
-                        startConnected = true;
-                    }
-                }
-                if (endShapeIndex >= 0 && endShapeIndex < m_shapes.size() && 
-                    endConnectionPointIndex >= 0 && endConnectionPointIndex <= 3) {
-                    Shape* endShape = m_shapes[endShapeIndex];
-                    QVector<ConnectionPoint*> endPoints = endShape->getConnectionPoints();
-                    if (endConnectionPointIndex < endPoints.size()) {
-                        arrowLine->setEndPoint(endPoints[endConnectionPointIndex]);
-                        endConnected = true;
-                    }
-                }
-                m_connections.append(arrowLine);
-            }
+    if (m_chunkedDocument && m_chunkedDocument->isOpen()) {
+        QFutureInterface<bool> result(QFutureInterfaceBase::Started);
+        bool saved = m_chunkedDocument->save(filePath);
+        result.reportResult(saved);
+        result.reportFinished();
+        return result.future();
+    }
+    SceneSnapshotRef snapshot = m_scene->snapshot();
+    return QtConcurrent::run([snapshot, filePath]() {
+        return ChunkedDocument::write(*snapshot, filePath);
+    });
+}
+void DrawingArea::updateResidentChunks()
+{
+    if (!m_chunkedDocument || !m_chunkedDocument->isOpen()) {
+        return;
+    }
+    // 选中、悬停和正在编辑连线所涉及的图形所在的块不能移出
+    QSet<const Shape*> pinned;
+    pinned.insert(m_selectedShape);
+    pinned.insert(m_hoveredShape);
+    for (Shape* shape : m_multiSelectedShapes) {
+        pinned.insert(shape);
+    }
+    QVector<Connection*> connections = m_multySelectedConnections;
+    connections << m_selectedConnection << m_currentConnection;
+    for (Connection* connection : connections) {
+        if (connection) {
+            pinned.insert(connection->getStartPoint().getOwner());
+            pinned.insert(connection->getEndPoint().getOwner());
         }
     }
+    pinned.remove(nullptr);
+    quint64 revision = m_scene->revision();
+    m_chunkedDocument->setViewport(m_chunkViewport, pinned);
+    if (m_scene->revision() != revision) {
+        update();
+        emit shapesCountChanged(getShapesCount());
+    }
+}
+bool DrawingArea::recoverFromJournal(const QString &directory)
+{
+    clearMultySelection();
+    m_hoveredShape = nullptr;
+    m_undoStack->clear();
+    if (!SceneJournal::recover(*m_scene, directory)) {
+        return false;
+    }
     setScale(1.0);
     update();
     emit shapesCountChanged(getShapesCount());
@@ -1878,7 +2031,10 @@ bool DrawingArea::importFromSvg(const QString &filePath)
 void DrawingArea::setSelectedShapeFillColor(const QColor& color)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setFillColor(color);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Fill Color")));
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
         emit fillColorChanged(color);
     }
@@ -1886,7 +2042,10 @@ void DrawingArea::setSelectedShapeFillColor(const QColor& color)
 void DrawingArea::setSelectedShapeLineColor(const QColor& color)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setLineColor(color);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Line Color")));
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();  
         emit lineColorChanged(color);
     }
@@ -1894,21 +2053,30 @@ void DrawingArea::setSelectedShapeLineColor(const QColor& color)
 void DrawingArea::setSelectedShapeTransparency(int transparency)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setTransparency(transparency);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Transparency")));
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();
     }
 }
 void DrawingArea::setSelectedShapeLineWidth(qreal width)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setLineWidth(width);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Line Width")));
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();
     }
 }
 void DrawingArea::setSelectedShapeLineStyle(int style)
 {
     if (m_selectedShape) {
+        ShapeStyleRef before = m_selectedShape->style();
         m_selectedShape->setLineStyle(style);
+        m_undoStack->push(new StyleCommand(m_scene, m_selectedShape, before, tr("Change Line Style")));
+        m_scene->notifyShapeChanged(m_selectedShape);
         update();
     }
 }
@@ -1917,6 +2085,7 @@ void DrawingArea::startRectMultiSelection(const QPoint& point)
     m_isMultiRectSelecting = true;
     m_multiSelectionStart = mapToScene(point);
     m_multiSelectionRect = QRect(m_multiSelectionStart, QSize(0, 0));
+    m_isCrossingSelection = false;
     update();
 }
 void DrawingArea::updateRectMultiSelection(const QPoint& point)
@@ -1925,6 +2094,7 @@ void DrawingArea::updateRectMultiSelection(const QPoint& point)
         return;
     QPoint currentPos = mapToScene(point);
     m_multiSelectionRect = QRect(m_multiSelectionStart, currentPos).normalized();
+    m_isCrossingSelection = currentPos.x() < m_multiSelectionStart.x();
     update();
 }
 void DrawingArea::finishRectMultiSelection()
@@ -1939,23 +2109,37 @@ bool DrawingArea::isShapeCompletelyInRect(Shape* shape, const QRect& rect) const
     QRect shapeRect = shape->getRect();
     return rect.contains(shapeRect);
 }
+bool DrawingArea::isShapeTouchedByRect(Shape* shape, const QRect& rect) const
+{
+    if (!shape->getRect().intersects(rect)) {
+        return false;
+    }
+    return Geometry::polygonIntersectsRect(shape->outlinePolygon(), QRectF(rect));
+}
 void DrawingArea::selectMultiShapesInRect(const QRect& rect)
 {
     clearMultySelection();
-    for (int i = 0; i < m_shapes.size(); ++i) {
-        if (isShapeCompletelyInRect(m_shapes[i], rect)) {
-            m_multiSelectedShapes.append(m_shapes[i]);
+    for (Shape* shape : shapeCandidates(rect)) {
+        bool hit = m_isCrossingSelection ? isShapeTouchedByRect(shape, rect)
+                                         : isShapeCompletelyInRect(shape, rect);
+        if (hit) {
+            m_multiSelectedShapes.append(shape);
         }
     }
-    for (int i = 0; i < m_connections.size(); ++i) {
-        Connection* conn = m_connections[i];
+    for (Connection* conn : connectionCandidates(rect)) {
         QPoint startPos = conn->getStartPosition();
         QPoint endPos = conn->getEndPosition();
-        if (rect.contains(startPos) && rect.contains(endPos)) {
+        bool hit = m_isCrossingSelection ? Geometry::segmentIntersectsRect(startPos, endPos, QRectF(rect))
+                                         : (rect.contains(startPos) && rect.contains(endPos));
+        if (hit) {
             m_multySelectedConnections.append(conn);
             conn->setSelected(true);
         }
     }
+    applyMultiSelectionResult();
+}
+void DrawingArea::applyMultiSelectionResult()
+{
     if (m_multiSelectedShapes.size() == 1) {
         m_selectedShape = m_multiSelectedShapes.first();
         m_multiSelectedShapes.clear();
@@ -1973,6 +2157,151 @@ void DrawingArea::selectMultiShapesInRect(const QRect& rect)
         emit multiSelectionChanged(true);
     }
 }
+void DrawingArea::startLassoSelection(const QPoint& point)
+{
+    m_isLassoSelecting = true;
+    m_lassoPolygon.clear();
+    m_lassoPolygon.append(QPointF(mapToScene(point)));
+    update();
+}
+void DrawingArea::updateLassoSelection(const QPoint& point)
+{
+    if (!m_isLassoSelecting)
+        return;
+    QPointF scenePos = mapToScene(point);
+    QPointF delta = scenePos - m_lassoPolygon.last();
+    if (qAbs(delta.x()) + qAbs(delta.y()) < 3) {
+        return;
+    }
+    m_lassoPolygon.append(scenePos);
+    update();
+}
+void DrawingArea::finishLassoSelection()
+{
+    if (!m_isLassoSelecting)
+        return;
+    m_isLassoSelecting = false;
+    if (m_lassoPolygon.size() >= 3) {
+        selectMultiShapesInLasso(m_lassoPolygon);
+    }
+    m_lassoPolygon.clear();
+}
+void DrawingArea::selectMultiShapesInLasso(const QPolygonF& lasso)
+{
+    clearMultySelection();
+    QRect lassoBounds = lasso.boundingRect().toAlignedRect();
+    for (Shape* shape : shapeCandidates(lassoBounds)) {
+        if (Geometry::polygonContainsPolygon(lasso, shape->outlinePolygon())) {
+            m_multiSelectedShapes.append(shape);
+        }
+    }
+    for (Connection* conn : connectionCandidates(lassoBounds)) {
+        if (Geometry::polygonContainsSegment(lasso, conn->getStartPosition(), conn->getEndPosition())) {
+            m_multySelectedConnections.append(conn);
+            conn->setSelected(true);
+        }
+    }
+    applyMultiSelectionResult();
+}
+void DrawingArea::drawLassoPolygon(QPainter* painter)
+{
+    if (!m_isLassoSelecting || m_lassoPolygon.isEmpty())
+        return;
+    QColor fillColor(0, 120, 215, 40);
+    QColor borderColor(0, 120, 215);
+    QPolygon viewPolygon;
+    for (const QPointF& point : m_lassoPolygon) {
+        viewPolygon << mapFromScene(point.toPoint());
+    }
+    painter->save();
+    painter->setBrush(fillColor);
+    painter->setPen(QPen(borderColor, 1, Qt::DashLine));
+    painter->drawPolygon(viewPolygon);
+    painter->restore();
+}
+QVector<Shape*> DrawingArea::shapeCandidates(const QRect& rect) const
+{
+    QVector<Shape*> shapes;
+    for (SceneModel::ObjectId id : m_spatialIndex.queryShapes(rect)) {
+        if (Shape* shape = m_scene->shapeById(id)) {
+            shapes.append(shape);
+        }
+    }
+    const GeometryStore& geometry = m_scene->geometry();
+    std::sort(shapes.begin(), shapes.end(), [&geometry](const Shape* a, const Shape* b) {
+        return geometry.zKey(a->geometrySlot()) < geometry.zKey(b->geometrySlot());
+    });
+    return shapes;
+}
+QVector<Connection*> DrawingArea::connectionCandidates(const QRect& rect) const
+{
+    QVector<Connection*> connections;
+    for (SceneModel::ObjectId id : m_spatialIndex.queryConnections(rect)) {
+        if (Connection* connection = m_scene->connectionById(id)) {
+            connections.append(connection);
+        }
+    }
+    return connections;
+}
+QPoint DrawingArea::snapMovingRect(const QRect& rect, Qt::KeyboardModifiers modifiers)
+{
+    if (!m_alignmentGuidesReady) {
+        QSet<const Shape*> movingShapes;
+        for (Shape* shape : m_multiSelectedShapes) {
+            movingShapes.insert(shape);
+        }
+        if (m_selectedShape) {
+            movingShapes.insert(m_selectedShape);
+        }
+        m_alignmentGuides.build(m_scene->geometry(), movingShapes);
+        m_alignmentGuidesReady = true;
+    }
+    if (modifiers & Qt::AltModifier) {
+        m_snapResult = AlignmentGuides::SnapResult();
+        return QPoint();
+    }
+    const int SNAP_DISTANCE = 6;
+    int threshold = qMax(1, qRound(SNAP_DISTANCE / m_scale));
+    m_snapResult = m_alignmentGuides.snap(rect, threshold, m_showGrid ? m_gridSize : 0);
+    return m_snapResult.offset;
+}
+QPoint DrawingArea::findPlacementOffset(const QRect& rect) const
+{
+    if (!m_autoPlacement || rect.isEmpty()) {
+        return QPoint();
+    }
+    PlacementGrid grid;
+    grid.build(QRect(QPoint(0, 0), m_scene->pageSize()), m_scene->geometry().liveRects());
+    QRect freeRect;
+    if (!grid.findFreeRect(rect, &freeRect)) {
+        return QPoint();
+    }
+    return freeRect.topLeft() - rect.topLeft();
+}
+void DrawingArea::resetAlignmentGuides()
+{
+    m_alignmentGuides.clear();
+    m_alignmentGuidesReady = false;
+    m_snapResult = AlignmentGuides::SnapResult();
+}
+void DrawingArea::drawAlignmentGuides(QPainter* painter)
+{
+    if (!m_snapResult.hasVerticalGuide && !m_snapResult.hasHorizontalGuide)
+        return;
+    painter->save();
+    QPen guidePen(QColor(255, 0, 160), 0);
+    guidePen.setCosmetic(true);
+    painter->setPen(guidePen);
+    if (m_snapResult.hasVerticalGuide) {
+        painter->drawLine(m_snapResult.verticalGuideX, 0,
+                          m_snapResult.verticalGuideX, m_scene->pageSize().height());
+    }
+    if (m_snapResult.hasHorizontalGuide) {
+        painter->drawLine(0, m_snapResult.horizontalGuideY,
+                          m_scene->pageSize().width(), m_snapResult.horizontalGuideY);
+    }
+    painter->restore();
+}
 void DrawingArea::clearMultySelection()
 {
     m_selectedShape = nullptr;
@@ -1994,9 +2323,15 @@ void DrawingArea::drawMultiSelectionRect(QPainter* painter)
         return;
     QColor fillColor(0, 120, 215, 40);
     QColor borderColor(0, 120, 215);
+    Qt::PenStyle penStyle = Qt::DashLine;
+    if (m_isCrossingSelection) {
+        fillColor = QColor(40, 170, 80, 40);
+        borderColor = QColor(40, 170, 80);
+        penStyle = Qt::DotLine;
+    }
     painter->save();
     painter->setBrush(fillColor);
-    painter->setPen(QPen(borderColor, 1, Qt::DashLine));
+    painter->setPen(QPen(borderColor, 1, penStyle));
     QRect viewRect(mapFromScene(m_multiSelectionRect.topLeft()), 
                   mapFromScene(m_multiSelectionRect.bottomRight()));
     painter->drawRect(viewRect);
@@ -2021,6 +2356,8 @@ void DrawingArea::copyMultiSelectedShapes()
     m_copiedConnectionEndShapes.clear();
     m_copiedConnectionStartPoints.clear();
     m_copiedConnectionEndPoints.clear();
+    m_copiedConnectionStartParams.clear();
+    m_copiedConnectionEndParams.clear();
     QPoint centerPoint(0, 0);
     int totalElements = 0;
     for (Shape* shape : m_multiSelectedShapes) {
@@ -2037,17 +2374,8 @@ void DrawingArea::copyMultiSelectedShapes()
         centerPoint /= totalElements;
     }
     for (Shape* shape : m_multiSelectedShapes) {
-        QString type = shape->type();
-        int basis = shape->getRect().width() / 2;
-        Shape* copiedShape = ShapeFactory::instance().createShape(type, basis);
+        Shape* copiedShape = ShapeFactory::instance().createCopy(shape);
         if (copiedShape) {
-            copiedShape->setRect(shape->getRect());
-            copiedShape->setText(shape->text());
-            copiedShape->setFillColor(shape->fillColor());
-            copiedShape->setLineColor(shape->lineColor());
-            copiedShape->setLineWidth(shape->lineWidth());
-            copiedShape->setLineStyle(shape->lineStyle());
-            copiedShape->setTransparency(shape->transparency());
             QPoint relativePos = shape->getRect().center() - centerPoint;
             m_copiedShapes.append(copiedShape);
             m_copiedShapesPositions.append(relativePos);
@@ -2067,20 +2395,22 @@ void DrawingArea::copyMultiSelectedShapes()
             int endShapeIndex = -1;
             ConnectionPoint::Position startPosition = ConnectionPoint::Free;
             ConnectionPoint::Position endPosition = ConnectionPoint::Free;
-            if (conn->getStartPoint() && conn->getStartPoint()->getOwner()) {
-                Shape* startShape = conn->getStartPoint()->getOwner();
+            if (conn->getStartPoint().getOwner()) {
+                Shape* startShape = conn->getStartPoint().getOwner();
                 startShapeIndex = m_multiSelectedShapes.indexOf(startShape);
-                startPosition = conn->getStartPoint()->getPositionType();
+                startPosition = conn->getStartPoint().getPositionType();
             }
-            if (conn->getEndPoint() && conn->getEndPoint()->getOwner()) {
-                Shape* endShape = conn->getEndPoint()->getOwner();
+            if (conn->getEndPoint().getOwner()) {
+                Shape* endShape = conn->getEndPoint().getOwner();
                 endShapeIndex = m_multiSelectedShapes.indexOf(endShape);
-                endPosition = conn->getEndPoint()->getPositionType();
+                endPosition = conn->getEndPoint().getPositionType();
             }
             m_copiedConnectionStartShapes.append(qMakePair(i, startShapeIndex));
             m_copiedConnectionEndShapes.append(qMakePair(i, endShapeIndex));
             m_copiedConnectionStartPoints.append(startPosition);
             m_copiedConnectionEndPoints.append(endPosition);
+            m_copiedConnectionStartParams.append(conn->getStartPoint().getOutlineParam());
+            m_copiedConnectionEndParams.append(conn->getEndPoint().getOutlineParam());
         }
     }
 }
@@ -2090,25 +2420,7 @@ void DrawingArea::cutMultiSelectedShapes()
         return;
     }
     copyMultiSelectedShapes();
-    QVector<Connection*> connectionsToRemove;
-    for (Shape* shape : m_multiSelectedShapes) {
-        for (Connection* connection : m_connections) {
-            if ((connection->getStartPoint() && connection->getStartPoint()->getOwner() == shape) || 
-                (connection->getEndPoint() && connection->getEndPoint()->getOwner() == shape)) {
-                if (!connectionsToRemove.contains(connection)) {
-                    connectionsToRemove.append(connection);
-                }
-            }
-        }
-    }
-    for (Connection* connection : connectionsToRemove) {
-        m_connections.removeOne(connection);
-        delete connection;
-    }
-    for (Shape* shape : m_multiSelectedShapes) {
-        m_shapes.removeOne(shape);
-        delete shape;
-    }
+    m_undoStack->push(new RemoveObjectsCommand(m_scene, m_multiSelectedShapes, QVector<Connection*>(), tr("Delete")));
     m_multiSelectedShapes.clear();
     m_selectedShape = nullptr;
     emit shapeSelectionChanged(false);
@@ -2120,8 +2432,11 @@ void DrawingArea::setSelectedShapeX(int x)
 {
     if (!m_selectedShape) return;
     QRect rect = m_selectedShape->getRect();
+    QRect before = rect;
     rect.moveLeft(x);
     m_selectedShape->setRect(rect);
+    recordGeometry(m_selectedShape, before, tr("Move"));
+    m_scene->notifyShapeChanged(m_selectedShape);
     update();
     emit shapePositionChanged(rect.topLeft());
 }
@@ -2129,8 +2444,11 @@ void DrawingArea::setSelectedShapeY(int y)
 {
     if (!m_selectedShape) return;
     QRect rect = m_selectedShape->getRect();
+    QRect before = rect;
     rect.moveTop(y);
     m_selectedShape->setRect(rect);
+    recordGeometry(m_selectedShape, before, tr("Move"));
+    m_scene->notifyShapeChanged(m_selectedShape);
     update();
     emit shapePositionChanged(rect.topLeft());
 }
@@ -2139,8 +2457,11 @@ void DrawingArea::setSelectedShapeWidth(int width)
     if (!m_selectedShape) return;
     width = qMax(1, width);
     QRect rect = m_selectedShape->getRect();
+    QRect before = rect;
     rect.setWidth(width);
     m_selectedShape->setRect(rect);
+    recordGeometry(m_selectedShape, before, tr("Resize"));
+    m_scene->notifyShapeChanged(m_selectedShape);
     update();
     emit shapeSizeChanged(rect.size());
 }
@@ -2149,8 +2470,11 @@ void DrawingArea::setSelectedShapeHeight(int height)
     if (!m_selectedShape) return;
     height = qMax(1, height);
     QRect rect = m_selectedShape->getRect();
+    QRect before = rect;
     rect.setHeight(height);
     m_selectedShape->setRect(rect);
+    recordGeometry(m_selectedShape, before, tr("Resize"));
+    m_scene->notifyShapeChanged(m_selectedShape);
     update();
     emit shapeSizeChanged(rect.size());
 }
@@ -9,9 +9,15 @@
 #include <QAction>
 #include <QClipboard>
 #include <QScrollBar>
+#include <QFuture>
 
 
 #include "chart/shape.h" //因为要用到Shape里的枚举
+#include "chart/spatialindex.h"
+#include "chart/alignmentguides.h"
+#include "chart/scenemodel.h"
+#include "chart/sceneio.h"
+#include "chart/undostack.h"
 #include "util/Utils.h"
 
 // 添加前向声明
@@ -20,6 +26,7 @@ class Connection;
 class ArrowLine;
 class ConnectionPoint;
 class CustomTextEdit;
+class ChunkedDocument;
 
 class DrawingArea : public QWidget
 {
@@ -49,11 +56,15 @@ public:
     // 获取当前页面设置
     QColor getBackgroundColor() const;
     QSize getPageSize() const;
-    QSize getDrawingAreaSize() const { return m_drawingAreaSize; }
+    QSize getDrawingAreaSize() const { return m_scene->pageSize(); }
     bool getShowGrid() const;
     QColor getGridColor() const;
     int getGridSize() const;
     int getGridThickness() const;
+
+    // 粘贴/拖放时是否自动避开已有图形
+    void setAutoPlacement(bool enabled) { m_autoPlacement = enabled; }
+    bool getAutoPlacement() const { return m_autoPlacement; }
     
     // 缩放相关方法
     void setScale(qreal scale);
@@ -69,10 +80,16 @@ public:
     QPoint mapToScene(const QPoint& viewPoint) const;    // 将视图坐标转换为场景坐标
     QPoint mapFromScene(const QPoint& scenePoint) const; // 将场景坐标转换为视图坐标
     
+    // 文档模型
+    SceneModel* scene() const { return m_scene; }
+    // 撤销栈，场景上的所有编辑操作都通过它记录
+    UndoStack* undoStack() const { return m_undoStack; }
+
     // 获取当前选中的图形
     Shape* getSelectedShape() const { return m_selectedShape; }
+    bool hasMultiSelection() const { return !m_multiSelectedShapes.isEmpty(); }
 
-    // 图层管理相关方法
+    // 图层管理相关方法，多选时作用于全部选中图形并保持它们的相对顺序
     void moveShapeUp();
     void moveShapeDown();
     void moveShapeToTop();
@@ -102,11 +119,23 @@ public:
     void setSelectedShapeWidth(int width);
     void setSelectedShapeHeight(int height);
     
-    // 导出功能
-    bool exportToPng(const QString &filePath);
+    // 导出功能：在工作线程中读取调用时刻的场景快照，导出期间可以继续编辑
+    QFuture<bool> exportToPng(const QString &filePath);
     // SVG导出与导入功能
-    bool exportToSvg(const QString &filePath);
-    bool importFromSvg(const QString &filePath);
+    QFuture<bool> exportToSvg(const QString &filePath);
+    bool importFromSvg(const QString &filePath, const SceneIO::ProgressCallback &progress = SceneIO::ProgressCallback());
+    // 原生二进制格式（.fcd）的保存与打开
+    QFuture<bool> exportToBinary(const QString &filePath);
+    bool importFromBinary(const QString &filePath);
+    // CBOR交换格式（.cbor）的保存与打开
+    QFuture<bool> exportToCbor(const QString &filePath);
+    bool importFromCbor(const QString &filePath);
+    // 从崩溃恢复日志中恢复内容，撤销历史被清空
+    bool recoverFromJournal(const QString &directory);
+    // 分块文档（.fcm）：打开后只有视口附近的块读入场景，撤销历史被清空
+    bool openChunkedDocument(const QString &filePath);
+    // 已打开分块文档时在界面线程中保存（未读入的块直接从原文件复制），否则在工作线程中把快照分块写出
+    QFuture<bool> exportToChunked(const QString &filePath);
     
 signals:
     // 图形选择状态改变的信号
@@ -124,7 +153,17 @@ signals:
 public slots:
     // 应用页面设置
     void applyPageSettings();
-    
+    // 撤销/重做，完成后清空选择
+    void undo();
+    void redo();
+    // 命名修订：保存时询问名称；恢复可以撤销
+    void saveRevision();
+    bool restoreRevision(int index);
+    
+private slots:
+    // 按当前可见范围读入或移出分块文档的块
+    void updateResidentChunks();
+
 protected:
     void paintEvent(QPaintEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -146,12 +185,16 @@ private:
     void cancelTextEditing();
     
     // 流程图连线相关方法
-    void startConnection(ConnectionPoint* startPoint);
-    void completeConnection(ConnectionPoint* endPoint = nullptr);
+    void startConnection(const ConnectionPoint& startPoint);
+    void completeConnection(const ConnectionPoint& endPoint = ConnectionPoint());
     void cancelConnection();
     
     // 查找特定图形下最近的连接点
-    ConnectionPoint* findNearestConnectionPoint(Shape* shape, const QPoint& pos);
+    ConnectionPoint findNearestConnectionPoint(Shape* shape, const QPoint& pos);
+
+    // 轮廓锚点：靠近轮廓且不在固定连接点上时，返回轮廓锚点，否则返回最近的固定连接点
+    ConnectionPoint resolveAnchorPoint(Shape* shape, const QPoint& pos);
+    bool isNearShapeOutline(Shape* shape, const QPoint& pos) const;
 
     // 尝试将连接线连接到最近的图形连接点
     void tryConnectLineToShapes(Connection* connection);
@@ -179,6 +222,9 @@ private:
     // 新增复制粘贴多选图形的方法
     void copyMultiSelectedShapes();         // 复制多个选中的图形
     void cutMultiSelectedShapes();          // 剪切多个选中的图形
+    void createSymbolFromSelection();       // 把多选图形及其内部连线转换为符号和一个实例
+    void recordGeometry(Shape* shape, const QRect& before, const QString& text);  // 记录单个图形的移动或缩放
+    bool importWith(const std::function<bool()>& import);  // 可撤销地把全部内容替换为import读入的内容
     
     // ArrowLine相关方法
     void createArrowLine(const QPoint& startPoint, const QPoint& endPoint);
@@ -201,9 +247,34 @@ private:
     void clearMultySelection();
     void drawMultiSelectionRect(QPainter* painter);
     bool isShapeCompletelyInRect(Shape* shape, const QRect& rect) const;
+    bool isShapeTouchedByRect(Shape* shape, const QRect& rect) const;
+    void applyMultiSelectionResult();      // 根据选中结果切换单选/多选状态
+
+    // 套索选择相关方法（按住Alt在空白处拖动）
+    void startLassoSelection(const QPoint& point);
+    void updateLassoSelection(const QPoint& point);
+    void finishLassoSelection();
+    void selectMultiShapesInLasso(const QPolygonF& lasso);
+    void drawLassoPolygon(QPainter* painter);
+
+    // 空间索引预筛选出的候选对象，图形按图层由下到上排列
+    QVector<Shape*> shapeCandidates(const QRect& rect) const;
+    QVector<Connection*> connectionCandidates(const QRect& rect) const;
+
+    // 图层操作的目标：单选图形与多选图形
+    QSet<Shape*> layerTargets() const;
+
+    // 拖动时的对齐参考线与网格吸附，返回需要叠加的偏移（按住Alt临时关闭）
+    QPoint snapMovingRect(const QRect& rect, Qt::KeyboardModifiers modifiers);
+    void resetAlignmentGuides();
+    void drawAlignmentGuides(QPainter* painter);
+
+    // 为即将放入的内容查找最近的空闲区域，返回需要叠加的偏移
+    QPoint findPlacementOffset(const QRect& rect) const;
     
 private:
-    QVector<Shape*> m_shapes;
+    SceneModel* m_scene;                 // 文档模型，持有全部图形与连线
+    UndoStack* m_undoStack;              // 须先于m_scene销毁：命令可能持有从场景对象池分配的对象
     Shape* m_selectedShape;
     bool m_dragging;
     QPoint m_dragStart;
@@ -225,7 +296,6 @@ private:
     CustomTextEdit* m_textEditor;
     
     // 连线相关变量
-    QVector<Connection*> m_connections;  // 所有连线
     Connection* m_currentConnection;     // 正在创建的连线
     Shape* m_hoveredShape;               // 鼠标悬停的形状
     Connection* m_selectedConnection;    // 当前选中的连线
@@ -245,14 +315,14 @@ private:
     QVector<QPair<int, int>> m_copiedConnectionEndShapes; // 连接线终点与图形的绑定关系
     QVector<ConnectionPoint::Position> m_copiedConnectionStartPoints; // 连接线起点的连接点位置
     QVector<ConnectionPoint::Position> m_copiedConnectionEndPoints; // 连接线终点的连接点位置
+    QVector<qreal> m_copiedConnectionStartParams; // 连接线起点的轮廓锚点参数
+    QVector<qreal> m_copiedConnectionEndParams;   // 连接线终点的轮廓锚点参数
     
     bool m_movingConnectionPoint;          // 是否正在移动连接线端点
-    ConnectionPoint* m_activeConnectionPoint; // 当前活动的连接点
+    bool m_activeEndpointIsStart;          // 正在移动的是否为选中连线的起点
     QPoint m_connectionDragPoint;          // 拖动连接线端点时的临时位置
     
     // 页面设置相关变量
-    QColor m_backgroundColor;              // 页面背景颜色
-    QSize m_drawingAreaSize;               // 绘图区域尺寸，新增
     bool m_showGrid;                       // 是否显示网格
     QColor m_gridColor;                    // 网格颜色
     int m_gridSize;                        // 网格大小
@@ -263,8 +333,25 @@ private:
     bool m_isMultiRectSelecting;                // 是否正在框选
     QRect m_multiSelectionRect;                 // 框选矩形
     QPoint m_multiSelectionStart;               // 框选起点
+    bool m_isCrossingSelection;                 // 从右向左拖动：交叉选择，触碰即选中
     QVector<QPoint> m_multyShapesStartPos;      // 批量移动时记录每个图形的起始位置
     QVector<Connection*> m_multySelectedConnections; // 存储选中的连接线
+
+    // 套索选择相关变量
+    bool m_isLassoSelecting;                    // 是否正在套索选择
+    QPolygonF m_lassoPolygon;                   // 套索轨迹（场景坐标）
+
+    SpatialIndex m_spatialIndex;                // 图形与连线的空间索引，用于选择时预筛选
+
+    // 对齐参考线相关变量
+    AlignmentGuides m_alignmentGuides;          // 其余图形边缘与中心的有序索引
+    bool m_alignmentGuidesReady;                // 本次拖动是否已建立参考线
+    AlignmentGuides::SnapResult m_snapResult;   // 当前吸附结果，用于绘制参考线
+
+    bool m_autoPlacement;                       // 粘贴/拖放时自动放到最近的空位
+
+    ChunkedDocument* m_chunkedDocument;         // 打开的分块文档，没有时为nullptr
+    QRect m_chunkViewport;                      // 上次请求驻留块时的可见范围（场景坐标）
 };
 
 #endif // DRAWINGAREA_H
@@ -1,10 +1,90 @@
 ﻿#include "mainwindow.h"
+#include "chart/scenemodel.h"
+#include "chart/sceneio.h"
+#include "chart/shape.h"
+#include "chart/shapefactory.h"
+#include "chart/connection.h"
+#include "chart/objectpool.h"
 #include <QApplication>
 #include <QTranslator>
 #include <QDir>
 #include <QDebug>
 #include <QFile>
-#include "chart/shape.h"
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// Import/export benchmark: builds a document of `count` shapes chained by connections,
+// then times saving and loading it as SVG, as a native binary document and as CBOR
+static int benchmarkImport(int count)
+{
+    SceneModel scene;
+    {
+        ObjectPool::Scope poolScope(scene.pool());
+        const int columns = 300;
+        scene.setPageSize(QSize(columns * 160, (count / columns + 1) * 120));
+        Shape* previous = nullptr;
+        for (int i = 0; i < count; ++i) {
+            Shape* shape = ShapeFactory::instance().createShape(
+                static_cast<ShapeFactory::TypeId>(i % ShapeFactory::SymbolInstanceType), 40);
+            shape->setRect(QRect((i % columns) * 160, (i / columns) * 120, 120, 80));
+            shape->setText(QString("Step %1").arg(i));
+            scene.addShape(shape);
+            if (previous) {
+                ArrowLine* connection = new ArrowLine(QPoint(), QPoint());
+                connection->setStartPoint(previous->port(ConnectionPoint::Right));
+                connection->setEndPoint(shape->port(ConnectionPoint::Left));
+                scene.addConnection(connection);
+            }
+            previous = shape;
+        }
+    }
+    QTemporaryDir dir;
+    const QString svgPath = dir.filePath("benchmark.svg");
+    const QString binaryPath = dir.filePath("benchmark.fcd");
+    const QString cborPath = dir.filePath("benchmark.cbor");
+    SceneSnapshotRef snapshot = scene.snapshot();
+    QElapsedTimer timer;
+    timer.start();
+    bool svgSaved = SceneIO::exportToSvg(*snapshot, svgPath);
+    qint64 svgExportTime = timer.elapsed();
+    timer.restart();
+    bool binarySaved = SceneIO::exportToBinary(*snapshot, binaryPath);
+    qint64 binaryExportTime = timer.elapsed();
+    timer.restart();
+    bool cborSaved = SceneIO::exportToCbor(*snapshot, cborPath);
+    qint64 cborExportTime = timer.elapsed();
+    if (!svgSaved || !binarySaved || !cborSaved) {
+        qWarning() << "Failed to write benchmark documents to" << dir.path();
+        return 1;
+    }
+    SceneModel svgScene;
+    timer.restart();
+    bool svgLoaded = SceneIO::importFromSvg(svgScene, svgPath);
+    qint64 svgTime = timer.elapsed();
+    SceneModel binaryScene;
+    timer.restart();
+    bool binaryLoaded = SceneIO::importFromBinary(binaryScene, binaryPath);
+    qint64 binaryTime = timer.elapsed();
+    SceneModel cborScene;
+    timer.restart();
+    bool cborLoaded = SceneIO::importFromCbor(cborScene, cborPath);
+    qint64 cborTime = timer.elapsed();
+    QTextStream out(stdout);
+    out << QString("%1 shapes, %2 connections\n").arg(count).arg(scene.connections().size());
+    out << QString("SVG    %1 KB, export %2 ms, import %3 ms, %4 objects\n")
+               .arg(QFileInfo(svgPath).size() / 1024).arg(svgExportTime).arg(svgTime)
+               .arg(svgLoaded ? svgScene.objectCount() : 0);
+    out << QString("Binary %1 KB, export %2 ms, import %3 ms, %4 objects\n")
+               .arg(QFileInfo(binaryPath).size() / 1024).arg(binaryExportTime).arg(binaryTime)
+               .arg(binaryLoaded ? binaryScene.objectCount() : 0);
+    out << QString("CBOR   %1 KB, export %2 ms, import %3 ms, %4 objects\n")
+               .arg(QFileInfo(cborPath).size() / 1024).arg(cborExportTime).arg(cborTime)
+               .arg(cborLoaded ? cborScene.objectCount() : 0);
+    out.flush();
+    return svgLoaded && binaryLoaded && cborLoaded ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
@@ -21,17 +101,15 @@ int main(int argc, char *argv[])
         }
     }
 
+    // --bench-import [shape count] runs the import/export benchmark instead of the editor
+    const QStringList arguments = a.arguments();
+    int benchmarkIndex = arguments.indexOf("--bench-import");
+    if (benchmarkIndex >= 0) {
+        int count = arguments.value(benchmarkIndex + 1).toInt();
+        return benchmarkImport(count > 0 ? count : 100000);
+    }
+
     MainWindow w;
     w.show();
-    
-    RectangleShape::registerShape();
-    CircleShape::registerShape();
-    PentagonShape::registerShape();
-    EllipseShape::registerShape();
-    RoundedRectangleShape::registerShape();
-    DiamondShape::registerShape();
-    HexagonShape::registerShape();
-    OctagonShape::registerShape();
-    CloudShape::registerShape();
     return a.exec();
 }
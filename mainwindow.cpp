@@ -2,12 +2,14 @@
 #include "toolbar.h"
 #include "drawingarea.h"
 #include "pagesettingdialog.h"
+#include "chart/scenejournal.h"
 #include "util/Utils.h"
 #include <QAction>
 #include <QStyle>
 #include <QIcon>
 #include <QScrollArea>
 #include <QFontDatabase>
+#include <QFutureWatcher>
 #include <QColorDialog>
 #include <QFileDialog>
 #include <QMessageBox>
@@ -16,8 +18,12 @@
 #include <QGraphicsEffect>
 #include <QPropertyAnimation>
 #include <QToolButton>
+#include <QProgressDialog>
+#include <QTimer>
+#include <QStandardPaths>
+#include <QCloseEvent>
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), m_pageSettingDialog(nullptr)
+    : QMainWindow(parent), m_journal(nullptr), m_pageSettingDialog(nullptr)
 {
     setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
     setupUi();
@@ -25,6 +31,7 @@ MainWindow::MainWindow(QWidget *parent)
     resize(1900, 1000);
     connect(m_drawingArea, &DrawingArea::shapeSelectionChanged, this, &MainWindow::updateFontControls);
     connect(m_drawingArea, &DrawingArea::shapeSelectionChanged, this, &MainWindow::updateArrangeControls);
+    connect(m_drawingArea, &DrawingArea::multiSelectionChanged, this, &MainWindow::updateArrangeControls);
     connect(m_drawingArea, &DrawingArea::fontColorChanged, this, &MainWindow::updateColorButtons);
     connect(m_drawingArea, &DrawingArea::fillColorChanged, this, &MainWindow::updateColorButtons);
     connect(m_drawingArea, &DrawingArea::lineColorChanged, this, &MainWindow::updateColorButtons);
@@ -35,6 +42,7 @@ MainWindow::MainWindow(QWidget *parent)
     updateZoomSlider();
     updateFontControls();
     updateStatusBarInfo();
+    QTimer::singleShot(0, this, &MainWindow::startJournal);
 }
 MainWindow::~MainWindow()
 {
@@ -852,36 +860,41 @@ void MainWindow::exportAsPng()
     if (!filePath.endsWith(".png", Qt::CaseInsensitive)) {
         filePath += ".png";
     }
-    bool success = m_drawingArea->exportToPng(filePath);
-    if (success) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle(tr("Export Successful"));
-        msgBox.setText(tr("Flowchart has been exported to PNG image successfully!"));
-        msgBox.setIcon(QMessageBox::Information);
-        msgBox.setStyleSheet(
-            "QMessageBox { background-color: #f5f5f7; }"
-            "QLabel { font-size: 13px; min-width: 300px; }"
-            "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
-            "QPushButton { background-color: #007aff; color: white; }"
-            "QPushButton:hover { background-color: #0069d9; }"
-            "QPushButton:pressed { background-color: #0062cc; }"
-        );
-        msgBox.exec();
-    } else {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle(tr("Export Failed"));
-        msgBox.setText(tr("An error occurred while exporting the PNG image. Please check the file path and permissions."));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setStyleSheet(
-            "QMessageBox { background-color: #f5f5f7; }"
-            "QLabel { font-size: 13px; min-width: 300px; }"
-            "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
-            "QPushButton { background-color: #007aff; color: white; }"
-            "QPushButton:hover { background-color: #0069d9; }"
-            "QPushButton:pressed { background-color: #0062cc; }"
-        );
-        msgBox.exec();
-    }
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [watcher]() {
+        bool success = watcher->result();
+        watcher->deleteLater();
+        if (success) {
+            QMessageBox msgBox;
+            msgBox.setWindowTitle(tr("Export Successful"));
+            msgBox.setText(tr("Flowchart has been exported to PNG image successfully!"));
+            msgBox.setIcon(QMessageBox::Information);
+            msgBox.setStyleSheet(
+                "QMessageBox { background-color: #f5f5f7; }"
+                "QLabel { font-size: 13px; min-width: 300px; }"
+                "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
+                "QPushButton { background-color: #007aff; color: white; }"
+                "QPushButton:hover { background-color: #0069d9; }"
+                "QPushButton:pressed { background-color: #0062cc; }"
+            );
+            msgBox.exec();
+        } else {
+            QMessageBox msgBox;
+            msgBox.setWindowTitle(tr("Export Failed"));
+            msgBox.setText(tr("An error occurred while exporting the PNG image. Please check the file path and permissions."));
+            msgBox.setIcon(QMessageBox::Critical);
+            msgBox.setStyleSheet(
+                "QMessageBox { background-color: #f5f5f7; }"
+                "QLabel { font-size: 13px; min-width: 300px; }"
+                "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
+                "QPushButton { background-color: #007aff; color: white; }"
+                "QPushButton:hover { background-color: #0069d9; }"
+                "QPushButton:pressed { background-color: #0062cc; }"
+            );
+            msgBox.exec();
+        }
+    });
+    watcher->setFuture(m_drawingArea->exportToPng(filePath));
 }
 void MainWindow::exportAsSvg()
 {
@@ -891,7 +904,11 @@ void MainWindow::exportAsSvg()
     QFileDialog dialog(this, tr("Export as SVG"));
     dialog.setAcceptMode(QFileDialog::AcceptSave);
     dialog.setFileMode(QFileDialog::AnyFile);
-    dialog.setNameFilter(tr("SVG Files (*.svg)"));
+    const QString svgFilter = tr("SVG Files (*.svg)");
+    const QString binaryFilter = tr("Flowchart Documents (*.fcd)");
+    const QString cborFilter = tr("Flowchart Data (*.cbor)");
+    const QString chunkedFilter = tr("Flowchart Maps (*.fcm)");
+    dialog.setNameFilters(QStringList() << svgFilter << binaryFilter << cborFilter << chunkedFilter);
     dialog.setDirectory(QDir::homePath());
     dialog.selectFile(defaultFileName);
     dialog.setDefaultSuffix("svg");
@@ -906,46 +923,64 @@ void MainWindow::exportAsSvg()
         return;
     }
     QString filePath = dialog.selectedFiles().first();
-    if (!filePath.endsWith(".svg", Qt::CaseInsensitive)) {
-        filePath += ".svg";
-    }
-    bool success = m_drawingArea->exportToSvg(filePath);
-    if (success) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle(tr("Export Successful"));
-        msgBox.setText(tr("Flowchart has been exported to SVG vector image successfully!"));
-        msgBox.setIcon(QMessageBox::Information);
-        msgBox.setStyleSheet(
-            "QMessageBox { background-color: #f5f5f7; }"
-            "QLabel { font-size: 13px; min-width: 300px; }"
-            "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
-            "QPushButton { background-color: #007aff; color: white; }"
-            "QPushButton:hover { background-color: #0069d9; }"
-            "QPushButton:pressed { background-color: #0062cc; }"
-        );
-        msgBox.exec();
-    } else {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle(tr("Export Failed"));
-        msgBox.setText(tr("An error occurred while exporting the SVG file. Please check the file path and permissions."));
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.setStyleSheet(
-            "QMessageBox { background-color: #f5f5f7; }"
-            "QLabel { font-size: 13px; min-width: 300px; }"
-            "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
-            "QPushButton { background-color: #007aff; color: white; }"
-            "QPushButton:hover { background-color: #0069d9; }"
-            "QPushButton:pressed { background-color: #0062cc; }"
-        );
-        msgBox.exec();
+    bool binary = dialog.selectedNameFilter() == binaryFilter || filePath.endsWith(".fcd", Qt::CaseInsensitive);
+    bool cbor = !binary && (dialog.selectedNameFilter() == cborFilter || filePath.endsWith(".cbor", Qt::CaseInsensitive));
+    bool chunked = !binary && !cbor
+                   && (dialog.selectedNameFilter() == chunkedFilter || filePath.endsWith(".fcm", Qt::CaseInsensitive));
+    QString suffix = binary ? ".fcd" : cbor ? ".cbor" : chunked ? ".fcm" : ".svg";
+    if (!filePath.endsWith(suffix, Qt::CaseInsensitive)) {
+        filePath += suffix;
     }
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [watcher, binary, cbor, chunked]() {
+        bool success = watcher->result();
+        watcher->deleteLater();
+        if (success) {
+            QMessageBox msgBox;
+            msgBox.setWindowTitle(tr("Export Successful"));
+            msgBox.setText(binary ? tr("Flowchart has been saved as a flowchart document successfully!")
+                           : cbor ? tr("Flowchart has been exported as CBOR data successfully!")
+                           : chunked ? tr("Flowchart has been saved as a flowchart map successfully!")
+                                  : tr("Flowchart has been exported to SVG vector image successfully!"));
+            msgBox.setIcon(QMessageBox::Information);
+            msgBox.setStyleSheet(
+                "QMessageBox { background-color: #f5f5f7; }"
+                "QLabel { font-size: 13px; min-width: 300px; }"
+                "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
+                "QPushButton { background-color: #007aff; color: white; }"
+                "QPushButton:hover { background-color: #0069d9; }"
+                "QPushButton:pressed { background-color: #0062cc; }"
+            );
+            msgBox.exec();
+        } else {
+            QMessageBox msgBox;
+            msgBox.setWindowTitle(tr("Export Failed"));
+            msgBox.setText(tr("An error occurred while exporting the SVG file. Please check the file path and permissions."));
+            msgBox.setIcon(QMessageBox::Critical);
+            msgBox.setStyleSheet(
+                "QMessageBox { background-color: #f5f5f7; }"
+                "QLabel { font-size: 13px; min-width: 300px; }"
+                "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
+                "QPushButton { background-color: #007aff; color: white; }"
+                "QPushButton:hover { background-color: #0069d9; }"
+                "QPushButton:pressed { background-color: #0062cc; }"
+            );
+            msgBox.exec();
+        }
+    });
+    watcher->setFuture(binary ? m_drawingArea->exportToBinary(filePath)
+                       : cbor ? m_drawingArea->exportToCbor(filePath)
+                       : chunked ? m_drawingArea->exportToChunked(filePath)
+                              : m_drawingArea->exportToSvg(filePath));
 }
 void MainWindow::importFromSvg()
 {
     if (!m_drawingArea) return;
     QFileDialog dialog(this, tr("Import from SVG"));
     dialog.setFileMode(QFileDialog::ExistingFile);
-    dialog.setNameFilter(tr("SVG Files (*.svg)"));
+    dialog.setNameFilters(QStringList() << tr("Flowchart Files (*.svg *.fcd *.cbor *.fcm)") << tr("SVG Files (*.svg)")
+                                        << tr("Flowchart Documents (*.fcd)") << tr("Flowchart Data (*.cbor)")
+                                        << tr("Flowchart Maps (*.fcm)"));
     dialog.setDirectory(QDir::homePath());
     dialog.setStyleSheet(
         "QFileDialog { background-color: #f5f5f7; }"
@@ -974,7 +1009,20 @@ void MainWindow::importFromSvg()
     if (confirmBox.exec() == QMessageBox::No) {
         return;
     }
-    bool success = m_drawingArea->importFromSvg(filePath);
+    // 大文件导入时显示进度，超过300毫秒才弹出
+    QProgressDialog progressDialog(tr("Importing..."), QString(), 0, 100, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(300);
+    bool success = filePath.endsWith(".fcd", Qt::CaseInsensitive)
+        ? m_drawingArea->importFromBinary(filePath)
+        : filePath.endsWith(".cbor", Qt::CaseInsensitive)
+        ? m_drawingArea->importFromCbor(filePath)
+        : filePath.endsWith(".fcm", Qt::CaseInsensitive)
+        ? m_drawingArea->openChunkedDocument(filePath)
+        : m_drawingArea->importFromSvg(filePath, [&progressDialog](int percent) {
+              progressDialog.setValue(percent);
+          });
+    progressDialog.reset();
     if (success) {
         QMessageBox msgBox;
         msgBox.setWindowTitle(tr("Import Successful"));
@@ -1005,6 +1053,37 @@ void MainWindow::importFromSvg()
         msgBox.exec();
     }
 }
+void MainWindow::startJournal()
+{
+    QString directory = QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath("recovery");
+    m_journal = new SceneJournal(m_drawingArea->scene(), directory, this);
+    if (SceneJournal::hasRecoveryData(directory)) {
+        QMessageBox confirmBox;
+        confirmBox.setWindowTitle(tr("Recover Flowchart"));
+        confirmBox.setText(tr("The application did not exit normally last time. Do you want to recover the unsaved flowchart?"));
+        confirmBox.setIcon(QMessageBox::Question);
+        confirmBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+        confirmBox.setDefaultButton(QMessageBox::Yes);
+        confirmBox.setStyleSheet(
+            "QMessageBox { background-color: #f5f5f7; }"
+            "QLabel { font-size: 13px; min-width: 300px; }"
+            "QPushButton { border-radius: 4px; padding: 6px 12px; min-width: 80px; }"
+            "QPushButton[text=\"Yes\"] { background-color: #007aff; color: white; }"
+            "QPushButton[text=\"No\"] { background-color: #f5f5f7; border: 1px solid #ccc; }"
+        );
+        if (confirmBox.exec() == QMessageBox::Yes) {
+            m_drawingArea->recoverFromJournal(directory);
+        }
+    }
+    m_journal->start();
+}
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    if (m_journal) {
+        m_journal->discard();
+    }
+    QMainWindow::closeEvent(event);
+}
 void MainWindow::createStatusBar()
 {
     m_statusBar = new QStatusBar(this);
@@ -1161,7 +1240,7 @@ void MainWindow::onLineStyleChanged(int index)
 void MainWindow::updateArrangeControls()
 {
     Shape* selectedShape = m_drawingArea->getSelectedShape();
-    bool hasSelection = (selectedShape != nullptr);
+    bool hasSelection = (selectedShape != nullptr) || m_drawingArea->hasMultiSelection();
     m_bringToFrontButton->setEnabled(hasSelection);
     m_sendToBackButton->setEnabled(hasSelection);
     m_bringForwardButton->setEnabled(hasSelection);
@@ -19,6 +19,7 @@
 class ToolBar;
 class DrawingArea;
 class PageSettingDialog;
+class SceneJournal;
 
 class MainWindow : public QMainWindow
 {
@@ -60,6 +61,8 @@ private slots:
     void exportAsPng();
     void exportAsSvg();
     void importFromSvg();
+    // 询问是否恢复上次异常退出前的内容，然后开始记录崩溃恢复日志
+    void startJournal();
     
     // 状态栏相关槽函数
     void updateStatusBarInfo();
@@ -83,10 +86,12 @@ private:
     void setupUi();
     
     bool eventFilter(QObject *watched, QEvent *event) override;
+    void closeEvent(QCloseEvent *event) override;
     
 private:
     ToolBar *m_toolBar;
     DrawingArea *m_drawingArea;
+    SceneJournal *m_journal;
     QWidget *m_centralWidget;
     QVBoxLayout *m_mainLayout;
     QHBoxLayout *m_contentLayout;
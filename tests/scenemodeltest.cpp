@@ -0,0 +1,179 @@
+﻿#include <QtTest>
+#include "chart/scenemodel.h"
+#include "chart/scenecommands.h"
+#include "chart/shapefactory.h"
+#include "chart/shape.h"
+#include "chart/connection.h"
+// SceneModel与对象进出命令的回归测试
+class SceneModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void takeShapeKeepsOrder();
+    void deleteAndUndo();
+    void undoAdd();
+    void raiseAndLowerSelection();
+    void deleteConnectedShapesSeparately();
+    void deleteConnectionsKeepsOrder();
+
+private:
+    Shape* addShape(SceneModel& scene, int x);
+};
+Shape* SceneModelTest::addShape(SceneModel& scene, int x)
+{
+    ObjectPool::Scope poolScope(scene.pool());
+    Shape* shape = ShapeFactory::instance().createShape(ShapeFactory::RectangleType, 40);
+    shape->setRect(QRect(x, 0, 80, 40));
+    scene.addShape(shape);
+    return shape;
+}
+void SceneModelTest::takeShapeKeepsOrder()
+{
+    SceneModel scene;
+    Shape* first = addShape(scene, 0);
+    Shape* middle = addShape(scene, 100);
+    Shape* last = addShape(scene, 200);
+    QCOMPARE(scene.takeShape(middle), middle);
+    QCOMPARE(scene.shapes().size(), 2);
+    QCOMPARE(scene.indexOf(first), 0);
+    QCOMPARE(scene.indexOf(last), 1);
+    QCOMPARE(scene.indexOf(middle), -1);
+    QCOMPARE(scene.takeShape(middle), static_cast<Shape*>(nullptr));
+    delete middle;
+}
+void SceneModelTest::deleteAndUndo()
+{
+    SceneModel scene;
+    Shape* first = addShape(scene, 0);
+    Shape* middle = addShape(scene, 100);
+    Shape* last = addShape(scene, 200);
+    Connection* connection = nullptr;
+    {
+        ObjectPool::Scope poolScope(scene.pool());
+        connection = new ArrowLine(QPoint(), QPoint());
+    }
+    connection->setStartPoint(ConnectionPoint(first, ConnectionPoint::Right));
+    connection->setEndPoint(ConnectionPoint(middle, ConnectionPoint::Left));
+    scene.addConnection(connection);
+    const SceneModel::ObjectId middleId = scene.idOf(middle);
+    const SceneModel::ObjectId connectionId = scene.idOf(connection);
+
+    RemoveObjectsCommand command(&scene, QVector<Shape*>() << middle, QVector<Connection*>(), "Delete");
+    command.redo();
+    QCOMPARE(scene.shapes().size(), 2);
+    QCOMPARE(scene.connections().size(), 0);
+    QCOMPARE(scene.idOf(middle), SceneModel::InvalidId);
+    QCOMPARE(scene.indexOf(first), 0);
+    QCOMPARE(scene.indexOf(last), 1);
+
+    command.undo();
+    QCOMPARE(scene.shapes().size(), 3);
+    QCOMPARE(scene.indexOf(middle), 1);
+    QCOMPARE(scene.connections().size(), 1);
+    QCOMPARE(scene.idOf(middle), middleId);
+    QCOMPARE(scene.idOf(connection), connectionId);
+
+    command.redo();
+    QCOMPARE(scene.shapes().size(), 2);
+    QCOMPARE(scene.shapeById(middleId), static_cast<Shape*>(nullptr));
+}
+void SceneModelTest::undoAdd()
+{
+    SceneModel scene;
+    Shape* first = addShape(scene, 0);
+    Shape* added = addShape(scene, 100);
+    const SceneModel::ObjectId addedId = scene.idOf(added);
+
+    AddObjectsCommand command(&scene, QVector<Shape*>() << added, QVector<Connection*>(), "Add");
+    command.undo();
+    QCOMPARE(scene.shapes().size(), 1);
+    QCOMPARE(scene.indexOf(first), 0);
+    QCOMPARE(scene.idOf(added), SceneModel::InvalidId);
+
+    command.redo();
+    QCOMPARE(scene.shapes().size(), 2);
+    QCOMPARE(scene.indexOf(added), 1);
+    QCOMPARE(scene.idOf(added), addedId);
+}
+void SceneModelTest::raiseAndLowerSelection()
+{
+    SceneModel scene;
+    QVector<Shape*> shapes;
+    for (int i = 0; i < 5; ++i) {
+        shapes.append(addShape(scene, i * 100));
+    }
+    // 相邻的选中图形作为一组移动，保持相对顺序
+    QSet<Shape*> selection;
+    selection << shapes[1] << shapes[2] << shapes[4];
+    scene.raiseShapes(selection);
+    QCOMPARE(scene.shapes(), QVector<Shape*>() << shapes[0] << shapes[3] << shapes[1] << shapes[2] << shapes[4]);
+    scene.lowerShapes(selection);
+    QCOMPARE(scene.shapes(), QVector<Shape*>() << shapes[0] << shapes[1] << shapes[2] << shapes[4] << shapes[3]);
+    for (int i = 0; i < scene.shapes().size(); ++i) {
+        QCOMPARE(scene.indexOf(scene.shapes()[i]), i);
+    }
+}
+void SceneModelTest::deleteConnectedShapesSeparately()
+{
+    SceneModel scene;
+    Shape* a = addShape(scene, 0);
+    Shape* b = addShape(scene, 200);
+    Connection* connection = nullptr;
+    {
+        ObjectPool::Scope poolScope(scene.pool());
+        connection = new ArrowLine(QPoint(), QPoint());
+    }
+    connection->setStartPoint(ConnectionPoint(a, ConnectionPoint::Right));
+    connection->setEndPoint(ConnectionPoint(b, ConnectionPoint::Left));
+    scene.addConnection(connection);
+
+    // 删除A时连线随之移出场景，并从B的关联列表中注销，删除B的命令不会再持有它
+    RemoveObjectsCommand removeA(&scene, QVector<Shape*>() << a, QVector<Connection*>(), "Delete A");
+    removeA.redo();
+    QVERIFY(b->incidentConnections().isEmpty());
+    RemoveObjectsCommand removeB(&scene, QVector<Shape*>() << b, QVector<Connection*>(), "Delete B");
+    removeB.redo();
+    QCOMPARE(scene.shapes().size(), 0);
+    QCOMPARE(scene.connections().size(), 0);
+
+    removeB.undo();
+    QCOMPARE(scene.shapes().size(), 1);
+    QCOMPARE(scene.connections().size(), 0);
+    QVERIFY(b->incidentConnections().isEmpty());
+    removeA.undo();
+    QCOMPARE(scene.shapes().size(), 2);
+    QCOMPARE(scene.connections().size(), 1);
+    QCOMPARE(a->incidentConnections(), QVector<Connection*>() << connection);
+    QCOMPARE(b->incidentConnections(), QVector<Connection*>() << connection);
+
+    removeA.redo();
+    removeB.redo();
+    QCOMPARE(scene.shapes().size(), 0);
+    QCOMPARE(scene.connections().size(), 0);
+}
+void SceneModelTest::deleteConnectionsKeepsOrder()
+{
+    SceneModel scene;
+    Shape* a = addShape(scene, 0);
+    Shape* b = addShape(scene, 200);
+    QVector<Connection*> connections;
+    for (int i = 0; i < 4; ++i) {
+        ObjectPool::Scope poolScope(scene.pool());
+        Connection* connection = new ArrowLine(QPoint(), QPoint());
+        connection->setStartPoint(ConnectionPoint(a, ConnectionPoint::Right));
+        connection->setEndPoint(ConnectionPoint(b, ConnectionPoint::Left));
+        scene.addConnection(connection);
+        connections.append(connection);
+    }
+    RemoveObjectsCommand command(&scene, QVector<Shape*>(), QVector<Connection*>() << connections[2] << connections[0],
+                                 "Delete");
+    command.redo();
+    QCOMPARE(scene.connections(), QVector<Connection*>() << connections[1] << connections[3]);
+    QCOMPARE(a->incidentConnections().size(), 2);
+    command.undo();
+    QCOMPARE(scene.connections(), connections);
+    QCOMPARE(a->incidentConnections().size(), 4);
+}
+QTEST_MAIN(SceneModelTest)
+#include "scenemodeltest.moc"
@@ -7,250 +7,123 @@
 #include <QIcon>
 #include "chart/shape.h"
 ShapeItem::ShapeItem(const QString& type, QWidget* parent)
-    : QWidget(parent), m_type(type)
+    : QWidget(parent), m_type(type), m_typeId(ShapeFactory::typeId(type))
 {
     setFixedSize(46, 46);
-    if ( type == ShapeTypes::Circle   || type == ShapeTypes::Octagon || 
-        type == ShapeTypes::Pentagon) {
-        m_shapeRect = QRect(11, 11, 24, 24);
-    } else if (type == ShapeTypes::Ellipse||type == ShapeTypes::Rectangle|| 
-        type == ShapeTypes::RoundedRectangle|| type == ShapeTypes::Diamond||
-        type == ShapeTypes::Cloud|| type == ShapeTypes::Hexagon) {
+    switch (m_typeId) {
+    case ShapeFactory::EllipseType:
+    case ShapeFactory::RectangleType:
+    case ShapeFactory::RoundedRectangleType:
+    case ShapeFactory::DiamondType:
+    case ShapeFactory::CloudType:
+    case ShapeFactory::HexagonType:
         m_shapeRect = QRect(8, 15, 30,18);
-    } else if (type == ShapeTypes::ArrowLine) {
+        break;
+    case ShapeFactory::ArrowLineType:
         m_shapeRect = QRect(6, 23, 32, 1); 
-    } else {
+        break;
+    default:
         m_shapeRect = QRect(11, 11, 24, 24);
+        break;
     }
-    if (type == ShapeTypes::Rectangle) {
-        setToolTip(tr("Rectangle"));
-    } else if (type == ShapeTypes::Circle) {
-        setToolTip(tr("Circle"));
-    } else if (type == ShapeTypes::Pentagon) {
-        setToolTip(tr("Pentagon"));
-    } else if (type == ShapeTypes::Ellipse) {
-        setToolTip(tr("Ellipse"));
-    } else if (type == ShapeTypes::ArrowLine) {
-        setToolTip(tr("ArrowLine"));
-    } else if (type == ShapeTypes::RoundedRectangle) {
-        setToolTip(tr("RoundedRectangle"));
-    } else if (type == ShapeTypes::Diamond) {
-        setToolTip(tr("Diamond"));
-    } else if (type == ShapeTypes::Hexagon) {
-        setToolTip(tr("Hexagon"));
-    } else if (type == ShapeTypes::Octagon) {
-        setToolTip(tr("Octagon"));
-    } else if (type == ShapeTypes::Cloud) {
-        setToolTip(tr("Cloud"));
-    }
+    setToolTip(ShapeFactory::displayName(m_typeId));
     setMouseTracking(true);
 }
-void ShapeItem::paintEvent(QPaintEvent* event)
+void ShapeItem::drawShape(QPainter* painter, const QRect& rect) const
 {
-    Q_UNUSED(event);
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    QColor bgColor = QColor(250, 250, 250);
-    painter.fillRect(rect(), bgColor);
-    painter.setPen(QPen(QColor(220, 220, 220), 1));
-    painter.drawRect(rect().adjusted(0, 0, -1, -1));
-    painter.setPen(QPen(Qt::black, 1.5));
-    painter.setBrush(QBrush(QColor(255, 255, 255)));
-    if (m_type == ShapeTypes::Rectangle) {
-        painter.drawRect(m_shapeRect);
-    } else if (m_type == ShapeTypes::Circle) {
-        painter.drawEllipse(m_shapeRect);
-    } else if (m_type == ShapeTypes::Pentagon) {
-        QPolygon polygon;
-        int centerX = m_shapeRect.center().x();
-        int centerY = m_shapeRect.center().y();
-        int radius = qMin(m_shapeRect.width(), m_shapeRect.height()) / 2;
-        for (int i = 0; i < 5; ++i) {
-            double angle = i * 2 * M_PI / 5 - M_PI / 2;
-            int x = centerX + radius * cos(angle);
-            int y = centerY + radius * sin(angle);
-            polygon << QPoint(x, y);
-        }
-        painter.drawPolygon(polygon);
-    } else if (m_type == ShapeTypes::Ellipse) {
-        painter.drawEllipse(m_shapeRect);
-    } else if (m_type == ShapeTypes::ArrowLine) {
-        QPoint startPoint = m_shapeRect.topLeft();
-        QPoint endPoint = m_shapeRect.topRight();
-        painter.setPen(QPen(Qt::black, 1));
-        painter.drawLine(startPoint, endPoint);
-        const int arrowSize = 6;
-        QPoint arrowP1 = endPoint - QPoint(arrowSize, arrowSize / 2);
-        QPoint arrowP2 = endPoint - QPoint(arrowSize, -arrowSize / 2);
-        QPolygon arrow;
-        arrow << endPoint << arrowP1 << arrowP2;
-        painter.setBrush(Qt::black);
-        painter.drawPolygon(arrow);
-    } else if (m_type == ShapeTypes::RoundedRectangle) {
-        int radius = m_shapeRect.height() / 6;
-        painter.drawRoundedRect(m_shapeRect, radius, radius);
-    } else if (m_type == ShapeTypes::Diamond) {
-        QPolygon polygon;
-        int w = m_shapeRect.width();
-        int h = m_shapeRect.height();
-        polygon << QPoint(m_shapeRect.left() + w/2, m_shapeRect.top());
-        polygon << QPoint(m_shapeRect.right(), m_shapeRect.top() + h/2);
-        polygon << QPoint(m_shapeRect.left() + w/2, m_shapeRect.bottom());
-        polygon << QPoint(m_shapeRect.left(), m_shapeRect.top() + h/2);
-        painter.drawPolygon(polygon);
-    } else if (m_type == ShapeTypes::Hexagon) {
-        QPolygon polygon;
-        int w = m_shapeRect.width();
-        int h = m_shapeRect.height();
-        polygon << QPoint(m_shapeRect.left() + w/4, m_shapeRect.top());
-        polygon << QPoint(m_shapeRect.left() + 3*w/4, m_shapeRect.top());
-        polygon << QPoint(m_shapeRect.right(), m_shapeRect.top() + h/2);
-        polygon << QPoint(m_shapeRect.left() + 3*w/4, m_shapeRect.bottom());
-        polygon << QPoint(m_shapeRect.left() + w/4, m_shapeRect.bottom());
-        polygon << QPoint(m_shapeRect.left(), m_shapeRect.top() + h/2);
-        painter.drawPolygon(polygon);
-    } else if (m_type == ShapeTypes::Octagon) {
-        int w = m_shapeRect.width();
-        int h = m_shapeRect.height();
-        QPolygon polygon;
-        int wOffset = w / 4; 
-        int HOffset = h / 4; 
-        polygon << QPoint(m_shapeRect.left() + wOffset, m_shapeRect.top());
-        polygon << QPoint(m_shapeRect.right() - wOffset, m_shapeRect.top());
-        polygon << QPoint(m_shapeRect.right(), m_shapeRect.top() + HOffset);
-        polygon << QPoint(m_shapeRect.right(), m_shapeRect.bottom() - HOffset);
-        polygon << QPoint(m_shapeRect.right() - wOffset, m_shapeRect.bottom());
-        polygon << QPoint(m_shapeRect.left() + wOffset, m_shapeRect.bottom());
-        polygon << QPoint(m_shapeRect.left(), m_shapeRect.bottom() - HOffset);
-        polygon << QPoint(m_shapeRect.left(), m_shapeRect.top() + HOffset);
-        painter.drawPolygon(polygon);
-    } else if (m_type == ShapeTypes::Cloud) {
-        QRectF targetRect(m_shapeRect);
-        QPointF pointA(30, 110);
-        QPainterPath prototypeCloudPath;
-        prototypeCloudPath.moveTo(pointA);
-        prototypeCloudPath.cubicTo(QPointF(40, 130), QPointF(65, 130), QPointF(75, 108));
-        prototypeCloudPath.cubicTo(QPointF(85, 130), QPointF(115, 140), QPointF(125, 108));
-        QPointF endOfBottom(170, 105);
-        prototypeCloudPath.cubicTo(QPointF(135, 130), QPointF(160, 130), endOfBottom);
-        prototypeCloudPath.cubicTo(QPointF(200, 100), QPointF(200, 65), QPointF(175, 45));
-        prototypeCloudPath.cubicTo(QPointF(180, 15), QPointF(140, 10), QPointF(110, 30));
-        prototypeCloudPath.cubicTo(QPointF(80, 5), QPointF(40, 15), QPointF(35, 45));
-        prototypeCloudPath.cubicTo(QPointF(0, 55), QPointF(0, 90), pointA);
-        prototypeCloudPath.closeSubpath();
-        
-        QRectF prototypeCloudBoundingRect =prototypeCloudPath.boundingRect();
-        qreal protoX = prototypeCloudBoundingRect.left();
-        qreal protoY = prototypeCloudBoundingRect.top();
-        qreal protoWidth = prototypeCloudBoundingRect.width();
-        qreal protoHeight = prototypeCloudBoundingRect.height();
-        qreal scaleX = targetRect.width() / protoWidth;
-        qreal scaleY = targetRect.height() / protoHeight;
-        qreal final_dx = targetRect.left() - protoX * scaleX;
-        qreal final_dy = targetRect.top() - protoY * scaleY;
-        QTransform transform(scaleX,   
-                            0,        
-                            0,        
-                            scaleY,   
-                            final_dx, 
-                            final_dy  
-                            );
-        painter.drawPath(transform.map(prototypeCloudPath));
-    }
-}
-void ShapeItem::mousePressEvent(QMouseEvent* event)
-{
-    if (event->button() == Qt::LeftButton) {
-        QDrag* drag = new QDrag(this);
-        QMimeData* mimeData = new QMimeData;
-        mimeData->setText(m_type);
-        drag->setMimeData(mimeData);
-        QRect tempRect(
-            m_shapeRect.topLeft().x() - m_shapeRect.width()/4,   
-            m_shapeRect.topLeft().y() - m_shapeRect.height()/4,  
-            m_shapeRect.width() * 2,    
-            m_shapeRect.height() * 2    
-        );
-        QSize dragSize(92, 92); 
-        QPixmap pixmap(dragSize);
-        pixmap.fill(Qt::transparent); 
-        QPainter painter(&pixmap);
-        painter.setRenderHint(QPainter::Antialiasing);
-        painter.setPen(QPen(Qt::black, 1.5));
-        painter.setBrush(QBrush(QColor(255, 255, 255)));
-        tempRect.moveCenter(QPoint(dragSize.width()/2, dragSize.height()/2));
-        if (m_type == ShapeTypes::Rectangle) {
-            painter.drawRect(tempRect);
-        } else if (m_type == ShapeTypes::Circle) {
-            painter.drawEllipse(tempRect);
-        } else if (m_type == ShapeTypes::Pentagon) {
+    switch (m_typeId) {
+    case ShapeFactory::RectangleType:
+        painter->drawRect(rect);
+        break;
+    case ShapeFactory::CircleType:
+        painter->drawEllipse(rect);
+        break;
+    case ShapeFactory::PentagonType:
+        {
             QPolygon polygon;
-            int centerX = tempRect.center().x();
-            int centerY = tempRect.center().y();
-            int radius = qMin(tempRect.width(), tempRect.height()) / 2;
+            int centerX = rect.center().x();
+            int centerY = rect.center().y();
+            int radius = qMin(rect.width(), rect.height()) / 2;
             for (int i = 0; i < 5; ++i) {
                 double angle = i * 2 * M_PI / 5 - M_PI / 2;
                 int x = centerX + radius * cos(angle);
                 int y = centerY + radius * sin(angle);
                 polygon << QPoint(x, y);
             }
-            painter.drawPolygon(polygon);
-        } else if (m_type == ShapeTypes::Ellipse) {
-            painter.drawEllipse(tempRect);
-        } else if (m_type == ShapeTypes::ArrowLine) {
-            QPoint startPoint = tempRect.topLeft();
-            QPoint endPoint = tempRect.topRight();
-            painter.setPen(QPen(Qt::black, 1));
-            painter.drawLine(startPoint, endPoint);
+            painter->drawPolygon(polygon);
+        }
+        break;
+    case ShapeFactory::EllipseType:
+        painter->drawEllipse(rect);
+        break;
+    case ShapeFactory::ArrowLineType:
+        {
+            QPoint startPoint = rect.topLeft();
+            QPoint endPoint = rect.topRight();
+            painter->setPen(QPen(Qt::black, 1));
+            painter->drawLine(startPoint, endPoint);
             const int arrowSize = 6;
             QPoint arrowP1 = endPoint - QPoint(arrowSize, arrowSize / 2);
             QPoint arrowP2 = endPoint - QPoint(arrowSize, -arrowSize / 2);
             QPolygon arrow;
             arrow << endPoint << arrowP1 << arrowP2;
-            painter.setBrush(Qt::black);
-            painter.drawPolygon(arrow);
-
-
-        } else if (m_type == ShapeTypes::RoundedRectangle) {
-            int radius = tempRect.height() / 6;
-            painter.drawRoundedRect(tempRect, radius, radius);
-        } else if (m_type == ShapeTypes::Diamond) {
+            painter->setBrush(Qt::black);
+            painter->drawPolygon(arrow);
+        }
+        break;
+    case ShapeFactory::RoundedRectangleType:
+        {
+            int radius = rect.height() / 6;
+            painter->drawRoundedRect(rect, radius, radius);
+        }
+        break;
+    case ShapeFactory::DiamondType:
+        {
             QPolygon polygon;
-            int w = tempRect.width();
-            int h = tempRect.height();
-            polygon << QPoint(tempRect.left() + w/2, tempRect.top());
-            polygon << QPoint(tempRect.right(), tempRect.top() + h/2);
-            polygon << QPoint(tempRect.left() + w/2, tempRect.bottom());
-            polygon << QPoint(tempRect.left(), tempRect.top() + h/2);
-            painter.drawPolygon(polygon);
-        } else if (m_type == ShapeTypes::Hexagon) {
+            int w = rect.width();
+            int h = rect.height();
+            polygon << QPoint(rect.left() + w/2, rect.top());
+            polygon << QPoint(rect.right(), rect.top() + h/2);
+            polygon << QPoint(rect.left() + w/2, rect.bottom());
+            polygon << QPoint(rect.left(), rect.top() + h/2);
+            painter->drawPolygon(polygon);
+        }
+        break;
+    case ShapeFactory::HexagonType:
+        {
             QPolygon polygon;
-            int w = tempRect.width();
-            int h = tempRect.height();
-            polygon << QPoint(tempRect.left() + w/4, tempRect.top());
-            polygon << QPoint(tempRect.left() + 3*w/4, tempRect.top());
-            polygon << QPoint(tempRect.right(), tempRect.top() + h/2);
-            polygon << QPoint(tempRect.left() + 3*w/4, tempRect.bottom());
-            polygon << QPoint(tempRect.left() + w/4, tempRect.bottom());
-            polygon << QPoint(tempRect.left(), tempRect.top() + h/2);
-            painter.drawPolygon(polygon);
-        } else if (m_type == ShapeTypes::Octagon) {
-            int w = tempRect.width();
-            int h = tempRect.height();
+            int w = rect.width();
+            int h = rect.height();
+            polygon << QPoint(rect.left() + w/4, rect.top());
+            polygon << QPoint(rect.left() + 3*w/4, rect.top());
+            polygon << QPoint(rect.right(), rect.top() + h/2);
+            polygon << QPoint(rect.left() + 3*w/4, rect.bottom());
+            polygon << QPoint(rect.left() + w/4, rect.bottom());
+            polygon << QPoint(rect.left(), rect.top() + h/2);
+            painter->drawPolygon(polygon);
+        }
+        break;
+    case ShapeFactory::OctagonType:
+        {
+            int w = rect.width();
+            int h = rect.height();
             QPolygon polygon;
             int wOffset = w / 4; 
             int HOffset = h / 4; 
-            polygon << QPoint(tempRect.left() + wOffset, tempRect.top());
-            polygon << QPoint(tempRect.right() - wOffset, tempRect.top());
-            polygon << QPoint(tempRect.right(), tempRect.top() + HOffset);
-            polygon << QPoint(tempRect.right(), tempRect.bottom() - HOffset);
-            polygon << QPoint(tempRect.right() - wOffset, tempRect.bottom());
-            polygon << QPoint(tempRect.left() + wOffset, tempRect.bottom());
-            polygon << QPoint(tempRect.left(), tempRect.bottom() - HOffset);
-            polygon << QPoint(tempRect.left(), tempRect.top() + HOffset);
-            painter.drawPolygon(polygon);
-        } else if (m_type == ShapeTypes::Cloud) {
-            QRectF targetRect(tempRect);
+            polygon << QPoint(rect.left() + wOffset, rect.top());
+            polygon << QPoint(rect.right() - wOffset, rect.top());
+            polygon << QPoint(rect.right(), rect.top() + HOffset);
+            polygon << QPoint(rect.right(), rect.bottom() - HOffset);
+            polygon << QPoint(rect.right() - wOffset, rect.bottom());
+            polygon << QPoint(rect.left() + wOffset, rect.bottom());
+            polygon << QPoint(rect.left(), rect.bottom() - HOffset);
+            polygon << QPoint(rect.left(), rect.top() + HOffset);
+            painter->drawPolygon(polygon);
+        }
+        break;
+    case ShapeFactory::CloudType:
+        {
+            QRectF targetRect(rect);
             QPointF pointA(30, 110);
             QPainterPath prototypeCloudPath;
             prototypeCloudPath.moveTo(pointA);
@@ -263,6 +136,7 @@ void ShapeItem::mousePressEvent(QMouseEvent* event)
             prototypeCloudPath.cubicTo(QPointF(80, 5), QPointF(40, 15), QPointF(35, 45));
             prototypeCloudPath.cubicTo(QPointF(0, 55), QPointF(0, 90), pointA);
             prototypeCloudPath.closeSubpath();
+
             QRectF prototypeCloudBoundingRect =prototypeCloudPath.boundingRect();
             qreal protoX = prototypeCloudBoundingRect.left();
             qreal protoY = prototypeCloudBoundingRect.top();
@@ -279,8 +153,49 @@ void ShapeItem::mousePressEvent(QMouseEvent* event)
                                 final_dx, 
                                 final_dy  
                                 );
-            painter.drawPath(transform.map(prototypeCloudPath));
+            painter->drawPath(transform.map(prototypeCloudPath));
         }
+        break;
+    default:
+        break;
+    }
+
+}
+void ShapeItem::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QColor bgColor = QColor(250, 250, 250);
+    painter.fillRect(rect(), bgColor);
+    painter.setPen(QPen(QColor(220, 220, 220), 1));
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+    painter.setPen(QPen(Qt::black, 1.5));
+    painter.setBrush(QBrush(QColor(255, 255, 255)));
+    drawShape(&painter, m_shapeRect);
+}
+void ShapeItem::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton) {
+        QDrag* drag = new QDrag(this);
+        QMimeData* mimeData = new QMimeData;
+        mimeData->setText(m_type);
+        drag->setMimeData(mimeData);
+        QRect tempRect(
+            m_shapeRect.topLeft().x() - m_shapeRect.width()/4,   
+            m_shapeRect.topLeft().y() - m_shapeRect.height()/4,  
+            m_shapeRect.width() * 2,    
+            m_shapeRect.height() * 2    
+        );
+        QSize dragSize(92, 92); 
+        QPixmap pixmap(dragSize);
+        pixmap.fill(Qt::transparent); 
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(QPen(Qt::black, 1.5));
+        painter.setBrush(QBrush(QColor(255, 255, 255)));
+        tempRect.moveCenter(QPoint(dragSize.width()/2, dragSize.height()/2));
+        drawShape(&painter, tempRect);
         drag->setPixmap(pixmap);
         drag->setHotSpot(QPoint(dragSize.width()/2, dragSize.height()/2));
         drag->exec(Qt::CopyAction);
@@ -29,7 +29,11 @@ protected:
     void mouseMoveEvent(QMouseEvent* event) override;
 
 private:
+    // 按类型ID绘制工具栏图标与拖拽预览
+    void drawShape(QPainter* painter, const QRect& rect) const;
+
     QString m_type;
+    ShapeFactory::TypeId m_typeId;
     QRect m_shapeRect;
 };
 